@@ -11,6 +11,13 @@
 #include <Mathematics/GteETManifoldMesh.h>
 #include <Mathematics/GtePrimalQuery2.h>
 #include <Mathematics/GteLine.h>
+#include <algorithm>
+#include <cstdint>
+#include <random>
+#include <thread>
+#include <type_traits>
+#include <unordered_map>
+#include <unordered_set>
 #include <vector>
 
 // Delaunay triangulation of points (intrinsic dimensionality 2).
@@ -51,9 +58,11 @@ class Delaunay2
 {
 public:
     // The class is a functor to support computing the Delaunay triangulation
-    // of multiple data sets using the same class object.
+    // of multiple data sets using the same class object.  For multithreading
+    // in operator(), choose 'numThreads' subject to the constraints
+    //     1 <= numThreads <= std::thread::hardware_concurrency().
     virtual ~Delaunay2();
-    Delaunay2();
+    Delaunay2(unsigned int numThreads = 1);
 
     // The input is the array of vertices whose Delaunay triangulation is
     // required.  The epsilon value is used to determine the intrinsic
@@ -87,6 +96,13 @@ public:
     // is found later, then GetDuplicates()[j] = i.
     inline std::vector<int> const& GetDuplicates() const;
 
+    // Point-location statistics for the last call to operator().  Each
+    // point is located by walking from a triangle of the previously
+    // inserted point; GetNumWalkSteps()/GetNumLocations() is the average
+    // number of triangles visited per located point.
+    inline int GetNumLocations() const;
+    inline size_t GetNumWalkSteps() const;
+
     // Locate those triangle edges that do not share other triangles.  The
     // returned array has hull.size() = 2*numEdges, each pair representing an
     // edge.  The edges are not ordered, but the pair of vertices for an edge
@@ -136,11 +152,66 @@ public:
 protected:
     // Support for incremental Delaunay triangulation.
     typedef ETManifoldMesh::Triangle Triangle;
-    bool GetContainingTriangle(int i, Triangle*& tri) const;
-    bool GetAndRemoveInsertionPolygon(int i,
-        std::set<Triangle*>& candidates, std::set<EdgeKey<true>>& boundary);
+    bool GetContainingTriangle(int i, Triangle*& tri);
+    bool GetAndRemoveInsertionPolygon(int i);
     bool Update(int i);
 
+    // Reorder the points to be inserted using a biased randomized insertion
+    // order (BRIO):  a random permutation is split into rounds of doubling
+    // size, and each round is sorted along a Hilbert curve, alternating the
+    // direction so that the end of one round is near the start of the next.
+    // Consecutive insertions are then spatially close, which keeps the walks
+    // in GetContainingTriangle short.
+    void SortInsertionOrder(std::vector<int>& order) const;
+    static uint32_t GetHilbertIndex(uint32_t x, uint32_t y);
+
+    // Hull edge j of 'tri' is <tri->V[mIndex[j][0]], tri->V[mIndex[j][1]]>.
+    // Move to the next (counterclockwise) or previous hull edge by rotating
+    // about the shared vertex through the triangles that contain it.
+    void GetNextHullEdge(Triangle*& tri, int& j) const;
+    void GetPreviousHullEdge(Triangle*& tri, int& j) const;
+
+    // Support for multithreaded triangulation.  The unique points, sorted by
+    // x with ties broken by y, are split into one strip per thread and each
+    // strip is triangulated by its own thread.  A strip triangle whose closed
+    // circumdisk lies strictly between the neighboring strips contains no
+    // point of another strip, so it is a triangle of the full triangulation;
+    // call it safe.  Every edge separating a safe triangle from the rest of
+    // the hull is an edge of any Delaunay triangulation of the points not
+    // interior to the safe region.  Those points are triangulated again, and
+    // the triangles on the unsafe side of the separating edges complete the
+    // mesh.  The function returns 'false' when the points are too few to
+    // split or the stitching fails (ComputeType not exact?); operator() then
+    // inserts serially.  On success the indices and adjacencies are
+    // assembled directly, and mGraph is created by GetGraph() only when it
+    // is requested.
+    bool UpdateParallel(std::vector<int> const& unique);
+    bool IsCircumdiskBetween(int v0, int v1, int v2, int left, int right)
+        const;
+
+    // Scratch storage for Update, kept between insertions (and between
+    // triangulations) so that inserting a point does not allocate once the
+    // containers have grown.  The candidates are the triangles whose
+    // circumcircles contain the point and are still to be removed; the
+    // polygon collects the removed triangles so that mBoundary can receive
+    // the boundary edges of the insertion polygon.  mHull stores the hull
+    // edges visible to a point outside the hull as <triangle,edge> pairs.
+    std::vector<Triangle*> mCandidates;
+    std::unordered_set<Triangle*> mPending;
+    ETManifoldMesh mPolygon;
+    std::vector<EdgeKey<true>> mBoundary;
+    std::vector<std::pair<Triangle*, int>> mHull;
+    std::vector<EdgeKey<true>> mVisible;
+
+    // The walk for the next point starts at the last triangle inserted by
+    // Update.  That triangle is still in mGraph when the next point is
+    // located, because triangles are removed only after the location.
+    Triangle* mLastTriangle;
+    int mNumLocations;
+    size_t mNumWalkSteps;
+
+    unsigned int mNumThreads;
+
     // The epsilon value is used for fuzzy determination of intrinsic
     // dimensionality.  If the dimension is 0 or 1, the constructor returns
     // early.  The caller is responsible for retrieving the dimension and
@@ -158,12 +229,17 @@ protected:
     std::vector<Vector2<ComputeType>> mComputeVertices;
     PrimalQuery2<ComputeType> mQuery;
 
+    // Double copies of float or double input, used by mQuery to decide most
+    // predicates without ComputeType arithmetic.  Empty for other inputs.
+    std::vector<Vector2<double>> mFilterVertices;
+
     // The graph information.
     int mNumVertices;
     int mNumUniqueVertices;
     int mNumTriangles;
     Vector2<InputType> const* mVertices;
-    ETManifoldMesh mGraph;
+    mutable ETManifoldMesh mGraph;
+    mutable bool mGraphDeferred;
     std::vector<int> mIndices;
     std::vector<int> mAdjacencies;
 
@@ -171,17 +247,6 @@ protected:
     // constructor, the first processed occurrence of that vertex has an
     // index stored in this array.  If there are no duplicates, then
     // mDuplicates[i] = i for all i.
-
-    struct ProcessedVertex
-    {
-        ProcessedVertex();
-        ProcessedVertex(Vector2<InputType> const& inVertex, int inLocation);
-        bool operator<(ProcessedVertex const& v) const;
-
-        Vector2<InputType> vertex;
-        int location;
-    };
-
     std::vector<int> mDuplicates;
 
     // Indexing for the vertices of the triangle adjacent to a vertex.  The
@@ -200,15 +265,20 @@ Delaunay2<InputType, ComputeType>::~Delaunay2()
 }
 
 template <typename InputType, typename ComputeType>
-Delaunay2<InputType, ComputeType>::Delaunay2()
+Delaunay2<InputType, ComputeType>::Delaunay2(unsigned int numThreads)
     :
+    mLastTriangle(nullptr),
+    mNumLocations(0),
+    mNumWalkSteps(0),
+    mNumThreads(numThreads),
     mEpsilon((InputType)0),
     mDimension(0),
     mLine(Vector2<InputType>::Zero(), Vector2<InputType>::Zero()),
     mNumVertices(0),
     mNumUniqueVertices(0),
     mNumTriangles(0),
-    mVertices(nullptr)
+    mVertices(nullptr),
+    mGraphDeferred(false)
 {
     // INVESTIGATE.  If the initialization of mIndex is placed in the
     // constructor initializer list, MSVS 2012 generates an internal
@@ -228,10 +298,14 @@ bool Delaunay2<InputType, ComputeType>::operator()(int numVertices,
     mNumUniqueVertices = 0;
     mNumTriangles = 0;
     mVertices = vertices;
+    mGraphDeferred = false;
     mGraph.Clear();
     mIndices.clear();
     mAdjacencies.clear();
     mDuplicates.resize(std::max(numVertices, 3));
+    mLastTriangle = nullptr;
+    mNumLocations = 0;
+    mNumWalkSteps = 0;
 
     int i, j;
     if (mNumVertices < 3)
@@ -267,6 +341,75 @@ bool Delaunay2<InputType, ComputeType>::operator()(int numVertices,
             mComputeVertices[i][j] = vertices[i][j];
         }
     }
+    if (std::is_same<InputType, float>::value
+        || std::is_same<InputType, double>::value)
+    {
+        mFilterVertices.resize(mNumVertices);
+        for (i = 0; i < mNumVertices; ++i)
+        {
+            for (j = 0; j < 2; ++j)
+            {
+                mFilterVertices[i][j] = static_cast<double>(vertices[i][j]);
+            }
+        }
+        mQuery.SetFilter(&mFilterVertices[0]);
+    }
+
+    // Sort the points to eliminate duplicates, either in the original input
+    // points or in the points obtained by snap rounding.  A point that occurs
+    // multiple times is represented by the occurrence that is one of the
+    // extreme points (if any) or else by its first occurrence, so mDuplicates
+    // does not depend on the insertion order chosen below.
+    std::vector<int> unique(mNumVertices);
+    for (i = 0; i < mNumVertices; ++i)
+    {
+        unique[i] = i;
+    }
+    std::sort(unique.begin(), unique.end(), [vertices](int i0, int i1)
+    {
+        return vertices[i0] < vertices[i1]
+            || (vertices[i0] == vertices[i1] && i0 < i1);
+    });
+    int numUnique = 0;
+    for (int k0 = 0, k1; k0 < mNumVertices; k0 = k1)
+    {
+        int location = unique[k0];
+        for (k1 = k0 + 1; k1 < mNumVertices; ++k1)
+        {
+            if (!(vertices[unique[k1]] == vertices[location]))
+            {
+                break;
+            }
+        }
+        for (int k = k0; k < k1; ++k)
+        {
+            j = unique[k];
+            if (j == info.extreme[0] || j == info.extreme[1]
+                || j == info.extreme[2])
+            {
+                location = j;
+            }
+        }
+        for (int k = k0; k < k1; ++k)
+        {
+            mDuplicates[unique[k]] = location;
+        }
+        unique[numUnique++] = location;
+    }
+    unique.resize(numUnique);
+    mNumUniqueVertices = numUnique;
+
+    if (mNumThreads > 1)
+    {
+        if (UpdateParallel(unique))
+        {
+            return true;
+        }
+        mIndices.clear();
+        mAdjacencies.clear();
+        mNumLocations = 0;
+        mNumWalkSteps = 0;
+    }
 
     // Insert the (nondegenerate) triangle constructed by the call to
     // GetInformation.  This is necessary for the circumcircle-visibility
@@ -275,42 +418,34 @@ bool Delaunay2<InputType, ComputeType>::operator()(int numVertices,
     {
         std::swap(info.extreme[1], info.extreme[2]);
     }
-    mGraph.Insert(info.extreme[0], info.extreme[1], info.extreme[2]);
+    mLastTriangle = mGraph.Insert(info.extreme[0], info.extreme[1],
+        info.extreme[2]);
 
-    // Incrementally update the triangulation.  The set of processed points
-    // is maintained to eliminate duplicates, either in the original input
-    // points or in the points obtained by snap rounding.
-    std::set<ProcessedVertex> processed;
-    for (i = 0; i < 3; ++i)
-    {
-        j = info.extreme[i];
-        processed.insert(ProcessedVertex(vertices[j], j));
-        mDuplicates[j] = j;
-    }
+    // Incrementally update the triangulation.
+    std::vector<int> order;
+    order.reserve(mNumUniqueVertices);
     for (i = 0; i < mNumVertices; ++i)
     {
-        ProcessedVertex v(vertices[i], i);
-        auto iter = processed.find(v);
-        if (iter == processed.end())
+        if (mDuplicates[i] == i && i != info.extreme[0]
+            && i != info.extreme[1] && i != info.extreme[2])
         {
-            if (!Update(i))
-            {
-                // A failure can occur if ComputeType is not an exact
-                // arithmetic type.
-                return false;
-            }
-            processed.insert(v);
-            mDuplicates[i] = i;
+            order.push_back(i);
         }
-        else
+    }
+    SortInsertionOrder(order);
+    for (auto k : order)
+    {
+        if (!Update(k))
         {
-            mDuplicates[i] = iter->location;
+            // A failure can occur if ComputeType is not an exact
+            // arithmetic type.
+            return false;
         }
     }
-    mNumUniqueVertices = static_cast<int>(processed.size());
 
     // Assign integer values to the triangles for use by the caller.
-    std::map<Triangle*, int> permute;
+    std::unordered_map<Triangle*, int> permute;
+    permute.reserve(mGraph.GetTriangles().size() + 1);
     i = -1;
     permute[nullptr] = i++;
     for (auto const& element : mGraph.GetTriangles())
@@ -393,6 +528,16 @@ Delaunay2<InputType, ComputeType>::GetQuery() const
 template <typename InputType, typename ComputeType> inline
 ETManifoldMesh const& Delaunay2<InputType, ComputeType>::GetGraph() const
 {
+    // The multithreaded triangulation creates the graph only on demand.
+    if (mGraphDeferred)
+    {
+        for (int t = 0; t < mNumTriangles; ++t)
+        {
+            mGraph.Insert(mIndices[3 * t], mIndices[3 * t + 1],
+                mIndices[3 * t + 2]);
+        }
+        mGraphDeferred = false;
+    }
     return mGraph;
 }
 
@@ -416,6 +561,18 @@ std::vector<int> const& Delaunay2<InputType, ComputeType>::GetDuplicates()
     return mDuplicates;
 }
 
+template <typename InputType, typename ComputeType> inline
+int Delaunay2<InputType, ComputeType>::GetNumLocations() const
+{
+    return mNumLocations;
+}
+
+template <typename InputType, typename ComputeType> inline
+size_t Delaunay2<InputType, ComputeType>::GetNumWalkSteps() const
+{
+    return mNumWalkSteps;
+}
+
 template <typename InputType, typename ComputeType>
 bool Delaunay2<InputType, ComputeType>::GetHull(std::vector<int>& hull) const
 {
@@ -589,11 +746,13 @@ int Delaunay2<InputType, ComputeType>::GetContainingTriangle(
 
 template <typename InputType, typename ComputeType>
 bool Delaunay2<InputType, ComputeType>::GetContainingTriangle(int i,
-    Triangle*& tri) const
+    Triangle*& tri)
 {
+    ++mNumLocations;
     int numTriangles = static_cast<int>(mGraph.GetTriangles().size());
     for (int t = 0; t < numTriangles; ++t)
     {
+        ++mNumWalkSteps;
         int j;
         for (j = 0; j < 3; ++j)
         {
@@ -611,9 +770,9 @@ bool Delaunay2<InputType, ComputeType>::GetContainingTriangle(int i,
                 else
                 {
                     // We reached a hull edge, so the point is outside the
-                    // hull.  TODO:  Once a hull data structure is in place,
-                    // return tri->T[j] as the candidate for starting a search
-                    // for visible hull edges.
+                    // hull.  The edge <v0,v1> of 'tri' is visible to point i
+                    // and is the starting point for Update's search for the
+                    // other visible hull edges.
                     return false;
                 }
             }
@@ -633,20 +792,21 @@ bool Delaunay2<InputType, ComputeType>::GetContainingTriangle(int i,
 }
 
 template <typename InputType, typename ComputeType>
-bool Delaunay2<InputType, ComputeType>::GetAndRemoveInsertionPolygon(int i,
-    std::set<Triangle*>& candidates, std::set<EdgeKey<true>>& boundary)
+bool Delaunay2<InputType, ComputeType>::GetAndRemoveInsertionPolygon(int i)
 {
-    // Locate the triangles that make up the insertion polygon.
-    ETManifoldMesh polygon;
-    while (candidates.size() > 0)
+    // Locate the triangles that make up the insertion polygon.  On entry,
+    // mCandidates and mPending hold the same initial triangles.
+    mPolygon.Clear();
+    while (mCandidates.size() > 0)
     {
-        Triangle* tri = *candidates.begin();
-        candidates.erase(candidates.begin());
+        Triangle* tri = mCandidates.back();
+        mCandidates.pop_back();
+        mPending.erase(tri);
 
         for (int j = 0; j < 3; ++j)
         {
             Triangle* adj = tri->T[j];
-            if (adj && candidates.find(adj) == candidates.end())
+            if (adj && mPending.find(adj) == mPending.end())
             {
                 int a0 = adj->V[0];
                 int a1 = adj->V[1];
@@ -654,12 +814,13 @@ bool Delaunay2<InputType, ComputeType>::GetAndRemoveInsertionPolygon(int i,
                 if (mQuery.ToCircumcircle(i, a0, a1, a2) <= 0)
                 {
                     // Point i is in the circumcircle.
-                    candidates.insert(adj);
+                    mCandidates.push_back(adj);
+                    mPending.insert(adj);
                 }
             }
         }
 
-        if (!polygon.Insert(tri->V[0], tri->V[1], tri->V[2]))
+        if (!mPolygon.Insert(tri->V[0], tri->V[1], tri->V[2]))
         {
             return false;
         }
@@ -669,15 +830,17 @@ bool Delaunay2<InputType, ComputeType>::GetAndRemoveInsertionPolygon(int i,
         }
     }
 
-    // Get the boundary edges of the insertion polygon.
-    for (auto const& element : polygon.GetTriangles())
+    // Get the boundary edges of the insertion polygon.  Each boundary edge
+    // belongs to exactly one polygon triangle, so there are no duplicates.
+    mBoundary.clear();
+    for (auto const& element : mPolygon.GetTriangles())
     {
         Triangle const* tri = element.second;
         for (int j = 0; j < 3; ++j)
         {
             if (!tri->T[j])
             {
-                boundary.insert(EdgeKey<true>(
+                mBoundary.push_back(EdgeKey<true>(
                     tri->V[mIndex[j][0]],
                     tri->V[mIndex[j][1]]));
             }
@@ -693,8 +856,7 @@ bool Delaunay2<InputType, ComputeType>::Update(int i)
     // failure to insert.  The Update function will return 'false' when
     // the insertion fails.
 
-    auto const& tmap = mGraph.GetTriangles();
-    Triangle* tri = tmap.begin()->second;
+    Triangle* tri = mLastTriangle;
     if (GetContainingTriangle(i, tri))
     {
         // The point is inside the convex hull.  The insertion polygon
@@ -703,27 +865,29 @@ bool Delaunay2<InputType, ComputeType>::Update(int i)
 
         // Use a depth-first search for those triangles whose circumcircles
         // contain point i.
-        std::set<Triangle*> candidates;
-        candidates.insert(tri);
+        mCandidates.clear();
+        mPending.clear();
+        mCandidates.push_back(tri);
+        mPending.insert(tri);
 
         // Get the boundary of the insertion polygon C that contains the
         // triangles whose circumcircles contain point i.  C contains the
         // point i.
-        std::set<EdgeKey<true>> boundary;
-        if (!GetAndRemoveInsertionPolygon(i, candidates, boundary))
+        if (!GetAndRemoveInsertionPolygon(i))
         {
             return false;
         }
 
         // The insertion polygon consists of the triangles formed by
         // point i and the faces of C.
-        for (auto const& key : boundary)
+        for (auto const& key : mBoundary)
         {
             int v0 = key.V[0];
             int v1 = key.V[1];
             if (mQuery.ToLine(i, v0, v1) < 0)
             {
-                if (!mGraph.Insert(i, v0, v1))
+                mLastTriangle = mGraph.Insert(i, v0, v1);
+                if (!mLastTriangle)
                 {
                     return false;
                 }
@@ -738,91 +902,110 @@ bool Delaunay2<InputType, ComputeType>::Update(int i)
         // is formed by point i and any triangles in the current
         // triangulation whose circumcircles contain point i.
 
-        // Locate the convex hull of the triangles.  TODO:  Maintain a hull
-        // data structure that is updated incrementally.
-        std::set<EdgeKey<true>> hull;
-        for (auto const& element : tmap)
+        // The walk stopped at a hull edge of 'tri' that is visible to point
+        // i.  The visible hull edges form a contiguous chain, so collect them
+        // by following the hull in both directions from that edge.
+        int j;
+        for (j = 0; j < 3; ++j)
         {
-            Triangle const* t = element.second;
-            for (int j = 0; j < 3; ++j)
+            if (!tri->T[j] && mQuery.ToLine(i, tri->V[mIndex[j][0]],
+                tri->V[mIndex[j][1]]) > 0)
+            {
+                break;
+            }
+        }
+        if (j == 3)
+        {
+            LogError("Unexpected condition (ComputeType not exact?)");
+            return false;
+        }
+
+        mHull.clear();
+        mHull.push_back(std::make_pair(tri, j));
+        Triangle* adj = tri;
+        int k = j;
+        for (;;)
+        {
+            GetNextHullEdge(adj, k);
+            if ((adj == tri && k == j) || mQuery.ToLine(i,
+                adj->V[mIndex[k][0]], adj->V[mIndex[k][1]]) <= 0)
             {
-                if (!t->T[j])
+                break;
+            }
+            mHull.push_back(std::make_pair(adj, k));
+        }
+        if (adj != tri || k != j)
+        {
+            adj = tri;
+            k = j;
+            for (;;)
+            {
+                GetPreviousHullEdge(adj, k);
+                if ((adj == tri && k == j) || mQuery.ToLine(i,
+                    adj->V[mIndex[k][0]], adj->V[mIndex[k][1]]) <= 0)
                 {
-                    hull.insert(EdgeKey<true>(
-                        t->V[mIndex[j][0]],
-                        t->V[mIndex[j][1]]));
+                    break;
                 }
+                mHull.push_back(std::make_pair(adj, k));
             }
         }
 
-        // TODO:  Until the hull change, for now just iterate over all the
-        // hull edges and use the ones visible to point i to locate the
-        // insertion polygon.
-        auto const& emap = mGraph.GetEdges();
-        std::set<Triangle*> candidates;
-        std::set<EdgeKey<true>> visible;
-        for (auto const& key : hull)
+        // Use the visible hull edges to locate the insertion polygon.
+        mCandidates.clear();
+        mPending.clear();
+        mVisible.clear();
+        for (auto const& edge : mHull)
         {
-            int v0 = key.V[0];
-            int v1 = key.V[1];
-            if (mQuery.ToLine(i, v0, v1) > 0)
+            adj = edge.first;
+            if (mPending.find(adj) == mPending.end())
             {
-                auto iter = emap.find(EdgeKey<false>(v0, v1));
-                if (iter != emap.end() && iter->second->T[1] == nullptr)
+                int a0 = adj->V[0];
+                int a1 = adj->V[1];
+                int a2 = adj->V[2];
+                if (mQuery.ToCircumcircle(i, a0, a1, a2) <= 0)
                 {
-                    Triangle* adj = iter->second->T[0];
-                    if (adj && candidates.find(adj) == candidates.end())
-                    {
-                        int a0 = adj->V[0];
-                        int a1 = adj->V[1];
-                        int a2 = adj->V[2];
-                        if (mQuery.ToCircumcircle(i, a0, a1, a2) <= 0)
-                        {
-                            // Point i is in the circumcircle.
-                            candidates.insert(adj);
-                        }
-                        else
-                        {
-                            // Point i is not in the circumcircle but the hull
-                            // edge is visible.
-                            visible.insert(key);
-                        }
-                    }
+                    // Point i is in the circumcircle.
+                    mCandidates.push_back(adj);
+                    mPending.insert(adj);
                 }
                 else
                 {
-                    LogError("Unexpected condition (ComputeType not exact?)");
-                    return false;
+                    // Point i is not in the circumcircle but the hull edge
+                    // is visible.
+                    mVisible.push_back(EdgeKey<true>(
+                        adj->V[mIndex[edge.second][0]],
+                        adj->V[mIndex[edge.second][1]]));
                 }
             }
         }
 
         // Get the boundary of the insertion subpolygon C that contains the
         // triangles whose circumcircles contain point i.
-        std::set<EdgeKey<true>> boundary;
-        if (!GetAndRemoveInsertionPolygon(i, candidates, boundary))
+        if (!GetAndRemoveInsertionPolygon(i))
         {
             return false;
         }
 
         // The insertion polygon P consists of the triangles formed by point i
         // and the back edges of C *and* the visible edges of mGraph-C.
-        for (auto const& key : boundary)
+        for (auto const& key : mBoundary)
         {
             int v0 = key.V[0];
             int v1 = key.V[1];
             if (mQuery.ToLine(i, v0, v1) < 0)
             {
                 // This is a back edge of the boundary.
-                if (!mGraph.Insert(i, v0, v1))
+                mLastTriangle = mGraph.Insert(i, v0, v1);
+                if (!mLastTriangle)
                 {
                     return false;
                 }
             }
         }
-        for (auto const& key : visible)
+        for (auto const& key : mVisible)
         {
-            if (!mGraph.Insert(i, key.V[1], key.V[0]))
+            mLastTriangle = mGraph.Insert(i, key.V[1], key.V[0]);
+            if (!mLastTriangle)
             {
                 return false;
             }
@@ -833,25 +1016,541 @@ bool Delaunay2<InputType, ComputeType>::Update(int i)
 }
 
 template <typename InputType, typename ComputeType>
-Delaunay2<InputType, ComputeType>::ProcessedVertex::ProcessedVertex()
+void Delaunay2<InputType, ComputeType>::SortInsertionOrder(
+    std::vector<int>& order) const
+{
+    int const numOrder = static_cast<int>(order.size());
+    if (numOrder < 2)
+    {
+        return;
+    }
+
+    // Quantize the points to a 2^16-by-2^16 grid over their bounding box.
+    // The same scale is used for both axes so that the curve is not
+    // stretched.
+    Vector2<double> vmin, vmax;
+    for (int j = 0; j < 2; ++j)
+    {
+        vmin[j] = static_cast<double>(mVertices[order[0]][j]);
+        vmax[j] = vmin[j];
+    }
+    for (auto i : order)
+    {
+        for (int j = 0; j < 2; ++j)
+        {
+            double value = static_cast<double>(mVertices[i][j]);
+            vmin[j] = std::min(vmin[j], value);
+            vmax[j] = std::max(vmax[j], value);
+        }
+    }
+    double extent = std::max(vmax[0] - vmin[0], vmax[1] - vmin[1]);
+    double scale = (extent > 0.0 ? 65535.0 / extent : 0.0);
+
+    std::shuffle(order.begin(), order.end(), std::default_random_engine());
+
+    // The last round is the second half of the permutation, the round before
+    // it the quarter before that, and so on.  Small rounds are not split.
+    std::vector<int> bounds;
+    for (int end = numOrder; end > 0; end /= 2)
+    {
+        bounds.push_back(end);
+        if (end <= 64)
+        {
+            break;
+        }
+    }
+    bounds.push_back(0);
+    std::reverse(bounds.begin(), bounds.end());
+
+    std::vector<std::pair<uint32_t, int>> keys;
+    keys.reserve(numOrder);
+    for (size_t r = 0; r + 1 < bounds.size(); ++r)
+    {
+        keys.clear();
+        for (int k = bounds[r]; k < bounds[r + 1]; ++k)
+        {
+            int i = order[k];
+            double x = static_cast<double>(mVertices[i][0]) - vmin[0];
+            double y = static_cast<double>(mVertices[i][1]) - vmin[1];
+            keys.push_back(std::make_pair(GetHilbertIndex(
+                static_cast<uint32_t>(x * scale),
+                static_cast<uint32_t>(y * scale)), i));
+        }
+        std::sort(keys.begin(), keys.end());
+        if (r & 1)
+        {
+            std::reverse(keys.begin(), keys.end());
+        }
+        int k = bounds[r];
+        for (auto const& key : keys)
+        {
+            order[k++] = key.second;
+        }
+    }
+}
+
+template <typename InputType, typename ComputeType>
+uint32_t Delaunay2<InputType, ComputeType>::GetHilbertIndex(uint32_t x,
+    uint32_t y)
 {
+    // Distance along the Hilbert curve of order 16 that starts at (0,0) and
+    // ends at (65535,0).
+    uint32_t const n = 65536;
+    uint32_t d = 0;
+    for (uint32_t s = n / 2; s > 0; s /= 2)
+    {
+        uint32_t rx = ((x & s) > 0 ? 1 : 0);
+        uint32_t ry = ((y & s) > 0 ? 1 : 0);
+        d += s * s * ((3 * rx) ^ ry);
+        if (ry == 0)
+        {
+            if (rx == 1)
+            {
+                x = n - 1 - x;
+                y = n - 1 - y;
+            }
+            std::swap(x, y);
+        }
+    }
+    return d;
 }
 
 template <typename InputType, typename ComputeType>
-Delaunay2<InputType, ComputeType>::ProcessedVertex::ProcessedVertex(
-    Vector2<InputType> const& inVertex, int inLocation)
-    :
-    vertex(inVertex),
-    location(inLocation)
+void Delaunay2<InputType, ComputeType>::GetNextHullEdge(Triangle*& tri,
+    int& j) const
+{
+    // Rotate clockwise about the end vertex of the edge until reaching the
+    // hull edge that starts at that vertex.
+    int v = tri->V[mIndex[j][1]];
+    j = mIndex[j][1];
+    while (tri->T[j])
+    {
+        tri = tri->T[j];
+        for (j = 0; j < 3; ++j)
+        {
+            if (tri->V[j] == v)
+            {
+                break;
+            }
+        }
+    }
+}
+
+template <typename InputType, typename ComputeType>
+void Delaunay2<InputType, ComputeType>::GetPreviousHullEdge(Triangle*& tri,
+    int& j) const
+{
+    // Rotate counterclockwise about the start vertex of the edge until
+    // reaching the hull edge that ends at that vertex.
+    int v = tri->V[mIndex[j][0]];
+    j = (j + 2) % 3;
+    while (tri->T[j])
+    {
+        tri = tri->T[j];
+        for (j = 0; j < 3; ++j)
+        {
+            if (tri->V[j] == v)
+            {
+                break;
+            }
+        }
+        j = (j + 2) % 3;
+    }
+}
+
+template <typename InputType, typename ComputeType>
+bool Delaunay2<InputType, ComputeType>::UpdateParallel(
+    std::vector<int> const& unique)
 {
+    // Each strip gets at least this many points; smaller strips are
+    // dominated by their unsafe triangles.
+    int const minStripSize = 1024;
+    int const numUnique = static_cast<int>(unique.size());
+    int const numStrips = std::min(static_cast<int>(mNumThreads),
+        numUnique / minStripSize);
+    if (numStrips < 2)
+    {
+        return false;
+    }
+
+    struct Strip
+    {
+        int first, last;  // [first,last) in 'unique'
+        int left, right;  // nearest points of the neighbors, -1 if none
+        std::vector<Vector2<InputType>> vertices;
+        std::vector<int> indices, adjacencies;
+        int numLocations;
+        size_t numWalkSteps;
+
+        // remap[t] is the index of safe triangle t among the safe triangles
+        // of the strip, or -1 when t is unsafe.  A separator is stored with
+        // the adjacency slot 3*t+j of its safe triangle.
+        std::vector<int> remap;
+        int numSafe, offset;
+        std::vector<std::pair<EdgeKey<true>, int>> separators;
+        std::vector<int> unsafe;
+        bool triangulated;
+    };
+
+    std::vector<Strip> strips(numStrips);
+    for (int s = 0; s < numStrips; ++s)
+    {
+        Strip& strip = strips[s];
+        strip.first = static_cast<int>(
+            static_cast<int64_t>(numUnique) * s / numStrips);
+        strip.last = static_cast<int>(
+            static_cast<int64_t>(numUnique) * (s + 1) / numStrips);
+        strip.left = (s > 0 ? unique[strip.first - 1] : -1);
+        strip.right = (s + 1 < numStrips ? unique[strip.last] : -1);
+        strip.numLocations = 0;
+        strip.numWalkSteps = 0;
+        strip.numSafe = 0;
+        strip.offset = 0;
+        strip.triangulated = false;
+    }
+
+    // Triangulate the strips and classify their triangles in parallel.  The
+    // strip meshes are also destroyed by the threads; only the index and
+    // adjacency arrays are kept.
+    std::vector<std::thread> process(numStrips);
+    for (int s = 0; s < numStrips; ++s)
+    {
+        process[s] = std::thread([this, s, &unique, &strips]()
+        {
+            Strip& strip = strips[s];
+            Delaunay2 del;
+            int const* global = &unique[strip.first];
+            int const numLocal = strip.last - strip.first;
+            strip.vertices.resize(numLocal);
+            for (int k = 0; k < numLocal; ++k)
+            {
+                strip.vertices[k] = mVertices[global[k]];
+            }
+            if (!del(numLocal, &strip.vertices[0], mEpsilon))
+            {
+                return;
+            }
+
+            strip.indices.swap(del.mIndices);
+            strip.adjacencies.swap(del.mAdjacencies);
+            strip.numLocations = del.mNumLocations;
+            strip.numWalkSteps = del.mNumWalkSteps;
+            auto const& indices = strip.indices;
+            auto const& adjacencies = strip.adjacencies;
+            int const numTriangles = static_cast<int>(indices.size() / 3);
+            strip.remap.resize(numTriangles);
+            for (int t = 0; t < numTriangles; ++t)
+            {
+                int const* v = &indices[3 * t];
+                strip.remap[t] = (IsCircumdiskBetween(global[v[0]],
+                    global[v[1]], global[v[2]], strip.left, strip.right) ?
+                    strip.numSafe++ : -1);
+            }
+
+            for (int t = 0; t < numTriangles; ++t)
+            {
+                int const* v = &indices[3 * t];
+                for (int j = 0; j < 3; ++j)
+                {
+                    int adj = adjacencies[3 * t + j];
+                    int v0 = global[v[mIndex[j][0]]];
+                    int v1 = global[v[mIndex[j][1]]];
+                    if (strip.remap[t] >= 0
+                        && (adj == -1 || strip.remap[adj] == -1))
+                    {
+                        strip.separators.push_back(std::make_pair(
+                            EdgeKey<true>(v0, v1), 3 * t + j));
+                    }
+                    if (strip.remap[t] == -1 || adj == -1)
+                    {
+                        // Vertices of unsafe triangles and of the strip hull
+                        // are not interior to the safe region.
+                        strip.unsafe.push_back(v0);
+                        strip.unsafe.push_back(v1);
+                    }
+                }
+            }
+            strip.triangulated = true;
+        });
+    }
+    for (int s = 0; s < numStrips; ++s)
+    {
+        process[s].join();
+    }
+
+    // Gather the points not interior to the safe region and the edges that
+    // separate the safe region from the rest.  A separator maps to the
+    // adjacency slot of its safe triangle in the final numbering and to a
+    // flag that is set once the edge is found in the stitching mesh.
+    int numSafe = 0;
+    std::vector<char> isUnsafe(mNumVertices, 0);
+    std::vector<int> stitch;
+    std::unordered_map<EdgeKey<true>, std::array<int, 2>,
+        EdgeKey<true>::Hash> separators;
+    for (auto& strip : strips)
+    {
+        if (!strip.triangulated)
+        {
+            return false;
+        }
+        strip.offset = numSafe;
+        numSafe += strip.numSafe;
+        for (auto v : strip.unsafe)
+        {
+            if (!isUnsafe[v])
+            {
+                isUnsafe[v] = 1;
+                stitch.push_back(v);
+            }
+        }
+        for (auto const& element : strip.separators)
+        {
+            int t = element.second / 3, j = element.second % 3;
+            int slot = 3 * (strip.offset + strip.remap[t]) + j;
+            separators.insert(std::make_pair(element.first,
+                std::array<int, 2>{ { slot, 0 } }));
+        }
+    }
+
+    std::vector<Vector2<InputType>> stitchVertices(stitch.size());
+    for (size_t k = 0; k < stitch.size(); ++k)
+    {
+        stitchVertices[k] = mVertices[stitch[k]];
+    }
+    Delaunay2 del;
+    if (!del(static_cast<int>(stitch.size()), &stitchVertices[0], mEpsilon))
+    {
+        return false;
+    }
+
+    // A stitching triangle that has a separator with the opposite direction
+    // is on the unsafe side.  The unsafe triangles are those reachable from
+    // such triangles without crossing a separator.
+    auto const& indices = del.GetIndices();
+    auto const& adjacencies = del.GetAdjacencies();
+    int const numTriangles = del.GetNumTriangles();
+    std::vector<int> remap(numTriangles, -1);
+    std::vector<int> candidates;
+    for (int t = 0; t < numTriangles; ++t)
+    {
+        int const* v = &indices[3 * t];
+        for (int j = 0; j < 3; ++j)
+        {
+            int v0 = stitch[v[mIndex[j][0]]];
+            int v1 = stitch[v[mIndex[j][1]]];
+            auto iter = separators.find(EdgeKey<true>(v1, v0));
+            if (iter != separators.end())
+            {
+                iter->second[1] = 1;
+                if (remap[t] == -1)
+                {
+                    remap[t] = 0;
+                    candidates.push_back(t);
+                }
+                continue;
+            }
+            iter = separators.find(EdgeKey<true>(v0, v1));
+            if (iter != separators.end())
+            {
+                iter->second[1] = 1;
+            }
+        }
+    }
+    for (auto const& element : separators)
+    {
+        if (!element.second[1])
+        {
+            return false;
+        }
+    }
+    if (separators.size() == 0)
+    {
+        // No triangle was safe, so the stitching triangulation is the
+        // complete triangulation.
+        for (int t = 0; t < numTriangles; ++t)
+        {
+            remap[t] = 0;
+        }
+    }
+    while (candidates.size() > 0)
+    {
+        int t = candidates.back();
+        candidates.pop_back();
+        int const* v = &indices[3 * t];
+        for (int j = 0; j < 3; ++j)
+        {
+            int adj = adjacencies[3 * t + j];
+            if (adj != -1 && remap[adj] == -1)
+            {
+                int v0 = stitch[v[mIndex[j][0]]];
+                int v1 = stitch[v[mIndex[j][1]]];
+                if (separators.find(EdgeKey<true>(v1, v0))
+                    == separators.end())
+                {
+                    remap[adj] = 0;
+                    candidates.push_back(adj);
+                }
+            }
+        }
+    }
+    int numTotal = numSafe;
+    for (int t = 0; t < numTriangles; ++t)
+    {
+        if (remap[t] == 0)
+        {
+            remap[t] = numTotal++;
+        }
+    }
+
+    // Assemble the index and adjacency arrays from the safe strip triangles
+    // followed by the unsafe stitching triangles.  The separators join the
+    // two groups.
+    mIndices.resize(3 * numTotal);
+    mAdjacencies.resize(3 * numTotal);
+    for (int s = 0; s < numStrips; ++s)
+    {
+        Strip const& strip = strips[s];
+        int const* global = &unique[strip.first];
+        auto const& stripIndices = strip.indices;
+        auto const& stripAdjacencies = strip.adjacencies;
+        for (size_t t = 0; t < strip.remap.size(); ++t)
+        {
+            if (strip.remap[t] >= 0)
+            {
+                int ibase = 3 * (strip.offset + strip.remap[t]);
+                for (int j = 0; j < 3; ++j)
+                {
+                    mIndices[ibase + j] = global[stripIndices[3 * t + j]];
+                    int adj = stripAdjacencies[3 * t + j];
+                    mAdjacencies[ibase + j] =
+                        (adj != -1 && strip.remap[adj] >= 0 ?
+                        strip.offset + strip.remap[adj] : -1);
+                }
+            }
+        }
+        mNumLocations += strip.numLocations;
+        mNumWalkSteps += strip.numWalkSteps;
+    }
+    for (int t = 0; t < numTriangles; ++t)
+    {
+        if (remap[t] >= 0)
+        {
+            int ibase = 3 * remap[t];
+            int const* v = &indices[3 * t];
+            for (int j = 0; j < 3; ++j)
+            {
+                mIndices[ibase + j] = stitch[v[j]];
+            }
+            for (int j = 0; j < 3; ++j)
+            {
+                int v0 = stitch[v[mIndex[j][0]]];
+                int v1 = stitch[v[mIndex[j][1]]];
+                auto iter = separators.find(EdgeKey<true>(v1, v0));
+                if (iter != separators.end())
+                {
+                    int slot = iter->second[0];
+                    mAdjacencies[ibase + j] = slot / 3;
+                    mAdjacencies[slot] = remap[t];
+                }
+                else
+                {
+                    int adj = adjacencies[3 * t + j];
+                    mAdjacencies[ibase + j] = (adj != -1 ? remap[adj] : -1);
+                }
+            }
+        }
+    }
+    mNumLocations += del.mNumLocations;
+    mNumWalkSteps += del.mNumWalkSteps;
+    mNumTriangles = numTotal;
+    mGraphDeferred = true;
+    return true;
 }
 
 template <typename InputType, typename ComputeType>
-bool Delaunay2<InputType, ComputeType>::ProcessedVertex::operator<(
-    ProcessedVertex const& v) const
+bool Delaunay2<InputType, ComputeType>::IsCircumdiskBetween(int v0, int v1,
+    int v2, int left, int right) const
 {
-    return vertex < v.vertex;
+    // Let A = V1-V0, B = V2-V0 and d = 2*Cross(A,B).  The circumcenter is
+    // C = V0 + U/d, where U = (B1*|A|^2 - A1*|B|^2, A0*|B|^2 - B0*|A|^2),
+    // and the radius is |U|/|d|.  With d > 0, the closed disk is strictly
+    // to the right of x = L when E = (V0[0]-L)*d + U[0] > |U|, and strictly
+    // to the left of x = R when F = (R-V0[0])*d - U[0] > |U|.  The tests are
+    // decided in double unless the difference is within the rounding error,
+    // in which case ComputeType decides.
+    double p[3][2];
+    int const vi[3] = { v0, v1, v2 };
+    for (int k = 0; k < 3; ++k)
+    {
+        for (int j = 0; j < 2; ++j)
+        {
+            p[k][j] = static_cast<double>(mVertices[vi[k]][j]);
+        }
+    }
+    double a0 = p[1][0] - p[0][0], a1 = p[1][1] - p[0][1];
+    double b0 = p[2][0] - p[0][0], b1 = p[2][1] - p[0][1];
+    double aa = a0 * a0 + a1 * a1, bb = b0 * b0 + b1 * b1;
+    double d = 2.0 * (a0 * b1 - a1 * b0);
+    double u0 = b1 * aa - a1 * bb, u1 = a0 * bb - b0 * aa;
+    if (d < 0.0)
+    {
+        d = -d;
+        u0 = -u0;
+        u1 = -u1;
+    }
+    double ulen = std::sqrt(u0 * u0 + u1 * u1);
+    double dmag = 2.0 * (std::abs(a0 * b1) + std::abs(a1 * b0));
+    double umag = std::abs(b1) * aa + std::abs(a1) * bb
+        + std::abs(a0) * bb + std::abs(b0) * aa;
+
+    int const bound[2] = { left, right };
+    for (int side = 0; side < 2; ++side)
+    {
+        int b = bound[side];
+        if (b == -1)
+        {
+            continue;
+        }
+
+        double x = static_cast<double>(mVertices[b][0]);
+        double delta = (side == 0 ? p[0][0] - x : x - p[0][0]);
+        double e = delta * d + (side == 0 ? u0 : -u0);
+        double margin = 1e-10 * (std::abs(delta) * dmag + umag);
+        if (e - ulen > margin)
+        {
+            continue;
+        }
+        if (e - ulen < -margin)
+        {
+            return false;
+        }
+
+        Vector2<ComputeType> const& P0 = mComputeVertices[v0];
+        Vector2<ComputeType> const& P1 = mComputeVertices[v1];
+        Vector2<ComputeType> const& P2 = mComputeVertices[v2];
+        ComputeType const zero(0);
+        ComputeType A0 = P1[0] - P0[0], A1 = P1[1] - P0[1];
+        ComputeType B0 = P2[0] - P0[0], B1 = P2[1] - P0[1];
+        ComputeType AA = A0 * A0 + A1 * A1, BB = B0 * B0 + B1 * B1;
+        ComputeType D = A0 * B1 - A1 * B0;
+        D = D + D;
+        ComputeType U0 = B1 * AA - A1 * BB, U1 = A0 * BB - B0 * AA;
+        if (D < zero)
+        {
+            D = -D;
+            U0 = -U0;
+        }
+        ComputeType E = (side == 0 ?
+            (P0[0] - mComputeVertices[b][0]) * D + U0 :
+            (mComputeVertices[b][0] - P0[0]) * D - U0);
+        if (!(E > zero && E * E > U0 * U0 + U1 * U1))
+        {
+            return false;
+        }
+    }
+    return true;
 }
 
 
+
 }
@@ -10,6 +10,7 @@
 #include <Mathematics/GteEdgeKey.h>
 #include <Mathematics/GteTriangleKey.h>
 #include <map>
+#include <unordered_map>
 #include <vector>
 
 namespace gte
@@ -21,12 +22,14 @@ public:
     // Edge data types.
     class Edge;
     typedef Edge* (*ECreator)(int, int);
-    typedef std::map<EdgeKey<false>, Edge*> EMap;
+    typedef std::unordered_map<EdgeKey<false>, Edge*,
+        EdgeKey<false>::Hash> EMap;
 
     // Triangle data types.
     class Triangle;
     typedef Triangle* (*TCreator)(int, int, int);
-    typedef std::map<TriangleKey<true>, Triangle*> TMap;
+    typedef std::unordered_map<TriangleKey<true>, Triangle*,
+        TriangleKey<true>::Hash> TMap;
 
     // Edge object.
     class GTE_IMPEXP Edge
@@ -73,7 +76,8 @@ public:
     ETManifoldMesh(ETManifoldMesh const& mesh);
     ETManifoldMesh& operator=(ETManifoldMesh const& mesh);
 
-    // Member access.
+    // Member access.  The maps are hashed, so their iteration order is not
+    // the sorted key order.
     EMap const& GetEdges() const;
     TMap const& GetTriangles() const;
 
@@ -93,7 +97,8 @@ public:
     // otherwise, <v0,v1,v2> is not in the mesh and 'false' is returned.
     bool Remove(int v0, int v1, int v2);
 
-    // Destroy the edges and triangles to obtain an empty mesh.
+    // Destroy the edges and triangles to obtain an empty mesh.  Objects made
+    // by the default creators are kept for reuse by later insertions.
     void Clear();
 
     // A manifold mesh is closed if each edge is shared twice.  A closed
@@ -138,6 +143,18 @@ protected:
     TMap mTMap;
     bool mAssertOnNonmanifoldInsertion;  // default: true
 
+    // Edges and triangles made by the default creators are recycled through
+    // these free lists instead of being deleted, so meshes that are edited
+    // heavily (Delaunay2 removes and inserts triangles for every point) stop
+    // allocating once the lists have grown.  Objects from user-supplied
+    // creators are always deleted.
+    Edge* NewEdge(int v0, int v1);
+    Triangle* NewTriangle(int v0, int v1, int v2);
+    void DeleteEdge(Edge* edge);
+    void DeleteTriangle(Triangle* tri);
+    std::vector<Edge*> mFreeEdges;
+    std::vector<Triangle*> mFreeTriangles;
+
     // Support for computing connected components.  This is a straightforward
     // depth-first search of the graph but uses a preallocated stack rather
     // than a recursive function that could possibly overflow the call stack.
@@ -8,6 +8,7 @@
 #pragma once
 
 #include <GTEngineDEF.h>
+#include <cstddef>
 
 namespace gte
 {
@@ -32,6 +33,12 @@ public:
     bool operator<(FeatureKey const& key) const;
     bool operator==(FeatureKey const& key) const;
 
+    // Hash functor for unordered containers keyed by feature keys.
+    struct Hash
+    {
+        size_t operator()(FeatureKey const& key) const;
+    };
+
     int V[N];
 };
 
@@ -72,5 +79,18 @@ bool FeatureKey<N, Ordered>::operator==(FeatureKey const& key) const
     return true;
 }
 
+template <int N, bool Ordered>
+size_t FeatureKey<N, Ordered>::Hash::operator()(FeatureKey const& key) const
+{
+    // FNV-1a, one index at a time.
+    size_t hash = static_cast<size_t>(2166136261u);
+    for (int i = 0; i < N; ++i)
+    {
+        hash ^= static_cast<size_t>(static_cast<unsigned int>(key.V[i]));
+        hash *= static_cast<size_t>(16777619u);
+    }
+    return hash;
+}
+
 
 }
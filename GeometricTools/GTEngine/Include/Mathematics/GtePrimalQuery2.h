@@ -8,6 +8,8 @@
 #pragma once
 
 #include <Mathematics/GteVector2.h>
+#include <cmath>
+#include <limits>
 
 // Queries about the relation of a point to various geometric objects.
 
@@ -24,8 +26,21 @@ public:
     PrimalQuery2();
     PrimalQuery2(int numVertices, Vector2<Real> const* vertices);
 
-    // Member access.
+    // Member access.  Set(...) clears any filter vertices.
     inline void Set(int numVertices, Vector2<Real> const* vertices);
+
+    // Optional floating-point filter for the index-based ToLine, ToTriangle
+    // and ToCircumcircle queries.  The filter vertices must be the same
+    // points as the Real vertices and exactly representable as double, for
+    // example the float or double input from which the Real vertices were
+    // created.  A query first evaluates its determinant in double together
+    // with a forward error bound (the stage-A bounds of Shewchuk's adaptive
+    // predicates) and falls back to Real arithmetic only when the bound
+    // cannot certify the sign.  With an exact Real (BSNumber, BSRational),
+    // the results are unchanged and most queries avoid exact arithmetic.
+    // Pass nullptr to disable the filter.
+    inline void SetFilter(Vector2<double> const* filterVertices);
+    inline Vector2<double> const* GetFilter() const;
     inline int GetNumVertices() const;
     inline Vector2<Real> const* GetVertices() const;
 
@@ -134,8 +149,15 @@ public:
         Vector2<Real> const& Q1) const;
 
 private:
+    // Return true and set 'sign' when the double evaluation certifies the
+    // sign of the query; return false when Real arithmetic is required.
+    bool FilteredToLine(int i, int v0, int v1, int& sign) const;
+    bool FilteredToCircumcircle(int i, int v0, int v1, int v2, int& sign)
+        const;
+
     int mNumVertices;
     Vector2<Real> const* mVertices;
+    Vector2<double> const* mFilterVertices;
 };
 
 
@@ -143,7 +165,8 @@ template <typename Real>
 PrimalQuery2<Real>::PrimalQuery2()
     :
     mNumVertices(0),
-    mVertices(nullptr)
+    mVertices(nullptr),
+    mFilterVertices(nullptr)
 {
 }
 
@@ -152,7 +175,8 @@ PrimalQuery2<Real>::PrimalQuery2(int numVertices,
     Vector2<Real> const* vertices)
     :
     mNumVertices(numVertices),
-    mVertices(vertices)
+    mVertices(vertices),
+    mFilterVertices(nullptr)
 {
 }
 
@@ -161,6 +185,19 @@ void PrimalQuery2<Real>::Set(int numVertices, Vector2<Real> const* vertices)
 {
     mNumVertices = numVertices;
     mVertices = vertices;
+    mFilterVertices = nullptr;
+}
+
+template <typename Real> inline
+void PrimalQuery2<Real>::SetFilter(Vector2<double> const* filterVertices)
+{
+    mFilterVertices = filterVertices;
+}
+
+template <typename Real> inline
+Vector2<double> const* PrimalQuery2<Real>::GetFilter() const
+{
+    return mFilterVertices;
 }
 
 template <typename Real> inline
@@ -178,6 +215,11 @@ Vector2<Real> const* PrimalQuery2<Real>::GetVertices() const
 template <typename Real>
 int PrimalQuery2<Real>::ToLine(int i, int v0, int v1) const
 {
+    int sign;
+    if (mFilterVertices && FilteredToLine(i, v0, v1, sign))
+    {
+        return sign;
+    }
     return ToLine(mVertices[i], v0, v1);
 }
 
@@ -203,6 +245,12 @@ int PrimalQuery2<Real>::ToLine(Vector2<Real> const& test, int v0, int v1)
 template <typename Real>
 int PrimalQuery2<Real>::ToLine(int i, int v0, int v1, int& order) const
 {
+    int sign;
+    if (mFilterVertices && FilteredToLine(i, v0, v1, sign) && sign != 0)
+    {
+        order = 3 * sign;
+        return sign;
+    }
     return ToLine(mVertices[i], v0, v1, order);
 }
 
@@ -270,7 +318,31 @@ int PrimalQuery2<Real>::ToLine(Vector2<Real> const& test, int v0, int v1,
 template <typename Real>
 int PrimalQuery2<Real>::ToTriangle(int i, int v0, int v1, int v2) const
 {
-    return ToTriangle(mVertices[i], v0, v1, v2);
+    if (!mFilterVertices)
+    {
+        return ToTriangle(mVertices[i], v0, v1, v2);
+    }
+
+    // Same logic as the vector version, with filtered line queries.
+    int sign0 = ToLine(i, v1, v2);
+    if (sign0 > 0)
+    {
+        return +1;
+    }
+
+    int sign1 = ToLine(i, v0, v2);
+    if (sign1 < 0)
+    {
+        return +1;
+    }
+
+    int sign2 = ToLine(i, v0, v1);
+    if (sign2 > 0)
+    {
+        return +1;
+    }
+
+    return ((sign0 && sign1 && sign2) ? -1 : 0);
 }
 
 template <typename Real>
@@ -301,6 +373,11 @@ int PrimalQuery2<Real>::ToTriangle(Vector2<Real> const& test, int v0, int v1,
 template <typename Real>
 int PrimalQuery2<Real>::ToCircumcircle(int i, int v0, int v1, int v2) const
 {
+    int sign;
+    if (mFilterVertices && FilteredToCircumcircle(i, v0, v1, v2, sign))
+    {
+        return sign;
+    }
     return ToCircumcircle(mVertices[i], v0, v1, v2);
 }
 
@@ -429,4 +506,101 @@ typename PrimalQuery2<Real>::OrderType PrimalQuery2<Real>::ToLineExtended(
 }
 
 
+template <typename Real>
+bool PrimalQuery2<Real>::FilteredToLine(int i, int v0, int v1, int& sign)
+    const
+{
+    Vector2<double> const& test = mFilterVertices[i];
+    Vector2<double> const& vec0 = mFilterVertices[v0];
+    Vector2<double> const& vec1 = mFilterVertices[v1];
+
+    double x0 = test[0] - vec0[0];
+    double y0 = test[1] - vec0[1];
+    double x1 = vec1[0] - vec0[0];
+    double y1 = vec1[1] - vec0[1];
+    double x0y1 = x0*y1;
+    double x1y0 = x1*y0;
+    double det = x0y1 - x1y0;
+
+    // Shewchuk's ccwerrboundA = (3 + 16*eps)*eps, eps = 2^{-53}.
+    double const eps = 0.5*std::numeric_limits<double>::epsilon();
+    double const errorFactor = (3.0 + 16.0*eps)*eps;
+    double bound = errorFactor*(std::abs(x0y1) + std::abs(x1y0));
+    if (det > bound)
+    {
+        sign = +1;
+        return true;
+    }
+    if (det < -bound)
+    {
+        sign = -1;
+        return true;
+    }
+
+    // A difference of doubles is zero only when the operands are equal, so
+    // a zero factor in each product certifies a zero determinant.
+    if ((x0 == 0.0 || y1 == 0.0) && (x1 == 0.0 || y0 == 0.0))
+    {
+        sign = 0;
+        return true;
+    }
+    return false;
+}
+
+template <typename Real>
+bool PrimalQuery2<Real>::FilteredToCircumcircle(int i, int v0, int v1,
+    int v2, int& sign) const
+{
+    Vector2<double> const& test = mFilterVertices[i];
+    Vector2<double> const& vec0 = mFilterVertices[v0];
+    Vector2<double> const& vec1 = mFilterVertices[v1];
+    Vector2<double> const& vec2 = mFilterVertices[v2];
+
+    // The lifted form |Vi - P|^2 has the same determinant as the
+    // |Vi|^2 - |P|^2 form of ToCircumcircle, but a tighter error bound.
+    double x0 = vec0[0] - test[0];
+    double y0 = vec0[1] - test[1];
+    double x1 = vec1[0] - test[0];
+    double y1 = vec1[1] - test[1];
+    double x2 = vec2[0] - test[0];
+    double y2 = vec2[1] - test[1];
+
+    double x1y2 = x1*y2;
+    double x2y1 = x2*y1;
+    double z0 = x0*x0 + y0*y0;
+
+    double x2y0 = x2*y0;
+    double x0y2 = x0*y2;
+    double z1 = x1*x1 + y1*y1;
+
+    double x0y1 = x0*y1;
+    double x1y0 = x1*y0;
+    double z2 = x2*x2 + y2*y2;
+
+    double det = z0*(x1y2 - x2y1) + z1*(x2y0 - x0y2) + z2*(x0y1 - x1y0);
+
+    // Shewchuk's iccerrboundA = (10 + 96*eps)*eps, eps = 2^{-53}.
+    double const eps = 0.5*std::numeric_limits<double>::epsilon();
+    double const errorFactor = (10.0 + 96.0*eps)*eps;
+    double permanent =
+        (std::abs(x1y2) + std::abs(x2y1))*z0 +
+        (std::abs(x2y0) + std::abs(x0y2))*z1 +
+        (std::abs(x0y1) + std::abs(x1y0))*z2;
+    double bound = errorFactor*permanent;
+
+    // A positive determinant means P is inside the circumcircle.
+    if (det > bound)
+    {
+        sign = -1;
+        return true;
+    }
+    if (det < -bound)
+    {
+        sign = +1;
+        return true;
+    }
+    return false;
+}
+
+
 }
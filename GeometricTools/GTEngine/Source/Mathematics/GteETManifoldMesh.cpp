@@ -14,14 +14,16 @@ using namespace gte;
 
 ETManifoldMesh::~ETManifoldMesh()
 {
-    for (auto& element : mEMap)
+    Clear();
+
+    for (auto edge : mFreeEdges)
     {
-        delete element.second;
+        delete edge;
     }
 
-    for (auto& element : mTMap)
+    for (auto tri : mFreeTriangles)
     {
-        delete element.second;
+        delete tri;
     }
 }
 
@@ -34,17 +36,28 @@ ETManifoldMesh::ETManifoldMesh(ECreator eCreator, TCreator tCreator)
 }
 
 ETManifoldMesh::ETManifoldMesh(ETManifoldMesh const& mesh)
+    :
+    mECreator(CreateEdge),
+    mTCreator(CreateTriangle),
+    mAssertOnNonmanifoldInsertion(true)
 {
     *this = mesh;
 }
 
 ETManifoldMesh& ETManifoldMesh::operator=(ETManifoldMesh const& mesh)
 {
+    if (this == &mesh)
+    {
+        return *this;
+    }
+
     Clear();
 
     mECreator = mesh.mECreator;
     mTCreator = mesh.mTCreator;
     mAssertOnNonmanifoldInsertion = mesh.mAssertOnNonmanifoldInsertion;
+    mTMap.reserve(mesh.mTMap.size());
+    mEMap.reserve(mesh.mEMap.size());
     for (auto const& element : mesh.mTMap)
     {
         Insert(element.first.V[0], element.first.V[1], element.first.V[2]);
@@ -74,6 +87,64 @@ ETManifoldMesh::Triangle* ETManifoldMesh::CreateTriangle(int v0, int v1,
     return new Triangle(v0, v1, v2);
 }
 
+ETManifoldMesh::Edge* ETManifoldMesh::NewEdge(int v0, int v1)
+{
+    if (mECreator == CreateEdge && mFreeEdges.size() > 0)
+    {
+        Edge* edge = mFreeEdges.back();
+        mFreeEdges.pop_back();
+        edge->V[0] = v0;
+        edge->V[1] = v1;
+        edge->T[0] = nullptr;
+        edge->T[1] = nullptr;
+        return edge;
+    }
+    return mECreator(v0, v1);
+}
+
+ETManifoldMesh::Triangle* ETManifoldMesh::NewTriangle(int v0, int v1, int v2)
+{
+    if (mTCreator == CreateTriangle && mFreeTriangles.size() > 0)
+    {
+        Triangle* tri = mFreeTriangles.back();
+        mFreeTriangles.pop_back();
+        tri->V[0] = v0;
+        tri->V[1] = v1;
+        tri->V[2] = v2;
+        for (int i = 0; i < 3; ++i)
+        {
+            tri->E[i] = nullptr;
+            tri->T[i] = nullptr;
+        }
+        return tri;
+    }
+    return mTCreator(v0, v1, v2);
+}
+
+void ETManifoldMesh::DeleteEdge(Edge* edge)
+{
+    if (mECreator == CreateEdge)
+    {
+        mFreeEdges.push_back(edge);
+    }
+    else
+    {
+        delete edge;
+    }
+}
+
+void ETManifoldMesh::DeleteTriangle(Triangle* tri)
+{
+    if (mTCreator == CreateTriangle)
+    {
+        mFreeTriangles.push_back(tri);
+    }
+    else
+    {
+        delete tri;
+    }
+}
+
 void ETManifoldMesh::AssertOnNonmanifoldInsertion(bool doAssert)
 {
     mAssertOnNonmanifoldInsertion = doAssert;
@@ -82,7 +153,8 @@ void ETManifoldMesh::AssertOnNonmanifoldInsertion(bool doAssert)
 ETManifoldMesh::Triangle* ETManifoldMesh::Insert(int v0, int v1, int v2)
 {
     TriangleKey<true> tkey(v0, v1, v2);
-    if (mTMap.find(tkey) != mTMap.end())
+    auto tinsert = mTMap.insert(std::make_pair(tkey, nullptr));
+    if (!tinsert.second)
     {
         // The triangle already exists.  Return a null pointer as a signal to
         // the caller that the insertion failed.
@@ -90,20 +162,21 @@ ETManifoldMesh::Triangle* ETManifoldMesh::Insert(int v0, int v1, int v2)
     }
 
     // Add the new triangle.
-    Triangle* tri = mTCreator(v0, v1, v2);
-    mTMap[tkey] = tri;
+    Triangle* tri = NewTriangle(v0, v1, v2);
+    tinsert.first->second = tri;
 
     // Add the edges to the mesh if they do not already exist.
     for (int i0 = 2, i1 = 0; i1 < 3; i0 = i1++)
     {
         EdgeKey<false> ekey(tri->V[i0], tri->V[i1]);
         Edge* edge;
-        auto eiter = mEMap.find(ekey);
-        if (eiter == mEMap.end())
+        auto einsert = mEMap.insert(std::make_pair(ekey, nullptr));
+        auto eiter = einsert.first;
+        if (einsert.second)
         {
             // This is the first time the edge is encountered.
-            edge = mECreator(tri->V[i0], tri->V[i1]);
-            mEMap[ekey] = edge;
+            edge = NewEdge(tri->V[i0], tri->V[i1]);
+            eiter->second = edge;
 
             // Update the edge and triangle.
             edge->T[0] = tri;
@@ -201,7 +274,7 @@ bool ETManifoldMesh::Remove(int v0, int v1, int v2)
         {
             EdgeKey<false> ekey(edge->V[0], edge->V[1]);
             mEMap.erase(ekey);
-            delete edge;
+            DeleteEdge(edge);
         }
 
         // Inform adjacent triangles the triangle is being deleted.
@@ -219,8 +292,8 @@ bool ETManifoldMesh::Remove(int v0, int v1, int v2)
         }
     }
 
-    mTMap.erase(tkey);
-    delete tri;
+    mTMap.erase(titer);
+    DeleteTriangle(tri);
     return true;
 }
 
@@ -228,12 +301,12 @@ void ETManifoldMesh::Clear()
 {
     for (auto& element : mEMap)
     {
-        delete element.second;
+        DeleteEdge(element.second);
     }
 
     for (auto& element : mTMap)
     {
-        delete element.second;
+        DeleteTriangle(element.second);
     }
 
     mEMap.clear();
@@ -127,7 +127,7 @@ typedef Coord* point;
 #define BLOCKSIZE 100000
 #define MAXBLOCKS 1000
 
-#define VA(x) ((x)->vecs+rdim)
+#define VA(x) ((x)->vecs+ctx->rdim)
 #define VB(x) ((x)->vecs)
 
 typedef point site;
@@ -140,12 +140,6 @@ typedef struct basis_s {
     Coord vecs[1]; /* the actual vectors, extended by malloc'ing bigger */
 } basis_s;
 
-//STORAGE_GLOBALS(basis_s)
-extern size_t basis_s_size;
-extern basis_s *basis_s_list;
-extern basis_s *new_block_basis_s(int);
-extern void flush_basis_s_blocks(void);
-void free_basis_s_storage(void);
 
 
 typedef struct neighbor {
@@ -163,12 +157,6 @@ typedef struct simplex {
     neighbor peak;      /* if null, remaining vertices give facet */
     neighbor neigh[1];   /* neighbors of simplex */
 } simplex;
-// STORAGE_GLOBALS(simplex)
-extern size_t simplex_size;
-extern simplex *simplex_list;
-extern simplex *new_block_simplex(int);
-extern void flush_simplex_blocks(void);
-void free_simplex_storage(void);
 
 
 typedef struct fg_node fg;
@@ -205,46 +193,84 @@ void free_fg_storage(void);
 
 
 
+typedef struct ClarksonDelaunay ClarksonDelaunay;
+
 typedef simplex * visit_func(simplex *, void *);
 typedef int test_func(simplex *, int, void *);
 
-static int sees(site, simplex *);
-static void buildhull(simplex *);
-static simplex *facets_print(simplex *s, void *p);
-static simplex *visit_triang_gen(simplex *s, visit_func *visit, test_func *test);
-
-
-static int *ptrToIntsToIndex, *listOfIntsToIndex;
-static float *ptrFloatsToIndex, *listOfFloatsToIndex, mult_up;
-
-static WORD *ptrToOutputList ;
-static int triangleDirection;
-
-static int numPointsProcessed;
-static int totalInputPoints;
-static int maxOutputEntries ;
-static int currenOutputIndex;
-static void triangleList_out (int v0, int v1, int v2, int v3);
-
-static point site_blocks[MAXBLOCKS];
-static int   num_blocks;
-
-// The next block of variables were static variables within functions that I moved
-// outside of the function.  I prepended each of the variables with the name of the function.
-// For example: sc_lscale was originally "lscale" in sc()
-//              visit_triang_gen_ss was originally "ss" in visit_triang_gen()
-//              search_ss was originally "ss" in search()
-static long get_next_site_s_num;
-static neighbor out_of_flat_p_neigh;
-static basis_s *sees_b;
-static long visit_triang_gen_vnum;
-static long visit_triang_gen_ss;
-static simplex **visit_triang_gen_st;
-static simplex **search_st;
-static long search_ss;
-static int   sc_lscale;
-static double   sc_max_scale, sc_ldetbound, sc_Sb;
-static simplex *make_facets_ns;
+/* Fixed-size blocks of simplices or bases, carved in order and kept between builds.
+ * Only the part used by the last build is cleared before the next one. */
+typedef struct block_pool {
+    char  *blocks[max_blocks];
+    int    num_blocks;  /* blocks allocated */
+    int    block;       /* block being carved */
+    int    used;        /* objects carved from it */
+    size_t size;        /* object size the blocks are carved for */
+} block_pool;
+
+/* Everything the triangulation used to keep in file-scope statics. One context can run one
+ * build at a time; separate contexts can run concurrently, and a context reuses its memory. */
+struct ClarksonDelaunay {
+    int *ptrToIntsToIndex, *listOfIntsToIndex;
+    float *ptrFloatsToIndex, *listOfFloatsToIndex, mult_up;
+    
+    WORD *ptrToOutputList;
+    int outputCapacity;
+    int triangleDirection;
+    
+    int numPointsProcessed;
+    int totalInputPoints;
+    int maxOutputEntries;
+    int currenOutputIndex;
+    
+    point site_blocks[MAXBLOCKS];
+    int   num_blocks;
+    int   num_site_blocks_allocated;
+    
+    // The next block of variables were static variables within functions that I moved
+    // outside of the function.  I prepended each of the variables with the name of the function.
+    // For example: sc_lscale was originally "lscale" in sc()
+    //              visit_triang_gen_ss was originally "ss" in visit_triang_gen()
+    //              search_ss was originally "ss" in search()
+    long get_next_site_s_num;
+    neighbor out_of_flat_p_neigh;
+    basis_s *sees_b;
+    long visit_triang_gen_vnum;
+    long visit_triang_gen_ss;
+    simplex **visit_triang_gen_st;
+    simplex **search_st;
+    long search_ss;
+    int   sc_lscale;
+    double   sc_max_scale, sc_ldetbound, sc_Sb;
+    simplex *make_facets_ns;
+    
+    basis_s tt_basis, *tt_basisp, *infinity_basis;
+    
+    int   pdim;   /* point dimension */
+    simplex *ch_root;
+    int basis_vec_size;
+    
+    long pnum;
+    site p;
+    int  rdim,   /* region dimension: (max) number of sites specifying region */
+    cdim,   /* number of sites currently specifying region */
+    site_size, /* size of malloc needed for a site */
+    point_size;  /* size of malloc needed for a point */
+    
+    size_t simplex_size;
+    simplex *simplex_list;
+    block_pool simplex_pool;
+    
+    size_t basis_s_size;
+    basis_s *basis_s_list;
+    block_pool basis_s_pool;
+};
+
+static int sees(ClarksonDelaunay *ctx, site, simplex *);
+static void buildhull(ClarksonDelaunay *ctx, simplex *);
+static simplex *facets_print(simplex *s, void *data);
+static simplex *visit_triang_gen(ClarksonDelaunay *ctx, simplex *s, visit_func *visit, test_func *test);
+static void triangleList_out (ClarksonDelaunay *ctx, int v0, int v1, int v2, int v3);
 
 // --------- from ch.c : numerical functions for hull computation ---------
 const int    EXACT_BITS = 53;   // = (int)floor (DBL_MANT_DIG * log ((double)FLT_RADIX) / log(2.) );
@@ -253,118 +279,111 @@ const double B_ERR_MIN_SQ = B_ERR_MIN * B_ERR_MIN;
 
 static Coord  hull_infinity[10]={57.2,0,0,0,0}; /* point at infinity for Delaunay triangulation; value not used */
 
-static basis_s   tt_basis = {0,1,-1,0,0,0},
-*tt_basisp = &tt_basis,
-*infinity_basis;
+#define DELIFT 0
 
-static int   pdim;   /* point dimension */
-static simplex *ch_root;
+/* Largest basis_s and site for any dimension, so the scratch bases and site blocks survive a change of dimension */
+#define MAX_BASIS_S_SIZE (sizeof(basis_s) + (2*MAXDIM-1)*sizeof(Coord))
+#define MAX_SITE_SIZE (sizeof(Coord)*MAXDIM)
 
-#define DELIFT 0
-static int basis_vec_size;
-
-// ------ from hull.c : "combinatorial" functions for hull computation
-static long pnum;
-static site p;
-static int  rdim,   /* region dimension: (max) number of sites specifying region */
-cdim,   /* number of sites currently specifying region */
-site_size, /* size of malloc needed for a site */
-point_size;  /* size of malloc needed for a point */
-
-// STORAGE(simplex)    expands into:
-size_t simplex_size;
-simplex *simplex_list = 0;
-simplex *new_block_simplex(int make_blocks)  {
+// ----------------------------------------------------------------
+static void *pool_alloc(block_pool *pool) {
+    char *obj;
+    if (pool->used == Nobj) {
+        pool->block++;
+        pool->used = 0;
+    }
+    if (pool->block == pool->num_blocks) {
+        if (pool->num_blocks == max_blocks)
+            exit(1);
+        pool->blocks[pool->num_blocks++] = (char*)calloc(Nobj, pool->size);
+    }
+    obj = pool->blocks[pool->block] + pool->used * pool->size;
+    pool->used++;
+    return obj;
+}
+
+// ----------------------------------------------------------------
+static void pool_release(block_pool *pool) {
     int i;
-    static simplex *simplex_block_table[max_blocks];
-    simplex *xlm, *xbt;
-    static int num_simplex_blocks;
-    if (make_blocks)  {
-        xbt = simplex_block_table[num_simplex_blocks++] = (simplex*)malloc(Nobj * simplex_size);
-        memset(xbt, 0, Nobj *simplex_size);
-        xlm = (simplex*)( (char*)xbt + (Nobj * simplex_size));
-        for (i=0;i<Nobj; i++) {
-            // **6Sep2014** xlm = ((simplex*) ( (char*)xlm + ((-1)) *simplex_size));
-            xlm = ((simplex*) ( (char*)xlm - simplex_size ));
-            xlm->next = simplex_list;
-            simplex_list = xlm;
-        }
-        return simplex_list;
-    };
-    for (i=0; i<num_simplex_blocks; i++)  free(simplex_block_table[i]);
-    *simplex_block_table = 0;
-    num_simplex_blocks = 0;
-    simplex_list = 0;
+    for (i=0; i<pool->num_blocks; i++) free(pool->blocks[i]);
+    pool->num_blocks = 0;
+    pool->block = 0;
+    pool->used = 0;
+}
+
+// ----------------------------------------------------------------
+static void pool_reset(block_pool *pool, size_t size) {
+    // clear what the last build used; blocks carved for another size are dropped
+    int i;
+    if (size != pool->size) {
+        pool_release(pool);
+        pool->size = size;
+        return;
+    }
+    for (i=0; i<pool->block; i++) memset(pool->blocks[i], 0, Nobj * size);
+    if (pool->num_blocks) memset(pool->blocks[pool->block], 0, pool->used * size);
+    pool->block = 0;
+    pool->used = 0;
+}
+
+// STORAGE(simplex), now one zeroed object at a time from the context's pool
+static simplex *new_block_simplex(ClarksonDelaunay *ctx, int make_blocks)  {
+    if (make_blocks)
+        return (simplex*)pool_alloc(&ctx->simplex_pool);
+    pool_release(&ctx->simplex_pool);
+    ctx->simplex_list = 0;
     return 0;
 }
-void free_simplex_storage(void) { new_block_simplex(0); }
+static void free_simplex_storage(ClarksonDelaunay *ctx) { new_block_simplex(ctx, 0); }
 
 
-// STORAGE(basis_s)    expands into:
-size_t basis_s_size;
-basis_s *basis_s_list = 0;
-basis_s *new_block_basis_s(int make_blocks) {
-    int i;
-    static basis_s *basis_s_block_table[max_blocks];
-    basis_s *xlm, *xbt;
-    static int num_basis_s_blocks;
-    if (make_blocks) {
-        xbt = basis_s_block_table[num_basis_s_blocks++] = (basis_s*)malloc(Nobj *basis_s_size);
-        memset(xbt,0,Nobj *basis_s_size);
-        xlm = (basis_s*)( (char*)xbt + (Nobj * basis_s_size));
-        for (i=0;i<Nobj; i++) {
-            // **6Sep2014** xlm = ((basis_s*) ( (char*)xlm + ((-1)) *basis_s_size));
-            xlm = (basis_s*)( (char*)xlm - basis_s_size);
-            xlm->next = basis_s_list;
-            basis_s_list = xlm;
-        }
-        return basis_s_list;
-    };
-    for (i=0; i<num_basis_s_blocks; i++) free(basis_s_block_table[i]);
-    *basis_s_block_table = NULL;
-    num_basis_s_blocks = 0;
-    basis_s_list = 0;
+// STORAGE(basis_s), as above
+static basis_s *new_block_basis_s(ClarksonDelaunay *ctx, int make_blocks) {
+    if (make_blocks)
+        return (basis_s*)pool_alloc(&ctx->basis_s_pool);
+    pool_release(&ctx->basis_s_pool);
+    ctx->basis_s_list = 0;
     return 0;
 }
-void free_basis_s_storage(void) {
-    new_block_basis_s(0);
+static void free_basis_s_storage(ClarksonDelaunay *ctx) {
+    new_block_basis_s(ctx, 0);
 }
 
 
 
 // --------- from ch.c : numerical functions for hull computation ---------
 
-static Coord Vec_dot(point x, point y) {
+static Coord Vec_dot(ClarksonDelaunay *ctx, point x, point y) {
     int i;
     Coord sum = 0;
-    for (i=0;i<rdim;i++) sum += x[i] * y[i];
+    for (i=0;i<ctx->rdim;i++) sum += x[i] * y[i];
     return sum;
 }
 // ----------------------------------------------------------------
-static Coord Vec_dot_pdim(point x, point y) {
+static Coord Vec_dot_pdim(ClarksonDelaunay *ctx, point x, point y) {
     int i;
     Coord sum = 0;
-    for (i=0;i<pdim;i++) sum += x[i] * y[i];
+    for (i=0;i<ctx->pdim;i++) sum += x[i] * y[i];
     return sum;
 }
 // ----------------------------------------------------------------
-static Coord Norm2(point x) {
+static Coord Norm2(ClarksonDelaunay *ctx, point x) {
     int i;
     Coord sum = 0;
-    for (i=0;i<rdim;i++) sum += x[i] * x[i];
+    for (i=0;i<ctx->rdim;i++) sum += x[i] * x[i];
     return sum;
 }
 // ----------------------------------------------------------------
-static void Ax_plus_y(Coord a, point x, point y) {
+static void Ax_plus_y(ClarksonDelaunay *ctx, Coord a, point x, point y) {
     int i;
-    for (i=0;i<rdim;i++) {
+    for (i=0;i<ctx->rdim;i++) {
         *y++ += a * *x++;
     }
 }
 // ----------------------------------------------------------------
-static void Ax_plus_y_test(Coord a, point x, point y) {
+static void Ax_plus_y_test(ClarksonDelaunay *ctx, Coord a, point x, point y) {
     int i;
-    for (i=0;i<rdim;i++) {
+    for (i=0;i<ctx->rdim;i++) {
         // check_overshoot(*y + a * *x);
         *y++ += a * *x++;
     }
@@ -383,7 +402,7 @@ static void Vec_scale_test(int n, Coord a, Coord *x)
 
 
 // ----------------------------------------------------------------
-static double sc(basis_s *v,simplex *s, int k, int j) {
+static double sc(ClarksonDelaunay *ctx, basis_s *v,simplex *s, int k, int j) {
     /* amount by which to scale up vector, for reduce_inner */
     
     double      labound;
@@ -391,10 +410,10 @@ static double sc(basis_s *v,simplex *s, int k, int j) {
     
     if (j<10) {
         labound = logb(v->sqa)/2;
-        sc_max_scale = EXACT_BITS - labound - 0.66*(k-2)-1  -DELIFT;
-        if (sc_max_scale<1) {
+        ctx->sc_max_scale = EXACT_BITS - labound - 0.66*(k-2)-1  -DELIFT;
+        if (ctx->sc_max_scale<1) {
             // warning(-10, overshot exact arithmetic);
-            sc_max_scale = 1;
+            ctx->sc_max_scale = 1;
         }
         
         if (j==0) {
@@ -402,14 +421,14 @@ static double sc(basis_s *v,simplex *s, int k, int j) {
             neighbor *sni;
             basis_s *snib;
             
-            sc_ldetbound = DELIFT;
+            ctx->sc_ldetbound = DELIFT;
             
-            sc_Sb = 0;
+            ctx->sc_Sb = 0;
             for (i=k-1,sni=s->neigh+k-1;i>0;i--,sni--) {
                 snib = sni->basis;
-                sc_Sb += snib->sqb;
-                sc_ldetbound += logb(snib->sqb)/2 + 1;
-                sc_ldetbound -= snib->lscale;
+                ctx->sc_Sb += snib->sqb;
+                ctx->sc_ldetbound += logb(snib->sqb)/2 + 1;
+                ctx->sc_ldetbound -= snib->lscale;
             }
         }
     }
@@ -417,21 +436,21 @@ static double sc(basis_s *v,simplex *s, int k, int j) {
     // when v->sqb is 0, _logb gives "divide by zero" error with Borland 2007 compilier, so check for it
     temp = v->sqb;
     if (temp)  temp = logb(temp) * 0.5;
-    if (sc_ldetbound - v->lscale + temp + 1 < 0) {
+    if (ctx->sc_ldetbound - v->lscale + temp + 1 < 0) {
         return 0;
     } else {
-        sc_lscale = (int)floor(logb(2*sc_Sb/(v->sqb + v->sqa*B_ERR_MIN)))/2;
-        if (sc_lscale > sc_max_scale) {
-            sc_lscale = (int)floor(sc_max_scale);
-        } else if (sc_lscale<0) sc_lscale = 0;
-        v->lscale += sc_lscale;
-        return ( ((int)(sc_lscale)<20) ? 1<<(int)(sc_lscale) : ldexp(1.f,(int)(sc_lscale)) );
+        ctx->sc_lscale = (int)floor(logb(2*ctx->sc_Sb/(v->sqb + v->sqa*B_ERR_MIN)))/2;
+        if (ctx->sc_lscale > ctx->sc_max_scale) {
+            ctx->sc_lscale = (int)floor(ctx->sc_max_scale);
+        } else if (ctx->sc_lscale<0) ctx->sc_lscale = 0;
+        v->lscale += ctx->sc_lscale;
+        return ( ((int)(ctx->sc_lscale)<20) ? 1<<(int)(ctx->sc_lscale) : ldexp(1.f,(int)(ctx->sc_lscale)) );
     }
 }
 
 
 // ----------------------------------------------------------------
-static int reduce_inner(basis_s *v, simplex *s, int k) {
+static int reduce_inner(ClarksonDelaunay *ctx, basis_s *v, simplex *s, int k) {
     // nothing is using the return value of this function
     point   va = VA(v),
     vb = VB(v);
@@ -441,31 +460,31 @@ static int reduce_inner(basis_s *v, simplex *s, int k) {
     neighbor *sni;
     // static int failcount;
     
-    v->sqa = v->sqb = Norm2(vb);
+    v->sqa = v->sqb = Norm2(ctx, vb);
     if (k<=1) {
-        memcpy(vb,va,basis_vec_size);
+        memcpy(vb,va,ctx->basis_vec_size);
         return 1;
     }
     for (j=0;j<250;j++) {
         
-        memcpy(vb,va,basis_vec_size);
+        memcpy(vb,va,ctx->basis_vec_size);
         for (i=k-1,sni=s->neigh+k-1;i>0;i--,sni--) {
             snibv = sni->basis;
-            dd = -Vec_dot(VB(snibv),vb)/ snibv->sqb;
-            Ax_plus_y( dd, VA(snibv), vb);
+            dd = -Vec_dot(ctx, VB(snibv),vb)/ snibv->sqb;
+            Ax_plus_y(ctx,  dd, VA(snibv), vb);
         }
-        v->sqb = Norm2(vb);
-        v->sqa = Norm2(va);
+        v->sqb = Norm2(ctx, vb);
+        v->sqa = Norm2(ctx, va);
         
         if (2*v->sqb >= v->sqa) { return 1;}
         
-        Vec_scale_test(rdim, sc(v,s,k,j), va);
+        Vec_scale_test(ctx->rdim, sc(ctx, v,s,k,j), va);
         
         for (i=k-1,sni=s->neigh+k-1;i>0;i--,sni--) {
             snibv = sni->basis;
-            dd = -Vec_dot(VB(snibv),va)/snibv->sqb;
+            dd = -Vec_dot(ctx, VB(snibv),va)/snibv->sqb;
             dd = floor(dd+0.5);
-            Ax_plus_y_test( dd, VA(snibv), va);
+            Ax_plus_y_test(ctx,  dd, VA(snibv), va);
         }
     }
     //  if (failcount++<10) {} a failure ?
@@ -473,15 +492,15 @@ static int reduce_inner(basis_s *v, simplex *s, int k) {
 }
 
 // ----------------------------------------------------------------
-static int reduce(basis_s **v, point p, simplex *s, int k) {
+static int reduce(ClarksonDelaunay *ctx, basis_s **v, point p, simplex *s, int k) {
     // nothing is using the return value of this function
     point   z;
     point   tt = s->neigh[0].vert;
     
     // if (!*v) NEWLRC(basis_s,(*v))
     if (!*v) {
-        (*v) = basis_s_list ? basis_s_list : new_block_basis_s(1);
-        basis_s_list = (*v)->next;
+        (*v) = ctx->basis_s_list ? ctx->basis_s_list : new_block_basis_s(ctx, 1);
+        ctx->basis_s_list = (*v)->next;
         (*v)->ref_count = 1;
     }
     else (*v)->lscale = 0;
@@ -489,105 +508,102 @@ static int reduce(basis_s **v, point p, simplex *s, int k) {
     
     // z = VB(*v);
     z = ((*v)->vecs);
-    if (p==hull_infinity) memcpy(*v,infinity_basis,basis_s_size);
+    if (p==hull_infinity) memcpy(*v,ctx->infinity_basis,ctx->basis_s_size);
     // else {trans(z,p,tt); lift(z,s);}
     else {
         {
             int i;
-            for (i=0;i<pdim;i++) z[i+rdim] = z[i] = p[i] - tt[i];
+            for (i=0;i<ctx->pdim;i++) z[i+ctx->rdim] = z[i] = p[i] - tt[i];
         };
         {
-            z[2*rdim-1] = z[rdim-1] = ldexp(Vec_dot_pdim(z,z), -0);
+            z[2*ctx->rdim-1] = z[ctx->rdim-1] = ldexp(Vec_dot_pdim(ctx, z,z), -0);
         };
     }
-    return reduce_inner(*v,s,k);
+    return reduce_inner(ctx, *v,s,k);
 }
 
 // ----------------------------------------------------------------
-static void get_basis_sede(simplex *s) {
+static void get_basis_sede(ClarksonDelaunay *ctx, simplex *s) {
     
     int   k=1;
     neighbor *sn = s->neigh+1,
     *sn0 = s->neigh;
     
-    if (sn0->vert == hull_infinity && cdim >1) {
+    if (sn0->vert == hull_infinity && ctx->cdim >1) {
         // SWAP(neighbor, *sn0, *sn );
         { neighbor t; t = *sn0; *sn0 = *sn; *sn = t; };
         // NULLIFY(basis_s,sn0->basis);
         {{ if ((sn0->basis) && --(sn0->basis)->ref_count == 0) {
-            memset(((sn0->basis)),0,basis_s_size);
-            ((sn0->basis))->next = basis_s_list;
-            basis_s_list = (sn0->basis);
+            memset(((sn0->basis)),0,ctx->basis_s_size);
+            ((sn0->basis))->next = ctx->basis_s_list;
+            ctx->basis_s_list = (sn0->basis);
         };
         };
             sn0->basis = 0;
         };
-        sn0->basis = tt_basisp;
-        tt_basisp->ref_count++;
+        sn0->basis = ctx->tt_basisp;
+        ctx->tt_basisp->ref_count++;
     } else {
         if (!sn0->basis) {
-            sn0->basis = tt_basisp;
-            tt_basisp->ref_count++;
-        } else while (k < cdim && sn->basis) {k++;sn++;}
+            sn0->basis = ctx->tt_basisp;
+            ctx->tt_basisp->ref_count++;
+        } else while (k < ctx->cdim && sn->basis) {k++;sn++;}
     }
-    while (k<cdim) {
+    while (k<ctx->cdim) {
         // NULLIFY(basis_s,sn->basis);
         {{ if ((sn->basis) && --(sn->basis)->ref_count == 0) {
-            memset(((sn->basis)),0,basis_s_size);
-            ((sn->basis))->next = basis_s_list;
-            basis_s_list = (sn->basis);
+            memset(((sn->basis)),0,ctx->basis_s_size);
+            ((sn->basis))->next = ctx->basis_s_list;
+            ctx->basis_s_list = (sn->basis);
         };
         };
             sn->basis = 0;
         };
-        reduce(&sn->basis,sn->vert,s,k);
+        reduce(ctx, &sn->basis,sn->vert,s,k);
         k++; sn++;
     }
 }
 
 
 // ----------------------------------------------------------------
-static int out_of_flat(simplex *root, point p) {
-    
-    if (!out_of_flat_p_neigh.basis)
-        out_of_flat_p_neigh.basis = (basis_s*) malloc(basis_s_size);
+static int out_of_flat(ClarksonDelaunay *ctx, simplex *root, point p) {
     
-    out_of_flat_p_neigh.vert = p;
-    cdim++;
-    root->neigh[cdim-1].vert = root->peak.vert;
+    ctx->out_of_flat_p_neigh.vert = p;
+    ctx->cdim++;
+    root->neigh[ctx->cdim-1].vert = root->peak.vert;
     // NULLIFY(basis_s,root->neigh[cdim-1].basis);
-    {{ if ((root->neigh[cdim-1].basis) && --(root->neigh[cdim-1].basis)->ref_count == 0) {
-        memset(((root->neigh[cdim-1].basis)),0,basis_s_size);
-        ((root->neigh[cdim-1].basis))->next = basis_s_list;
-        basis_s_list = (root->neigh[cdim-1].basis);
+    {{ if ((root->neigh[ctx->cdim-1].basis) && --(root->neigh[ctx->cdim-1].basis)->ref_count == 0) {
+        memset(((root->neigh[ctx->cdim-1].basis)),0,ctx->basis_s_size);
+        ((root->neigh[ctx->cdim-1].basis))->next = ctx->basis_s_list;
+        ctx->basis_s_list = (root->neigh[ctx->cdim-1].basis);
     };
     };
-        root->neigh[cdim-1].basis = 0;
+        root->neigh[ctx->cdim-1].basis = 0;
     };
     
-    get_basis_sede(root);
+    get_basis_sede(ctx, root);
     if (root->neigh[0].vert == hull_infinity) return 1;
-    reduce(&out_of_flat_p_neigh.basis,p,root,cdim);
-    if (out_of_flat_p_neigh.basis->sqa != 0) return 1;
-    cdim--;
+    reduce(ctx, &ctx->out_of_flat_p_neigh.basis,p,root,ctx->cdim);
+    if (ctx->out_of_flat_p_neigh.basis->sqa != 0) return 1;
+    ctx->cdim--;
     return 0;
 }
 
 
 // ----------------------------------------------------------------
-static void get_normal_sede(simplex *s) {
+static void get_normal_sede(ClarksonDelaunay *ctx, simplex *s) {
     
     neighbor *rn;
     int i,j;
     
-    get_basis_sede(s);
-    if (rdim==3 && cdim==3) {
+    get_basis_sede(ctx, s);
+    if (ctx->rdim==3 && ctx->cdim==3) {
         point   c,
         a = VB(s->neigh[1].basis),
         b = VB(s->neigh[2].basis);
         // NEWLRC(basis_s,s->normal);
-        { s->normal = basis_s_list ? basis_s_list : new_block_basis_s(1);
-            basis_s_list = s->normal->next;
+        { s->normal = ctx->basis_s_list ? ctx->basis_s_list : new_block_basis_s(ctx, 1);
+            ctx->basis_s_list = s->normal->next;
             s->normal->ref_count = 1;
         };
         // c = VB(s->normal);
@@ -595,74 +611,71 @@ static void get_normal_sede(simplex *s) {
         c[0] = a[1]*b[2] - a[2]*b[1];
         c[1] = a[2]*b[0] - a[0]*b[2];
         c[2] = a[0]*b[1] - a[1]*b[0];
-        s->normal->sqb = Norm2(c);
-        for (i=cdim+1,rn = ch_root->neigh+cdim-1; i; i--, rn--) {
-            for (j = 0; j<cdim && rn->vert != s->neigh[j].vert;j++);
-            if (j<cdim) continue;
+        s->normal->sqb = Norm2(ctx, c);
+        for (i=ctx->cdim+1,rn = ctx->ch_root->neigh+ctx->cdim-1; i; i--, rn--) {
+            for (j = 0; j<ctx->cdim && rn->vert != s->neigh[j].vert;j++);
+            if (j<ctx->cdim) continue;
             if (rn->vert==hull_infinity) {
                 if (c[2] > -B_ERR_MIN) continue;
-            } else  if (!sees(rn->vert,s)) continue;
+            } else  if (!sees(ctx, rn->vert,s)) continue;
             c[0] = -c[0]; c[1] = -c[1]; c[2] = -c[2];
             break;
         }
         return;
     }
     
-    for (i=cdim+1,rn = ch_root->neigh+cdim-1; i; i--, rn--) {
-        for (j = 0; j<cdim && rn->vert != s->neigh[j].vert;j++);
-        if (j<cdim) continue;
-        reduce(&s->normal,rn->vert,s,cdim);
+    for (i=ctx->cdim+1,rn = ctx->ch_root->neigh+ctx->cdim-1; i; i--, rn--) {
+        for (j = 0; j<ctx->cdim && rn->vert != s->neigh[j].vert;j++);
+        if (j<ctx->cdim) continue;
+        reduce(ctx, &s->normal,rn->vert,s,ctx->cdim);
         if (s->normal->sqb != 0) break;
     }
     
 }
 
 // ----------------------------------------------------------------
-static int sees(site p, simplex *s) {
+static int sees(ClarksonDelaunay *ctx, site p, simplex *s) {
     point   tt,zz;
     double   dd,dds;
     int i;
     
-    if (!sees_b)
-        sees_b = (basis_s*)malloc(basis_s_size);
-    else
-        sees_b->lscale = 0;
+    ctx->sees_b->lscale = 0;
     // zz = VB(sees_b);
-    zz = ((sees_b)->vecs);
-    if (cdim==0) return 0;
+    zz = ((ctx->sees_b)->vecs);
+    if (ctx->cdim==0) return 0;
     if (!s->normal) {
-        get_normal_sede(s);
+        get_normal_sede(ctx, s);
         // for (i=0;i<cdim;i++) NULLIFY(basis_s,s->neigh[i].basis);
-        for (i=0;i<cdim;i++) {
+        for (i=0;i<ctx->cdim;i++) {
             { if ((s->neigh[i].basis) && --(s->neigh[i].basis)->ref_count == 0) {
-                memset(((s->neigh[i].basis)),0,basis_s_size);
-                ((s->neigh[i].basis))->next = basis_s_list;
-                basis_s_list = (s->neigh[i].basis);
+                memset(((s->neigh[i].basis)),0,ctx->basis_s_size);
+                ((s->neigh[i].basis))->next = ctx->basis_s_list;
+                ctx->basis_s_list = (s->neigh[i].basis);
             };
             };
             s->neigh[i].basis = 0;
         };
     }
     tt = s->neigh[0].vert;
-    if (p==hull_infinity) memcpy(sees_b,infinity_basis,basis_s_size);
+    if (p==hull_infinity) memcpy(ctx->sees_b,ctx->infinity_basis,ctx->basis_s_size);
     // else {trans(zz,p,tt); lift(zz,s);}
     else {
         { int i;
-            for (i=0;i<pdim;i++) zz[i+rdim] = zz[i] = p[i] - tt[i];
+            for (i=0;i<ctx->pdim;i++) zz[i+ctx->rdim] = zz[i] = p[i] - tt[i];
         };
         {
-            zz[2*rdim-1] =zz[rdim-1]= ldexp(Vec_dot_pdim(zz,zz), -0);
+            zz[2*ctx->rdim-1] =zz[ctx->rdim-1]= ldexp(Vec_dot_pdim(ctx, zz,zz), -0);
         };
     }
     for (i=0;i<3;i++) {
-        dd = Vec_dot(zz,s->normal->vecs);
+        dd = Vec_dot(ctx, zz,s->normal->vecs);
         if (dd == 0.0) {
             return 0;
         }
-        dds = dd*dd/s->normal->sqb/Norm2(zz);
+        dds = dd*dd/s->normal->sqb/Norm2(ctx, zz);
         if (dds > B_ERR_MIN_SQ) return (dd<0);
-        get_basis_sede(s);
-        reduce_inner(sees_b,s,cdim);
+        get_basis_sede(ctx, s);
+        reduce_inner(ctx, ctx->sees_b,s,ctx->cdim);
     }
     //          exit(1);
     return 0;
@@ -670,19 +683,18 @@ static int sees(site p, simplex *s) {
 
 
 // ----------------------------------------------------------------
-static void ReleaseMemory(void)  {
+static void ReleaseMemory(ClarksonDelaunay *ctx)  {
     int i;
-    free_basis_s_storage();
-    free_simplex_storage();
-    
-    for (i=0; i<num_blocks; i++)
-        free (site_blocks[i]);
-    if (sees_b)
-        free (sees_b);
-    if (visit_triang_gen_st)
-        free (visit_triang_gen_st);
-    if (search_st)
-        free (search_st);
+    free_basis_s_storage(ctx);
+    free_simplex_storage(ctx);
+    
+    for (i=0; i<ctx->num_site_blocks_allocated; i++)
+        free (ctx->site_blocks[i]);
+    free (ctx->sees_b);
+    free (ctx->out_of_flat_p_neigh.basis);
+    free (ctx->visit_triang_gen_st);
+    free (ctx->search_st);
+    free (ctx->ptrToOutputList);
 }
 
 // ----------------------------------------------------------------
@@ -692,12 +704,12 @@ static int hullt(simplex *s, int i, void *dummy) {return i>-1;}
 // -------------------------------------------
 static int truet(simplex *s, int i, void *dum) {return 1;}
 // -------------------------------------------
-static simplex *visit_triang(simplex *root, visit_func *visit)
+static simplex *visit_triang(ClarksonDelaunay *ctx, simplex *root, visit_func *visit)
 /* visit the whole triangulation */
-{return visit_triang_gen(root, visit, truet);}
+{return visit_triang_gen(ctx, root, visit, truet);}
 
 // ----------------------------------------------------------------
-static void build_convex_hull(void) {
+static void build_convex_hull(ClarksonDelaunay *ctx) {
     // site_numm   returns number of site when given site
     // dim         dimension of point set
     
@@ -705,102 +717,98 @@ static void build_convex_hull(void) {
     
     // In order to use Clarkson's program as a function, the global and static variables
     // have to be reset every time
-    cdim = 0;
-    rdim = pdim+1;
-    if (rdim > MAXDIM)
+    ctx->cdim = 0;
+    ctx->rdim = ctx->pdim+1;
+    if (ctx->rdim > MAXDIM)
         exit(1); // "dimension bound MAXDIM exceeded; rdim=%d; pdim=%d\n", rdim, pdim);
     
-    numPointsProcessed = 0;
-    ptrToIntsToIndex  = listOfIntsToIndex;    // reset this in case the points are integers
-    ptrFloatsToIndex = listOfFloatsToIndex;   // reset this in case the points are floats
+    ctx->numPointsProcessed = 0;
+    ctx->ptrToIntsToIndex  = ctx->listOfIntsToIndex;    // reset this in case the points are integers
+    ctx->ptrFloatsToIndex = ctx->listOfFloatsToIndex;   // reset this in case the points are floats
     
-    ptrToOutputList = NULL;
+    // the output list, site blocks, scratch bases and traversal stacks are kept from the last build
+    ctx->currenOutputIndex = 0;
     
-    get_next_site_s_num = 0;
-    memset ((char*)site_blocks, 0, sizeof (site_blocks) );
-    num_blocks = 0;
+    ctx->get_next_site_s_num = 0;
+    ctx->num_blocks = 0;
     
-    out_of_flat_p_neigh.basis = 0;
-    out_of_flat_p_neigh.simp = 0;
-    out_of_flat_p_neigh.vert = 0;
+    ctx->out_of_flat_p_neigh.simp = 0;
+    ctx->out_of_flat_p_neigh.vert = 0;
     
-    sees_b = NULL;
+    ctx->visit_triang_gen_vnum = -1;
     
-    visit_triang_gen_st = NULL;
-    visit_triang_gen_vnum = -1;
-    visit_triang_gen_ss = 2000;
+    ctx->tt_basis.next = NULL;
+    ctx->tt_basis.ref_count = 1;
+    ctx->tt_basis.lscale = -1;
+    ctx->tt_basis.sqa = 0;
+    ctx->tt_basis.sqb = 0;
+    ctx->tt_basis.vecs[0] = 0;
     
-    search_st = NULL;
-    search_ss = MAXDIM;
+    ctx->sc_lscale = 0;
+    ctx->sc_max_scale = ctx->sc_ldetbound = ctx->sc_Sb = 0;
     
-    tt_basis.next = NULL;
-    tt_basis.ref_count = 1;
-    tt_basis.lscale = -1;
-    tt_basis.sqa = 0;
-    tt_basis.sqb = 0;
-    tt_basis.vecs[0] = 0;
+    ctx->make_facets_ns = NULL;
     
-    sc_lscale = 0;
-    sc_max_scale = sc_ldetbound = sc_Sb = 0;
+    ctx->point_size = ctx->site_size = sizeof(Coord)*ctx->pdim;
+    ctx->basis_vec_size = sizeof(Coord)*ctx->rdim;
+    ctx->basis_s_size = sizeof(basis_s)+ (2*ctx->rdim-1)*sizeof(Coord);
+    ctx->simplex_size = sizeof(simplex) + (ctx->rdim-1)*sizeof(neighbor);
     
-    make_facets_ns = NULL;
-    
-    point_size = site_size = sizeof(Coord)*pdim;
-    basis_vec_size = sizeof(Coord)*rdim;
-    basis_s_size = sizeof(basis_s)+ (2*rdim-1)*sizeof(Coord);
-    simplex_size = sizeof(simplex) + (rdim-1)*sizeof(neighbor);
+    // recycle the simplices and bases of the last build instead of freeing them
+    pool_reset(&ctx->basis_s_pool, ctx->basis_s_size);
+    pool_reset(&ctx->simplex_pool, ctx->simplex_size);
+    ctx->basis_s_list = 0;
+    ctx->simplex_list = 0;
     
     root = NULL;
-    p = hull_infinity;
+    ctx->p = hull_infinity;
     // NEWLRC(basis_s, infinity_basis);
-    { infinity_basis = basis_s_list ? basis_s_list : new_block_basis_s(1);
-        basis_s_list = infinity_basis->next;
-        infinity_basis->ref_count = 1;
+    { ctx->infinity_basis = ctx->basis_s_list ? ctx->basis_s_list : new_block_basis_s(ctx, 1);
+        ctx->basis_s_list = ctx->infinity_basis->next;
+        ctx->infinity_basis->ref_count = 1;
     };
-    infinity_basis->vecs[2*rdim-1]
-    = infinity_basis->vecs[rdim-1]
+    ctx->infinity_basis->vecs[2*ctx->rdim-1]
+    = ctx->infinity_basis->vecs[ctx->rdim-1]
     = 1;
-    infinity_basis->sqa
-    = infinity_basis->sqb
+    ctx->infinity_basis->sqa
+    = ctx->infinity_basis->sqb
     = 1;
     
     // NEWL(simplex,root);
-    { root = simplex_list ? simplex_list : new_block_simplex(1);
-        simplex_list = root->next;
+    { root = ctx->simplex_list ? ctx->simplex_list : new_block_simplex(ctx, 1);
+        ctx->simplex_list = root->next;
     };
     
-    ch_root = root;
+    ctx->ch_root = root;
     
     // copy_simp(s,root);
     { {
-        s = simplex_list ? simplex_list : new_block_simplex(1);
-        simplex_list = s->next;
+        s = ctx->simplex_list ? ctx->simplex_list : new_block_simplex(ctx, 1);
+        ctx->simplex_list = s->next;
     };
-        memcpy(s,root,simplex_size);
+        memcpy(s,root,ctx->simplex_size);
         {
             int i;
             neighbor *mrsn;
-            for (i=-1,mrsn=root->neigh-1;i<cdim;i++,mrsn++) {
+            for (i=-1,mrsn=root->neigh-1;i<ctx->cdim;i++,mrsn++) {
                 if (mrsn->basis) mrsn->basis->ref_count++;
             };
         }; };
     
-    root->peak.vert = p;
+    root->peak.vert = ctx->p;
     root->peak.simp = s;
     s->peak.simp = root;
     
-    buildhull(root);  // process the points
+    buildhull(ctx, root);  // process the points
     
     /* visit all simplices with facets of the current hull */
-    visit_triang_gen( visit_triang(root, facet_test), facets_print, hullt);      // create a triangle list
-    
-    ReleaseMemory();
+    visit_triang_gen(ctx,  visit_triang(ctx, root, facet_test), facets_print, hullt);      // create a triangle list
 }
 
 
 
 // -------------------------------------------
-static simplex *visit_triang_gen(simplex *s, visit_func *visit, test_func *test) {
+static simplex *visit_triang_gen(ClarksonDelaunay *ctx, simplex *s, visit_func *visit, test_func *test) {
     /*
      * starting at s, visit simplices t such that test(s,i,0) is true,
      * and t is the i'th neighbor of s;
@@ -812,25 +820,23 @@ static simplex *visit_triang_gen(simplex *s, visit_func *visit, test_func *test)
     simplex *t;
     int i;
     long tms = 0;
-#define pushv(x) *(visit_triang_gen_st + tms++) = x;
-#define popv(x)  x = *(visit_triang_gen_st + --tms);
+#define pushv(x) *(ctx->visit_triang_gen_st + tms++) = x;
+#define popv(x)  x = *(ctx->visit_triang_gen_st + --tms);
     
     
-    visit_triang_gen_vnum--;
-    if (!visit_triang_gen_st)
-        visit_triang_gen_st = (simplex**)malloc((visit_triang_gen_ss + MAXDIM+1) * sizeof(simplex*));
+    ctx->visit_triang_gen_vnum--;
     if (s) pushv(s);
     while (tms) {
-        if (tms>visit_triang_gen_ss) { // DEBEXP(-1,tms);
-            visit_triang_gen_st=(simplex**)realloc(visit_triang_gen_st,
-                                                   ((visit_triang_gen_ss += visit_triang_gen_ss)+MAXDIM+1) * sizeof(simplex*));
+        if (tms>ctx->visit_triang_gen_ss) { // DEBEXP(-1,tms);
+            ctx->visit_triang_gen_st=(simplex**)realloc(ctx->visit_triang_gen_st,
+                                                   ((ctx->visit_triang_gen_ss += ctx->visit_triang_gen_ss)+MAXDIM+1) * sizeof(simplex*));
         }
         popv(t);
-        if (!t || t->visit == visit_triang_gen_vnum) continue;
-        t->visit = visit_triang_gen_vnum;
-        if ((v=(*visit)(t,0))) {return (simplex*)v;}
-        for (i=-1,sn = t->neigh-1;i<cdim;i++,sn++)
-            if ((sn->simp->visit != visit_triang_gen_vnum) && sn->simp && test(t,i,0))
+        if (!t || t->visit == ctx->visit_triang_gen_vnum) continue;
+        t->visit = ctx->visit_triang_gen_vnum;
+        if ((v=(*visit)(t,ctx))) {return (simplex*)v;}
+        for (i=-1,sn = t->neigh-1;i<ctx->cdim;i++,sn++)
+            if ((sn->simp->visit != ctx->visit_triang_gen_vnum) && sn->simp && test(t,i,ctx))
                 pushv(sn->simp);
     }
     return NULL;
@@ -839,24 +845,24 @@ static simplex *visit_triang_gen(simplex *s, visit_func *visit, test_func *test)
 
 
 // ----------------------------------------------------------------
-static neighbor *op_simp(simplex *a, simplex *b) {{
+static neighbor *op_simp(ClarksonDelaunay *ctx, simplex *a, simplex *b) {{
     int i;
     /* the neighbor entry of a containing b */
     neighbor *x;
-    for (i=0, x = a->neigh; (x->simp != b) && (i<cdim) ; i++, x++) ;
-    if (i<cdim) return x;
+    for (i=0, x = a->neigh; (x->simp != b) && (i<ctx->cdim) ; i++, x++) ;
+    if (i<ctx->cdim) return x;
     else {
         exit(1); }
 }}
 
 
 // ----------------------------------------------------------------
-static neighbor *op_vert(simplex *a, site b)   {  {
+static neighbor *op_vert(ClarksonDelaunay *ctx, simplex *a, site b)   {  {
     int i;
     /* the neighbor entry of a containing b */
     neighbor *x;
-    for (i=0, x = a->neigh; (x->vert != b) && (i<cdim) ; i++, x++) ;
-    if (i<cdim)
+    for (i=0, x = a->neigh; (x->vert != b) && (i<ctx->cdim) ; i++, x++) ;
+    if (i<ctx->cdim)
         return x;
     else {
         exit(1); }
@@ -864,7 +870,7 @@ static neighbor *op_vert(simplex *a, site b)   {  {
 
 
 // ----------------------------------------------------------------
-static void connect(simplex *s) {
+static void connect(ClarksonDelaunay *ctx, simplex *s) {
     /* make neighbor connections between newly created simplices incident to p */
     
     site xf,xb,xfi;
@@ -874,37 +880,37 @@ static void connect(simplex *s) {
     
     if (!s) return;
     // assert(!s->peak.vert && s->peak.simp->peak.vert==p && !op_vert(s,p)->simp->peak.vert);
-    if (s->visit==pnum) return;
-    s->visit = pnum;
+    if (s->visit==ctx->pnum) return;
+    s->visit = ctx->pnum;
     seen = s->peak.simp;
-    xfi = op_simp(seen,s)->vert;
-    for (i=0, sn = s->neigh; i<cdim; i++,sn++) {
+    xfi = op_simp(ctx, seen,s)->vert;
+    for (i=0, sn = s->neigh; i<ctx->cdim; i++,sn++) {
         xb = sn->vert;
-        if (p == xb) continue;
+        if (ctx->p == xb) continue;
         sb = seen;
         sf = sn->simp;
         xf = xfi;
         if (!sf->peak.vert) {   /* are we done already? */
-            sf = op_vert(seen,xb)->simp;
+            sf = op_vert(ctx, seen,xb)->simp;
             if (sf->peak.vert) continue;
         } else do {
             xb = xf;
-            xf = op_simp(sf,sb)->vert;
+            xf = op_simp(ctx, sf,sb)->vert;
             sb = sf;
-            sf = op_vert(sb,xb)->simp;
+            sf = op_vert(ctx, sb,xb)->simp;
         } while (sf->peak.vert);
         
         sn->simp = sf;
-        op_vert(sf,xf)->simp = s;
+        op_vert(ctx, sf,xf)->simp = s;
         
-        connect(sf);
+        connect(ctx, sf);
     }
 }
 
 
 
 // ----------------------------------------------------------------
-static simplex *make_facets(simplex *seen) {
+static simplex *make_facets(ClarksonDelaunay *ctx, simplex *seen) {
     /*
      * visit simplices s with sees(p,s), and make a facet for every neighbor
      * of s not seen by p
@@ -916,94 +922,94 @@ static simplex *make_facets(simplex *seen) {
     
     
     if (!seen) return NULL;
-    seen->peak.vert = p;
+    seen->peak.vert = ctx->p;
     
-    for (i=0,bn = seen->neigh; i<cdim; i++,bn++) {
+    for (i=0,bn = seen->neigh; i<ctx->cdim; i++,bn++) {
         n = bn->simp;
-        if (pnum != n->visit) {
-            n->visit = pnum;
-            if (sees(p,n)) make_facets(n);
+        if (ctx->pnum != n->visit) {
+            n->visit = ctx->pnum;
+            if (sees(ctx, ctx->p,n)) make_facets(ctx, n);
         }
         if (n->peak.vert) continue;
         // copy_simp(make_facets_ns,seen);
-        { { make_facets_ns = simplex_list ? simplex_list : new_block_simplex(1);
-            simplex_list = make_facets_ns->next;
+        { { ctx->make_facets_ns = ctx->simplex_list ? ctx->simplex_list : new_block_simplex(ctx, 1);
+            ctx->simplex_list = ctx->make_facets_ns->next;
         };
-            memcpy(make_facets_ns,seen,simplex_size);
+            memcpy(ctx->make_facets_ns,seen,ctx->simplex_size);
             {
                 int i;
                 neighbor *mrsn;
-                for (i=-1,mrsn=seen->neigh-1;i<cdim;i++,mrsn++) {
+                for (i=-1,mrsn=seen->neigh-1;i<ctx->cdim;i++,mrsn++) {
                     if (mrsn->basis) mrsn->basis->ref_count++;
                 };
             }; };
         
-        make_facets_ns->visit = 0;
-        make_facets_ns->peak.vert = 0;
-        make_facets_ns->normal = 0;
-        make_facets_ns->peak.simp = seen;
+        ctx->make_facets_ns->visit = 0;
+        ctx->make_facets_ns->peak.vert = 0;
+        ctx->make_facets_ns->normal = 0;
+        ctx->make_facets_ns->peak.simp = seen;
         // NULLIFY(basis_s,make_facets_ns->neigh[i].basis);
-        {{ if ((make_facets_ns->neigh[i].basis) && --(make_facets_ns->neigh[i].basis)->ref_count == 0) {
-            memset(((make_facets_ns->neigh[i].basis)),0,basis_s_size);
-            ((make_facets_ns->neigh[i].basis))->next = basis_s_list;
-            basis_s_list = (make_facets_ns->neigh[i].basis);
+        {{ if ((ctx->make_facets_ns->neigh[i].basis) && --(ctx->make_facets_ns->neigh[i].basis)->ref_count == 0) {
+            memset(((ctx->make_facets_ns->neigh[i].basis)),0,ctx->basis_s_size);
+            ((ctx->make_facets_ns->neigh[i].basis))->next = ctx->basis_s_list;
+            ctx->basis_s_list = (ctx->make_facets_ns->neigh[i].basis);
         };
         };
-            make_facets_ns->neigh[i].basis = 0;
+            ctx->make_facets_ns->neigh[i].basis = 0;
         };
-        make_facets_ns->neigh[i].vert = p;
-        bn->simp = op_simp(n,seen)->simp = make_facets_ns;
+        ctx->make_facets_ns->neigh[i].vert = ctx->p;
+        bn->simp = op_simp(ctx, n,seen)->simp = ctx->make_facets_ns;
     }
-    return make_facets_ns;
+    return ctx->make_facets_ns;
 }
 
 
 
 // ----------------------------------------------------------------
-static simplex *extend_simplices(simplex *s) {
+static simplex *extend_simplices(ClarksonDelaunay *ctx, simplex *s) {
     /*
      * p lies outside flat containing previous sites;
      * make p a vertex of every current simplex, and create some new simplices
      */
     
-    int   i, ocdim=cdim-1;
+    int   i, ocdim=ctx->cdim-1;
     simplex *ns;
     neighbor *nsn;
     
-    if (s->visit == pnum) return s->peak.vert ? s->neigh[ocdim].simp : s;
-    s->visit = pnum;
-    s->neigh[ocdim].vert = p;
+    if (s->visit == ctx->pnum) return s->peak.vert ? s->neigh[ocdim].simp : s;
+    s->visit = ctx->pnum;
+    s->neigh[ocdim].vert = ctx->p;
     // NULLIFY(basis_s,s->normal);
     {{ if ((s->normal) && --(s->normal)->ref_count == 0) {
-        memset(((s->normal)),0,basis_s_size);
-        ((s->normal))->next = basis_s_list;
-        basis_s_list = (s->normal);
+        memset(((s->normal)),0,ctx->basis_s_size);
+        ((s->normal))->next = ctx->basis_s_list;
+        ctx->basis_s_list = (s->normal);
     };
     };
         s->normal = 0;
     };
     // NULLIFY(basis_s,s->neigh[0].basis);
     {{ if ((s->neigh[0].basis) && --(s->neigh[0].basis)->ref_count == 0) {
-        memset(((s->neigh[0].basis)),0,basis_s_size);
-        ((s->neigh[0].basis))->next = basis_s_list;
-        basis_s_list = (s->neigh[0].basis);
+        memset(((s->neigh[0].basis)),0,ctx->basis_s_size);
+        ((s->neigh[0].basis))->next = ctx->basis_s_list;
+        ctx->basis_s_list = (s->neigh[0].basis);
     };
     };
         s->neigh[0].basis = 0;
     };
     if (!s->peak.vert) {
-        s->neigh[ocdim].simp = extend_simplices(s->peak.simp);
+        s->neigh[ocdim].simp = extend_simplices(ctx, s->peak.simp);
         return s;
     } else {
         // copy_simp(ns,s);
-        { { ns = simplex_list ? simplex_list : new_block_simplex(1);
-            simplex_list = ns->next;
+        { { ns = ctx->simplex_list ? ctx->simplex_list : new_block_simplex(ctx, 1);
+            ctx->simplex_list = ns->next;
         };
-            memcpy(ns,s,simplex_size);
+            memcpy(ns,s,ctx->simplex_size);
             {
                 int i;
                 neighbor *mrsn;
-                for (i=-1,mrsn=s->neigh-1;i<cdim;i++,mrsn++) {
+                for (i=-1,mrsn=s->neigh-1;i<ctx->cdim;i++,mrsn++) {
                     if (mrsn->basis) mrsn->basis->ref_count++;
                 };
             }; };
@@ -1014,15 +1020,15 @@ static simplex *extend_simplices(simplex *s) {
         ns->neigh[ocdim] = s->peak;
         // inc_ref(basis_s,s->peak.basis);
         { if (s->peak.basis)  s->peak.basis->ref_count++; };
-        for (i=0,nsn=ns->neigh;i<cdim;i++,nsn++)
-            nsn->simp = extend_simplices(nsn->simp);
+        for (i=0,nsn=ns->neigh;i<ctx->cdim;i++,nsn++)
+            nsn->simp = extend_simplices(ctx, nsn->simp);
     }
     return ns;
 }
 
 
 // ----------------------------------------------------------------
-static simplex *search(simplex *root) {
+static simplex *search(ClarksonDelaunay *ctx, simplex *root) {
     /* return a simplex s that corresponds to a facet of the
      * current hull, and sees(p, s) */
     
@@ -1030,116 +1036,122 @@ static simplex *search(simplex *root) {
     neighbor *sn;
     int i;
     long tms = 0;
-#define pushs(x) *(search_st + tms++) = x;
-#define pops(x)  x = *(search_st + --tms);
+#define pushs(x) *(ctx->search_st + tms++) = x;
+#define pops(x)  x = *(ctx->search_st + --tms);
     
-    if (!search_st)
-        search_st = (simplex **)malloc((search_ss+MAXDIM+1)*sizeof(simplex*));
     pushs(root->peak.simp);
-    root->visit = pnum;
-    if (!sees(p,root))
-        for (i=0,sn=root->neigh;i<cdim;i++,sn++) pushs(sn->simp);
+    root->visit = ctx->pnum;
+    if (!sees(ctx, ctx->p,root))
+        for (i=0,sn=root->neigh;i<ctx->cdim;i++,sn++) pushs(sn->simp);
     while (tms) {
-        if (tms>search_ss)
-            search_st=(simplex**)realloc(search_st,
-                                         ((search_ss += search_ss) + MAXDIM+1) * sizeof(simplex*));
+        if (tms>ctx->search_ss)
+            ctx->search_st=(simplex**)realloc(ctx->search_st,
+                                         ((ctx->search_ss += ctx->search_ss) + MAXDIM+1) * sizeof(simplex*));
         pops(s);
-        if (s->visit == pnum) continue;
-        s->visit = pnum;
-        if (!sees(p,s)) continue;
+        if (s->visit == ctx->pnum) continue;
+        s->visit = ctx->pnum;
+        if (!sees(ctx, ctx->p,s)) continue;
         if (!s->peak.vert) return s;
-        for (i=0, sn=s->neigh; i<cdim; i++,sn++) pushs(sn->simp);
+        for (i=0, sn=s->neigh; i<ctx->cdim; i++,sn++) pushs(sn->simp);
     }
     return NULL;
 }
 
 
 // -------------------------------------------
-static site new_site (site p, long j) {
+static site new_site (ClarksonDelaunay *ctx, site p, long j) {
     
     if (0==(j%BLOCKSIZE)) {
-        return(site_blocks[num_blocks++]=(site)malloc(BLOCKSIZE*site_size));
+        // site blocks are sized for MAXDIM so they can be reused whatever the dimension
+        if (ctx->num_blocks == ctx->num_site_blocks_allocated)
+            ctx->site_blocks[ctx->num_site_blocks_allocated++] = (site)malloc(BLOCKSIZE*MAX_SITE_SIZE);
+        return ctx->site_blocks[ctx->num_blocks++];
     } else
-        return p + pdim;
+        return p + ctx->pdim;
 }
 
 // -------------------------------------------
-static site get_next_site(void) {
+static site get_next_site(ClarksonDelaunay *ctx) {
     int i;
-    p = new_site(p, get_next_site_s_num);
-    get_next_site_s_num++;
+    ctx->p = new_site(ctx, ctx->p, ctx->get_next_site_s_num);
+    ctx->get_next_site_s_num++;
     
-    if (numPointsProcessed >= totalInputPoints)  {
+    if (ctx->numPointsProcessed >= ctx->totalInputPoints)  {
         // guess at how much memory is needed for the output list
-        maxOutputEntries = numPointsProcessed * 3*3; // 3 values per triangle, and there will be about 2 times as many triangles as input points
-        ptrToOutputList = (WORD*)malloc((maxOutputEntries + 1) * sizeof(WORD));
-        currenOutputIndex = 0;
+        ctx->maxOutputEntries = ctx->numPointsProcessed * 3*3; // 3 values per triangle, and there will be about 2 times as many triangles as input points
+        if (ctx->maxOutputEntries + 1 > ctx->outputCapacity)  {
+            free (ctx->ptrToOutputList);
+            ctx->outputCapacity = ctx->maxOutputEntries + 1;
+            ctx->ptrToOutputList = (WORD*)malloc(ctx->outputCapacity * sizeof(WORD));
+        }
+        ctx->currenOutputIndex = 0;
         return 0;
     }
-    if (ptrToIntsToIndex)  {         // if there is a list of integer points
-        for (i=0; i<pdim; i++)  {
-            p[i] = *ptrToIntsToIndex++;
+    if (ctx->ptrToIntsToIndex)  {         // if there is a list of integer points
+        for (i=0; i<ctx->pdim; i++)  {
+            ctx->p[i] = *ctx->ptrToIntsToIndex++;
         }
     }
     else  {                         // else convert the floating points to integers
-        for (i=0; i<pdim; i++)  {
-            p[i] = floor(*ptrFloatsToIndex * mult_up + 0.5);
-            ptrFloatsToIndex++;
+        for (i=0; i<ctx->pdim; i++)  {
+            ctx->p[i] = floor(*ctx->ptrFloatsToIndex * ctx->mult_up + 0.5);
+            ctx->ptrFloatsToIndex++;
         }
     }
-    numPointsProcessed ++;
-    return p;
+    ctx->numPointsProcessed ++;
+    return ctx->p;
 }
 
 // -------------------------------------------
-static long site_numm(site p) {
+static long site_numm(ClarksonDelaunay *ctx, site p) {
     long i,j;
     
     if (p==hull_infinity) return -1;
     if (!p) return -2;
-    for (i=0; i<num_blocks; i++)
-        if ((j=p-site_blocks[i])>=0 && j < BLOCKSIZE*pdim)
-            return j/pdim + BLOCKSIZE*i;
+    for (i=0; i<ctx->num_blocks; i++)
+        if ((j=p-ctx->site_blocks[i])>=0 && j < BLOCKSIZE*ctx->pdim)
+            return j/ctx->pdim + BLOCKSIZE*i;
     return -3;
 }
 
 // ----------------------------------------------------------------
-static point get_another_site(void) {
+static point get_another_site(ClarksonDelaunay *ctx) {
     point pnext;
     
-    pnext = get_next_site();
+    pnext = get_next_site(ctx);
     
     if (!pnext) return NULL;
-    pnum = site_numm(pnext)+2;
+    ctx->pnum = site_numm(ctx, pnext)+2;
     return pnext;
 }
 
 
 // ----------------------------------------------------------------
-static void buildhull (simplex *root) {
+static void buildhull (ClarksonDelaunay *ctx, simplex *root) {
     
-    while (cdim < rdim) {
-        p = get_another_site();
-        if (!p) return;
-        if (out_of_flat(root,p))
-            extend_simplices(root);
+    while (ctx->cdim < ctx->rdim) {
+        ctx->p = get_another_site(ctx);
+        if (!ctx->p) return;
+        if (out_of_flat(ctx, root,ctx->p))
+            extend_simplices(ctx, root);
         else
-            connect(make_facets(search(root)));
+            connect(ctx, make_facets(ctx, search(ctx, root)));
     }
-    while ((p = get_another_site()))
-        connect(make_facets(search(root)));
+    while ((ctx->p = get_another_site(ctx)))
+        connect(ctx, make_facets(ctx, search(ctx, root)));
 }
 
 
 // ------------------------------------------------------
-static simplex *facets_print(simplex *s, void *p) {
+static simplex *facets_print(simplex *s, void *data) {
+    ClarksonDelaunay *ctx = (ClarksonDelaunay *)data;
     point v[MAXDIM];
     int j;
     
-    for (j=0;j<cdim;j++) v[j] = s->neigh[j].vert;
+    for (j=0;j<ctx->cdim;j++) v[j] = s->neigh[j].vert;
     
-    triangleList_out ( site_numm(v[0]), site_numm(v[1]), site_numm(v[2]),
-                      (pdim == 3) ? site_numm(v[3]) : 0 );
+    triangleList_out(ctx,  site_numm(ctx, v[0]), site_numm(ctx, v[1]), site_numm(ctx, v[2]),
+                      (ctx->pdim == 3) ? site_numm(ctx, v[3]) : 0 );
     return NULL;
 }
 
@@ -1157,7 +1169,7 @@ static int IsTriangleClockwise (int *a, int *b, int *c)  {
 }
 
 // ------------------------------------------------------
-static void triangleList_out (int v0, int v1, int v2, int v3) {
+static void triangleList_out (ClarksonDelaunay *ctx, int v0, int v1, int v2, int v3) {
     // outfunc: given a list of points, output in a given format
     // if one of the values < 0, it is a point to identify the convex hull rather than a triangle
     int isCW;
@@ -1171,24 +1183,24 @@ static void triangleList_out (int v0, int v1, int v2, int v3) {
         // v0, v1, v2 are indexes to triangle vertexes, an x and y, in listOfIntsToIndex, so,
         // v0 is index to the first vertex: ie, listOfIntsToIndex[v0*2], listOfIntsToIndex[v0*2+1]
         // v1 is listOfIntsToIndex[v1*2], listOfIntsToIndex[v1*2+1]
-        if (triangleDirection)  {
-            if (ptrToIntsToIndex)  {         // if there is a list of integer points
-                isCW = IsTriangleClockwise (&listOfIntsToIndex[v0*2], &listOfIntsToIndex[v1*2], &listOfIntsToIndex[v2*2]);
+        if (ctx->triangleDirection)  {
+            if (ctx->ptrToIntsToIndex)  {         // if there is a list of integer points
+                isCW = IsTriangleClockwise (&ctx->listOfIntsToIndex[v0*2], &ctx->listOfIntsToIndex[v1*2], &ctx->listOfIntsToIndex[v2*2]);
             }
             else  {
-                isCW = IsFloatTriangleClockwise (&listOfFloatsToIndex[v0*2], &listOfFloatsToIndex[v1*2], &listOfFloatsToIndex[v2*2]);
+                isCW = IsFloatTriangleClockwise (&ctx->listOfFloatsToIndex[v0*2], &ctx->listOfFloatsToIndex[v1*2], &ctx->listOfFloatsToIndex[v2*2]);
             }
-            if ( ((triangleDirection > 0) && !isCW)  ||   // if user wants CW triangles, but it is not CW
-                ((triangleDirection < 0) && isCW))  {     // or user wants CCW triangles, but it is CW
-                ptrToOutputList[currenOutputIndex++] = (WORD)v2;
-                ptrToOutputList[currenOutputIndex++] = (WORD)v1;
-                ptrToOutputList[currenOutputIndex++] = (WORD)v0;
+            if ( ((ctx->triangleDirection > 0) && !isCW)  ||   // if user wants CW triangles, but it is not CW
+                ((ctx->triangleDirection < 0) && isCW))  {     // or user wants CCW triangles, but it is CW
+                ctx->ptrToOutputList[ctx->currenOutputIndex++] = (WORD)v2;
+                ctx->ptrToOutputList[ctx->currenOutputIndex++] = (WORD)v1;
+                ctx->ptrToOutputList[ctx->currenOutputIndex++] = (WORD)v0;
                 return;
             }
         }
-        ptrToOutputList[currenOutputIndex++] = (WORD)v0;
-        ptrToOutputList[currenOutputIndex++] = (WORD)v1;
-        ptrToOutputList[currenOutputIndex++] = (WORD)v2;
+        ctx->ptrToOutputList[ctx->currenOutputIndex++] = (WORD)v0;
+        ctx->ptrToOutputList[ctx->currenOutputIndex++] = (WORD)v1;
+        ctx->ptrToOutputList[ctx->currenOutputIndex++] = (WORD)v2;
         
         // In all the testing I did so far, currenOutputIndex has never exceeeded maxOutputEntries
         // So I removed the test to see if currenOutputIndex is within the appropriate range
@@ -1196,34 +1208,75 @@ static void triangleList_out (int v0, int v1, int v2, int v3) {
 }
 
 // ------------------------------------------------------
-WORD *BuildTriangleIndexList (void *pointList, float factor, int numberOfInputPoints, int numDimensions, int clockwise, int *numTriangleVertices ) {
-    // returns an index list that can be used by: ->IASetIndexBuffer(), using the format: DXGI_FORMAT_R16_UINT
-    // Adjust triangleList_out() if you do not want to spend time putting the triangles into clockwise order,
-    // or to put them in anti-clockwise order.
-    
-    // I don't know what the limit of Clarkson's function is in regards to how many input points
-    // it will accept, but I set the return value to 16-bit integers because I assume nobody needs
-    // more than 64,000 triangles at a time
+ClarksonDelaunay *DelaunayContextCreate (void)  {
+    ClarksonDelaunay *ctx = (ClarksonDelaunay*)calloc(1, sizeof(ClarksonDelaunay));
+    if (!ctx)
+        return NULL;
+    // scratch bases big enough for any dimension, kept for the life of the context
+    ctx->sees_b = (basis_s*)calloc(1, MAX_BASIS_S_SIZE);
+    ctx->out_of_flat_p_neigh.basis = (basis_s*)calloc(1, MAX_BASIS_S_SIZE);
+    
+    ctx->visit_triang_gen_ss = 2000;
+    ctx->visit_triang_gen_st = (simplex**)malloc((ctx->visit_triang_gen_ss + MAXDIM+1) * sizeof(simplex*));
+    ctx->search_ss = MAXDIM;
+    ctx->search_st = (simplex **)malloc((ctx->search_ss+MAXDIM+1)*sizeof(simplex*));
+    
+    ctx->tt_basisp = &ctx->tt_basis;
+    return ctx;
+}
+
+// ------------------------------------------------------
+void DelaunayContextDestroy (ClarksonDelaunay *ctx)  {
+    if (!ctx)
+        return;
+    ReleaseMemory(ctx);
+    free (ctx);
+}
+
+// ------------------------------------------------------
+WORD *BuildTriangleIndexListInContext (ClarksonDelaunay *ctx, void *pointList, float factor, int numberOfInputPoints, int numDimensions, int clockwise, int *numTriangleVertices )  {
+    // Same as BuildTriangleIndexList(), but all the state lives in ctx, so separate contexts can
+    // triangulate on separate threads. The returned list belongs to ctx and stays valid until the
+    // next build in that context; do not free it.
     
     if (factor)  {
-        ptrToIntsToIndex = NULL;     // set to NULL to show get_next_site() to process floating-points
-        mult_up = factor;
-        listOfFloatsToIndex = (float*)pointList;
+        ctx->listOfIntsToIndex = NULL;     // set to NULL to show get_next_site() to process floating-points
+        ctx->mult_up = factor;
+        ctx->listOfFloatsToIndex = (float*)pointList;
     }
     else  {
         // the points are integers, in which case mult_up and listOfFloatsToIndex will not be used
         // so they don't need to be initialized
-        listOfIntsToIndex = (int*)pointList;
+        ctx->listOfIntsToIndex = (int*)pointList;
     }
     
-    pdim = numDimensions;
-    totalInputPoints = numberOfInputPoints;
-    triangleDirection = clockwise;
+    ctx->pdim = numDimensions;
+    ctx->totalInputPoints = numberOfInputPoints;
+    ctx->triangleDirection = clockwise;
     
-    build_convex_hull();    // This function does all the work
+    build_convex_hull(ctx);    // This function does all the work
     
-    *numTriangleVertices = currenOutputIndex;
-    return ptrToOutputList ;    // calling function has to free return value: ptrToOutputList ;
+    *numTriangleVertices = ctx->currenOutputIndex;
+    return ctx->ptrToOutputList ;
 }
 
-
+// ------------------------------------------------------
+WORD *BuildTriangleIndexList (void *pointList, float factor, int numberOfInputPoints, int numDimensions, int clockwise, int *numTriangleVertices ) {
+    // returns an index list that can be used by: ->IASetIndexBuffer(), using the format: DXGI_FORMAT_R16_UINT
+    // Adjust triangleList_out() if you do not want to spend time putting the triangles into clockwise order,
+    // or to put them in anti-clockwise order.
+    
+    // I don't know what the limit of Clarkson's function is in regards to how many input points
+    // it will accept, but I set the return value to 16-bit integers because I assume nobody needs
+    // more than 64,000 triangles at a time
+    
+    // Callers that triangulate repeatedly should keep a context instead; this one is built and torn down per call
+    ClarksonDelaunay *ctx = DelaunayContextCreate();
+    WORD *indexList, *triangles;
+    
+    triangles = BuildTriangleIndexListInContext(ctx, pointList, factor, numberOfInputPoints, numDimensions, clockwise, numTriangleVertices);
+    indexList = (WORD*)malloc(ctx->outputCapacity * sizeof(WORD));
+    memcpy(indexList, triangles, *numTriangleVertices * sizeof(WORD));
+    DelaunayContextDestroy(ctx);
+    return indexList;    // calling function has to free return value
+}
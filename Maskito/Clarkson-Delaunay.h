@@ -15,6 +15,13 @@
 extern "C" {
 #endif
     unsigned int * BuildTriangleIndexList (void *pointList, float factor, int numberOfInputPoints, int numDimensions, int clockwise, int *numTriangleVertices );
+
+    /* Reentrant form: one context per thread. The context keeps its memory between builds, and the
+     * returned list belongs to it until the next build in that context. */
+    typedef struct ClarksonDelaunay ClarksonDelaunay;
+    ClarksonDelaunay * DelaunayContextCreate (void);
+    void DelaunayContextDestroy (ClarksonDelaunay *context);
+    unsigned int * BuildTriangleIndexListInContext (ClarksonDelaunay *context, void *pointList, float factor, int numberOfInputPoints, int numDimensions, int clockwise, int *numTriangleVertices );
 #ifdef __cplusplus
 }
 #endif
@@ -5,8 +5,22 @@
 
 import Foundation
 
+final class WarpContext {
+    // Owns the native per-face warp state for as long as the face is tracked.
+    let handle : COpaquePointer
+    
+    init() {
+        handle = warp_context_create()
+    }
+    
+    deinit {
+        warp_context_destroy(handle)
+    }
+}
+
 struct Face {
     let landmarks : [PhiPoint]
     var parameters : [CDouble]
     let time : NSDate
-}
\ No newline at end of file
+    let context = WarpContext()
+}
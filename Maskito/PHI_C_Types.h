@@ -21,4 +21,15 @@ typedef struct {
     int z;
 } PhiPoint3D;
 
+// Interleaved face vertex: position in clip space, texture coordinate, blend alpha.
+// Same layout as the Swift Coordinate used by the face VBO.
+typedef struct {
+    float x;
+    float y;
+    float z;
+    float u;
+    float v;
+    float alpha;
+} PhiVertex;
+
 #endif /* PHI_C_Types_h */
@@ -511,55 +511,31 @@ class Renderer : NSObject, AVCaptureVideoDataOutputSampleBufferDelegate, AVCaptu
 //                drawInnerMouth(XY: uvPoints, UV: uvPoints)
             }
         case .HANDSOME:
-            for pointArray in facePoints {
-                let uvPoints = pointArray.map {
-                    return $0.PhiPointValue
-                }
-                
-                let (xyPoints, rotationAmount) = doWarp(uvPoints)
+            for (face, (uvPoints, (xyPoints, rotationAmount))) in zip(facePhiPoints, doWarps(facePhiPoints)).enumerate() {
                 drawBlurFace(XY: xyPoints, UV: uvPoints, withRotation: Float(rotationAmount))
-                drawClearFace(XY: xyPoints, UV: uvPoints, withAlphas: (0.7, 1.0, 0.9, 0.9))
-                drawRightEye(XY: xyPoints, UV: uvPoints)
-                drawLeftEye(XY: xyPoints, UV: uvPoints)
-                drawMouth(XY: xyPoints, UV: uvPoints)
+                drawClearFace(face: face, withAlphas: (0.7, 1.0, 0.9, 0.9))
+                drawFeatures(face: face)
                 let (ratio, min, max) = prepTeeth(UVs: uvPoints)
                 drawBrighterMouth(XY: xyPoints, UV: uvPoints, withMin: min, andMax: max, andRatio: ratio, andRotation: Float(rotationAmount))
             }
         case .PRETTY:
-            for pointArray in facePoints {
-                let uvPoints = pointArray.map {
-                    return $0.PhiPointValue
-                }
-                
-                let (xyPoints, rotationAmount) = doWarp(uvPoints)
+            for (face, (uvPoints, (xyPoints, rotationAmount))) in zip(facePhiPoints, doWarps(facePhiPoints)).enumerate() {
                 drawBlurFace(XY: xyPoints, UV: uvPoints, withRotation: Float(rotationAmount))
-                drawClearFace(XY: xyPoints, UV: uvPoints, withAlphas: (0.6, 1.0, 0.9, 0.9))
-                drawRightEye(XY: xyPoints, UV: uvPoints)
-                drawLeftEye(XY: xyPoints, UV: uvPoints)
-                drawMouth(XY: xyPoints, UV: uvPoints)
+                drawClearFace(face: face, withAlphas: (0.6, 1.0, 0.9, 0.9))
+                drawFeatures(face: face)
                 let (ratio, min, max) = prepTeeth(UVs: uvPoints)
                 drawBrighterMouth(XY: xyPoints, UV: uvPoints, withMin: min, andMax: max, andRatio: ratio, andRotation: Float(rotationAmount))
             }
         case .SILLY:
-            for pointArray in facePoints {
-                let uvPoints = pointArray.map {
-                    return $0.PhiPointValue
-                }
-                let (xyPoints, rotationAmount) = doWarp(uvPoints)
-                drawClearFace(XY: xyPoints, UV: uvPoints, withAlphas: (1.0, 1.0, 1.0, 1.0))
-                drawRightEye(XY: xyPoints, UV: uvPoints)
-                drawLeftEye(XY: xyPoints, UV: uvPoints)
-                drawMouth(XY: xyPoints, UV: uvPoints)
+            for (face, (uvPoints, (xyPoints, rotationAmount))) in zip(facePhiPoints, doWarps(facePhiPoints)).enumerate() {
+                drawClearFace(face: face, withAlphas: (1.0, 1.0, 1.0, 1.0))
+                drawFeatures(face: face)
                 let (ratio, min, max) = prepTeeth(UVs: uvPoints)
 
                 drawBrighterMouth(XY: xyPoints, UV: uvPoints, withMin: min, andMax: max, andRatio: ratio, andRotation: Float(rotationAmount))
             }
         case _:
-            for pointArray in facePoints {
-                let uvPoints = pointArray.map {
-                    return $0.PhiPointValue
-                }
-                let (xyPoints, _) = doWarp(uvPoints)
+            for (uvPoints, (xyPoints, _)) in zip(facePhiPoints, doWarps(facePhiPoints)) {
                 drawClearFace(XY: xyPoints, UV: uvPoints, withAlphas: (1.0, 1.0, 1.0, 1.0))
                 drawRightEye(XY: xyPoints, UV: uvPoints)
                 drawLeftEye(XY: xyPoints, UV: uvPoints)
@@ -769,12 +745,26 @@ class Renderer : NSObject, AVCaptureVideoDataOutputSampleBufferDelegate, AVCaptu
     }
     
     func drawClearFace(XY xy: [PhiPoint], UV uv: [PhiPoint], withAlphas alpha : (Float, Float, Float, Float)) {
+        drawClearFace(fillingVertices: { (box) in
+            self.vertexManager!.fillFaceVertex(XY: xy, UV: uv, inBox: box, inFaceAlpha: alpha.0, outFaceAlpha: alpha.1, aroundEyesAlpha: alpha.2, aroundMouthAlpha: alpha.3)
+        })
+    }
+    
+    func drawClearFace(face idx: Int, withAlphas alpha : (Float, Float, Float, Float)) {
+        drawClearFace(fillingVertices: { (box) in
+            self.vertexManager!.fillFaceVertex(vertices: self.warper.faceVertices(idx, inBox: box, withAlphas: alpha))
+        })
+    }
+    
+    // Blends the face skin from the upright texture over the output; fill uploads the face's
+    // vertices for the upright box.
+    private func drawClearFace(fillingVertices fill: (CGRect) -> ()) {
         let box = textureManager!.uprightRect
         if let box = box {
             glEnable(GLenum(GL_BLEND))
             glBlendFuncSeparate(GLenum(GL_SRC_ALPHA), GLenum(GL_ONE_MINUS_SRC_ALPHA), GLenum(GL_ZERO), GLenum(GL_ONE))
             let (xyzSlot, uvSlot, alphaSlot, textureSlot) = shaderManager!.activatePassThroughShader()
-            vertexManager!.fillFaceVertex(XY: xy, UV: uv, inBox: box, inFaceAlpha: alpha.0, outFaceAlpha: alpha.1, aroundEyesAlpha: alpha.2, aroundMouthAlpha: alpha.3)
+            fill(box)
             vertexManager!.selectFacePart(FacePart.SKIN)
             let (num, type) = vertexManager!.bindFaceVBO(withPositionSlot: xyzSlot, andUVSlot: uvSlot, andAlphaSlot: alphaSlot)
             textureManager!.bindUprightTextureToSlot(textureSlot)
@@ -786,6 +776,24 @@ class Renderer : NSObject, AVCaptureVideoDataOutputSampleBufferDelegate, AVCaptu
         }
     }
     
+    func drawFeatures(face idx: Int) {
+        // Right eye, left eye and mouth, drawn from a single upload of the face's vertices.
+        let box = textureManager!.uprightRect
+        if let box = box {
+            vertexManager!.fillFaceVertex(vertices: warper.faceVertices(idx, inBox: box, withAlphas: (1.0, 1.0, 1.0, 1.0)))
+            for part in [FacePart.RIGHT_EYE, FacePart.LEFT_EYE, FacePart.ALL_MOUTH] {
+                let (xyzSlot, uvSlot, alphaSlot, textureSlot) = shaderManager!.activatePassThroughShader()
+                vertexManager!.selectFacePart(part)
+                let (num, type) = vertexManager!.bindFaceVBO(withPositionSlot: xyzSlot, andUVSlot: uvSlot, andAlphaSlot: alphaSlot)
+                textureManager!.bindUprightTextureToSlot(textureSlot)
+                textureManager!.bindOutputTextureAsOutput()
+                textureManager!.setViewPortForOutputTexture()
+                glDrawElements(GLenum(GL_TRIANGLES), num, type, nil)
+                vertexManager!.unbindFaceVBO(fromPositionSlot: xyzSlot, andUVSlot: uvSlot, andAlphaSlot: alphaSlot)
+            }
+        }
+    }
+    
     func drawMouth(XY xy: [PhiPoint], UV uv: [PhiPoint]) {
         let box = textureManager!.uprightRect
         if let box = box {
@@ -872,6 +880,10 @@ class Renderer : NSObject, AVCaptureVideoDataOutputSampleBufferDelegate, AVCaptu
         return warper.doWarp(uv, warp: warpType)
     }
     
+    func doWarps(uvs : [[PhiPoint]]) -> [([PhiPoint], Float64)] {
+        return warper.doWarps(uvs, warp: warpType)
+    }
+    
     func scheduleSave() {
         captureNext = true
     }
@@ -969,7 +981,8 @@ class Renderer : NSObject, AVCaptureVideoDataOutputSampleBufferDelegate, AVCaptu
                 if let time = calibrateTime { // do calibration
                     failCalibrateTime = nil // nil this out, since either: it's already nil or the clever user has rotated their device
                     let deltaT = NSDate().timeIntervalSinceDate(time)
-                    if deltaT > 5.5 {
+                    // Stop as soon as the estimate is stable, or after the full countdown.
+                    if deltaT > 5.5 || warper.calibrationConverged(warpType) {
                         switch warpType {
                         case .PRETTY:
                             warper.finaliseAttractiveWarpPretty()
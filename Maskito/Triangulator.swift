@@ -5,10 +5,9 @@
 import Foundation
 
 
-func tidyIndices(edgesAndLandmarks : [PhiPoint], numEdges : Int, numFaces : Int) -> [PhiTriangle] {
+func tidyIndices(numFaces : Int) -> [PhiTriangle] {
     var tris : Int32 = 0
-    var edgesAndLandmarks = edgesAndLandmarks
-    let ans = triangulate_wrapper(&edgesAndLandmarks, Int32(numEdges), Int32(numFaces), &tris)
+    let ans = triangulate_wrapper(Int32(numFaces), &tris)
     var safeAns : [PhiTriangle] = []
     for idx in 0..<Int(tris) {
         safeAns.append(ans[idx])
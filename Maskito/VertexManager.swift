@@ -22,9 +22,20 @@ func makeEdges(n: Int, scalex: CGFloat, scaley: CGFloat) -> [PhiPoint] {
 let overlay_points : [TexturePosition] = [(0.303932,0.480691),(0.310398,0.533282),(0.319193,0.58626),(0.332644,0.63497),(0.357217,0.681157),(0.393689,0.721716),(0.437662,0.758587),(0.486549,0.785174),(0.545784,0.792936),(0.607605,0.784009),(0.656234,0.7549),(0.699172,0.717834),(0.734092,0.676305),(0.756079,0.628954),(0.767201,0.577916),(0.773151,0.526683),(0.774185,0.474869),(0.341438,0.438774),(0.369374,0.411023),(0.417744,0.398797),(0.468443,0.399573),(0.516037,0.411993),(0.581997,0.413157),(0.625711,0.399767),(0.673823,0.397632),(0.719348,0.410441),(0.742369,0.441102),(0.54268,0.455657),(0.54449,0.492529),(0.545784,0.527848),(0.547853,0.565108),(0.490688,0.584708),(0.518107,0.591306),(0.546301,0.597516),(0.574496,0.591112),(0.602173,0.58432),(0.385411,0.463613),(0.41283,0.448671),(0.446974,0.448671),(0.478789,0.468077),(0.445422,0.471958),(0.411019,0.472152),(0.605535,0.469241),(0.635799,0.449835),(0.671754,0.448865),(0.699431,0.46439),(0.67434,0.473317),(0.638386,0.473317),(0.450336,0.646031),(0.480341,0.62779),(0.517072,0.620609),(0.548112,0.626819),(0.577858,0.621386),(0.612261,0.62973),(0.64149,0.647972),(0.612002,0.682321),(0.578376,0.699592),(0.546301,0.702115),(0.512416,0.698816),(0.477496,0.680186),(0.464304,0.646808),(0.516555,0.634),(0.547853,0.637299),(0.578117,0.635746),(0.628557,0.648166),(0.578376,0.673394),(0.547077,0.676693),(0.514227,0.673006)]
 
 // MARK: Triangles making up the various things
-let ALLFACE : [GLubyte] = [ 0, 36, 17,36, 18, 17,36, 37, 18,37, 19, 18,37, 38, 19,38, 20, 19,38, 39, 20,39, 21, 20,36, 41, 37,41, 40, 37,40, 38, 37,40, 39, 38,39, 27, 21,27, 22, 21,27, 42, 22,42, 23, 22,42, 43, 23,43, 24, 23,43, 44, 24,44, 25, 24,44, 45, 25,45, 26, 25,45, 16, 26,42, 47, 43,47, 44, 43,47, 46, 44,46, 45, 44,39, 28, 27,28, 42, 27,32, 33, 30,33, 34, 30,31, 30, 32,31, 30, 29,34, 35, 30,35, 29, 30,35, 28, 29,31, 29, 28, 0,  1, 36,39, 31, 28,35, 42, 28,15, 16, 45,40, 31, 39,35, 47, 42, 1, 41, 36, 1, 40, 41,15, 45, 46,15, 46, 47,35, 15, 47, 1, 31, 40, 1,  2, 31,35, 14, 15, 2, 48, 31, 3, 48,  2, 4, 48,  3,54, 14, 35,54, 13, 14,12, 13, 54, 4,  5, 48, 5, 59, 48,11, 12, 54,55, 11, 54,10, 11, 55,56, 10, 55, 9, 10, 56, 5,  6, 59, 6, 58, 59, 6,  7, 58, 7, 57, 58, 7,  8, 57,57,  9, 56, 8,  9, 57,48, 49, 31,53, 54, 35,49, 50, 31,52, 53, 35,50, 32, 31,52, 35, 34,50, 51, 32,51, 52, 34,51, 34, 33,51, 33, 32,48, 60, 49,59, 60, 48,60, 67, 61,64, 54, 53,55, 54, 64,65, 64, 63,67, 62, 61,65, 63, 62,67, 66, 62,66, 65, 62,51, 52, 63,61, 62, 51,60, 61, 49,61, 50, 49,63, 64, 53,63, 53, 52,61, 51, 50,51, 62, 63,59, 67, 60,59, 58, 67,58, 57, 67,57, 66, 67,57, 65, 66,57, 56, 65,65, 55, 56,55, 64, 65]
+// Reorders a triangle list for the GPU's post-transform vertex cache (see vertex_cache.h), keeping
+// each triangle's winding. Global lets are initialised on first use, so each table is reordered once.
+func cacheOrdered(indices: [GLubyte]) -> [GLubyte] {
+    var tris = 0.stride(to: indices.count, by: 3).map { PhiTriangle(p0: UInt32(indices[$0]), p1: UInt32(indices[$0 + 1]), p2: UInt32(indices[$0 + 2])) }
+    let nVertices = Int32(indices.maxElement()!) + 1
+    if optimize_vertex_cache(&tris, Int32(tris.count), nVertices, nil) == 0 {
+        return indices
+    }
+    return tris.flatMap { [GLubyte($0.p0), GLubyte($0.p1), GLubyte($0.p2)] }
+}
+
+let ALLFACE : [GLubyte] = cacheOrdered([ 0, 36, 17,36, 18, 17,36, 37, 18,37, 19, 18,37, 38, 19,38, 20, 19,38, 39, 20,39, 21, 20,36, 41, 37,41, 40, 37,40, 38, 37,40, 39, 38,39, 27, 21,27, 22, 21,27, 42, 22,42, 23, 22,42, 43, 23,43, 24, 23,43, 44, 24,44, 25, 24,44, 45, 25,45, 26, 25,45, 16, 26,42, 47, 43,47, 44, 43,47, 46, 44,46, 45, 44,39, 28, 27,28, 42, 27,32, 33, 30,33, 34, 30,31, 30, 32,31, 30, 29,34, 35, 30,35, 29, 30,35, 28, 29,31, 29, 28, 0,  1, 36,39, 31, 28,35, 42, 28,15, 16, 45,40, 31, 39,35, 47, 42, 1, 41, 36, 1, 40, 41,15, 45, 46,15, 46, 47,35, 15, 47, 1, 31, 40, 1,  2, 31,35, 14, 15, 2, 48, 31, 3, 48,  2, 4, 48,  3,54, 14, 35,54, 13, 14,12, 13, 54, 4,  5, 48, 5, 59, 48,11, 12, 54,55, 11, 54,10, 11, 55,56, 10, 55, 9, 10, 56, 5,  6, 59, 6, 58, 59, 6,  7, 58, 7, 57, 58, 7,  8, 57,57,  9, 56, 8,  9, 57,48, 49, 31,53, 54, 35,49, 50, 31,52, 53, 35,50, 32, 31,52, 35, 34,50, 51, 32,51, 52, 34,51, 34, 33,51, 33, 32,48, 60, 49,59, 60, 48,60, 67, 61,64, 54, 53,55, 54, 64,65, 64, 63,67, 62, 61,65, 63, 62,67, 66, 62,66, 65, 62,51, 52, 63,61, 62, 51,60, 61, 49,61, 50, 49,63, 64, 53,63, 53, 52,61, 51, 50,51, 62, 63,59, 67, 60,59, 58, 67,58, 57, 67,57, 66, 67,57, 65, 66,57, 56, 65,65, 55, 56,55, 64, 65])
 
-let ALLFACE_NOTREYE : [GLubyte] = [ 0, 36, 17,36, 18, 17,36, 37, 18,37, 19, 18,37, 38, 19,38, 20, 19,38, 39, 20,39, 21, 20,36, 41, 37,41, 40, 37,40, 38, 37,40, 39, 38,39, 27, 21,27, 22, 21,27, 42, 22,42, 23, 22,42, 43, 23,43, 24, 23,43, 44, 24,44, 25, 24,44, 45, 25,45, 26, 25,45, 16, 26,39, 28, 27,28, 42, 27,32, 33, 30,33, 34, 30,31, 30, 32,31, 30, 29,34, 35, 30,35, 29, 30,35, 28, 29,31, 29, 28, 0,  1, 36,39, 31, 28,35, 42, 28,15, 16, 45,40, 31, 39,35, 47, 42, 1, 41, 36, 1, 40, 41,15, 45, 46,15, 46, 47,35, 15, 47, 1, 31, 40, 1,  2, 31,35, 14, 15, 2, 48, 31, 3, 48,  2, 4, 48,  3,54, 14, 35,54, 13, 14,12, 13, 54, 4,  5, 48, 5, 59, 48,11, 12, 54,55, 11, 54,10, 11, 55,56, 10, 55, 9, 10, 56, 5,  6, 59, 6, 58, 59, 6,  7, 58, 7, 57, 58, 7,  8, 57,57,  9, 56, 8,  9, 57,48, 49, 31,53, 54, 35,49, 50, 31,52, 53, 35,50, 32, 31,52, 35, 34,50, 51, 32,51, 52, 34,51, 34, 33,51, 33, 32,48, 60, 49,59, 60, 48,60, 67, 61,64, 54, 53,55, 54, 64,65, 64, 63,67, 62, 61,65, 63, 62,67, 66, 62,66, 65, 62,51, 52, 63,61, 62, 51,60, 61, 49,61, 50, 49,63, 64, 53,63, 53, 52,61, 51, 50,51, 62, 63,59, 67, 60,59, 58, 67,58, 57, 67,57, 66, 67,57, 65, 66,57, 56, 65,65, 55, 56,55, 64, 65]
+let ALLFACE_NOTREYE : [GLubyte] = cacheOrdered([ 0, 36, 17,36, 18, 17,36, 37, 18,37, 19, 18,37, 38, 19,38, 20, 19,38, 39, 20,39, 21, 20,36, 41, 37,41, 40, 37,40, 38, 37,40, 39, 38,39, 27, 21,27, 22, 21,27, 42, 22,42, 23, 22,42, 43, 23,43, 24, 23,43, 44, 24,44, 25, 24,44, 45, 25,45, 26, 25,45, 16, 26,39, 28, 27,28, 42, 27,32, 33, 30,33, 34, 30,31, 30, 32,31, 30, 29,34, 35, 30,35, 29, 30,35, 28, 29,31, 29, 28, 0,  1, 36,39, 31, 28,35, 42, 28,15, 16, 45,40, 31, 39,35, 47, 42, 1, 41, 36, 1, 40, 41,15, 45, 46,15, 46, 47,35, 15, 47, 1, 31, 40, 1,  2, 31,35, 14, 15, 2, 48, 31, 3, 48,  2, 4, 48,  3,54, 14, 35,54, 13, 14,12, 13, 54, 4,  5, 48, 5, 59, 48,11, 12, 54,55, 11, 54,10, 11, 55,56, 10, 55, 9, 10, 56, 5,  6, 59, 6, 58, 59, 6,  7, 58, 7, 57, 58, 7,  8, 57,57,  9, 56, 8,  9, 57,48, 49, 31,53, 54, 35,49, 50, 31,52, 53, 35,50, 32, 31,52, 35, 34,50, 51, 32,51, 52, 34,51, 34, 33,51, 33, 32,48, 60, 49,59, 60, 48,60, 67, 61,64, 54, 53,55, 54, 64,65, 64, 63,67, 62, 61,65, 63, 62,67, 66, 62,66, 65, 62,51, 52, 63,61, 62, 51,60, 61, 49,61, 50, 49,63, 64, 53,63, 53, 52,61, 51, 50,51, 62, 63,59, 67, 60,59, 58, 67,58, 57, 67,57, 66, 67,57, 65, 66,57, 56, 65,65, 55, 56,55, 64, 65])
 
 
 
@@ -40,12 +51,12 @@ let LEYE : [GLubyte] = [
 let NOSE : [GLubyte] = [
     32, 33, 30, 33, 34, 30, 31, 30, 32, 31, 30, 29, 34, 35, 30, 35, 29, 30, 35, 28, 29, 31, 29, 28
 ]
-let MOUTH : [GLubyte] = [
+let MOUTH : [GLubyte] = cacheOrdered([
     48, 60, 49, 59, 60, 48, 60, 67, 61, 64, 54, 53, 55, 54, 64, 65, 64, 63, 67, 62, 61, 65, 63, 62, 67, 66, 62, 66, 65, 62, 51, 52, 63, 61, 62, 51, 60, 61, 49, 61, 50, 49, 63, 64, 53, 63, 53, 52, 61, 51, 50, 51, 62, 63, 59, 67, 60, 59, 58, 67, 58, 57, 67, 57, 66, 67, 57, 65, 66, 57, 56, 65, 65, 55, 56, 55, 64, 65
-]
-let SKIN : [GLubyte] = [
+])
+let SKIN : [GLubyte] = cacheOrdered([
     0, 36, 17, 36, 18, 17, 36, 37, 18, 37, 19, 18, 37, 38, 19, 38, 20, 19, 38, 39, 20, 39, 21, 20, 39, 27, 21, 27, 22, 21, 27, 42, 22, 42, 23, 22, 42, 43, 23, 43, 24, 23, 43, 44, 24, 44, 25, 24, 44, 45, 25, 45, 26, 25, 45, 16, 26, 39, 28, 27, 28, 42, 27, 32, 33, 30, 33, 34, 30, 31, 30, 32, 31, 30, 29, 34, 35, 30, 35, 29, 30, 35, 28, 29, 31, 29, 28, 0, 1, 36, 39, 31, 28, 35, 42, 28, 15, 16, 45, 40, 31, 39, 35, 47, 42, 1, 41, 36, 1, 40, 41, 15, 45, 46, 15, 46, 47, 35, 15, 47, 1, 31, 40, 1, 2, 31, 35, 14, 15, 2, 48, 31, 3, 48, 2, 4, 48, 3, 54, 14, 35, 54, 13, 14, 12, 13, 54, 4, 5, 48, 5, 59, 48, 11, 12, 54, 55, 11, 54, 10, 11, 55, 56, 10, 55, 9, 10, 56, 5, 6, 59, 6, 58, 59, 6, 7, 58, 7, 57, 58, 7, 8, 57, 57, 9, 56, 8, 9, 57, 48, 49, 31, 53, 54, 35, 49, 50, 31, 52, 53, 35, 50, 32, 31, 52, 35, 34, 50, 51, 32, 51, 52, 34, 51, 34, 33, 51, 33, 32
-]
+])
 
 
 enum FacePart {
@@ -369,6 +380,16 @@ class VertexManager {
         glBindBuffer(GLenum(GL_ARRAY_BUFFER), 0)
     }
     
+    func fillFaceVertex(vertices faceVertices : [PhiVertex]) {
+        // PhiVertex is laid out like Coordinate, so the warp engine's output uploads as-is.
+        glBindVertexArrayOES(faceAO);
+        glBindBuffer(GLenum(GL_ARRAY_BUFFER), facePositionBuffer)
+        glBufferData(GLenum(GL_ARRAY_BUFFER), faceVertices.size(), faceVertices, GLenum(GL_STATIC_DRAW))
+        
+        glBindVertexArray(0)
+        glBindBuffer(GLenum(GL_ARRAY_BUFFER), 0)
+    }
+    
     func selectFacePart(part : FacePart) {
         glBindVertexArrayOES(faceAO);
         glBindBuffer(GLenum(GL_ELEMENT_ARRAY_BUFFER), faceIndexBuffer)
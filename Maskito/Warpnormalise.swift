@@ -14,10 +14,46 @@ func boundArray(array : [Double], withUpper upper : Double, andLower lower : Dou
 let PRETTY_KEY = "phi.warp.pretty"
 let HANDSOME_KEY = "phi.warp.handsome"
 
+final class Calibration {
+    // Owns a native calibration accumulator for one golden inner warp kind.
+    let handle : COpaquePointer
+    
+    init(kind : PhiWarpKind) {
+        handle = calibration_create(kind)
+    }
+    
+    deinit {
+        calibration_destroy(handle)
+    }
+    
+    func reset() {
+        calibration_reset(handle)
+    }
+    
+    func addObservation(landmarks : [PhiPoint]) {
+        var landmarks = landmarks
+        calibration_add_observation(handle, &landmarks)
+    }
+    
+    var converged : Bool {
+        return calibration_converged(handle) != 0
+    }
+    
+    // nil until at least one frame has been accepted
+    var estimate : [Double]? {
+        guard calibration_num_observations(handle) > 0 else {
+            return nil
+        }
+        var scaling : [Double] = Array(count: 6, repeatedValue: 1.0)
+        calibration_estimate(handle, &scaling)
+        return scaling
+    }
+}
+
 class Warper {
-    var prettyObs = 0
+    let prettyCalibration = Calibration(kind: PhiWarpApplyGoldenInnerPretty)
     var _prettyScale : [Double] = [1.05, 1.05, 0.93, 0.93, 1.05, 1.05]
-    var handsomeObs = 0
+    let handsomeCalibration = Calibration(kind: PhiWarpApplyGoldenInnerHandsome)
     var _handsomeScale : [Double] = [1.03, 1.03, 0.96, 0.96, 1.03, 1.02]
     var prettyScale : [Double] {
         get {
@@ -57,6 +93,8 @@ class Warper {
 
     
     var face_log : [Face] = []
+    // Contexts of the last doWarps call, in face order
+    var last_contexts : [WarpContext] = []
     
     func doWarp (landmarks : [PhiPoint], warp : WarpType) -> ([PhiPoint], Float64) {
         // Check if we've seen this before
@@ -124,38 +162,7 @@ class Warper {
     
     func doSwitchFace2D(all_landmarks : [[PhiPoint]]) -> ([[PhiPoint]], [Float64]) {
         print("doSwitchFace")
-        let num_faces = all_landmarks.count
-        var factr : [Float64] = Array(count: num_faces, repeatedValue: 0.0)
-        
-        var tmp_faces = all_landmarks
-        for idx in 0..<(num_faces+1)/2 {
-            let idx1 = idx*2
-            let idx2 = (idx1 + 1) % num_faces
-            var face1 = all_landmarks[idx1]
-            var face2 = all_landmarks[idx2]
-            
-
-            
-            if idx1 + 1  >=  num_faces{
-                face1 = all_landmarks[idx1]
-                face2 = tmp_faces[idx2]
-            }
-        
-            let pidx1 = findBestFace(face1)
-            let pidx2 = findBestFace(face2)
-            
-            
-//            let (warped_faces, factr1, factr2) = doSwap(face1, landmarks2: face2, initParam1: &face_log[pidx1].parameters, initParam2: &face_log[pidx2].parameters)
-            let (warped_faces, factr1, factr2) = doShitSwap(face1, landmarks2: face2, initParam1: &face_log[pidx1].parameters, initParam2: &face_log[pidx2].parameters)
-            let warped1 = Array(warped_faces[0..<68])
-            let warped2 = Array(warped_faces[68..<136])
-
-            tmp_faces[idx1] = warped1
-            tmp_faces[idx2] = warped2
-            factr[idx1] = factr1
-            factr[idx2] = factr2
-        }
-        return(tmp_faces, factr)
+        return doSwaps(all_landmarks)
     }
     
     func doSwitchFace3D(all_landmarks : [[PhiPoint]]) -> ([[PhiPoint]], [Float64]) {
@@ -188,32 +195,7 @@ class Warper {
     
 
     func doPuppetFace3D(all_landmarks : [[PhiPoint]]) -> ([[PhiPoint]], [Float64]) {
-        let num_faces = all_landmarks.count
-        var factr : [Float64] = Array(count: num_faces, repeatedValue: 0.0)
-        
-        var tmp_faces = all_landmarks
-
-        for idx in 0..<(num_faces+1)/2 {
-            let idx1 = idx * 2
-            let idx2 = (idx1 + 1) % num_faces
-            let face1 = all_landmarks[idx1]
-            let face2 = all_landmarks[idx2]
-            
-            let pidx1 = findBestFace(face1)
-            let pidx2 = findBestFace(face2)
-            
-            
-            let (warped_faces, factr1, factr2) = doSwap(face1, landmarks2: face2, initParam1: &face_log[pidx1].parameters, initParam2: &face_log[pidx2].parameters)
-            //            let (warped_faces, factr1, factr2) = doShitSwap(face1, landmarks2: face2, initParam1: &face_log[pidx1].parameters, initParam2: &face_log[pidx2].parameters)
-            let warped1 = Array(warped_faces[0..<68])
-            let warped2 = Array(warped_faces[68..<136])
-            tmp_faces[idx1] = warped1
-
-            tmp_faces[idx2] = warped2
-            factr[idx1] = factr1
-            factr[idx2] = factr2
-        }
-        return(tmp_faces, factr)
+        return doSwaps(all_landmarks)
     }
     
     func doShitSwap( landmarks1 : [PhiPoint], landmarks2 : [PhiPoint], inout initParam1 : [CDouble],  inout initParam2 : [CDouble]) -> ([PhiPoint], Float64, Float64) {
@@ -257,187 +239,214 @@ class Warper {
         }
     }
     
-    func doAttractiveWarp(landmarks : [PhiPoint], inout initParam : [CDouble]) -> ([PhiPoint], Float64) {
+    func runWarp(kind : PhiWarpKind, landmarks : [PhiPoint], inout initParam : [CDouble], inout scaling : [Double]) -> ([PhiPoint], Float64) {
+        // Writes straight into a Swift-owned buffer; scaling is only read by the golden inner kinds.
         var factr : Float64 = 0
         var landmarks = landmarks
-        let ans = attractive_adjusted_warp(&landmarks, &initParam, &factr);
-        var safeAns : [PhiPoint] = [];
-        for idx in 0..<landmarks.count {
-            safeAns.append((ans[Int(idx)]))
+        var output = [PhiPoint](count: landmarks.count, repeatedValue: PhiPoint(x: 0, y: 0))
+        warp_face_into(kind, &landmarks, &initParam, &factr, &scaling, &output)
+        return (output, factr)
+    }
+    
+    func warpKind(warp : WarpType) -> PhiWarpKind? {
+        switch warp {
+        case .PRETTY:
+            return PhiWarpApplyGoldenInnerPretty
+        case .HANDSOME:
+            return PhiWarpApplyGoldenInnerHandsome
+        case .SILLY:
+            return PhiWarpSilly
+        case .DYNAMIC:
+            return PhiWarpDynamic
+        case .TINY:
+            return PhiWarpTiny
+        case .BIGLIPS:
+            return PhiWarpBigLips
+        case .NOSE:
+            return PhiWarpBigNose
+        case _:
+            return nil
         }
-        free(ans)
-
-        return (safeAns, factr)
     }
     
-    func doAttractiveWarp2(landmarks : [PhiPoint], inout initParam : [CDouble]) -> ([PhiPoint], Float64) {
-        var factr : Float64 = 0
-        var landmarks = landmarks
-        let ans = attractive_adjusted_warp(&landmarks, &initParam, &factr);
-        var safeAns : [PhiPoint] = [];
-        for idx in 0..<landmarks.count {
-            safeAns.append((ans[Int(idx)]))
+    func warpContexts(all_landmarks : [[PhiPoint]]) -> [WarpContext] {
+        // Hold the contexts here so a face pruned from the log mid-frame stays valid, and give two
+        // faces matched to the same log entry separate contexts, since they are warped concurrently.
+        var seen = Set<ObjectIdentifier>()
+        var warp_contexts : [WarpContext] = []
+        for face_landmarks in all_landmarks {
+            let context = face_log[findBestFace(face_landmarks)].context
+            if seen.contains(ObjectIdentifier(context)) {
+                warp_contexts.append(WarpContext())
+            } else {
+                seen.insert(ObjectIdentifier(context))
+                warp_contexts.append(context)
+            }
         }
-        free(ans)
-        
-        return (safeAns, factr)
+        last_contexts = warp_contexts
+        return warp_contexts
     }
     
-    func doAttractiveWarpPretty(landmarks : [PhiPoint], inout initParam : [CDouble]) -> ([PhiPoint], Float64) {
-        var factr : Float64 = 0
-        var landmarks = landmarks
-//        let ans = golden_inner_pretty(&landmarks, &initParam, &factr)
-        let ans = apply_golden_inner_pretty(&landmarks, &initParam, &factr, &prettyScale)
-        var safeAns : [PhiPoint] = []
-        for idx in 0..<landmarks.count {
-            safeAns.append((ans[Int(idx)]))
+    func doSwaps(all_landmarks : [[PhiPoint]]) -> ([[PhiPoint]], [Float64]) {
+        // Every face takes its partner's landmarks in one call, without solving any pose.
+        let num_faces = all_landmarks.count
+        guard num_faces > 0 else {
+            return ([], [])
+        }
+        var landmarks = all_landmarks.flatMap { $0 }
+        let warp_contexts = warpContexts(all_landmarks)
+        var contexts = warp_contexts.map { $0.handle }
+        var factrs : [Float64] = Array(count: num_faces, repeatedValue: 0.0)
+        var output = [PhiPoint](count: landmarks.count, repeatedValue: PhiPoint(x: 0, y: 0))
+        withExtendedLifetime(warp_contexts) {
+            warp_contexts_swap_into(&contexts, Int32(num_faces), &landmarks, &factrs, &output)
         }
-        free(ans)
         
-        return (safeAns, factr)
+        var swapped_faces : [[PhiPoint]] = []
+        for face in 0..<num_faces {
+            swapped_faces.append(Array(output[face * 68..<(face + 1) * 68]))
+        }
+        return (swapped_faces, factrs)
     }
     
-    func doAttractiveWarpHandsome(landmarks : [PhiPoint], inout initParam : [CDouble]) -> ([PhiPoint], Float64) {
-        var factr : Float64 = 0
-        var landmarks = landmarks
-//        let ans = golden_inner_handsome(&landmarks, &initParam, &factr)
-        let ans = apply_golden_inner_handsome(&landmarks, &initParam, &factr, &handsomeScale)
-        var safeAns : [PhiPoint] = [];
-        for idx in 0..<landmarks.count {
-            safeAns.append((ans[Int(idx)]))
+    func doWarps(all_landmarks : [[PhiPoint]], warp : WarpType) -> [([PhiPoint], Float64)] {
+        // Warps every face in one call; each tracked face carries its own context, so they run concurrently.
+        guard let kind = warpKind(warp) where all_landmarks.count > 0 else {
+            return all_landmarks.map { ($0, 0.0) }
+        }
+        let num_faces = all_landmarks.count
+        var landmarks = all_landmarks.flatMap { $0 }
+        let warp_contexts = warpContexts(all_landmarks)
+        var contexts = warp_contexts.map { $0.handle }
+        var scaling = warp == .HANDSOME ? handsomeScale : prettyScale
+        for context in contexts {
+            warp_context_set_scaling(context, &scaling)
+        }
+        var factrs : [Float64] = Array(count: num_faces, repeatedValue: 0.0)
+        var output = [PhiPoint](count: landmarks.count, repeatedValue: PhiPoint(x: 0, y: 0))
+        withExtendedLifetime(warp_contexts) {
+            warp_contexts_warp_into(&contexts, kind, Int32(num_faces), &landmarks, &factrs, &output)
         }
-        free(ans)
         
-        return (safeAns, factr)
+        var warped_faces : [([PhiPoint], Float64)] = []
+        for face in 0..<num_faces {
+            warped_faces.append((Array(output[face * 68..<(face + 1) * 68]), factrs[face]))
+        }
+        return warped_faces
+    }
+    
+    func faceVertices(face : Int, inBox box: CGRect, withAlphas alpha : (Float, Float, Float, Float)) -> [PhiVertex] {
+        // Vertices for a face of the last doWarps call, straight from the unrounded warp.
+        var alphas : [Float] = [alpha.0, alpha.1, alpha.2, alpha.3]
+        var vertices = [PhiVertex](count: 68, repeatedValue: PhiVertex(x: 0, y: 0, z: 0, u: 0, v: 0, alpha: 0))
+        warp_context_vertices_into(last_contexts[face].handle, Float(box.width), Float(box.height), &alphas, &vertices)
+        return vertices
+    }
+    
+    func doAttractiveWarp(landmarks : [PhiPoint], inout initParam : [CDouble]) -> ([PhiPoint], Float64) {
+        var scaling : [Double] = []
+        let (warped, factr) = runWarp(PhiWarpAttractive, landmarks: landmarks, initParam: &initParam, scaling: &scaling)
+        return (warped, factr)
+    }
+    
+    func doAttractiveWarp2(landmarks : [PhiPoint], inout initParam : [CDouble]) -> ([PhiPoint], Float64) {
+        var scaling : [Double] = []
+        let (warped, factr) = runWarp(PhiWarpAttractive, landmarks: landmarks, initParam: &initParam, scaling: &scaling)
+        return (warped, factr)
+    }
+    
+    func doAttractiveWarpPretty(landmarks : [PhiPoint], inout initParam : [CDouble]) -> ([PhiPoint], Float64) {
+        var scaling = prettyScale
+        let (warped, factr) = runWarp(PhiWarpApplyGoldenInnerPretty, landmarks: landmarks, initParam: &initParam, scaling: &scaling)
+        return (warped, factr)
+    }
+    
+    func doAttractiveWarpHandsome(landmarks : [PhiPoint], inout initParam : [CDouble]) -> ([PhiPoint], Float64) {
+        var scaling = handsomeScale
+        let (warped, factr) = runWarp(PhiWarpApplyGoldenInnerHandsome, landmarks: landmarks, initParam: &initParam, scaling: &scaling)
+        return (warped, factr)
     }
     
     func resetAttractiveWarpPretty() {
-        _prettyScale = [0.0, 0.0, 0.0, 0.0, 0.0, 0.0]
-        prettyObs = 0
+        prettyCalibration.reset()
     }
     
     func addAttractiveWarpPrettyObservation(landmarks : [PhiPoint]) {
-        let landmarks = landmarks
-        let idx = findBestFace(landmarks)
-        prettyObs += 1
-        let rez = calcAttractiveWarpPretty(landmarks, initParam: &face_log[idx].parameters)
-        _prettyScale = zip(_prettyScale, rez).map { return $0 + $1 }
+        prettyCalibration.addObservation(landmarks)
     }
     
     func finaliseAttractiveWarpPretty() {
-        _prettyScale = _prettyScale.map { $0 / Double(prettyObs) }
-        prettyScale = _prettyScale
+        // Keeps the previous scale if no usable frame was seen.
+        if let scale = prettyCalibration.estimate {
+            prettyScale = scale
+        }
         print("New pretty scale \(prettyScale)")
     }
     
     func resetAttractiveWarpHandsome() {
-        _handsomeScale = [1.0, 1.0, 1.0, 1.0, 1.0, 1.0]
-        handsomeObs = 0
+        handsomeCalibration.reset()
     }
     
     func addAttractiveWarpHandsomeObservation(landmarks : [PhiPoint]) {
-        let idx = findBestFace(landmarks)
-        handsomeObs += 1
-        let rez = calcAttractiveWarpHandsome(landmarks, initParam: &face_log[idx].parameters)
-        _handsomeScale = zip(_handsomeScale, rez).map { return $0 + $1 }
+        handsomeCalibration.addObservation(landmarks)
     }
     
     func finaliseAttractiveWarpHandsome() {
-        _handsomeScale = _handsomeScale.map { $0 / Double(handsomeObs) }
-        handsomeScale = _handsomeScale
+        if let scale = handsomeCalibration.estimate {
+            handsomeScale = scale
+        }
         print("New handsome scale \(handsomeScale)")
     }
     
-    func calcAttractiveWarpHandsome(landmarks : [PhiPoint], inout initParam : [CDouble]) -> ([Double]) {
-        var factr : Float64 = 0
-        var landmarks = landmarks
-        var scaling : [Double] = Array(count: 6, repeatedValue: 1.0)
-        calc_golden_inner_handsome(&landmarks, &initParam, &factr, &scaling);
-        return scaling
+    func calibrationConverged(warp : WarpType) -> Bool {
+        switch warp {
+        case .PRETTY:
+            return prettyCalibration.converged
+        case .HANDSOME:
+            return handsomeCalibration.converged
+        case _:
+            return false
+        }
     }
     
-    func calcAttractiveWarpPretty(landmarks : [PhiPoint], inout initParam : [CDouble]) -> ([Double]) {
-        var factr : Float64 = 0
-        var landmarks = landmarks
-        var scaling : [Double] = Array(count: 6, repeatedValue: 1.0)
-        calc_golden_inner_pretty(&landmarks, &initParam, &factr, &scaling);
-        return scaling
-    }
-
     func doSillyWarp(landmarks : [PhiPoint], inout initParam : [CDouble]) -> ([PhiPoint], Float64) {
-        var factr : Float64 = 0
-        var landmarks = landmarks
-        let ans = silly_adjusted_warp(&landmarks, &initParam, &factr);
-        var safeAns : [PhiPoint] = [];
-        for idx in 0..<landmarks.count {
-            safeAns.append((ans[Int(idx)]))
-        }
-        free(ans)
-        return (safeAns, factr)
+        var scaling : [Double] = []
+        let (warped, factr) = runWarp(PhiWarpSilly, landmarks: landmarks, initParam: &initParam, scaling: &scaling)
+        return (warped, factr)
     }
     
     func doBigNoseWarp(landmarks : [PhiPoint], inout initParam : [CDouble]) -> ([PhiPoint], Float64) {
-        var factr : Float64 = 0
-        var landmarks = landmarks
-        let ans = bignose_adjusted_warp(&landmarks, &initParam, &factr);
-        var safeAns : [PhiPoint] = [];
-        for idx in 0..<landmarks.count {
-            safeAns.append((ans[Int(idx)]))
-        }
-        free(ans)
-        return (safeAns, factr)
+        var scaling : [Double] = []
+        let (warped, factr) = runWarp(PhiWarpBigNose, landmarks: landmarks, initParam: &initParam, scaling: &scaling)
+        return (warped, factr)
     }
     
     
     func doDynamicWarp(landmarks : [PhiPoint], inout initParam : [CDouble]) -> ([PhiPoint], Float64) {
-        var factr : Float64 = 0
-        var landmarks = landmarks
-        let ans = dynamic_adjusted_warp(&landmarks, &initParam, &factr);
-        var safeAns : [PhiPoint] = [];
-        for idx in 0..<landmarks.count {
-            safeAns.append((ans[Int(idx)]))
-        }
-        free(ans)
-        return (safeAns, 0.0)
+        var scaling : [Double] = []
+        let (warped, _) = runWarp(PhiWarpDynamic, landmarks: landmarks, initParam: &initParam, scaling: &scaling)
+        return (warped, 0.0)
     }
     
-    func doBigLipsWarp(landmarks : [PhiPoint], inout initParam : [CDouble]) -> ([PhiPoint], Float64)  {
-        var factr : Float64 = 0
-        var landmarks = landmarks
-        let ans = biglips_adjusted_warp(&landmarks, &initParam, &factr);
-        var safeAns : [PhiPoint] = [];
-        for idx in 0..<landmarks.count {
-            safeAns.append((ans[Int(idx)]))
-        }
-        free(ans)
-        return (safeAns, 0.0)
+    func doBigLipsWarp(landmarks : [PhiPoint], inout initParam : [CDouble]) -> ([PhiPoint], Float64) {
+        var scaling : [Double] = []
+        let (warped, _) = runWarp(PhiWarpBigLips, landmarks: landmarks, initParam: &initParam, scaling: &scaling)
+        return (warped, 0.0)
     }
     
     func doTinyFaceWarp(landmarks : [PhiPoint], inout initParam : [CDouble]) -> ([PhiPoint], Float64) {
-        var factr : Float64 = 0
-        var landmarks = landmarks
-        let ans = tiny_face_warp(&landmarks, &initParam, &factr);
-        var safeAns : [PhiPoint] = [];
-        for idx in 0..<landmarks.count {
-            safeAns.append((ans[Int(idx)]))
-        }
-        free(ans)
-        return (safeAns, 0.0)
+        var scaling : [Double] = []
+        let (warped, _) = runWarp(PhiWarpTiny, landmarks: landmarks, initParam: &initParam, scaling: &scaling)
+        return (warped, 0.0)
     }
     
     
     func doT1inyFaceWarp(landmarks : [PhiPoint], inout initParam : [CDouble]) -> ([PhiPoint], Float64) {
-        var factr : Float64 = 0
-        var landmarks = landmarks
         print("do tiny face")
         print(landmarks)
-        let ans = tiny_face_warp(&landmarks, &initParam, &factr);
-        var safeAns : [PhiPoint] = [];
-        for idx in 0..<landmarks.count {
-            safeAns.append((ans[Int(idx)]))
-        }
-        free(ans)
-        return (safeAns, 0.0)
+        var scaling : [Double] = []
+        let (warped, _) = runWarp(PhiWarpTiny, landmarks: landmarks, initParam: &initParam, scaling: &scaling)
+        return (warped, 0.0)
     }
     
     
@@ -448,13 +457,9 @@ class Warper {
         var factr2 : Float64 = 0.0
         var landmarks1 = landmarks1
         var landmarks2 = landmarks2
-        let ans = face_swap_warp(&landmarks1, &landmarks2, &initParam1, &initParam2, &factr1, &factr2)
-        var safeAns : [PhiPoint] = [];
-        for idx in 0..<(landmarks1.count + landmarks2.count) {
-            safeAns.append((ans[Int(idx)]))
-        }
-        free(ans)
-        return (safeAns, factr1, factr2)
+        var output = [PhiPoint](count: landmarks1.count + landmarks2.count, repeatedValue: PhiPoint(x: 0, y: 0))
+        face_swap_warp_into(&landmarks1, &landmarks2, &initParam1, &initParam2, &factr1, &factr2, &output)
+        return (output, factr1, factr2)
     }
     
     func doPuppet(landmarks1 : [PhiPoint], landmarks2 : [PhiPoint], inout initParam1 : [CDouble],  inout initParam2 : [CDouble]) -> ([PhiPoint], Float64, Float64) {
@@ -462,13 +467,8 @@ class Warper {
         var factr2 : Float64 = 0.0
         var landmarks1 = landmarks1
         var landmarks2 = landmarks2
-        //        var param1 : [Float64]
-        let ans = face_puppet_warp(&landmarks1, &landmarks2, &initParam1, &initParam2, &factr1, &factr2)
-        var safeAns : [PhiPoint] = [];
-        for idx in 0..<(landmarks1.count + landmarks2.count) {
-            safeAns.append((ans[Int(idx)]))
-        }
-        free(ans)
-        return (safeAns, factr1, factr2)
+        var output = [PhiPoint](count: landmarks1.count + landmarks2.count, repeatedValue: PhiPoint(x: 0, y: 0))
+        face_puppet_warp_into(&landmarks1, &landmarks2, &initParam1, &initParam2, &factr1, &factr2, &output)
+        return (output, factr1, factr2)
     }
 }
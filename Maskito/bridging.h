@@ -9,6 +9,7 @@
 //#import "Clarkson-Delaunay.h"
 //#import "triangulator.h"
 #import "triangle_wrapper.h"
+#import "vertex_cache.h"
 #import "normalise_warp.h"
 #import <Google/Analytics.h>
 //#import "MWPhotoBrowser.h"
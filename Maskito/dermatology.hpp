@@ -12,74 +12,163 @@
 #include "face_landmarks.hpp"
 
 #include <iostream>
+#include <thread>
 
-std::vector<std::vector<float>> find_skin_mask(const cv::Mat &image, const std::vector<std::array<std::array<long, 2>, 68>> &landmarks){
+#if defined(__ARM_NEON)
+#include <arm_neon.h>
+#endif
+
+/* Skin smoothing modes for improve_skin */
+enum skin_smoothing {SKIN_SMOOTHING_GAUSSIAN, SKIN_SMOOTHING_GUIDED};
+const int GUIDED_SMOOTHING_RADIUS = 8;
+const double GUIDED_SMOOTHING_EPSILON = 0.01; // variance kept as edges, in (level / 255)^2
+
+/* Blur estimate */
+const double BLUR_LAPLACIAN_REFERENCE = 16; // Laplacian std. dev. of a sharp face, in 8-bit levels
+
+std::vector<int> full_face_dlib(){
+    /*Face outline and both eyebrows: their hull covers the forehead up to the brows.*/
+    std::vector<int> full_face = face_dlib;
+    full_face.insert(full_face.end(), leyebrow_dlib.begin(), leyebrow_dlib.end());
+    full_face.insert(full_face.end(), reyebrow_dlib.begin(), reyebrow_dlib.end());
+    return full_face;
+};
+
+cv::Rect face_box(const std::array<std::array<long, 2>, 68> &landmarks, int padding, int num_rows, int num_cols){
+    /*bounding box of the face hull (outline and eyebrows), grown by
+     padding pixels on every side and clipped to the image.*/
+    const std::vector<int> full_face = full_face_dlib();
+    long x_min = landmarks[full_face[0]][0], x_max = x_min;
+    long y_min = landmarks[full_face[0]][1], y_max = y_min;
+    for (int i = 1; i < full_face.size(); i++){
+        x_min = std::min(x_min, landmarks[full_face[i]][0]);
+        x_max = std::max(x_max, landmarks[full_face[i]][0]);
+        y_min = std::min(y_min, landmarks[full_face[i]][1]);
+        y_max = std::max(y_max, landmarks[full_face[i]][1]);
+    };
+    /*the hull is filled with coverage up to a pixel past its vertices*/
+    const cv::Rect box((int)x_min - padding - 1, (int)y_min - padding - 1, (int)(x_max - x_min) + 2 * padding + 3, (int)(y_max - y_min) + 2 * padding + 3);
+    return box & cv::Rect(0, 0, num_cols, num_rows);
+};
+
+cv::Mat1f find_skin_mask(const cv::Mat &image, const std::vector<std::array<std::array<long, 2>, 68>> &landmarks){
     /*find skin pixels in the face.  This is done by finding the
      convex hull defined by the face landmarks, then subtracting
-     the convex hulls around the eyes and the mouth.*/
-    long num_rows = image.dims[0];
-    long num_cols = image.dims[1];
-    
-    std::vector<std::vector<long>> face = copy_subset_vector(landmarks, face_dlib);
-    std::vector<std::vector<long>> left_eye = copy_subset_vector(landmarks, leye_dlib);
-    std::vector<std::vector<long>> right_eye = copy_subset_vector(landmarks, reye_dlib);
-    std::vector<std::vector<long>> teeth = copy_subset_vector(landmarks, innermouth_dlib);
-    std::vector<std::vector<long>> left_eyebrow = copy_subset_vector(landmarks, leyebrow_dlib);
-    std::vector<std::vector<long>> right_eyebrow = copy_subset_vector(landmarks, reyebrow_dlib);
-    std::vector<std::vector<long>> _full_face = face.insert(face.end(), left_eyebrow.begin(), left_eyebrow.end());
-    std::vector<std::vector<long>> full_face = _full_face.insert( _full_face.end(), right_eyebrow.begin(), right_eyebrow.end());
-    
-    std::vector<std::vector<float>> left_eye_mask = convex_mask(num_rows, num_cols, left_eye);
-    std::vector<std::vector<float>> invert_left_eye_mask = invert_mask(left_eye_mask);
-    std::vector<std::vector<float>> right_eye_mask = convex_mask(num_rows, num_cols, right_eye);
-    std::vector<std::vector<float>> invert_right_eye_mask = invert_mask(right_eye_mask);
-    std::vector<std::vector<float>> teeth_mask = convex_mask(num_rows, num_cols, teeth);
-    std::vector<std::vector<float>> invert_teeth_mask = invert_mask(teeth_mask);
-    std::vector<std::vector<float>> face_mask = convex_mask(num_rows, num_cols, full_face);
-    
-    std::vector<std::vector<float>> skin_a = elementwise_product(face_mask, invert_left_eye_mask);
-    std::vector<std::vector<float>> skin_b = elementwise_product(invert_right_eye_mask, invert_teeth_mask);
-    std::vector<std::vector<float>> skin_mask = elementwise_product(skin_a, skin_b);
+     the convex hulls around the eyes and the mouth. The hulls are
+     filled straight into one mask, visiting only their bounding boxes.*/
+    cv::Mat1f skin_mask = cv::Mat1f::zeros(image.rows, image.cols);
+    const std::vector<int> full_face = full_face_dlib();
+    
+    for (int face = 0; face < landmarks.size(); face++){
+        fill_convex_hull(skin_mask, landmark_points(landmarks[face], full_face), 1.0, true);
+    };
+    for (int face = 0; face < landmarks.size(); face++){
+        fill_convex_hull(skin_mask, landmark_points(landmarks[face], leye_dlib), 0.0, true);
+        fill_convex_hull(skin_mask, landmark_points(landmarks[face], reye_dlib), 0.0, true);
+        fill_convex_hull(skin_mask, landmark_points(landmarks[face], innermouth_dlib), 0.0, true);
+    };
     
     return skin_mask;
 };
 
-std::vector<std::vector<float>> find_face_mask(const cv::Mat &image, const std::vector<std::array<std::array<long, 2>, 68>> &landmarks){
-    /*find skin pixels in the face.  This is done by finding the
-     convex hull defined by the face landmarks, then subtracting
-     the convex hulls around the eyes and the mouth.*/
-    long num_rows = image.dims[0];
-    long num_cols = image.dims[1];
+cv::Mat1f find_face_mask(const cv::Mat &image, const std::vector<std::array<std::array<long, 2>, 68>> &landmarks){
+    /*find the pixels in the convex hull of each face's outline
+     and eyebrows.*/
+    cv::Mat1f face_mask = cv::Mat1f::zeros(image.rows, image.cols);
+    const std::vector<int> full_face = full_face_dlib();
     
-    std::vector<std::vector<long>> face = copy_subset_vector(landmarks, face_dlib);
-    std::vector<std::vector<float>> face_mask = convex_mask(num_rows, num_cols, full_face);
+    for (int face = 0; face < landmarks.size(); face++){
+        fill_convex_hull(face_mask, landmark_points(landmarks[face], full_face), 1.0);
+    };
     return face_mask;
 };
 
-double estimate_image_blur(const cv::Mat &image, const std::vector<std::array<std::array<long, 2>, 68>> &landmarks){
-    long num_rows = image.dims[0];
-    long num_cols = image.dims[1];
-    long num_pixels = num_rows * num_cols;
-    
-    cv::Mat image_gray;
-    cv::cvCvtColor(image, image_gray, CV_RGB2GRAY);
-    cv::Mat image_gray_equalized = image_gray
-    
-    std::vector<std::vector<float>> mask_face_outine = find_face(image, landmarks);
-    cv::Ptr<cv::CLAHE> clahe = cv::createCLAHE(double clipLimit = 0.01, cv::Size tileGridSize=cv::Size(8,8));
-    
-    clahe->apply(image_gray, image_gray_equalized);
+void accumulate_laplacian_row(const float * above, const float * row, const float * below, const float * mask_row, int num_cols, double &sum_weight, double &sum_laplacian, double &sum_squared){
+    /*adds the mask-weighted count, sum and sum of squares of the 4-neighbour
+     Laplacian over the inner columns of row.*/
+    float weight = 0.0f, laplacian_total = 0.0f, squared_total = 0.0f;
+    int x = 1;
+#if defined(__ARM_NEON)
+    float32x4_t weight4 = vdupq_n_f32(0.0f), laplacian4 = vdupq_n_f32(0.0f), squared4 = vdupq_n_f32(0.0f);
+    const float32x4_t minus_four = vdupq_n_f32(-4.0f);
+    for (; x + 4 < num_cols; x += 4){
+        const float32x4_t mask4 = vld1q_f32(mask_row + x);
+        float32x4_t laplacian = vaddq_f32(vaddq_f32(vld1q_f32(above + x), vld1q_f32(below + x)), vaddq_f32(vld1q_f32(row + x - 1), vld1q_f32(row + x + 1)));
+        laplacian = vmlaq_f32(laplacian, vld1q_f32(row + x), minus_four);
+        const float32x4_t weighted = vmulq_f32(mask4, laplacian);
+        weight4 = vaddq_f32(weight4, mask4);
+        laplacian4 = vaddq_f32(laplacian4, weighted);
+        squared4 = vmlaq_f32(squared4, weighted, laplacian);
+    };
+    float lanes[4];
+    vst1q_f32(lanes, weight4);
+    weight = lanes[0] + lanes[1] + lanes[2] + lanes[3];
+    vst1q_f32(lanes, laplacian4);
+    laplacian_total = lanes[0] + lanes[1] + lanes[2] + lanes[3];
+    vst1q_f32(lanes, squared4);
+    squared_total = lanes[0] + lanes[1] + lanes[2] + lanes[3];
+#endif
+    for (; x < num_cols - 1; x++){
+        const float laplacian = above[x] + below[x] + row[x - 1] + row[x + 1] - 4.0f * row[x];
+        weight += mask_row[x];
+        laplacian_total += mask_row[x] * laplacian;
+        squared_total += mask_row[x] * laplacian * laplacian;
+    };
+    sum_weight += weight;
+    sum_laplacian += laplacian_total;
+    sum_squared += squared_total;
+};
+
+double estimate_image_blur(const cv::Mat &image, const std::vector<std::array<std::array<long, 2>, 68>> &landmarks, int downsample = 1){
+    /*sharpness of the faces: the standard deviation of the Laplacian of the
+     gray image inside the face hulls, relative to BLUR_LAPLACIAN_REFERENCE and
+     mapped onto the blur_metric scale (0.1 for a flat face, rising with
+     detail). Only each face's bounding box is read. With downsample > 1 the
+     Laplacian is taken on downsample x downsample block averages, which is
+     cheaper and less sensitive to noise; the reference is for downsample 1.*/
+    const std::vector<int> full_face = full_face_dlib();
+    downsample = std::max(1, downsample);
+    const float block_scale = 1.0f / (downsample * downsample);
+    double sum_weight = 0.0, sum_laplacian = 0.0, sum_squared = 0.0;
     
-    for(int i=0; i<image_gray_equalized.rows; i++){
-        for(int j=0; j<image_gray_equalized.cols; j++){
-            image_gray_equalized.at<uchar>(i,j) = image_gray_equalized.at<uchar>(i,j) * mask_face_outine[i][j];
+    for (int face = 0; face < landmarks.size(); face++){
+        const cv::Rect box = face_box(landmarks[face], 1, image.rows, image.cols);
+        const int num_rows = box.height / downsample;
+        const int num_cols = box.width / downsample;
+        if (num_rows < 3 || num_cols < 3){
+            continue;
+        };
+        
+        std::vector<cv::Point2f> hull = landmark_points(landmarks[face], full_face);
+        for (cv::Point2f &point : hull){
+            point.x = (point.x - box.x) / downsample;
+            point.y = (point.y - box.y) / downsample;
+        };
+        cv::Mat1f mask = cv::Mat1f::zeros(num_rows, num_cols);
+        fill_convex_hull(mask, hull, 1.0);
+        
+        /*gray as in CV_RGB2GRAY, averaged over each block*/
+        std::vector<float> gray(num_rows * num_cols, 0.0f);
+        for (int y = 0; y < num_rows * downsample; y++){
+            const uchar * image_row = image.ptr<uchar>(box.y + y) + 3 * box.x;
+            float * gray_row = &gray[(y / downsample) * num_cols];
+            for (int x = 0; x < num_cols * downsample; x++){
+                gray_row[x / downsample] += (0.299f * image_row[3 * x] + 0.587f * image_row[3 * x + 1] + 0.114f * image_row[3 * x + 2]) * block_scale;
+            };
+        };
+        
+        for (int y = 1; y < num_rows - 1; y++){
+            accumulate_laplacian_row(&gray[(y - 1) * num_cols], &gray[y * num_cols], &gray[(y + 1) * num_cols], mask[y], num_cols, sum_weight, sum_laplacian, sum_squared);
         };
     };
     
-    cv::GaussianBlur( image_gray_equalized, image_gray_equalized, Size(3,3), 0, 0, cv::BORDER_DEFAULT);
-    
-    double max_val = max_of_cvmat(image_gray_equalized);
-    double blur_metric = 1.0 - (0.5 + std::exp(std::log(0.4) - 0.85 * max_val));
+    double sharpness = 0.0;
+    if (sum_weight > 0.0){
+        const double mean = sum_laplacian / sum_weight;
+        const double variance = std::max(0.0, sum_squared / sum_weight - mean * mean);
+        sharpness = std::min(1.0, std::sqrt(variance) / BLUR_LAPLACIAN_REFERENCE);
+    };
+    double blur_metric = 1.0 - (0.5 + std::exp(std::log(0.4) - 0.85 * sharpness));
     
     return blur_metric;
 };
@@ -88,38 +177,338 @@ void smooth_layers(cv::Mat &image, int sigma){
     /*Apply a gaussian_filter to each layer of the image,
      one layer at a time (not all three layers at once).*/
     //TODO: not sure if image and source can be the same
-    cv::GaussianBlur(image, image, Size(sigma, sigma), 0, 0, cv::BORDER_DEFAULT);
+    cv::GaussianBlur(image, image, cv::Size(sigma, sigma), 0, 0, cv::BORDER_DEFAULT);
+};
+
+int reflect_101(int index, int size){
+    /*Border index as cv::BORDER_DEFAULT (gfedcb|abcdefgh|gfedcba).*/
+    if (size == 1){
+        return 0;
+    };
+    while (index < 0 || index >= size){
+        index = index < 0 ? -index : 2 * (size - 1) - index;
+    };
+    return index;
+};
+
+void smooth_by_mask(cv::Mat &image, const cv::Mat1f &mask, int patch_size, float weight, const cv::Rect &roi){
+    /*Gaussian blur of an 8-bit, 3 channel image blended in by mask * weight,
+     in place and in one pass over roi: image += (blur(image) - image) * mask * weight.
+     Each source row is blurred horizontally once, into a ring of patch_size rows;
+     the vertical taps and the blend run per pixel, only where the mask is non-zero.
+     Same kernel and borders as smooth_layers. mask is the size of the image.*/
+    const cv::Rect area = roi & cv::Rect(0, 0, image.cols, image.rows);
+    if (area.width <= 0 || area.height <= 0 || weight <= 0.0f){
+        return;
+    };
+    const int radius = patch_size / 2;
+    const int taps = 2 * radius + 1;
+    const cv::Mat kernel_mat = cv::getGaussianKernel(taps, 0, CV_32F);
+    const std::vector<float> kernel(kernel_mat.begin<float>(), kernel_mat.end<float>());
+    
+    std::vector<int> tap_offsets(area.width * taps);
+    for (int x = 0; x < area.width; x++){
+        for (int k = 0; k < taps; k++){
+            tap_offsets[x * taps + k] = 3 * reflect_101(area.x + x + k - radius, image.cols);
+        };
+    };
+    
+    /*Rows are only ever read before they are written: source row y + radius
+     enters the ring before row y is blended, and reflected rows near the
+     top and bottom fall inside the same window.*/
+    const int row_floats = area.width * 3;
+    std::vector<float> ring(taps * row_floats);
+    const int last_source = std::min(image.rows - 1, area.y + area.height - 1 + radius);
+    int next_source = std::max(0, area.y - radius);
+    std::vector<const float *> tap_rows(taps);
+    
+    for (int y = area.y; y < area.y + area.height; y++){
+        for (; next_source <= std::min(last_source, y + radius); next_source++){
+            const uchar * source_row = image.ptr<uchar>(next_source);
+            float * blurred = &ring[(next_source % taps) * row_floats];
+            for (int x = 0; x < area.width; x++){
+                const int * offsets = &tap_offsets[x * taps];
+                float sum0 = 0.0f, sum1 = 0.0f, sum2 = 0.0f;
+                for (int k = 0; k < taps; k++){
+                    const uchar * pixel = source_row + offsets[k];
+                    sum0 += kernel[k] * pixel[0];
+                    sum1 += kernel[k] * pixel[1];
+                    sum2 += kernel[k] * pixel[2];
+                };
+                blurred[3 * x + 0] = sum0;
+                blurred[3 * x + 1] = sum1;
+                blurred[3 * x + 2] = sum2;
+            };
+        };
+        
+        for (int k = 0; k < taps; k++){
+            tap_rows[k] = &ring[(reflect_101(y + k - radius, image.rows) % taps) * row_floats];
+        };
+        uchar * row = image.ptr<uchar>(y) + 3 * area.x;
+        const float * mask_row = mask[y] + area.x;
+        for (int x = 0; x < area.width; x++){
+            const float alpha = mask_row[x] * weight;
+            if (alpha <= 0.0f){
+                continue;
+            };
+            for (int c = 0; c < 3; c++){
+                float sum = 0.0f;
+                for (int k = 0; k < taps; k++){
+                    sum += kernel[k] * tap_rows[k][3 * x + c];
+                };
+                row[3 * x + c] = (uchar)(row[3 * x + c] + (sum - row[3 * x + c]) * alpha + 0.5f);
+            };
+        };
+    };
+};
+
+void integral_table(const std::vector<float> &plane, int num_rows, int num_cols, std::vector<double> &table){
+    /*summed-area table of plane, laid out as dlib::integral_image_generic
+     but with a zero first row and column so box sums need no border cases:
+     table[(y + 1) * (num_cols + 1) + x + 1] is the sum over [0, y] x [0, x].*/
+    const int stride = num_cols + 1;
+    table.assign((num_rows + 1) * stride, 0.0);
+    for (int y = 0; y < num_rows; y++){
+        const float * plane_row = &plane[y * num_cols];
+        const double * above = &table[y * stride];
+        double * row = &table[(y + 1) * stride];
+        double running = 0.0;
+        for (int x = 0; x < num_cols; x++){
+            running += plane_row[x];
+            row[x + 1] = above[x + 1] + running;
+        };
+    };
+};
+
+void box_mean_row(const std::vector<double> &table, int num_cols, int top, int bottom, int radius, float * out){
+    /*mean of the table's plane over rows [top, bottom) and columns
+     [x - radius, x + radius] clipped to the plane, for every x. The cost
+     does not depend on radius; the interior loop is branch-free so it
+     vectorises.*/
+    const int stride = num_cols + 1;
+    const double * upper = &table[top * stride];
+    const double * lower = &table[bottom * stride];
+    const int height = bottom - top;
+    const int interior_begin = std::min(radius, num_cols);
+    const int interior_end = std::max(interior_begin, num_cols - radius);
+    
+    const double scale = 1.0 / (height * (2 * radius + 1));
+    for (int x = interior_begin; x < interior_end; x++){
+        out[x] = (float)((lower[x + radius + 1] - lower[x - radius] - upper[x + radius + 1] + upper[x - radius]) * scale);
+    };
+    for (int x = 0; x < num_cols; x++){
+        if (x == interior_begin){
+            x = interior_end;
+            if (x == num_cols){
+                break;
+            };
+        };
+        const int left = std::max(0, x - radius);
+        const int right = std::min(num_cols, x + radius + 1);
+        out[x] = (float)((lower[right] - lower[left] - upper[right] + upper[left]) / (height * (right - left)));
+    };
 };
 
-void improve_skin(const cv::Mat &image, const cv::Mat &image_hsv, const vector<std::array<std::array<long, 2>, 68>> &landmarks, int blur_patch_size_hsv, int blur_patch_size_rgb){
-    /*returns a new image in which the skin has been smoothed.*/
+void guided_filter_rows(const cv::Mat &source, cv::Mat &image, const cv::Mat1f &mask, const cv::Rect &area, int y_begin, int y_end, int radius, float epsilon, float weight){
+    /*self-guided filter of rows [y_begin, y_end) of source, one channel at a
+     time, blended into the same rows of image(area) by mask * weight.
+     source is a copy of image(area); windows are clipped to it. Rows up to
+     2 * radius away are read, as the coefficients a and b are box filtered too.*/
+    const int num_rows = source.rows;
+    const int num_cols = source.cols;
+    const int halo_begin = std::max(0, y_begin - 2 * radius);
+    const int halo_end = std::min(num_rows, y_end + 2 * radius);
+    const int coeff_begin = std::max(0, y_begin - radius);
+    const int coeff_end = std::min(num_rows, y_end + radius);
+    const int halo_rows = halo_end - halo_begin;
+    const int coeff_rows = coeff_end - coeff_begin;
+    
+    std::vector<float> guide(halo_rows * num_cols), guide_squared(halo_rows * num_cols);
+    std::vector<float> coeff_a(coeff_rows * num_cols), coeff_b(coeff_rows * num_cols);
+    std::vector<double> table_guide, table_squared, table_a, table_b;
+    std::vector<float> mean_guide(num_cols), mean_squared(num_cols), mean_a(num_cols), mean_b(num_cols);
+    
+    for (int c = 0; c < 3; c++){
+        for (int y = 0; y < halo_rows; y++){
+            const uchar * source_row = source.ptr<uchar>(halo_begin + y);
+            float * guide_row = &guide[y * num_cols];
+            float * squared_row = &guide_squared[y * num_cols];
+            for (int x = 0; x < num_cols; x++){
+                guide_row[x] = source_row[3 * x + c];
+                squared_row[x] = guide_row[x] * guide_row[x];
+            };
+        };
+        integral_table(guide, halo_rows, num_cols, table_guide);
+        integral_table(guide_squared, halo_rows, num_cols, table_squared);
+        
+        /*a = var / (var + epsilon), b = mean * (1 - a) over each window*/
+        for (int y = coeff_begin; y < coeff_end; y++){
+            const int top = std::max(0, y - radius) - halo_begin;
+            const int bottom = std::min(num_rows, y + radius + 1) - halo_begin;
+            box_mean_row(table_guide, num_cols, top, bottom, radius, &mean_guide[0]);
+            box_mean_row(table_squared, num_cols, top, bottom, radius, &mean_squared[0]);
+            float * a_row = &coeff_a[(y - coeff_begin) * num_cols];
+            float * b_row = &coeff_b[(y - coeff_begin) * num_cols];
+            for (int x = 0; x < num_cols; x++){
+                const float variance = std::max(0.0f, mean_squared[x] - mean_guide[x] * mean_guide[x]);
+                a_row[x] = variance / (variance + epsilon);
+                b_row[x] = mean_guide[x] - a_row[x] * mean_guide[x];
+            };
+        };
+        integral_table(coeff_a, coeff_rows, num_cols, table_a);
+        integral_table(coeff_b, coeff_rows, num_cols, table_b);
+        
+        /*output = mean(a) * guide + mean(b), blended in by the mask*/
+        for (int y = y_begin; y < y_end; y++){
+            const int top = std::max(0, y - radius) - coeff_begin;
+            const int bottom = std::min(num_rows, y + radius + 1) - coeff_begin;
+            box_mean_row(table_a, num_cols, top, bottom, radius, &mean_a[0]);
+            box_mean_row(table_b, num_cols, top, bottom, radius, &mean_b[0]);
+            const float * guide_row = &guide[(y - halo_begin) * num_cols];
+            const float * mask_row = mask[area.y + y] + area.x;
+            uchar * row = image.ptr<uchar>(area.y + y) + 3 * area.x;
+            for (int x = 0; x < num_cols; x++){
+                const float alpha = mask_row[x] * weight;
+                if (alpha <= 0.0f){
+                    continue;
+                };
+                const float filtered = mean_a[x] * guide_row[x] + mean_b[x];
+                row[3 * x + c] = cv::saturate_cast<uchar>(row[3 * x + c] + (filtered - row[3 * x + c]) * alpha);
+            };
+        };
+    };
+};
+
+void guided_smooth_by_mask(cv::Mat &image, const cv::Mat1f &mask, int radius, float epsilon, float weight, const cv::Rect &roi, int num_threads = 0){
+    /*edge-preserving alternative to smooth_by_mask: a guided filter (He et
+     al.) of each channel guided by itself, blended in by mask * weight.
+     Flat areas are averaged over the (2 * radius + 1)^2 window while edges
+     with variance well above epsilon (in squared 8-bit levels) are kept.
+     Box filters come from summed-area tables, so the cost per pixel does
+     not depend on radius. roi is split into strips of rows, one per thread;
+     num_threads 0 means one per core.*/
+    const cv::Rect area = roi & cv::Rect(0, 0, image.cols, image.rows);
+    if (area.width <= 0 || area.height <= 0 || weight <= 0.0f){
+        return;
+    };
+    if (num_threads <= 0){
+        num_threads = std::max(1u, std::thread::hardware_concurrency());
+    };
+    /*strips much thinner than the halo of 2 * radius rows repeat too much work*/
+    num_threads = std::max(1, std::min(num_threads, area.height / std::max(16, 2 * radius)));
+    
+    const cv::Mat source = image(area).clone();
+    std::vector<std::thread> workers;
+    for (int t = 1; t < num_threads; t++){
+        const int y_begin = area.height * t / num_threads;
+        const int y_end = area.height * (t + 1) / num_threads;
+        workers.push_back(std::thread([&, y_begin, y_end](){
+            guided_filter_rows(source, image, mask, area, y_begin, y_end, radius, epsilon, weight);
+        }));
+    };
+    guided_filter_rows(source, image, mask, area, 0, area.height / num_threads, radius, epsilon, weight);
+    for (std::thread &worker : workers){
+        worker.join();
+    };
+};
+
+void improve_skin_in_region(cv::Mat &image, const cv::Mat &image_hsv, const std::vector<std::array<std::array<long, 2>, 68>> &landmarks, int blur_patch_size_hsv, int blur_patch_size_rgb, skin_smoothing smoothing, int num_threads){
+    /*smooths the skin of image in place; image_hsv is the same image in HSV.
+     Each smoothing is one fused blur-and-blend pass. image may be a view of
+     a face box, with landmarks relative to it. num_threads bounds the strips
+     of the guided filter.*/
     double blur_factor = estimate_image_blur(image, landmarks);
     
-    std::vector<std::vector<float>> skin_mask = find_skin_mask(image, landmarks);
-    std::vector<std::vector<float>> not_skin_mask = invert_mask(skin_mask);
+    cv::Mat1f skin_mask = find_skin_mask(image, landmarks);
+    const cv::Rect whole_image(0, 0, image.cols, image.rows);
     
-    /*HSV smoothing*/
-    smooth_layers(image_hsv, blur_patch_size_hsv);
-    cv::Mat image_hsv_copy = image_hsv;
+    if (smoothing == SKIN_SMOOTHING_GUIDED){
+        /*one edge-preserving pass in RGB stands in for both blurs*/
+        guided_smooth_by_mask(image, skin_mask, GUIDED_SMOOTHING_RADIUS, (float)(GUIDED_SMOOTHING_EPSILON * 255 * 255), (float)blur_factor, whole_image, num_threads);
+        return;
+    };
     
-    elementwise_product_cvmat(image_hsv, skin_mask);
-    elementwise_product_cvmat(image_hsv_copy, not_skin_mask);
-    elementwise_sum_cvmat(image_hsv, image_hsv_copy);
-    cv::cvCvtColor(image_hsv, image, CV_HSV2RGB);
-    cv::Mat image_original = image;
+    /*HSV smoothing: blurred HSV on the skin, the original elsewhere*/
+    cv::Mat image_hsv_smoothed = image_hsv.clone();
+    smooth_by_mask(image_hsv_smoothed, skin_mask, blur_patch_size_hsv, 1.0f, whole_image);
+    cv::cvtColor(image_hsv_smoothed, image, CV_HSV2RGB);
     
-    /*RGB smoothing*/
-    smooth_layers(image, blur_patch_size_rgb);
-    cv::Mat image_rgb_copy = image_original;
-    cv::Mat image_rgb_copy2 = image_original;
-    elementwise_product_cvmat(image, skin_mask);
-    elementwise_product_cvmat(image_rgb_copy, skin_mask);
-    elementwise_product_cvmat(image_rgb_copy2, not_skin_mask);
+    /*RGB smoothing: blur_factor of the blurred RGB on the skin*/
+    smooth_by_mask(image, skin_mask, blur_patch_size_rgb, (float)blur_factor, whole_image);
+};
+
+void improve_skin(cv::Mat &image, const cv::Mat &image_hsv, const std::vector<std::array<std::array<long, 2>, 68>> &landmarks, const std::vector<cv::Rect> &face_boxes, int blur_patch_size_hsv, int blur_patch_size_rgb, skin_smoothing smoothing = SKIN_SMOOTHING_GAUSSIAN){
+    /*smooths the skin inside each face's padded box and leaves every other
+     pixel alone. face_boxes[i] must hold the hull of landmarks[i] plus the
+     blur radius (see face_box). Overlapping boxes are merged, so each region
+     is written by one thread only, and the regions are processed concurrently,
+     sharing the cores between them.*/
+    std::vector<cv::Rect> regions;
+    std::vector<std::vector<int>> region_faces;
+    for (int face = 0; face < face_boxes.size(); face++){
+        if (face_boxes[face].width <= 0 || face_boxes[face].height <= 0){
+            continue;
+        };
+        regions.push_back(face_boxes[face]);
+        region_faces.push_back(std::vector<int>(1, face));
+    };
+    bool merged = true;
+    while (merged){
+        merged = false;
+        for (int i = 0; i < regions.size() && !merged; i++){
+            for (int j = i + 1; j < regions.size() && !merged; j++){
+                if ((regions[i] & regions[j]).area() > 0){
+                    regions[i] |= regions[j];
+                    region_faces[i].insert(region_faces[i].end(), region_faces[j].begin(), region_faces[j].end());
+                    regions.erase(regions.begin() + j);
+                    region_faces.erase(region_faces.begin() + j);
+                    merged = true;
+                };
+            };
+        };
+    };
     
-    elementwise_product_cvmat_scalar(image, blur_factor);
-    elementwise_product_cvmat_scalar(image_rgb_copy, 1.0 - blur_factor);
+    const int region_threads = std::max(1, (int)std::thread::hardware_concurrency() / std::max(1, (int)regions.size()));
     
-    elementwise_sum_cvmat(image, image_rgb_copy2);
-    elementwise_sum_cvmat(image, image_rgb_copy);
+    auto process_region = [&](int r){
+        const cv::Rect &region = regions[r];
+        std::vector<std::array<std::array<long, 2>, 68>> local_landmarks;
+        for (int face : region_faces[r]){
+            std::array<std::array<long, 2>, 68> shifted = landmarks[face];
+            for (int k = 0; k < 68; k++){
+                shifted[k][0] -= region.x;
+                shifted[k][1] -= region.y;
+            };
+            local_landmarks.push_back(shifted);
+        };
+        cv::Mat image_region = image(region);
+        improve_skin_in_region(image_region, image_hsv(region), local_landmarks, blur_patch_size_hsv, blur_patch_size_rgb, smoothing, region_threads);
+    };
+    
+    std::vector<std::thread> workers;
+    for (int r = 1; r < regions.size(); r++){
+        workers.push_back(std::thread(process_region, r));
+    };
+    if (!regions.empty()){
+        process_region(0);
+    };
+    for (std::thread &worker : workers){
+        worker.join();
+    };
+};
+
+void improve_skin(cv::Mat &image, const cv::Mat &image_hsv, const std::vector<std::array<std::array<long, 2>, 68>> &landmarks, int blur_patch_size_hsv, int blur_patch_size_rgb, skin_smoothing smoothing = SKIN_SMOOTHING_GAUSSIAN){
+    /*improve_skin with each face's box padded by the larger blur radius,
+     plus one pixel for the 3x3 blur in estimate_image_blur. The guided
+     filter reads twice its radius, through the box filtered coefficients.*/
+    int padding = std::max(blur_patch_size_hsv, blur_patch_size_rgb) / 2 + 1;
+    if (smoothing == SKIN_SMOOTHING_GUIDED){
+        padding = std::max(padding, 2 * GUIDED_SMOOTHING_RADIUS + 1);
+    };
+    std::vector<cv::Rect> face_boxes;
+    for (int face = 0; face < landmarks.size(); face++){
+        face_boxes.push_back(face_box(landmarks[face], padding, image.rows, image.cols));
+    };
+    improve_skin(image, image_hsv, landmarks, face_boxes, blur_patch_size_hsv, blur_patch_size_rgb, smoothing);
 };
 #endif
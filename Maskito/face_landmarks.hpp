@@ -4,6 +4,7 @@
 // Global index sets
 
 #include <dlib/matrix/matrix.h>
+#include <array>
 
 std::vector<int> face_dlib {0, 1, 2, 3, 4, 5, 6, 7, 8, 9, 10, 11, 12, 13, 14, 15, 16};
 std::vector<int> face_half_dlib {0, 1, 2, 3, 4, 5, 6, 7, 8};
@@ -20,6 +21,10 @@ std::vector<int> innermouth_dlib {60, 61, 62, 63, 64, 65, 66, 67};
 std::vector<int> total_mouth {48, 49, 50, 51, 52, 53, 54, 55, 56, 57, 58, 59, 60, 61, 62, 63, 64, 65, 66, 67};
 std::vector<int> total_eyes {36, 37, 38, 39, 40, 41, 42, 43, 44, 45, 46, 47};
 
+// Mirror pairs across the face midline, used for robust roll estimation
+std::vector<int> roll_pairs_left_dlib {0, 4, 17, 21, 36, 39, 31, 48};
+std::vector<int> roll_pairs_right_dlib {16, 12, 26, 22, 45, 42, 35, 54};
+
 
 
 std::vector<int> dlib_total {0, 1, 2, 3, 4, 5, 6, 7, 8, 9, 10, 11, 12, 13, 14, 15, 16, 17, 18, 19, 20, 21, 22, 23, 24, 25, 26, 27, 28, 29, 30, 31, 32, 33, 34, 35, 36, 37, 38, 39, 40, 41, 42, 43, 44, 45, 46, 47, 48, 49, 50, 51,52, 53, 54, 55, 56, 57, 58, 59, 60, 61, 62, 63, 64, 65, 66, 67, 68};
@@ -28,6 +33,8 @@ std::vector<int> dlib_face_outline {0, 1, 2, 3, 4, 5, 6, 7, 8, 9, 10, 11, 12, 13
 
 std::vector<int> dlib_not_face_outline {27, 28, 29, 30, 31, 32, 33, 34, 35, 36, 37, 38, 39, 40, 41, 42, 43, 44, 45, 46, 47, 48, 49, 50, 51,52, 53, 54, 55, 56, 57, 58, 59, 60, 61, 62, 63, 64, 65, 66, 67, 68};
 
+std::vector<int> dlib_inner_face {27, 28, 29, 30, 31, 32, 33, 34, 35, 36, 37, 38, 39, 40, 41, 42, 43, 44, 45, 46, 47, 48, 49, 50, 51, 52, 53, 54, 55, 56, 57, 58, 59, 60, 61, 62, 63, 64, 65, 66, 67};
+
 //std::vector<int> dlib_face_outline {0, 1, 2, 3, 4, 5, 6, 7, 8, 9, 10, 11, 12, 13, 14, 15, 16, 26,25,24,23,22,21,20,19,18,17};
 
 std::vector<int> face_trn = face_dlib;
@@ -75,4 +82,100 @@ double landmarks_faceflat_dlib[136] = {-62.65732219, -35.32321718,-60.97235592,
 int fifty_twenty_mouth[] =  {-25,0,-25,10,0,10,25,10,25,0,25,-10,0,-10,-25,-10};
 
 
-#endif
\ No newline at end of file
+// Precomputed 3D templates
+
+typedef std::array<double, 2> point_2d;
+typedef std::array<point_2d, 68> landmarks_2d;
+typedef std::array<std::array<double, 3>, 68> landmarks_3d;
+
+void load_landmarks3d(const double * landmarks3d_ptr, landmarks_3d &landmarks3d)
+{
+    for (int row = 0; row < 68; row++)
+    {
+        for (int col = 0; col < 3; col++)
+        {
+            landmarks3d[row][col] = landmarks3d_ptr[row * 3 + col];
+        }
+    }
+};
+
+void center_landmarks3d(landmarks_3d &landmarks3d, int centre_row)
+{
+    const std::array<double, 3> centre = landmarks3d[centre_row];
+    for (int row = 0; row < 68; row++)
+    {
+        for (int col = 0; col < 3; col++)
+        {
+            landmarks3d[row][col] -= centre[col];
+        }
+    }
+};
+
+double column_stddev(const landmarks_3d &landmarks, int col)
+{
+    double mean = 0.0;
+    for (int row = 0; row < 68; row++)
+    {
+        mean += landmarks[row][col];
+    }
+    mean /= 68.0;
+    double variance = 0.0;
+    for (int row = 0; row < 68; row++)
+    {
+        variance += (landmarks[row][col] - mean) * (landmarks[row][col] - mean);
+    }
+    return std::sqrt(variance / 67.0);
+};
+
+double landmark_distance(const landmarks_3d &landmarks, int first, int second)
+{
+    return std::sqrt(std::pow(landmarks[first][0] - landmarks[second][0], 2.0) + std::pow(landmarks[first][1] - landmarks[second][1], 2.0));
+};
+
+struct face_template
+{
+    // Template centred on the nose (row 30), which is how every warp consumes it.
+    landmarks_3d centered;
+    double stddev[3];
+    
+    // Ideal feature distances for the golden warps
+    double ideal_eyedist_lh;
+    double ideal_eyedist_lv1;
+    double ideal_eyedist_lv2;
+    double ideal_eyedist_rh;
+    double ideal_eyedist_rv1;
+    double ideal_eyedist_rv2;
+    double ideal_nosedist_h1;
+    double ideal_nosedist_h2;
+    double ideal_nosedist_v;
+};
+
+face_template make_face_template(const double * landmarks3d_ptr)
+{
+    face_template tpl;
+    load_landmarks3d(landmarks3d_ptr, tpl.centered);
+    center_landmarks3d(tpl.centered, 30);
+    
+    for (int col = 0; col < 3; col++)
+    {
+        tpl.stddev[col] = column_stddev(tpl.centered, col);
+    }
+    
+    tpl.ideal_eyedist_lh = landmark_distance(tpl.centered, 36, 39);
+    tpl.ideal_eyedist_lv1 = landmark_distance(tpl.centered, 37, 41);
+    tpl.ideal_eyedist_lv2 = landmark_distance(tpl.centered, 38, 40);
+    tpl.ideal_eyedist_rh = landmark_distance(tpl.centered, 42, 45);
+    tpl.ideal_eyedist_rv1 = landmark_distance(tpl.centered, 43, 47);
+    tpl.ideal_eyedist_rv2 = landmark_distance(tpl.centered, 44, 46);
+    tpl.ideal_nosedist_h1 = landmark_distance(tpl.centered, 31, 35);
+    tpl.ideal_nosedist_h2 = landmark_distance(tpl.centered, 32, 34);
+    tpl.ideal_nosedist_v = landmark_distance(tpl.centered, 27, 33);
+    return tpl;
+};
+
+// Built once at startup; warps take these by const reference.
+const face_template face_template_female = make_face_template(landmarks3d_female);
+const face_template face_template_male = make_face_template(landmarks3d_male);
+const face_template face_template_dlib = make_face_template(landmarks3d_dlib);
+
+#endif
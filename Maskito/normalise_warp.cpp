@@ -5,367 +5,683 @@
 #include <dlib/matrix/matrix.h>
 #include <dlib/optimization.h>
 #include <dlib/graph_utils.h>
+#include <dlib/threads.h>
 #include "face_landmarks.hpp"
+#include <algorithm>
+#include <array>
+#include <atomic>
+#include <cmath>
 #include <chrono>
+#include <cstdint>
+#include <thread>
+#if defined(__ARM_NEON)
+#include <arm_neon.h>
+#endif
+
+// Fixed-size working types. dlib keeps matrices of at most 256 bytes on the stack, so
+// 68-point landmark sets (see face_landmarks.hpp) are held in std::array rather than dlib::matrix.
+typedef dlib::matrix<double,3,3> rotation_3d;
+typedef dlib::matrix<double,6,1> cholesky_vector;
+
+// Solver counters for profiling and replay runs. Faces are solved concurrently, so they are atomic;
+// relaxed ordering is enough for counts read after the warps return.
+struct warp_counters
+{
+    std::atomic<unsigned long> pose_solves;
+    std::atomic<unsigned long> solver_iterations;
+    std::atomic<unsigned long> cost_evaluations;
+    std::atomic<unsigned long> folded_triangles;
+};
+
+warp_counters counters;
+
+void count_event(std::atomic<unsigned long> &counter)
+{
+    counter.fetch_add(1, std::memory_order_relaxed);
+};
 
-typedef dlib::matrix<double,0,1> column_vector;
+// The animated effects read time through this, so a replay can drive them from a recorded clock.
+PhiWarpClock warp_clock = nullptr;
+
+double warp_clock_seconds()
+{
+    if (warp_clock)
+    {
+        return warp_clock();
+    }
+    return std::chrono::duration_cast<std::chrono::milliseconds>(std::chrono::steady_clock::now().time_since_epoch()).count() / 1000.0;
+};
 
-dlib::matrix<double> unflattenMatrix(const dlib::matrix<double,6,1> &vector) {
-    dlib::matrix<double> matrix(3,3);
+rotation_3d unflattenMatrix(const cholesky_vector &vector) {
+    rotation_3d matrix;
     matrix = vector(0,0), 0.0,         0.0,
     vector(1,0), vector(2,0), 0.0,
     vector(3,0), vector(4,0), vector(5,0);
     return matrix;
 }
 
-dlib::matrix<double> return_rotation_matrix_from_flat_vector(const dlib::matrix<double,6,1> &vector)
+rotation_3d return_rotation_matrix_from_flat_vector(const cholesky_vector &vector)
 {
-    dlib::matrix<double,3,3> rotation_matrix_cholesky = unflattenMatrix(vector);
-    dlib::matrix<double,3,3> rotation_matrix = rotation_matrix_cholesky * dlib::trans(rotation_matrix_cholesky);
+    rotation_3d rotation_matrix_cholesky = unflattenMatrix(vector);
+    rotation_3d rotation_matrix = rotation_matrix_cholesky * dlib::trans(rotation_matrix_cholesky);
     
     return rotation_matrix;
 };
 
-dlib::matrix<double> return_rotation_matrix_grad_from_flat_vector_and_index(const dlib::matrix<double,6,1> &vector, const dlib::matrix<double,6,1> &idx_vector)
+rotation_3d return_rotation_matrix_grad_from_flat_vector_and_index(const cholesky_vector &vector, const cholesky_vector &idx_vector)
 {
-    dlib::matrix<double, 3, 3> rotation_matrix_cholesky_left = unflattenMatrix(vector);
-    dlib::matrix<double, 3, 3> rotation_matrix_cholesky_right = dlib::trans(rotation_matrix_cholesky_left);
-    
-    dlib::matrix<double, 3, 3> rotation_matrix_idx_left = unflattenMatrix(idx_vector);
-    dlib::matrix<double, 3, 3> rotation_matrix_idx_right = dlib::trans(rotation_matrix_idx_left);
+    rotation_3d rotation_matrix_cholesky_left = unflattenMatrix(vector);
+    rotation_3d rotation_matrix_cholesky_right = dlib::trans(rotation_matrix_cholesky_left);
     
+    rotation_3d rotation_matrix_idx_left = unflattenMatrix(idx_vector);
+    rotation_3d rotation_matrix_idx_right = dlib::trans(rotation_matrix_idx_left);
     
-    dlib::matrix<double, 3, 3> rotation_matrix = rotation_matrix_cholesky_left * rotation_matrix_idx_right + rotation_matrix_idx_left * rotation_matrix_cholesky_right;
-    //    std::cout << rotation_matrix;
+    rotation_3d rotation_matrix = rotation_matrix_cholesky_left * rotation_matrix_idx_right + rotation_matrix_idx_left * rotation_matrix_cholesky_right;
     return rotation_matrix;
 };
 
-double cost_function_3d_rotation(dlib::matrix<double> vector, const dlib::matrix<double> &landmarks3d, const dlib::matrix<double> &landmarks){
-    
-    dlib::matrix<double,3,3> rotation_matrix = return_rotation_matrix_from_flat_vector(vector);
+void load_landmarks(const int * landmarks_ptr, landmarks_2d &landmarks)
+{
+    for (int row = 0; row < 68; row++)
+    {
+        landmarks[row][0] = (double)landmarks_ptr[row * 2 + 0];
+        landmarks[row][1] = (double)landmarks_ptr[row * 2 + 1];
+    }
+};
+
+point_2d column_means(const landmarks_2d &landmarks)
+{
+    point_2d mean = {{0.0, 0.0}};
+    for (int row = 0; row < 68; row++)
+    {
+        mean[0] += landmarks[row][0];
+        mean[1] += landmarks[row][1];
+    }
+    mean[0] /= 68.0;
+    mean[1] /= 68.0;
+    return mean;
+};
+
+void center_landmarks(landmarks_2d &landmarks, const point_2d centre)
+{
+    for (int row = 0; row < 68; row++)
+    {
+        landmarks[row][0] -= centre[0];
+        landmarks[row][1] -= centre[1];
+    }
+};
+
+double cost_function_3d_rotation(const cholesky_vector &vector, const landmarks_3d &landmarks3d, const landmarks_2d &landmarks){
     
-    dlib::matrix<double> rotated_3d_landmarks = landmarks3d * rotation_matrix;
-    dlib::matrix<double> rotated_3d_landmarks_subm = dlib::colm(rotated_3d_landmarks, dlib::range(0,1));
-    dlib::matrix<double> mismatch_error = dlib::sum_cols(dlib::pow(rotated_3d_landmarks_subm - landmarks,2));
-    //    dlib::matrix<double> mismatch_error_covariance = dlib::trans(mismatch_error) * mismatch_error;
-    //    dlib::matrix<double> mismatch_error_final = dlib::trans(mismatch_error) * mismatch_error_covariance * mismatch_error;
+    rotation_3d rotation_matrix = return_rotation_matrix_from_flat_vector(vector);
     
-    //    double error = mismatch_error_final(0,0);
-    double error = dlib::sum_rows(mismatch_error);
+    double error = 0.0;
+    for (int row = 0; row < 68; row++)
+    {
+        for (int col = 0; col < 2; col++)
+        {
+            double rotated = landmarks3d[row][0] * rotation_matrix(0,col) + landmarks3d[row][1] * rotation_matrix(1,col) + landmarks3d[row][2] * rotation_matrix(2,col);
+            error += (rotated - landmarks[row][col]) * (rotated - landmarks[row][col]);
+        }
+    }
     return error;
 };
 
-dlib::matrix<double> derivative_cost_function_3d_rotation(dlib::matrix<double> vector, const dlib::matrix<double> &landmarks3d, const dlib::matrix<double> &landmarks){
+cholesky_vector derivative_cost_function_3d_rotation(const cholesky_vector &vector, const landmarks_3d &landmarks3d, const landmarks_2d &landmarks){
+    
+    rotation_3d rotation_matrix = return_rotation_matrix_from_flat_vector(vector);
     
-    dlib::matrix<double,6,1> derivatives;
+    // The gradient for each parameter is sum(landmarks3d * grad_rotation .* 2 * mismatch), which only
+    // depends on the landmarks through the 3x2 matrix trans(landmarks3d) * (2 * mismatch).
+    dlib::matrix<double,3,2> weighted_mismatch;
+    weighted_mismatch = 0.0;
+    for (int row = 0; row < 68; row++)
+    {
+        for (int col = 0; col < 2; col++)
+        {
+            double rotated = landmarks3d[row][0] * rotation_matrix(0,col) + landmarks3d[row][1] * rotation_matrix(1,col) + landmarks3d[row][2] * rotation_matrix(2,col);
+            double mismatch_error = 2 * (rotated - landmarks[row][col]);
+            for (int k = 0; k < 3; k++)
+            {
+                weighted_mismatch(k,col) += landmarks3d[row][k] * mismatch_error;
+            }
+        }
+    }
     
+    cholesky_vector derivatives;
     for (int i = 0; i < 6; i++)
     {
-        dlib::matrix<double, 6, 1> vector_derv;
+        cholesky_vector vector_derv;
         vector_derv = 0.0, 0.0, 0.0, 0.0, 0.0, 0.0;
         vector_derv(i,0) = 1.0;
         
-        dlib::matrix<double,3,3> rotation_matrix = return_rotation_matrix_from_flat_vector(vector);
-        dlib::matrix<double,3,3> grad_rotation_matrix = return_rotation_matrix_grad_from_flat_vector_and_index(vector, vector_derv);
-        
-        dlib::matrix<double> rotated_3d_landmarks = landmarks3d * rotation_matrix;
-        dlib::matrix<double> rotated_3d_landmarks_subm = dlib::colm(rotated_3d_landmarks, dlib::range(0,1));
-        dlib::matrix<double> mismatch_error = 2 * (rotated_3d_landmarks_subm - landmarks);
+        rotation_3d grad_rotation_matrix = return_rotation_matrix_grad_from_flat_vector_and_index(vector, vector_derv);
         
-        dlib::matrix<double> lm_grad = dlib::colm(landmarks3d * grad_rotation_matrix, dlib::range(0,1));
-        
-        double error = dlib::sum_rows(dlib::sum_cols(dlib::pointwise_multiply(lm_grad, mismatch_error)));
+        double error = 0.0;
+        for (int k = 0; k < 3; k++)
+        {
+            error += grad_rotation_matrix(k,0) * weighted_mismatch(k,0) + grad_rotation_matrix(k,1) * weighted_mismatch(k,1);
+        }
         derivatives(i,0) = error;
-        
     }
     return derivatives;
 };
 
-//double derivative_cost_function_3d_rotation2(dlib::matrix<double> vector, const dlib::matrix<double> &landmarks3d, const dlib::matrix<double> &landmarks, dlib::matrix<double> & der){
-//
-//    dlib::matrix<double,6,1> derivatives;
-//
-//    for (int i = 0; i < 6; i++)
-//    {
-//        dlib::matrix<double, 6, 1> vector_derv;
-//        vector_derv = 0.0, 0.0, 0.0, 0.0, 0.0, 0.0;
-//        vector_derv(i,0) = 1.0;
-//
-//        dlib::matrix<double,3,3> rotation_matrix = return_rotation_matrix_from_flat_vector(vector_derv);
-//
-//        dlib::matrix<double> rotated_3d_landmarks = landmarks3d * rotation_matrix;
-//        dlib::matrix<double> rotated_3d_landmarks_subm = dlib::colm(rotated_3d_landmarks, dlib::range(0,1));
-//        dlib::matrix<double> mismatch_error = dlib::sum_cols(dlib::sqrt(dlib::pow(rotated_3d_landmarks_subm - landmarks,2)));
-//
-//        double error = dlib::sum_rows(mismatch_error);
-//        derivatives(i,0) = error;
-//    }
-//    der = derivatives;
-//    return cost_function_3d_rotation(vector, landmarks3d, landmarks);
-//};
-
-double cost_function_2d_rotation(dlib::matrix<double> angle, const dlib::matrix<double> &centered_landmarks)
+class fixed_bfgs_search_strategy
 {
-    dlib::matrix<double,2,2> rotation_matrix = dlib::rotation_matrix(angle(0,0));
-    dlib::matrix<double> rotated_landmarks = centered_landmarks * rotation_matrix;
+    // dlib::bfgs_search_strategy with the inverse Hessian held in a plain array, so that
+    // a 6 parameter solve never touches the heap.
+public:
+    fixed_bfgs_search_strategy() : been_used(false), been_used_twice(false) {}
+    
+    double get_wolfe_rho () const { return 0.01; }
+    
+    double get_wolfe_sigma () const { return 0.9; }
+    
+    unsigned long get_max_line_search_iterations () const { return 100; }
     
-    dlib::matrix<long> dlib_leye_range(1,leye_dlib.size());
-    for (int i = 0; i < leye_dlib.size(); i++ )
+    const cholesky_vector& get_next_direction (const cholesky_vector &x, const double, const cholesky_vector &funct_derivative)
     {
-        dlib_leye_range(0,i) = (long)leye_dlib[i];
+        // find_min asks for one direction per iteration.
+        count_event(counters.solver_iterations);
+        if (been_used == false)
+        {
+            been_used = true;
+            set_diagonal(1.0);
+        }
+        else
+        {
+            // update H with the BFGS formula from (3.2.12) on page 55 of Fletcher
+            cholesky_vector delta = x - prev_x;
+            cholesky_vector gamma = funct_derivative - prev_derivative;
+            
+            double dg = dlib::dot(delta, gamma);
+            
+            if (been_used_twice == false)
+            {
+                double gg = dlib::dot(gamma, gamma);
+                if (std::abs(gg) > std::numeric_limits<double>::epsilon())
+                {
+                    set_diagonal(dlib::put_in_range(0.01, 100, dg/gg));
+                    been_used_twice = true;
+                }
+            }
+            
+            cholesky_vector Hg;
+            cholesky_vector gH;
+            for (int i = 0; i < 6; i++)
+            {
+                Hg(i) = 0.0;
+                gH(i) = 0.0;
+                for (int j = 0; j < 6; j++)
+                {
+                    Hg(i) += H[i][j] * gamma(j);
+                    gH(i) += gamma(j) * H[j][i];
+                }
+            }
+            double gHg = dlib::dot(gamma, Hg);
+            if (gHg < std::numeric_limits<double>::infinity() && dg < std::numeric_limits<double>::infinity() &&
+                dg != 0)
+            {
+                for (int i = 0; i < 6; i++)
+                {
+                    for (int j = 0; j < 6; j++)
+                    {
+                        H[i][j] += (1 + gHg/dg)*delta(i)*delta(j)/dg - (delta(i)*gH(j) + Hg(i)*delta(j))/dg;
+                    }
+                }
+            }
+            else
+            {
+                set_diagonal(1.0);
+                been_used_twice = false;
+            }
+        }
+        
+        prev_x = x;
+        for (int i = 0; i < 6; i++)
+        {
+            prev_direction(i) = 0.0;
+            for (int j = 0; j < 6; j++)
+            {
+                prev_direction(i) -= H[i][j] * funct_derivative(j);
+            }
+        }
+        prev_derivative = funct_derivative;
+        return prev_direction;
     }
     
-    dlib::matrix<long> dlib_reye_range(1,reye_dlib.size());
-    for (int i = 0; i < reye_dlib.size(); i++ )
+private:
+    void set_diagonal(double value)
     {
-        dlib_reye_range(0,i) = (long)reye_dlib[i];
+        for (int i = 0; i < 6; i++)
+        {
+            for (int j = 0; j < 6; j++)
+            {
+                H[i][j] = (i == j) ? value : 0.0;
+            }
+        }
     }
     
-    dlib::matrix<double> old_mean_leye_tmp = dlib::rowm(centered_landmarks, dlib_leye_range);
-    dlib::matrix<double> old_mean_leye = dlib::sum_rows(old_mean_leye_tmp) * (1.0/((double)leye_dlib.size()));
-    dlib::matrix<double> old_mean_reye_tmp = dlib::rowm(centered_landmarks, dlib_reye_range);
-    dlib::matrix<double> old_mean_reye = dlib::sum_rows(old_mean_reye_tmp) * (1.0/((double)reye_dlib.size()));
-    
-    dlib::matrix<double> mean_leye_tmp = dlib::rowm(rotated_landmarks, dlib_leye_range);
-    dlib::matrix<double> mean_leye = dlib::sum_rows(mean_leye_tmp) * (1.0/((double)leye_dlib.size()));
-    dlib::matrix<double> mean_reye_tmp = dlib::rowm(rotated_landmarks, dlib_reye_range);
-    dlib::matrix<double> mean_reye = dlib::sum_rows(mean_reye_tmp) * (1.0/((double)leye_dlib.size()));
-    
-    double mismatch_error = 68*2*100000;//std::numeric_limits<double>::max();
-    
-    mismatch_error = std::sqrt(std::pow(mean_leye(0,1) - mean_reye(0,1),2));
-    
-    return mismatch_error;
-    
+    bool been_used;
+    bool been_used_twice;
+    cholesky_vector prev_x;
+    cholesky_vector prev_derivative;
+    cholesky_vector prev_direction;
+    double H[6][6];
 };
 
-dlib::matrix<double> find_2d_rotation_matrix(const dlib::matrix<double> &landmarks, double * startAngle)
+double closest_equivalent_angle(double angle, double reference)
 {
-    dlib::matrix<double> mean_landmarks = dlib::rowm(landmarks,30);
-    dlib::matrix<double> centered_landmarks = landmarks;
-    dlib::set_colm(centered_landmarks,0) = colm(centered_landmarks,0) - mean_landmarks(0,0);
-    dlib::set_colm(centered_landmarks,1) = colm(centered_landmarks,1) - mean_landmarks(0,1);
-    
-    auto cost_function_2d_rotation_wrapper = [&centered_landmarks](double x)
+    // The roll is only defined up to a multiple of pi; pick the branch nearest
+    // the previous frame's angle, within the range the old line search covered.
+    while (angle - reference > dlib::pi / 2) angle -= dlib::pi;
+    while (angle - reference < -dlib::pi / 2) angle += dlib::pi;
+    if (angle > 3.1) angle -= dlib::pi;
+    if (angle < -3.1) angle += dlib::pi;
+    return angle;
+};
+
+double estimate_2d_rotation_angle(const landmarks_2d &landmarks, double start_angle, bool robust)
+{
+    // Rotating by R(a) moves the left-right offset (dx, dy) to dy*cos(a) - dx*sin(a)
+    // vertically, which is zero at a = atan(dy/dx). The eye-mean offset matches the
+    // old cost function; the robust variant sums offsets over mirrored landmark pairs.
+    double dx = 0.0;
+    double dy = 0.0;
+    if (robust)
+    {
+        for (int i = 0; i < roll_pairs_left_dlib.size(); i++)
+        {
+            dx += landmarks[roll_pairs_left_dlib[i]][0] - landmarks[roll_pairs_right_dlib[i]][0];
+            dy += landmarks[roll_pairs_left_dlib[i]][1] - landmarks[roll_pairs_right_dlib[i]][1];
+        }
+    }
+    else
     {
-        dlib::matrix<double, 1, 1> arse;
-        arse = x;
-        auto cost = cost_function_2d_rotation(arse, centered_landmarks);
-        //        std::cout << "Cost: "<< cost << " for x: " << x <<std::endl;
-        return cost;
-    };
-    
-    //    column_vector angle(1);
-    double angle = startAngle[0];
-//    double min_f;
-//    double dervative_eps = 1e-7;
+        for (int i = 0; i < leye_dlib.size(); i++)
+        {
+            dx += landmarks[leye_dlib[i]][0] - landmarks[reye_dlib[i]][0];
+            dy += landmarks[leye_dlib[i]][1] - landmarks[reye_dlib[i]][1];
+        }
+    }
     
-    //    const double begin = -1e200,
-    //    const double end = 1e200,
-    //    const double eps = 1e-3,
-    //    const long max_iter = 100,
-    //    const double initial_search_radius = 1
-    try {
-        dlib::find_min_single_variable(
-                                       cost_function_2d_rotation_wrapper,
-                                       angle,
-                                       -3.1,
-                                       3.1,
-                                       1e-3,
-                                       80,
-                                       1e-2);
-        //        dlib::find_min_using_approximate_derivatives(dlib::cg_search_strategy(),
-        //                                                     dlib::gradient_norm_stop_strategy(1e-7),
-        //                                                     cost_function_2d_rotation_wrapper,
-        //                                                     angle,
-        //                                                     min_f,
-        //                                                     1e-9);
-        //        std::cout << dlib::csv << angle << std::endl;
-    }
-    catch (std::exception &e)
-    {
-        std::cout << e.what() << std::endl;
-    };
-    //    angle = (angle + startAngle[0]) / 2;
+    if (dx == 0.0 && dy == 0.0)
+    {
+        return start_angle;
+    }
+    return closest_equivalent_angle(std::atan2(dy, dx), start_angle);
+};
+
+rotation_3d find_2d_rotation_matrix(const landmarks_2d &landmarks, double * startAngle, bool robust = false)
+{
+    double angle = estimate_2d_rotation_angle(landmarks, startAngle[0], robust);
     startAngle[0] = angle;
-    //    dlib::matrix<double>
     dlib::matrix<double,2,2> rotation_matrix_2d = dlib::rotation_matrix(angle);
     dlib::matrix<double,2,2> rotation_matrix_2d_inv = dlib::inv(rotation_matrix_2d);
-    //    dlib::matrix<double,3,3> rotation_matrix = dlib::identity_matrix<double>(3);
-    dlib::matrix<double,3,3> rotation_matrix_inv = dlib::identity_matrix<double>(3);
-    //    dlib::set_subm(rotation_matrix, dlib::range(0,1), dlib::range(0,1)) = rotation_matrix_2d;
+    rotation_3d rotation_matrix_inv = dlib::identity_matrix<double>(3);
     dlib::set_subm(rotation_matrix_inv, dlib::range(0,1), dlib::range(0,1)) = rotation_matrix_2d_inv;
     
     return rotation_matrix_inv;
 };
 
-dlib::matrix<double> find_3d_rotation_matrix(const dlib::matrix<double> &landmarks, const dlib::matrix<double> &landmarks3d, double * matrixParams)
+rotation_3d find_3d_rotation_matrix(const landmarks_2d &landmarks, const landmarks_3d &centered_landmarks3d, double * matrixParams)
 {
-    dlib::matrix<double> mean_landmarks = dlib::rowm(landmarks,30);
-    dlib::matrix<double> centered_landmarks = landmarks;
-    dlib::set_colm(centered_landmarks,0) = colm(centered_landmarks,0) - mean_landmarks(0,0);
-    dlib::set_colm(centered_landmarks,1) = colm(centered_landmarks,1) - mean_landmarks(0,1);
-    
-    dlib::matrix<double> mean_landmarks3d = dlib::rowm(landmarks3d,30);
-    dlib::matrix<double> centered_landmarks3d = landmarks3d;
-    dlib::set_colm(centered_landmarks3d,0) = colm(centered_landmarks3d,0) - mean_landmarks3d(0,0);
-    dlib::set_colm(centered_landmarks3d,1) = colm(centered_landmarks3d,1) - mean_landmarks3d(0,1);
-    dlib::set_colm(centered_landmarks3d,2) = colm(centered_landmarks3d,2) - mean_landmarks3d(0,2);
+    // The template is expected to be centred on row 30 already (see face_template).
+    landmarks_2d centered_landmarks = landmarks;
+    center_landmarks(centered_landmarks, landmarks[30]);
     
-    auto cost_function_3d_rotation_wrapper = [&centered_landmarks3d, &centered_landmarks](dlib::matrix<double,6,1> x)
+    auto cost_function_3d_rotation_wrapper = [&centered_landmarks3d, &centered_landmarks](const cholesky_vector &x)
     {
+        count_event(counters.cost_evaluations);
         return cost_function_3d_rotation(x, centered_landmarks3d, centered_landmarks);
     };
     
-    auto cost_function_3d_rotation_wrapper_derivative = [&centered_landmarks3d, &centered_landmarks](dlib::matrix<double,6,1> x)
+    auto cost_function_3d_rotation_wrapper_derivative = [&centered_landmarks3d, &centered_landmarks](const cholesky_vector &x)
     {
-        auto ans = derivative_cost_function_3d_rotation(x, centered_landmarks3d, centered_landmarks);
-        //        std::cout << ans << std::endl;
-        return ans;
+        return derivative_cost_function_3d_rotation(x, centered_landmarks3d, centered_landmarks);
     };
     
-    column_vector vector(6);
+    cholesky_vector vector;
     for (int i = 0; i < 6; ++i) {
         vector(i) = matrixParams[i];
     }
     
-    //    dlib::matrix<double> true_deriv = cost_function_3d_rotation_wrapper_derivative(vector);
-    //    //        dlib::central_differences<double> approx_deriv = dlib::derivative(cost_function_3d_rotation_wrapper)(vector, 1e-7);
-    //
-    //    std::cout << dlib::csv << true_deriv << "<-- our derivs" << std::endl;
-    //
-    //    dlib::matrix<double,6,1> approx_deriv;
-    //
-    //    for (int i = 0; i < 7; i++)
-    //    {
-    //        dlib::matrix<double> new_vector = vector;
-    //        new_vector(i,0) += 1e-7;
-    //        approx_deriv(i,0) = (cost_function_3d_rotation_wrapper(new_vector) - cost_function_3d_rotation_wrapper(vector)) / 1e-7;
-    //    }
-    //
-    //    dlib::matrix<double,6,1> true_derivss;
-    //
-    //    for (int i = 0; i < 7; i++)
-    //    {
-    //        true_derivss(i,0) = true_deriv(i,0);
-    //    }
-    //
-    //    std::cout << dlib::csv << approx_deriv << "<-- approx derivs" << std::endl;
-    
+    count_event(counters.pose_solves);
     try {
-        //        double min_f;
-        //        double dervative_eps = 1e-7;
-        
-        //        dlib::find_min_using_approximate_derivatives(dlib::bfgs_search_strategy(),
-        //                                                     dlib::objective_delta_stop_strategy(1e-3),
-        //                                                     cost_function_3d_rotation_wrapper,
-        //                                                     vector,
-        //                                                     1e-10);
-        
-        //        dlib::matrix<double> true_deriv = cost_function_3d_rotation_wrapper_derivative(vector);
-        //        dlib::central_differences<double> approx_deriv = dlib::derivative(cost_function_3d_rotation_wrapper)(vector, 1e-7);
-        
-        //        std::cout << dlib::csv << true_deriv << "<-- our derivs" << std::endl;
-        //        std::cout << dlib::length(dlib::derivative(cost_function_3d_rotation_wrapper)(vector));
-        
-        //        std::cout << "Difference between analytic derivative and numerical approximation of derivative: "
-        //        << dlib::length(dlib::derivative(cost_function_3d_rotation_wrapper)(vector) - true_deriv) << std::endl;
-        
-        dlib::find_min(dlib::bfgs_search_strategy(),
+        dlib::find_min(fixed_bfgs_search_strategy(),
                        dlib::objective_delta_stop_strategy(1e-3),
                        cost_function_3d_rotation_wrapper,
                        cost_function_3d_rotation_wrapper_derivative,
                        vector,
                        1e-10);
-        
-        
     }
     catch (std::exception& e)
     {
         std::cout << "Optimisation failed with " << e.what() << std::endl;
     };
     for (int i = 0; i < 6; ++i) {
-        vector(i) = vector(i);// + matrixParams[i] * 0.1; // Average
-        matrixParams[i] = vector(i); // Average
+        matrixParams[i] = vector(i);
     }
-    dlib::matrix<double,3,3> rotation_matrix = return_rotation_matrix_from_flat_vector(vector);
+    rotation_3d rotation_matrix = return_rotation_matrix_from_flat_vector(vector);
     
     return rotation_matrix;
     
 };
 
-dlib::matrix<double> find_overall_rotation_matrix(const dlib::matrix<double> &landmarks, const dlib::matrix<double> &landmarks3d, double * parameters)
+rotation_3d find_overall_rotation_matrix(const landmarks_2d &landmarks, const landmarks_3d &landmarks3d, double * parameters, bool robust_roll = false)
 {
-    dlib::matrix<double,3,3> rotation_matrix_2d_inv = find_2d_rotation_matrix(landmarks, parameters);
-    dlib::matrix<double,2,2> rotation_matrix_2d_2b2 = dlib::inv(dlib::subm(rotation_matrix_2d_inv,dlib::range(0,1),dlib::range(0,1)));
+    rotation_3d rotation_matrix_2d_inv = find_2d_rotation_matrix(landmarks, parameters, robust_roll);
+    // find_2d_rotation_matrix leaves the roll in parameters[0]; its inverse is the plain rotation.
+    dlib::matrix<double,2,2> rotation_matrix_2d_2b2 = dlib::rotation_matrix(parameters[0]);
     
-    dlib::matrix<double,3,3> rotation_matrix_3d = find_3d_rotation_matrix(landmarks*rotation_matrix_2d_2b2, landmarks3d, parameters + 1);
+    landmarks_2d derotated_landmarks;
+    for (int row = 0; row < 68; row++)
+    {
+        derotated_landmarks[row][0] = landmarks[row][0] * rotation_matrix_2d_2b2(0,0) + landmarks[row][1] * rotation_matrix_2d_2b2(1,0);
+        derotated_landmarks[row][1] = landmarks[row][0] * rotation_matrix_2d_2b2(0,1) + landmarks[row][1] * rotation_matrix_2d_2b2(1,1);
+    }
     
-    dlib::matrix<double,3,3> rotation_matrix_total = rotation_matrix_3d * rotation_matrix_2d_inv;
+    rotation_3d rotation_matrix_3d = find_3d_rotation_matrix(derotated_landmarks, landmarks3d, parameters + 1);
+    
+    rotation_3d rotation_matrix_total = rotation_matrix_3d * rotation_matrix_2d_inv;
     
     return rotation_matrix_total;
 };
 
+void multiply_landmarks3d(const landmarks_3d &landmarks3d, const rotation_3d &matrix, landmarks_3d &result)
+{
+    for (int row = 0; row < 68; row++)
+    {
+        for (int col = 0; col < 3; col++)
+        {
+            result[row][col] = landmarks3d[row][0] * matrix(0,col) + landmarks3d[row][1] * matrix(1,col) + landmarks3d[row][2] * matrix(2,col);
+        }
+    }
+};
+
+void flatten_landmarks(const landmarks_2d &centered_landmarks, const landmarks_3d &centered_landmarks3d, const rotation_3d &rotation_matrix, landmarks_3d &flattened)
+{
+    // Posed template depth with the user's own x,y.
+    multiply_landmarks3d(centered_landmarks3d, rotation_matrix, flattened);
+    for (int row = 0; row < 68; row++)
+    {
+        flattened[row][0] = centered_landmarks[row][0];
+        flattened[row][1] = centered_landmarks[row][1];
+    }
+};
+
+void frontalise_landmarks(const landmarks_2d &centered_landmarks, const landmarks_3d &centered_landmarks3d, const rotation_3d &rotation_matrix, landmarks_3d &frontal)
+{
+    landmarks_3d flattened;
+    flatten_landmarks(centered_landmarks, centered_landmarks3d, rotation_matrix, flattened);
+    multiply_landmarks3d(flattened, dlib::inv(rotation_matrix), frontal);
+};
+
+void reproject_landmarks(const landmarks_3d &frontal, const rotation_3d &rotation_matrix, const point_2d &centre, landmarks_2d &result)
+{
+    for (int row = 0; row < 68; row++)
+    {
+        for (int col = 0; col < 2; col++)
+        {
+            result[row][col] = frontal[row][0] * rotation_matrix(0,col) + frontal[row][1] * rotation_matrix(1,col) + frontal[row][2] * rotation_matrix(2,col) + centre[col];
+        }
+    }
+};
+
+double landmark_distance(const landmarks_2d &landmarks, int first, int second)
+{
+    return std::sqrt(std::pow(landmarks[first][0] - landmarks[second][0], 2.0) + std::pow(landmarks[first][1] - landmarks[second][1], 2.0));
+};
+
+void write_phi_points(const landmarks_2d &landmarks, PhiPoint * output)
+{
+    for (int row = 0; row < 68; row++)
+    {
+        output[row] = PhiPoint{
+            static_cast<int>(std::round(landmarks[row][0])),
+            static_cast<int>(std::round(landmarks[row][1]))
+        };
+    }
+};
+
+void write_face_vertices(const landmarks_2d &xy, const landmarks_2d &uv, float width, float height, const float * region_alphas, PhiVertex * output)
+{
+    // region_alphas is {inner face, outline, eyes, mouth}; the split matches fillFaceVertex.
+    for (int row = 0; row < 68; row++)
+    {
+        float alpha;
+        if (row < 27)
+        {
+            alpha = region_alphas[1];
+        }
+        else if (row < 36)
+        {
+            alpha = region_alphas[0];
+        }
+        else if (row < 46)
+        {
+            alpha = region_alphas[2];
+        }
+        else
+        {
+            alpha = region_alphas[3];
+        }
+        output[row] = PhiVertex{
+            2.0f * (float)xy[row][0] / width - 1.0f,
+            2.0f * (float)xy[row][1] / height - 1.0f,
+            0.0f,
+            (float)uv[row][0] / width,
+            (float)uv[row][1] / height,
+            alpha
+        };
+    }
+};
+
+// Fold-over repair
+//
+// Vertices take their positions from the warped landmarks and their texture coordinates from the
+// source landmarks, so a triangle of the in-face mesh (face_landmarks.hpp) wound differently in
+// the two is drawn inside out and tears the texture. Aggressive warps at steep angles can do
+// this; the check runs over every triangle at once on structure-of-arrays corners. Swaps are not
+// repaired: their output is the partner's shape, and pulling it back toward the face's own
+// landmarks would undo the swap.
+
+// The in-face triangles, padded to a whole number of 4-wide vectors with empty triangles
+const int fold_mesh_size = 108;
+// Twice the smallest source area, in square pixels, of a triangle that can fold. Slivers such as
+// the inner lips of a closed mouth have no winding worth keeping and are left alone.
+const float fold_min_source_area = 8.0f;
+// Twice the area, in square pixels, a triangle must be turned over by to count as folded, so lines
+// that cross by a pixel after rounding are not repaired.
+const float fold_min_inverted_area = 4.0f;
+// Corners of folded triangles are moved halfway back to the source at most this many times.
+const int fold_repair_passes = 6;
+
+struct fold_mesh
+{
+    std::array<int, fold_mesh_size> a, b, c;
+};
+
+fold_mesh make_fold_mesh()
+{
+    fold_mesh mesh;
+    for (int t = 0; t < fold_mesh_size; t++)
+    {
+        bool used = t < (int)triangles.size();
+        mesh.a[t] = used ? triangles[t][0] : 0;
+        mesh.b[t] = used ? triangles[t][1] : 0;
+        mesh.c[t] = used ? triangles[t][2] : 0;
+    }
+    return mesh;
+};
+
+const fold_mesh inface_fold_mesh = make_fold_mesh();
+
+struct fold_corners
+{
+    alignas(16) float ax[fold_mesh_size];
+    alignas(16) float ay[fold_mesh_size];
+    alignas(16) float bx[fold_mesh_size];
+    alignas(16) float by[fold_mesh_size];
+    alignas(16) float cx[fold_mesh_size];
+    alignas(16) float cy[fold_mesh_size];
+};
+
+void gather_fold_corners(const landmarks_2d &points, const point_2d &origin, fold_corners &corners)
+{
+    // Whole pixels, as write_phi_points hands them on, relative to the nose so single precision
+    // holds the areas exactly on large images.
+    float x[68], y[68];
+    for (int row = 0; row < 68; row++)
+    {
+        x[row] = (float)(std::round(points[row][0]) - origin[0]);
+        y[row] = (float)(std::round(points[row][1]) - origin[1]);
+    }
+    const fold_mesh &mesh = inface_fold_mesh;
+    for (int t = 0; t < fold_mesh_size; t++)
+    {
+        corners.ax[t] = x[mesh.a[t]];
+        corners.ay[t] = y[mesh.a[t]];
+        corners.bx[t] = x[mesh.b[t]];
+        corners.by[t] = y[mesh.b[t]];
+        corners.cx[t] = x[mesh.c[t]];
+        corners.cy[t] = y[mesh.c[t]];
+    }
+};
+
+void signed_areas(const fold_corners &corners, float * area)
+{
+    // Twice the signed area of each triangle
+#if defined(__ARM_NEON)
+    for (int t = 0; t < fold_mesh_size; t += 4)
+    {
+        float32x4_t ax = vld1q_f32(corners.ax + t);
+        float32x4_t ay = vld1q_f32(corners.ay + t);
+        float32x4_t abx = vsubq_f32(vld1q_f32(corners.bx + t), ax);
+        float32x4_t aby = vsubq_f32(vld1q_f32(corners.by + t), ay);
+        float32x4_t acx = vsubq_f32(vld1q_f32(corners.cx + t), ax);
+        float32x4_t acy = vsubq_f32(vld1q_f32(corners.cy + t), ay);
+        vst1q_f32(area + t, vsubq_f32(vmulq_f32(abx, acy), vmulq_f32(aby, acx)));
+    }
+#else
+    for (int t = 0; t < fold_mesh_size; t++)
+    {
+        area[t] = (corners.bx[t] - corners.ax[t]) * (corners.cy[t] - corners.ay[t]) - (corners.by[t] - corners.ay[t]) * (corners.cx[t] - corners.ax[t]);
+    }
+#endif
+};
+
+int find_folds(const float * source_area, const float * warped_area, uint32_t * folded)
+{
+    // Folded when the warped area, signed by the source winding, is turned over by more than the
+    // minimum: source * warped < -min_inverted * |source|. Source slivers under the minimum area,
+    // and the empty padding triangles, are never folded.
+#if defined(__ARM_NEON)
+    const float32x4_t min_source = vdupq_n_f32(fold_min_source_area);
+    const float32x4_t min_inverted = vdupq_n_f32(-fold_min_inverted_area);
+    uint32x4_t count = vdupq_n_u32(0);
+    for (int t = 0; t < fold_mesh_size; t += 4)
+    {
+        float32x4_t source = vld1q_f32(source_area + t);
+        float32x4_t warped = vld1q_f32(warped_area + t);
+        float32x4_t source_size = vabsq_f32(source);
+        uint32x4_t mask = vandq_u32(vcgeq_f32(source_size, min_source), vcltq_f32(vmulq_f32(source, warped), vmulq_f32(min_inverted, source_size)));
+        vst1q_u32(folded + t, mask);
+        count = vsubq_u32(count, mask);
+    }
+    uint32x2_t pair = vadd_u32(vget_low_u32(count), vget_high_u32(count));
+    return (int)vget_lane_u32(vpadd_u32(pair, pair), 0);
+#else
+    int count = 0;
+    for (int t = 0; t < fold_mesh_size; t++)
+    {
+        const float source_size = std::abs(source_area[t]);
+        folded[t] = source_size >= fold_min_source_area && source_area[t] * warped_area[t] < -fold_min_inverted_area * source_size ? 0xFFFFFFFFu : 0u;
+        count += folded[t] & 1;
+    }
+    return count;
+#endif
+};
+
+void repair_folds(const landmarks_2d &source, landmarks_2d &warped)
+{
+    const point_2d origin = {std::round(source[30][0]), std::round(source[30][1])};
+    fold_corners corners;
+    alignas(16) float source_area[fold_mesh_size];
+    alignas(16) float warped_area[fold_mesh_size];
+    alignas(16) uint32_t folded[fold_mesh_size];
+    gather_fold_corners(source, origin, corners);
+    signed_areas(corners, source_area);
+    
+    // Each pass halves the distance of every folded triangle's corners from the source, which
+    // turns the triangle back toward the source winding. Only those corners move, so the rest of
+    // the warp is kept even when a fold takes every pass.
+    for (int pass = 0; pass < fold_repair_passes; pass++)
+    {
+        gather_fold_corners(warped, origin, corners);
+        signed_areas(corners, warped_area);
+        int num_folded = find_folds(source_area, warped_area, folded);
+        if (num_folded == 0)
+        {
+            return;
+        }
+        if (pass == 0)
+        {
+            counters.folded_triangles.fetch_add(num_folded, std::memory_order_relaxed);
+        }
+        
+        std::array<bool, 68> offending {};
+        for (int t = 0; t < fold_mesh_size; t++)
+        {
+            if (folded[t])
+            {
+                offending[inface_fold_mesh.a[t]] = true;
+                offending[inface_fold_mesh.b[t]] = true;
+                offending[inface_fold_mesh.c[t]] = true;
+            }
+        }
+        for (int row = 0; row < 68; row++)
+        {
+            if (offending[row])
+            {
+                warped[row][0] = source[row][0] + (warped[row][0] - source[row][0]) * 0.5;
+                warped[row][1] = source[row][1] + (warped[row][1] - source[row][1]) * 0.5;
+            }
+        }
+    }
+};
+
 //warp adjust
 
 
-double check_do_warp(dlib::matrix<double,68,2> landmarks, double nose_side_distance_thresh, double nose_down_distance_thresh){
-    
-    dlib::matrix<double> mean_landmarks = dlib::rowm(landmarks,30);
-    dlib::set_colm(landmarks,0) = colm(landmarks,0) - landmarks(0,0);
-    dlib::set_colm(landmarks,1) = colm(landmarks,1) - landmarks(0,1);
-    
-    double left_nose_dist = std::sqrt(dlib::squared_euclidean_distance()(dlib::rowm(landmarks,31), dlib::rowm(landmarks,33)));
-    double right_nose_dist = std::sqrt(dlib::squared_euclidean_distance()(dlib::rowm(landmarks,35), dlib::rowm(landmarks,33)));
+double check_do_warp(const landmarks_2d &landmarks, double nose_side_distance_thresh, double nose_down_distance_thresh){
     
-    dlib::matrix<double,1,2> nose_dists;
-    nose_dists = left_nose_dist, right_nose_dist;
+    double left_nose_dist = landmark_distance(landmarks, 31, 33);
+    double right_nose_dist = landmark_distance(landmarks, 35, 33);
     
-    double nose_dist_check = std::abs((left_nose_dist - right_nose_dist) / dlib::mean(nose_dists));
+    double nose_dist_check = std::abs((left_nose_dist - right_nose_dist) / (0.5 * (left_nose_dist + right_nose_dist)));
     
-    double height_nose_dist_check = std::sqrt(dlib::squared_euclidean_distance()(dlib::rowm(landmarks,33), dlib::rowm(landmarks,30)) /
-                                              dlib::squared_euclidean_distance()(dlib::rowm(landmarks,29), dlib::rowm(landmarks,30)));
+    double height_nose_dist_check = landmark_distance(landmarks, 33, 30) / landmark_distance(landmarks, 29, 30);
     
-    //Check not gurning:
-    //double inner_lip_distance = std::sqrt(dlib::squared_euclidean_distance()(dlib::rowm(landmarks,62), dlib::rowm(landmarks,66)));
-    double top_lip_distance = std::sqrt(dlib::squared_euclidean_distance()(dlib::rowm(landmarks,62), dlib::rowm(landmarks,51)));
-    double bottom_lip_distance = std::sqrt(dlib::squared_euclidean_distance()(dlib::rowm(landmarks,66), dlib::rowm(landmarks,57)));
-    
-    dlib::matrix<double,1,2> lip_dists;
-    lip_dists = top_lip_distance, bottom_lip_distance;
-    //double outer_lip_distance = dlib::mean(lip_dists);
-    
-    std::vector<double> do_warp = {0.1,0.1};
-    
-    dlib::matrix<double,1,2> mean_tmp;
-    dlib::matrix<double,1,2> mean_tmp2;
+    double do_warp[2] = {0.1, 0.1};
     
     if (height_nose_dist_check > nose_down_distance_thresh){
-        //        mean_tmp = (1.0 - (nose_dist_check / nose_side_distance_thresh)), (nose_down_distance_thresh / height_nose_dist_check);
-        mean_tmp = (1.0 - (nose_dist_check / nose_side_distance_thresh)), 1.0 - (nose_dist_check / nose_side_distance_thresh);
-        do_warp[0] = std::min(do_warp[0] + dlib::mean(mean_tmp), 1.0);
+        double side_term = 1.0 - (nose_dist_check / nose_side_distance_thresh);
+        do_warp[0] = std::min(do_warp[0] + side_term, 1.0);
         do_warp[1] = do_warp[0];
     };
     
     if ((nose_dist_check < nose_side_distance_thresh) && (height_nose_dist_check > nose_down_distance_thresh)){
-        mean_tmp = (1.0 - (nose_dist_check / nose_side_distance_thresh)), (nose_down_distance_thresh / height_nose_dist_check);
-        //        mean_tmp = (1.0 - (nose_dist_check / nose_side_distance_thresh)), 1.0 - (nose_dist_check / nose_side_distance_thresh);
-        do_warp[0] = std::min(do_warp[0] + mean_tmp(0,0), 1.0);
-        do_warp[1] = std::min(do_warp[1] + mean_tmp(0,1), 1.0);
+        do_warp[0] = std::min(do_warp[0] + (1.0 - (nose_dist_check / nose_side_distance_thresh)), 1.0);
+        do_warp[1] = std::min(do_warp[1] + (nose_down_distance_thresh / height_nose_dist_check), 1.0);
     };
     
-    
-    //    if ((nose_dist_check < nose_side_distance_thresh) && (height_nose_dist_check > nose_down_distance_thresh)){
-    //        mean_tmp2 = (1.0 - (nose_dist_check / nose_side_distance_thresh)), (nose_down_distance_thresh / height_nose_dist_check);
-    //        do_warp[1] = std::min(do_warp[1] + dlib::mean(mean_tmp2), 1.0);
-    //    };
-    
     return ((do_warp[0] + do_warp[1]) / 2.0);
 };
 
 
-double smoothed_reg = 1;
-dlib::matrix<double,68,2> adjust_warp_for_angle(dlib::matrix<double,68,2> &landmarks, dlib::matrix<double,68,2> &landmarks_new, double & factr)
+void adjust_warp_for_angle(const landmarks_2d &landmarks, landmarks_2d &landmarks_new, double & smoothed_reg, double & factr)
 {
     double nose_side_distance_thresh = 1.0;
     double nose_down_distance_thresh = 0.0;
@@ -374,71 +690,63 @@ dlib::matrix<double,68,2> adjust_warp_for_angle(dlib::matrix<double,68,2> &landm
     
     smoothed_reg = 0.9 * smoothed_reg + 0.1 * regression_factor;
     double squashed_regression_factor = std::min(std::max((smoothed_reg - 0.5)/0.4, 0.0), 1.0);
-    //    double squashed_regression_factor_mouth = std::min(std::max((smoothed_reg - 0.5)/0.35, 0.0), 1.0);
     factr = smoothed_reg;
-    dlib::matrix<double> diff = landmarks_new - landmarks;
-    dlib::matrix<double> adjusted_lm = (landmarks + diff * squashed_regression_factor);
-    //    for (const int idx : total_mouth) {
-    //        adjusted_lm(idx, 0) = landmarks(idx, 0) + diff(idx, 0) * squashed_regression_factor_mouth;
-    //        adjusted_lm(idx, 1) = landmarks(idx, 1) + diff(idx, 1) * squashed_regression_factor_mouth;
-    //    }
-    return adjusted_lm;
+    for (int row = 0; row < 68; row++)
+    {
+        landmarks_new[row][0] = landmarks[row][0] + (landmarks_new[row][0] - landmarks[row][0]) * squashed_regression_factor;
+        landmarks_new[row][1] = landmarks[row][1] + (landmarks_new[row][1] - landmarks[row][1]) * squashed_regression_factor;
+    }
 };
 
+void prepare_landmarks(const int * landmarks_ptr, landmarks_2d &landmarks, landmarks_2d &centered_landmarks)
+{
+    load_landmarks(landmarks_ptr, landmarks);
+    centered_landmarks = landmarks;
+    center_landmarks(centered_landmarks, landmarks[30]);
+};
 
 PhiPoint * return_3d_adjusted_warp(int * landmarks_ptr, int * face_flat_warp_ptr, double * parameters)
 {
     // CALLER MUST FREE MEMORY ON RETURN.
-    dlib::matrix<int, 68, 2> landmarks_i = dlib::mat(landmarks_ptr, 68, 2);
-    dlib::matrix<double, 68, 2> landmarks = dlib::matrix_cast<double>(landmarks_i);
-    
-    dlib::matrix<int, 68, 2> face_flat_warp_i = dlib::mat(face_flat_warp_ptr, 68, 2);
-    dlib::matrix<double, 68, 2> face_flat_warp = dlib::matrix_cast<double>(face_flat_warp_i);
-    
-    dlib::matrix<double> mean_landmarks = dlib::rowm(landmarks,30);
-    dlib::matrix<double> centered_landmarks = landmarks;
-    dlib::set_colm(centered_landmarks,0) = colm(centered_landmarks,0) - mean_landmarks(0,0);
-    dlib::set_colm(centered_landmarks,1) = colm(centered_landmarks,1) - mean_landmarks(0,1);
-    
-    double *dlib_3d = landmarks3d_dlib;
-    dlib::matrix<double,68,3> landmarks3d = dlib::mat(dlib_3d, 68, 3);
-    dlib::matrix<double> mean_landmarks3d = dlib::rowm(landmarks3d,30);
-    dlib::matrix<double> centered_landmarks3d = landmarks3d;
-    dlib::set_colm(centered_landmarks3d,0) = colm(centered_landmarks3d,0) - mean_landmarks3d(0,0);
-    dlib::set_colm(centered_landmarks3d,1) = colm(centered_landmarks3d,1) - mean_landmarks3d(0,1);
-    dlib::set_colm(centered_landmarks3d,2) = colm(centered_landmarks3d,2) - mean_landmarks3d(0,2);
+    const face_template &tpl = face_template_dlib;
+    landmarks_2d landmarks, centered_landmarks;
+    prepare_landmarks(landmarks_ptr, landmarks, centered_landmarks);
     
-    dlib::matrix<double> mean_face_flat = dlib::rowm(face_flat_warp,30);
-    dlib::matrix<double> centered_face_flat_warp = face_flat_warp;
-    dlib::set_colm(centered_face_flat_warp,0) = colm(face_flat_warp,0) - mean_face_flat(0,0);
-    dlib::set_colm(centered_face_flat_warp,1) = colm(face_flat_warp,1) - mean_face_flat(0,1);
+    landmarks_2d face_flat_warp;
+    load_landmarks(face_flat_warp_ptr, face_flat_warp);
+    center_landmarks(face_flat_warp, face_flat_warp[30]);
     
-    double stdev_landmarks3d[2];
-    stdev_landmarks3d[0] = dlib::stddev(dlib::colm(centered_landmarks3d,0));
-    stdev_landmarks3d[1] = dlib::stddev(dlib::colm(centered_landmarks3d,1));
-    
-    double stdev_face_flat_warp[2];
-    stdev_face_flat_warp[0] = dlib::stddev(dlib::colm(centered_face_flat_warp,0));
-    stdev_face_flat_warp[1] = dlib::stddev(dlib::colm(centered_face_flat_warp,1));
+    landmarks_3d centered_face_flat_warp;
+    for (int row = 0; row < 68; row++)
+    {
+        centered_face_flat_warp[row][0] = face_flat_warp[row][0];
+        centered_face_flat_warp[row][1] = face_flat_warp[row][1];
+        centered_face_flat_warp[row][2] = 0.0;
+    }
     
-    dlib::set_colm(centered_landmarks3d,0) = dlib::colm(centered_face_flat_warp,0) * ((double)stdev_landmarks3d[0] / (double)stdev_face_flat_warp[0]);
-    dlib::set_colm(centered_landmarks3d,1) = dlib::colm(centered_face_flat_warp,1) * ((double)stdev_landmarks3d[1] / (double)stdev_face_flat_warp[1]);
+    // Replace the template's x,y with the flat warp, rescaled to the template's spread.
+    landmarks_3d centered_landmarks3d = tpl.centered;
+    for (int col = 0; col < 2; col++)
+    {
+        double scale = tpl.stddev[col] / column_stddev(centered_face_flat_warp, col);
+        for (int row = 0; row < 68; row++)
+        {
+            centered_landmarks3d[row][col] = centered_face_flat_warp[row][col] * scale;
+        }
+    }
     
-    dlib::matrix<double> rotation_matrix = find_overall_rotation_matrix(centered_landmarks, centered_landmarks3d, parameters);
+    rotation_3d rotation_matrix = find_overall_rotation_matrix(centered_landmarks, centered_landmarks3d, parameters);
     
-    dlib::matrix<double,68,3> new_warp = centered_landmarks3d * rotation_matrix;
-    dlib::matrix<double,68,2> new_warp_de_centered = dlib::subm(new_warp,dlib::range(0,67),dlib::range(0,1));
-    dlib::set_colm(new_warp_de_centered,0) = colm(new_warp_de_centered,0) + mean_landmarks(0,0);
-    dlib::set_colm(new_warp_de_centered,1) = colm(new_warp_de_centered,1) + mean_landmarks(0,1);
+    landmarks_2d new_warp_de_centered;
+    reproject_landmarks(centered_landmarks3d, rotation_matrix, landmarks[30], new_warp_de_centered);
     
-    PhiPoint * output = (PhiPoint *)malloc(new_warp_de_centered.nr()*sizeof(PhiPoint));
-    for (int row = 0; row < new_warp_de_centered.nr(); row++)
+    PhiPoint * output = (PhiPoint *)malloc(68*sizeof(PhiPoint));
+    for (int row = 0; row < 68; row++)
     {
         output[row] = PhiPoint{
-            static_cast<int>(std::lround(new_warp_de_centered(row,0))),
-            static_cast<int>(std::lround(new_warp_de_centered(row,1)))
+            static_cast<int>(std::lround(new_warp_de_centered[row][0])),
+            static_cast<int>(std::lround(new_warp_de_centered[row][1]))
         };
-        
     };
     return output;
 };
@@ -455,2204 +763,830 @@ int index_of_nearest_value(double val, dlib::matrix<double> row_matrix){
     }
     return idx;
 };
+
+// Warp engine
 //
-PhiPoint * return_3d_golden_total_face_warp_pretty(int * landmarks_ptr, double * parameters, double * factr)
+// Every effect shares the same pipeline: centre on the nose, solve the pose against a template,
+// frontalise, move landmarks about in the frontal frame and reproject. The engine solves each
+// face's pose once and caches it, and effects are plain data applied to the cached frontal
+// landmarks in a single pass, so switching or stacking effects within a frame costs no extra solves.
+
+struct face_pose
 {
-    // CALLER MUST FREE MEMORY ON RETURN.
-    const double eye_scaling = 1;
-    
-    dlib::matrix<int, 68, 2> landmarks_i = dlib::mat(landmarks_ptr, 68, 2);
-    //    std::cout << landmarks_i << std::endl;
-    dlib::matrix<double, 68, 2> landmarks = dlib::matrix_cast<double>(landmarks_i);
-    //    std::cout << landmarks << std::endl;
-    
-    dlib::matrix<double> mean_landmarks = dlib::rowm(landmarks,30);
-    dlib::matrix<double> centered_landmarks = landmarks;
-    dlib::set_colm(centered_landmarks,0) = colm(centered_landmarks,0) - mean_landmarks(0,0);
-    dlib::set_colm(centered_landmarks,1) = colm(centered_landmarks,1) - mean_landmarks(0,1);
-    
-    //    double *dlib_3d = landmarks3d_dlib;
-    double *dlib_3d = landmarks3d_female;
-    
-    dlib::matrix<double,68,3> landmarks3d = dlib::mat(dlib_3d, 68, 3);
-    dlib::matrix<double> mean_landmarks3d = dlib::rowm(landmarks3d,30);
-    dlib::matrix<double> centered_landmarks3d = landmarks3d;
-    dlib::set_colm(centered_landmarks3d,0) = colm(centered_landmarks3d,0) - mean_landmarks3d(0,0);
-    dlib::set_colm(centered_landmarks3d,1) = colm(centered_landmarks3d,1) - mean_landmarks3d(0,1);
-    dlib::set_colm(centered_landmarks3d,2) = colm(centered_landmarks3d,2) - mean_landmarks3d(0,2);
-    
-    dlib::matrix<double> rotation_matrix = find_overall_rotation_matrix(centered_landmarks, centered_landmarks3d, parameters);
-    
-    dlib::matrix<double,68,3> flattened_2d_landmarks_full = centered_landmarks3d * rotation_matrix;
-    dlib::set_subm(flattened_2d_landmarks_full, dlib::range(0,67), dlib::range(0,1)) = centered_landmarks;
-    dlib::matrix<double,68,3> flattened_2d_landmarks_full_rotated = flattened_2d_landmarks_full * dlib::inv(rotation_matrix);
+    const face_template * tpl;
+    landmarks_2d landmarks;
+    landmarks_2d centered_landmarks;
+    rotation_3d rotation_matrix;
+    landmarks_3d frontal;
+    // Centroid of the landmarks in the frontal frame, the pivot for whole-face scaling.
+    std::array<double, 3> frontal_centroid;
+    // Solved [roll, cholesky] parameters, handed back to the caller on a cache hit.
+    double parameters[7];
+};
+
+// Pivots for region_scale other than a landmark index
+const int pivot_region_mean = -1;
+const int pivot_face_centroid = -2;
+
+struct region_scale
+{
+    const std::vector<int> * region;
+    int pivot;
+    double scale_x;
+    double scale_y;
+    double scale_z;
+};
+
+const int max_region_scales = 8;
+
+struct warp_effect
+{
+    int num_scales;
+    region_scale scales[max_region_scales];
+    // Landmarks that take the template's x,y outright, applied after scaling. May be null.
+    const std::vector<int> * exchange_list;
+};
+
+void frontalise_face_pose(face_pose &pose)
+{
+    frontalise_landmarks(pose.centered_landmarks, pose.tpl->centered, pose.rotation_matrix, pose.frontal);
     
-    dlib::matrix<long> dlib_leye_range(1,leye_dlib.size());
-    for (int i = 0; i < leye_dlib.size(); i++ )
+    point_2d centroid = column_means(pose.centered_landmarks);
+    rotation_3d inverse_rotation = dlib::inv(pose.rotation_matrix);
+    for (int col = 0; col < 3; col++)
     {
-        dlib_leye_range(0,i) = (long)leye_dlib[i];
+        pose.frontal_centroid[col] = centroid[0] * inverse_rotation(0,col) + centroid[1] * inverse_rotation(1,col);
     }
-    dlib::matrix<double> dlib_leye = dlib::subm(flattened_2d_landmarks_full_rotated, dlib_leye_range, dlib::range(0,2));
+};
+
+void solve_face_pose(const landmarks_2d &landmarks, const face_template &tpl, double * parameters, face_pose &pose, bool robust_roll = false)
+{
+    pose.tpl = &tpl;
+    pose.landmarks = landmarks;
+    pose.centered_landmarks = landmarks;
+    center_landmarks(pose.centered_landmarks, landmarks[30]);
     
-    double dlib_leye_mean[2];
-    dlib_leye_mean[0] = dlib::mean(dlib::colm(dlib_leye,0));
-    dlib_leye_mean[1] = dlib::mean(dlib::colm(dlib_leye,1));
+    pose.rotation_matrix = find_overall_rotation_matrix(pose.centered_landmarks, tpl.centered, parameters, robust_roll);
+    std::copy(parameters, parameters + 7, pose.parameters);
     
-    dlib::set_colm(dlib_leye,0) = ((dlib::colm(dlib_leye,0) - dlib_leye_mean[0]) * eye_scaling) + dlib_leye_mean[0];
-    dlib::set_colm(dlib_leye,1) = ((dlib::colm(dlib_leye,1) - dlib_leye_mean[1]) * eye_scaling) + dlib_leye_mean[1];
+    frontalise_face_pose(pose);
+};
+
+void refit_face_pose(const landmarks_2d &landmarks, double * parameters, face_pose &pose, bool robust_roll = false)
+{
+    // Keeps the solved 3D rotation and only re-estimates the roll, which is analytic, so a face
+    // that barely moved skips the BFGS search but still follows the new landmarks exactly.
+    pose.landmarks = landmarks;
+    pose.centered_landmarks = landmarks;
+    center_landmarks(pose.centered_landmarks, landmarks[30]);
+    
+    rotation_3d rotation_matrix_2d_inv = find_2d_rotation_matrix(pose.centered_landmarks, pose.parameters, robust_roll);
+    cholesky_vector vector;
+    for (int i = 0; i < 6; ++i) {
+        vector(i) = pose.parameters[i + 1];
+    }
+    pose.rotation_matrix = return_rotation_matrix_from_flat_vector(vector) * rotation_matrix_2d_inv;
+    std::copy(pose.parameters, pose.parameters + 7, parameters);
     
-    dlib::matrix<long> dlib_reye_range(1,reye_dlib.size());
-    for (int i = 0; i < reye_dlib.size(); i++ )
+    frontalise_face_pose(pose);
+};
+
+double aligned_rms_distance(const landmarks_2d &reference, const landmarks_2d &landmarks)
+{
+    // RMS residual left after the best similarity transform (translation, rotation and scale)
+    // of reference onto landmarks. In closed form: |b|^2 - |sum conj(a) b|^2 / |a|^2.
+    point_2d reference_mean = column_means(reference);
+    point_2d mean = column_means(landmarks);
+    double reference_norm = 0.0;
+    double norm = 0.0;
+    double dot = 0.0;
+    double cross = 0.0;
+    for (int row = 0; row < 68; row++)
+    {
+        double ax = reference[row][0] - reference_mean[0];
+        double ay = reference[row][1] - reference_mean[1];
+        double bx = landmarks[row][0] - mean[0];
+        double by = landmarks[row][1] - mean[1];
+        reference_norm += ax * ax + ay * ay;
+        norm += bx * bx + by * by;
+        dot += ax * bx + ay * by;
+        cross += ax * by - ay * bx;
+    }
+    
+    double residual = norm;
+    if (reference_norm > 0.0)
+    {
+        residual -= (dot * dot + cross * cross) / reference_norm;
+    }
+    return std::sqrt(std::max(residual, 0.0) / 68.0);
+};
+
+void apply_region_scale(landmarks_3d &frontal, const region_scale &scale, const std::array<double, 3> &face_centroid)
+{
+    std::array<double, 3> pivot = {{0.0, 0.0, 0.0}};
+    if (scale.pivot == pivot_region_mean)
+    {
+        for (const int idx : *scale.region)
+        {
+            for (int col = 0; col < 3; col++)
+            {
+                pivot[col] += frontal[idx][col];
+            }
+        }
+        for (int col = 0; col < 3; col++)
+        {
+            pivot[col] /= (double)scale.region->size();
+        }
+    }
+    else if (scale.pivot == pivot_face_centroid)
     {
-        dlib_reye_range(0,i) = (long)reye_dlib[i];
+        pivot = face_centroid;
     }
-    dlib::matrix<double> dlib_reye = dlib::subm(flattened_2d_landmarks_full_rotated, dlib_reye_range, dlib::range(0,2));
-    
-    double dlib_reye_mean[2];
-    dlib_reye_mean[0] = dlib::mean(dlib::colm(dlib_reye,0));
-    dlib_reye_mean[1] = dlib::mean(dlib::colm(dlib_reye,1));
-    
-    dlib::set_colm(dlib_reye,0) = ((dlib::colm(dlib_reye,0) - dlib_reye_mean[0]) * eye_scaling) + dlib_reye_mean[0];
-    dlib::set_colm(dlib_reye,1) = ((dlib::colm(dlib_reye,1) - dlib_reye_mean[1]) * eye_scaling) + dlib_reye_mean[1];
-    
-    dlib::set_subm(flattened_2d_landmarks_full_rotated, dlib_leye_range, dlib::range(0,2)) = dlib_leye;
-    dlib::set_subm(flattened_2d_landmarks_full_rotated, dlib_reye_range, dlib::range(0,2)) = dlib_reye;
-    
-    
-    dlib::matrix<long> switch_list(1,exchange_list_nose_chin_warp.size());
-    for (int i = 0; i < exchange_list_nose_chin_warp.size(); i++ )
+    else
     {
-        switch_list(0,i) = (long)exchange_list_nose_chin_warp[i];
+        pivot = frontal[scale.pivot];
     }
     
-    
-    dlib::set_subm(flattened_2d_landmarks_full_rotated, switch_list, dlib::range(0,1)) = dlib::subm(centered_landmarks3d, switch_list, dlib::range(0,1));
-    
-    dlib::matrix<double, 68,2> _2d_landmarks_full;
-    _2d_landmarks_full = dlib::subm(flattened_2d_landmarks_full_rotated * rotation_matrix, dlib::range(0,67), dlib::range(0,1));
-    
-    
-    dlib::set_colm(_2d_landmarks_full,0) = colm(_2d_landmarks_full,0) + mean_landmarks(0,0);
-    dlib::set_colm(_2d_landmarks_full,1) = colm(_2d_landmarks_full,1) + mean_landmarks(0,1);
-    
-    _2d_landmarks_full = adjust_warp_for_angle(landmarks, _2d_landmarks_full, *factr);
-    
-    PhiPoint * output = (PhiPoint *)malloc(_2d_landmarks_full.nr()*sizeof(PhiPoint));
-    for (int row = 0; row < _2d_landmarks_full.nr(); row++)
+    const double scaling[3] = {scale.scale_x, scale.scale_y, scale.scale_z};
+    for (const int idx : *scale.region)
     {
-        output[row] = PhiPoint{
-            static_cast<int>(std::round(_2d_landmarks_full(row,0))),
-            static_cast<int>(std::round(_2d_landmarks_full(row,1)))
-        };
-        
+        for (int col = 0; col < 3; col++)
+        {
+            frontal[idx][col] = ((frontal[idx][col] - pivot[col]) * scaling[col]) + pivot[col];
+        }
     }
-    
-    return output;
 };
 
-PhiPoint * return_3d_golden_total_face_warp_handsome(int * landmarks_ptr, double * parameters, double * factr)
+void apply_warp_effects(const face_pose &pose, const warp_effect * effects, int num_effects, landmarks_2d &warped)
 {
-    // CALLER MUST FREE MEMORY ON RETURN.
-    const double eye_scaling = 1.00;
-    
-    dlib::matrix<int, 68, 2> landmarks_i = dlib::mat(landmarks_ptr, 68, 2);
-    //    std::cout << landmarks_i << std::endl;
-    dlib::matrix<double, 68, 2> landmarks = dlib::matrix_cast<double>(landmarks_i);
-    //    std::cout << landmarks << std::endl;
-    
-    dlib::matrix<double> mean_landmarks = dlib::rowm(landmarks,30);
-    dlib::matrix<double> centered_landmarks = landmarks;
-    dlib::set_colm(centered_landmarks,0) = colm(centered_landmarks,0) - mean_landmarks(0,0);
-    dlib::set_colm(centered_landmarks,1) = colm(centered_landmarks,1) - mean_landmarks(0,1);
-    
-    //    double *dlib_3d = landmarks3d_dlib;
-    double *dlib_3d = landmarks3d_male;
-    
-    dlib::matrix<double,68,3> landmarks3d = dlib::mat(dlib_3d, 68, 3);
-    dlib::matrix<double> mean_landmarks3d = dlib::rowm(landmarks3d,30);
-    dlib::matrix<double> centered_landmarks3d = landmarks3d;
-    dlib::set_colm(centered_landmarks3d,0) = colm(centered_landmarks3d,0) - mean_landmarks3d(0,0);
-    dlib::set_colm(centered_landmarks3d,1) = colm(centered_landmarks3d,1) - mean_landmarks3d(0,1);
-    dlib::set_colm(centered_landmarks3d,2) = colm(centered_landmarks3d,2) - mean_landmarks3d(0,2);
-    
-    dlib::matrix<double> rotation_matrix = find_overall_rotation_matrix(centered_landmarks, centered_landmarks3d, parameters);
-    
-    dlib::matrix<double,68,3> flattened_2d_landmarks_full = centered_landmarks3d * rotation_matrix;
-    dlib::set_subm(flattened_2d_landmarks_full, dlib::range(0,67), dlib::range(0,1)) = centered_landmarks;
-    dlib::matrix<double,68,3> flattened_2d_landmarks_full_rotated = flattened_2d_landmarks_full * dlib::inv(rotation_matrix);
-    
-    dlib::matrix<long> dlib_leye_range(1,leye_dlib.size());
-    for (int i = 0; i < leye_dlib.size(); i++ )
+    landmarks_3d frontal = pose.frontal;
+    for (int i = 0; i < num_effects; i++)
     {
-        dlib_leye_range(0,i) = (long)leye_dlib[i];
+        const warp_effect &effect = effects[i];
+        for (int j = 0; j < effect.num_scales; j++)
+        {
+            apply_region_scale(frontal, effect.scales[j], pose.frontal_centroid);
+        }
+        if (effect.exchange_list != nullptr)
+        {
+            for (const int idx : *effect.exchange_list)
+            {
+                frontal[idx][0] = pose.tpl->centered[idx][0];
+                frontal[idx][1] = pose.tpl->centered[idx][1];
+            }
+        }
     }
-    dlib::matrix<double> dlib_leye = dlib::subm(flattened_2d_landmarks_full_rotated, dlib_leye_range, dlib::range(0,2));
-    
-    double dlib_leye_mean[2];
-    dlib_leye_mean[0] = dlib::mean(dlib::colm(dlib_leye,0));
-    dlib_leye_mean[1] = dlib::mean(dlib::colm(dlib_leye,1));
-    
-    dlib::set_colm(dlib_leye,0) = ((dlib::colm(dlib_leye,0) - dlib_leye_mean[0]) * eye_scaling) + dlib_leye_mean[0];
-    dlib::set_colm(dlib_leye,1) = ((dlib::colm(dlib_leye,1) - dlib_leye_mean[1]) * eye_scaling) + dlib_leye_mean[1];
-    
-    dlib::matrix<long> dlib_reye_range(1,reye_dlib.size());
-    for (int i = 0; i < reye_dlib.size(); i++ )
-    {
-        dlib_reye_range(0,i) = (long)reye_dlib[i];
-    }
-    dlib::matrix<double> dlib_reye = dlib::subm(flattened_2d_landmarks_full_rotated, dlib_reye_range, dlib::range(0,2));
-    
-    double dlib_reye_mean[2];
-    dlib_reye_mean[0] = dlib::mean(dlib::colm(dlib_reye,0));
-    dlib_reye_mean[1] = dlib::mean(dlib::colm(dlib_reye,1));
-    
-    dlib::set_colm(dlib_reye,0) = ((dlib::colm(dlib_reye,0) - dlib_reye_mean[0]) * eye_scaling) + dlib_reye_mean[0];
-    dlib::set_colm(dlib_reye,1) = ((dlib::colm(dlib_reye,1) - dlib_reye_mean[1]) * eye_scaling) + dlib_reye_mean[1];
-    
-    dlib::set_subm(flattened_2d_landmarks_full_rotated, dlib_leye_range, dlib::range(0,2)) = dlib_leye;
-    dlib::set_subm(flattened_2d_landmarks_full_rotated, dlib_reye_range, dlib::range(0,2)) = dlib_reye;
-    
-    
-    dlib::matrix<long> switch_list(1,exchange_list_nose_chin_warp.size());
-    for (int i = 0; i < exchange_list_nose_chin_warp.size(); i++ )
-    {
-        switch_list(0,i) = (long)exchange_list_nose_chin_warp[i];
-    }
-    
-    
-    dlib::set_subm(flattened_2d_landmarks_full_rotated, switch_list, dlib::range(0,1)) = dlib::subm(centered_landmarks3d, switch_list, dlib::range(0,1));
-    
-    dlib::matrix<double, 68,2> _2d_landmarks_full;
-    _2d_landmarks_full = dlib::subm(flattened_2d_landmarks_full_rotated * rotation_matrix, dlib::range(0,67), dlib::range(0,1));
-    
-    
-    dlib::set_colm(_2d_landmarks_full,0) = colm(_2d_landmarks_full,0) + mean_landmarks(0,0);
-    dlib::set_colm(_2d_landmarks_full,1) = colm(_2d_landmarks_full,1) + mean_landmarks(0,1);
-    
-    _2d_landmarks_full = adjust_warp_for_angle(landmarks, _2d_landmarks_full, *factr);
-    
-    PhiPoint * output = (PhiPoint *)malloc(_2d_landmarks_full.nr()*sizeof(PhiPoint));
-    for (int row = 0; row < _2d_landmarks_full.nr(); row++)
-    {
-        output[row] = PhiPoint{
-            static_cast<int>(std::round(_2d_landmarks_full(row,0))),
-            static_cast<int>(std::round(_2d_landmarks_full(row,1)))
-        };
-        
-    }
-    
-    
-    //    exit(1);
-    return output;
-};
-//
-PhiPoint * return_3d_golden_inner_face_warp_pretty(int * landmarks_ptr, double * parameters, double * factr)
-{
-    // CALLER MUST FREE MEMORY ON RETURN.
-    //const double eye_scaling = 1.00;
-    
-    dlib::matrix<int, 68, 2> landmarks_i = dlib::mat(landmarks_ptr, 68, 2);
-    //    std::cout << landmarks_i << std::endl;
-    dlib::matrix<double, 68, 2> landmarks = dlib::matrix_cast<double>(landmarks_i);
-    //    std::cout << landmarks << std::endl;
-    
-    dlib::matrix<double> mean_landmarks = dlib::rowm(landmarks,30);
-    dlib::matrix<double> centered_landmarks = landmarks;
-    dlib::set_colm(centered_landmarks,0) = colm(centered_landmarks,0) - mean_landmarks(0,0);
-    dlib::set_colm(centered_landmarks,1) = colm(centered_landmarks,1) - mean_landmarks(0,1);
-    
-    //    double *dlib_3d = landmarks3d_dlib;
-    double *dlib_3d = landmarks3d_female;
-    
-    dlib::matrix<double,68,3> landmarks3d = dlib::mat(dlib_3d, 68, 3);
-    dlib::matrix<double> mean_landmarks3d = dlib::rowm(landmarks3d,30);
-    dlib::matrix<double> centered_landmarks3d = landmarks3d;
-    dlib::set_colm(centered_landmarks3d,0) = colm(centered_landmarks3d,0) - mean_landmarks3d(0,0);
-    dlib::set_colm(centered_landmarks3d,1) = colm(centered_landmarks3d,1) - mean_landmarks3d(0,1);
-    dlib::set_colm(centered_landmarks3d,2) = colm(centered_landmarks3d,2) - mean_landmarks3d(0,2);
-    
-    dlib::matrix<double> rotation_matrix = find_overall_rotation_matrix(centered_landmarks, centered_landmarks3d, parameters);
-    
-    dlib::matrix<double,68,3> flattened_2d_landmarks_full = centered_landmarks3d * rotation_matrix;
-    dlib::set_subm(flattened_2d_landmarks_full, dlib::range(0,67), dlib::range(0,1)) = centered_landmarks;
-    dlib::matrix<double,68,3> flattened_2d_landmarks_full_rotated = flattened_2d_landmarks_full * dlib::inv(rotation_matrix);
-    
-    // Calculate scaling factors for warp
-    
-    // left eye, horizontal
-    double ideal_eyedist_lh = std::sqrt(std::pow(centered_landmarks3d(36, 0) - centered_landmarks3d(39, 0), 2.0) +  std::pow(centered_landmarks3d(36, 1) - centered_landmarks3d(39, 1), 2.0));
-    double user_eyedist_lh = std::sqrt(std::pow(flattened_2d_landmarks_full_rotated(36, 0) - flattened_2d_landmarks_full_rotated(39, 0), 2) +
-                                       std::pow(flattened_2d_landmarks_full_rotated(36, 1) - flattened_2d_landmarks_full_rotated(39, 1), 2));
-    double leye_hscale = ideal_eyedist_lh / user_eyedist_lh;
-    
-    // left eye, vertical
-    double ideal_eyedist_lv1 = std::sqrt(std::pow(centered_landmarks3d(37, 0) - centered_landmarks3d(41, 0), 2.0) +  std::pow(centered_landmarks3d(37, 1) - centered_landmarks3d(41, 1), 2.0));
-    double user_eyedist_lv1 = std::sqrt(std::pow(flattened_2d_landmarks_full_rotated(37, 0) - flattened_2d_landmarks_full_rotated(41, 0), 2) +
-                                        std::pow(flattened_2d_landmarks_full_rotated(37, 1) - flattened_2d_landmarks_full_rotated(41, 1), 2));
-    
-    double ideal_eyedist_lv2 = std::sqrt(std::pow(centered_landmarks3d(38, 0) - centered_landmarks3d(40, 0), 2.0) +  std::pow(centered_landmarks3d(38, 1) - centered_landmarks3d(40, 1), 2.0));
-    double user_eyedist_lv2 = std::sqrt(std::pow(flattened_2d_landmarks_full_rotated(38, 0) - flattened_2d_landmarks_full_rotated(40, 0), 2) +
-                                        std::pow(flattened_2d_landmarks_full_rotated(38, 1) - flattened_2d_landmarks_full_rotated(40, 1), 2));
-    double leye_vscale = 0.5 * (ideal_eyedist_lv1 / user_eyedist_lv1) + 0.5 * (ideal_eyedist_lv2 / user_eyedist_lv2);
-    
-    // right eye, horizontal
-    double ideal_eyedist_rh = std::sqrt(std::pow(centered_landmarks3d(42, 0) - centered_landmarks3d(45, 0), 2.0) +  std::pow(centered_landmarks3d(42, 1) - centered_landmarks3d(45, 1), 2.0));
-    double user_eyedist_rh = std::sqrt(std::pow(flattened_2d_landmarks_full_rotated(42, 0) - flattened_2d_landmarks_full_rotated(45, 0), 2.0) +
-                                       std::pow(flattened_2d_landmarks_full_rotated(42, 1) - flattened_2d_landmarks_full_rotated(45, 1), 2.0));
-    double reye_hscale = ideal_eyedist_rh / user_eyedist_rh;
-    
-    // right eye, vertical
-    double ideal_eyedist_rv1 = std::sqrt(std::pow(centered_landmarks3d(43, 0) - centered_landmarks3d(47, 0), 2.0) +  std::pow(centered_landmarks3d(43, 1) - centered_landmarks3d(47, 1), 2.0));
-    double user_eyedist_rv1 = std::sqrt(std::pow(flattened_2d_landmarks_full_rotated(43, 0) - flattened_2d_landmarks_full_rotated(47, 0), 2) +
-                                        std::pow(flattened_2d_landmarks_full_rotated(43, 1) - flattened_2d_landmarks_full_rotated(47, 1), 2));
-    
-    double ideal_eyedist_rv2 = std::sqrt(std::pow(centered_landmarks3d(44, 0) - centered_landmarks3d(46, 0), 2.0) +  std::pow(centered_landmarks3d(44, 1) - centered_landmarks3d(46, 1), 2.0));
-    double user_eyedist_rv2 = std::sqrt(std::pow(flattened_2d_landmarks_full_rotated(44, 0) - flattened_2d_landmarks_full_rotated(46, 0), 2) +
-                                        std::pow(flattened_2d_landmarks_full_rotated(44, 1) - flattened_2d_landmarks_full_rotated(46, 1), 2));
-    double reye_vscale = 0.5 * (ideal_eyedist_rv1 / user_eyedist_rv1) + 0.5 * (ideal_eyedist_rv2 / user_eyedist_rv2);
-    
-    double eye_vscale = 0.5 * leye_vscale + 0.5 * reye_vscale;
-    double eye_hscale = 0.5 * leye_hscale + 0.5 * reye_hscale;
-    
-    //    std::cout << "Eyes " << eye_hscale << ", " << eye_vscale << std::endl;
-    
-    // nose hscale
-    double ideal_nosedist_h1 = std::sqrt(std::pow(centered_landmarks3d(31, 0) - centered_landmarks3d(35, 0), 2.0) +  std::pow(centered_landmarks3d(31, 1) - centered_landmarks3d(35, 1), 2.0));
-    double user_nosedist_h1 = std::sqrt(std::pow(flattened_2d_landmarks_full_rotated(31, 0) - flattened_2d_landmarks_full_rotated(35, 0), 2) +
-                                        std::pow(flattened_2d_landmarks_full_rotated(31, 1) - flattened_2d_landmarks_full_rotated(35, 1), 2));
-    
-    double nose_hscale1 = ideal_nosedist_h1 / user_nosedist_h1;
-    
-//    double ideal_nosedist_h2 = std::sqrt(std::pow(centered_landmarks3d(32, 0) - centered_landmarks3d(34, 0), 2.0) +  std::pow(centered_landmarks3d(32, 1) - centered_landmarks3d(34, 1), 2.0));
-//    double user_nosedist_h2 = std::sqrt(std::pow(flattened_2d_landmarks_full_rotated(32, 0) - flattened_2d_landmarks_full_rotated(34, 0), 2) +
-//                                        std::pow(flattened_2d_landmarks_full_rotated(32, 1) - flattened_2d_landmarks_full_rotated(34, 1), 2));
-    
-    //double nose_hscale2 = ideal_nosedist_h2 / user_nosedist_h2;
-    
-    double nose_hscale = nose_hscale1; // 0.7 for the wider .: more accurate value, 0.3 of the other
-    
-    // nose vscale
-    double ideal_nosedist_v = std::sqrt(std::pow(centered_landmarks3d(27, 0) - centered_landmarks3d(33, 0), 2.0) +  std::pow(centered_landmarks3d(27, 1) - centered_landmarks3d(33, 1), 2.0));
-    double user_nosedist_v = std::sqrt(std::pow(flattened_2d_landmarks_full_rotated(27, 0) - flattened_2d_landmarks_full_rotated(33, 0), 2) +
-                                       std::pow(flattened_2d_landmarks_full_rotated(27, 1) - flattened_2d_landmarks_full_rotated(33, 1), 2));
-    
-    double nose_vscale = ideal_nosedist_v / user_nosedist_v;
-    
-    
-    
-    //    std::cout << "Nose " << nose_hscale << ", " << nose_vscale << std::endl;
-    
-    
-    dlib::matrix<long> dlib_leye_range(1,leye_dlib.size());
-    for (int i = 0; i < leye_dlib.size(); i++ )
-    {
-        dlib_leye_range(0,i) = (long)leye_dlib[i];
-    }
-    dlib::matrix<double> dlib_leye = dlib::subm(flattened_2d_landmarks_full_rotated, dlib_leye_range, dlib::range(0,2));
-    
-    double dlib_leye_mean[2];
-    dlib_leye_mean[0] = dlib::mean(dlib::colm(dlib_leye,0));
-    dlib_leye_mean[1] = dlib::mean(dlib::colm(dlib_leye,1));
-    
-    dlib::set_colm(dlib_leye,0) = ((dlib::colm(dlib_leye,0) - dlib_leye_mean[0]) * eye_hscale) + dlib_leye_mean[0];
-    dlib::set_colm(dlib_leye,1) = ((dlib::colm(dlib_leye,1) - dlib_leye_mean[1]) * eye_vscale) + dlib_leye_mean[1];
-    
-    dlib::set_subm(flattened_2d_landmarks_full_rotated, dlib_leye_range, dlib::range(0,2)) = dlib_leye;
-    
-    dlib::matrix<long> dlib_reye_range(1,reye_dlib.size());
-    for (int i = 0; i < reye_dlib.size(); i++ )
-    {
-        dlib_reye_range(0,i) = (long)reye_dlib[i];
-    }
-    dlib::matrix<double> dlib_reye = dlib::subm(flattened_2d_landmarks_full_rotated, dlib_reye_range, dlib::range(0,2));
-    
-    double dlib_reye_mean[2];
-    dlib_reye_mean[0] = dlib::mean(dlib::colm(dlib_reye,0));
-    dlib_reye_mean[1] = dlib::mean(dlib::colm(dlib_reye,1));
-    
-    dlib::set_colm(dlib_reye,0) = ((dlib::colm(dlib_reye,0) - dlib_reye_mean[0]) * eye_hscale) + dlib_reye_mean[0];
-    dlib::set_colm(dlib_reye,1) = ((dlib::colm(dlib_reye,1) - dlib_reye_mean[1]) * eye_vscale) + dlib_reye_mean[1];
-    
-    dlib::set_subm(flattened_2d_landmarks_full_rotated, dlib_reye_range, dlib::range(0,2)) = dlib_reye;
-    
-    
-    dlib::matrix<long> dlib_nose_range(1,nose_dlib.size());
-    for (int i = 0; i < nose_dlib.size(); i++ )
-    {
-        dlib_nose_range(0,i) = (long)nose_dlib[i];
-    }
-    dlib::matrix<double> dlib_nose = dlib::subm(flattened_2d_landmarks_full_rotated, dlib_nose_range, dlib::range(0,2));
-    
-    double dlib_nose_mean[2];
-    dlib_nose_mean[0] = dlib::mean(dlib::colm(dlib_nose,0));
-    dlib_nose_mean[1] = dlib::mean(dlib::colm(dlib_nose,1));
-    
-    dlib::set_colm(dlib_nose,0) = ((dlib::colm(dlib_nose,0) - dlib_nose_mean[0]) * nose_hscale) + dlib_nose_mean[0];
-    dlib::set_colm(dlib_nose,1) = ((dlib::colm(dlib_nose,1) - dlib_nose_mean[1]) * nose_vscale) + dlib_nose_mean[1];
-    
-    dlib::set_subm(flattened_2d_landmarks_full_rotated, dlib_nose_range, dlib::range(0,2)) = dlib_nose;
-    
-    dlib::matrix<double, 68,2> _2d_landmarks_full;
-    _2d_landmarks_full = dlib::subm(flattened_2d_landmarks_full_rotated * rotation_matrix, dlib::range(0,67), dlib::range(0,1));
-    
-    
-    
-    dlib::set_colm(_2d_landmarks_full,0) = colm(_2d_landmarks_full,0) + mean_landmarks(0,0);
-    dlib::set_colm(_2d_landmarks_full,1) = colm(_2d_landmarks_full,1) + mean_landmarks(0,1);
-    
-    _2d_landmarks_full = adjust_warp_for_angle(landmarks, _2d_landmarks_full, *factr);
-    
-    PhiPoint * output = (PhiPoint *)malloc(_2d_landmarks_full.nr()*sizeof(PhiPoint));
-    for (int row = 0; row < _2d_landmarks_full.nr(); row++)
-    {
-        output[row] = PhiPoint{
-            static_cast<int>(std::round(_2d_landmarks_full(row,0))),
-            static_cast<int>(std::round(_2d_landmarks_full(row,1)))
-        };
-        
-    }
-    
-    return output;
-};
-
-PhiPoint * return_3d_golden_inner_face_warp_handsome(int * landmarks_ptr, double * parameters, double * factr)
-{
-    // CALLER MUST FREE MEMORY ON RETURN.
-    //const double eye_scaling = 1.00;
-    
-    dlib::matrix<int, 68, 2> landmarks_i = dlib::mat(landmarks_ptr, 68, 2);
-    //    std::cout << landmarks_i << std::endl;
-    dlib::matrix<double, 68, 2> landmarks = dlib::matrix_cast<double>(landmarks_i);
-    //    std::cout << landmarks << std::endl;
-    
-    dlib::matrix<double> mean_landmarks = dlib::rowm(landmarks,30);
-    dlib::matrix<double> centered_landmarks = landmarks;
-    dlib::set_colm(centered_landmarks,0) = colm(centered_landmarks,0) - mean_landmarks(0,0);
-    dlib::set_colm(centered_landmarks,1) = colm(centered_landmarks,1) - mean_landmarks(0,1);
-    
-    //    double *dlib_3d = landmarks3d_dlib;
-    double *dlib_3d = landmarks3d_male;
-    
-    dlib::matrix<double,68,3> landmarks3d = dlib::mat(dlib_3d, 68, 3);
-    dlib::matrix<double> mean_landmarks3d = dlib::rowm(landmarks3d,30);
-    dlib::matrix<double> centered_landmarks3d = landmarks3d;
-    dlib::set_colm(centered_landmarks3d,0) = colm(centered_landmarks3d,0) - mean_landmarks3d(0,0);
-    dlib::set_colm(centered_landmarks3d,1) = colm(centered_landmarks3d,1) - mean_landmarks3d(0,1);
-    dlib::set_colm(centered_landmarks3d,2) = colm(centered_landmarks3d,2) - mean_landmarks3d(0,2);
-    
-    dlib::matrix<double> rotation_matrix = find_overall_rotation_matrix(centered_landmarks, centered_landmarks3d, parameters);
-    
-    dlib::matrix<double,68,3> flattened_2d_landmarks_full = centered_landmarks3d * rotation_matrix;
-    dlib::set_subm(flattened_2d_landmarks_full, dlib::range(0,67), dlib::range(0,1)) = centered_landmarks;
-    dlib::matrix<double,68,3> flattened_2d_landmarks_full_rotated = flattened_2d_landmarks_full * dlib::inv(rotation_matrix);
-    
-    // Calculate scaling factors for warp
-    
-    // left eye, horizontal
-    double ideal_eyedist_lh = std::sqrt(std::pow(centered_landmarks3d(36, 0) - centered_landmarks3d(39, 0), 2.0) +  std::pow(centered_landmarks3d(36, 1) - centered_landmarks3d(39, 1), 2.0));
-    double user_eyedist_lh = std::sqrt(std::pow(flattened_2d_landmarks_full_rotated(36, 0) - flattened_2d_landmarks_full_rotated(39, 0), 2) +
-                                       std::pow(flattened_2d_landmarks_full_rotated(36, 1) - flattened_2d_landmarks_full_rotated(39, 1), 2));
-    double leye_hscale = ideal_eyedist_lh / user_eyedist_lh;
-    
-    // left eye, vertical
-    double ideal_eyedist_lv1 = std::sqrt(std::pow(centered_landmarks3d(37, 0) - centered_landmarks3d(41, 0), 2.0) +  std::pow(centered_landmarks3d(37, 1) - centered_landmarks3d(41, 1), 2.0));
-    double user_eyedist_lv1 = std::sqrt(std::pow(flattened_2d_landmarks_full_rotated(37, 0) - flattened_2d_landmarks_full_rotated(41, 0), 2) +
-                                        std::pow(flattened_2d_landmarks_full_rotated(37, 1) - flattened_2d_landmarks_full_rotated(41, 1), 2));
-    
-    double ideal_eyedist_lv2 = std::sqrt(std::pow(centered_landmarks3d(38, 0) - centered_landmarks3d(40, 0), 2.0) +  std::pow(centered_landmarks3d(38, 1) - centered_landmarks3d(40, 1), 2.0));
-    double user_eyedist_lv2 = std::sqrt(std::pow(flattened_2d_landmarks_full_rotated(38, 0) - flattened_2d_landmarks_full_rotated(40, 0), 2) +
-                                        std::pow(flattened_2d_landmarks_full_rotated(38, 1) - flattened_2d_landmarks_full_rotated(40, 1), 2));
-    double leye_vscale = 0.5 * (ideal_eyedist_lv1 / user_eyedist_lv1) + 0.5 * (ideal_eyedist_lv2 / user_eyedist_lv2);
-    
-    // right eye, horizontal
-    double ideal_eyedist_rh = std::sqrt(std::pow(centered_landmarks3d(42, 0) - centered_landmarks3d(45, 0), 2.0) +  std::pow(centered_landmarks3d(42, 1) - centered_landmarks3d(45, 1), 2.0));
-    double user_eyedist_rh = std::sqrt(std::pow(flattened_2d_landmarks_full_rotated(42, 0) - flattened_2d_landmarks_full_rotated(45, 0), 2.0) +
-                                       std::pow(flattened_2d_landmarks_full_rotated(42, 1) - flattened_2d_landmarks_full_rotated(45, 1), 2.0));
-    double reye_hscale = ideal_eyedist_rh / user_eyedist_rh;
-    
-    // right eye, vertical
-    double ideal_eyedist_rv1 = std::sqrt(std::pow(centered_landmarks3d(43, 0) - centered_landmarks3d(47, 0), 2.0) +  std::pow(centered_landmarks3d(43, 1) - centered_landmarks3d(47, 1), 2.0));
-    double user_eyedist_rv1 = std::sqrt(std::pow(flattened_2d_landmarks_full_rotated(43, 0) - flattened_2d_landmarks_full_rotated(47, 0), 2) +
-                                        std::pow(flattened_2d_landmarks_full_rotated(43, 1) - flattened_2d_landmarks_full_rotated(47, 1), 2));
-    
-    double ideal_eyedist_rv2 = std::sqrt(std::pow(centered_landmarks3d(44, 0) - centered_landmarks3d(46, 0), 2.0) +  std::pow(centered_landmarks3d(44, 1) - centered_landmarks3d(46, 1), 2.0));
-    double user_eyedist_rv2 = std::sqrt(std::pow(flattened_2d_landmarks_full_rotated(44, 0) - flattened_2d_landmarks_full_rotated(46, 0), 2) +
-                                        std::pow(flattened_2d_landmarks_full_rotated(44, 1) - flattened_2d_landmarks_full_rotated(46, 1), 2));
-    double reye_vscale = 0.5 * (ideal_eyedist_rv1 / user_eyedist_rv1) + 0.5 * (ideal_eyedist_rv2 / user_eyedist_rv2);
-    
-    double eye_vscale = 0.5 * leye_vscale + 0.5 * reye_vscale;
-    double eye_hscale = 0.5 * leye_hscale + 0.5 * reye_hscale;
-    
-    //    std::cout << "Eyes " << eye_hscale << ", " << eye_vscale << std::endl;
-    
-    // nose hscale
-    double ideal_nosedist_h1 = std::sqrt(std::pow(centered_landmarks3d(31, 0) - centered_landmarks3d(35, 0), 2.0) +  std::pow(centered_landmarks3d(31, 1) - centered_landmarks3d(35, 1), 2.0));
-    double user_nosedist_h1 = std::sqrt(std::pow(flattened_2d_landmarks_full_rotated(31, 0) - flattened_2d_landmarks_full_rotated(35, 0), 2) +
-                                        std::pow(flattened_2d_landmarks_full_rotated(31, 1) - flattened_2d_landmarks_full_rotated(35, 1), 2));
-    
-    double nose_hscale1 = ideal_nosedist_h1 / user_nosedist_h1;
-    
-    double ideal_nosedist_h2 = std::sqrt(std::pow(centered_landmarks3d(32, 0) - centered_landmarks3d(34, 0), 2.0) +  std::pow(centered_landmarks3d(32, 1) - centered_landmarks3d(34, 1), 2.0));
-    double user_nosedist_h2 = std::sqrt(std::pow(flattened_2d_landmarks_full_rotated(32, 0) - flattened_2d_landmarks_full_rotated(34, 0), 2) +
-                                        std::pow(flattened_2d_landmarks_full_rotated(32, 1) - flattened_2d_landmarks_full_rotated(34, 1), 2));
-    
-    double nose_hscale2 = ideal_nosedist_h2 / user_nosedist_h2;
-    
-    double nose_hscale = 0.7 * nose_hscale1 + 0.3 * nose_hscale2; // 0.7 for the wider .: more accurate value, 0.3 of the other
-    
-    // nose vscale
-    double ideal_nosedist_v = std::sqrt(std::pow(centered_landmarks3d(27, 0) - centered_landmarks3d(33, 0), 2.0) +  std::pow(centered_landmarks3d(27, 1) - centered_landmarks3d(33, 1), 2.0));
-    double user_nosedist_v = std::sqrt(std::pow(flattened_2d_landmarks_full_rotated(27, 0) - flattened_2d_landmarks_full_rotated(33, 0), 2) +
-                                       std::pow(flattened_2d_landmarks_full_rotated(27, 1) - flattened_2d_landmarks_full_rotated(33, 1), 2));
-    
-    double nose_vscale = ideal_nosedist_v / user_nosedist_v;
-    
-    
-    
-    //    std::cout << "Nose " << nose_hscale << ", " << nose_vscale << std::endl;
-    
-    
-    dlib::matrix<long> dlib_leye_range(1,leye_dlib.size());
-    for (int i = 0; i < leye_dlib.size(); i++ )
-    {
-        dlib_leye_range(0,i) = (long)leye_dlib[i];
-    }
-    dlib::matrix<double> dlib_leye = dlib::subm(flattened_2d_landmarks_full_rotated, dlib_leye_range, dlib::range(0,2));
-    
-    double dlib_leye_mean[2];
-    dlib_leye_mean[0] = dlib::mean(dlib::colm(dlib_leye,0));
-    dlib_leye_mean[1] = dlib::mean(dlib::colm(dlib_leye,1));
-    
-    dlib::set_colm(dlib_leye,0) = ((dlib::colm(dlib_leye,0) - dlib_leye_mean[0]) * eye_hscale) + dlib_leye_mean[0];
-    dlib::set_colm(dlib_leye,1) = ((dlib::colm(dlib_leye,1) - dlib_leye_mean[1]) * eye_vscale) + dlib_leye_mean[1];
-    
-    dlib::set_subm(flattened_2d_landmarks_full_rotated, dlib_leye_range, dlib::range(0,2)) = dlib_leye;
-    
-    dlib::matrix<long> dlib_reye_range(1,reye_dlib.size());
-    for (int i = 0; i < reye_dlib.size(); i++ )
-    {
-        dlib_reye_range(0,i) = (long)reye_dlib[i];
-    }
-    dlib::matrix<double> dlib_reye = dlib::subm(flattened_2d_landmarks_full_rotated, dlib_reye_range, dlib::range(0,2));
-    
-    double dlib_reye_mean[2];
-    dlib_reye_mean[0] = dlib::mean(dlib::colm(dlib_reye,0));
-    dlib_reye_mean[1] = dlib::mean(dlib::colm(dlib_reye,1));
-    
-    dlib::set_colm(dlib_reye,0) = ((dlib::colm(dlib_reye,0) - dlib_reye_mean[0]) * eye_hscale) + dlib_reye_mean[0];
-    dlib::set_colm(dlib_reye,1) = ((dlib::colm(dlib_reye,1) - dlib_reye_mean[1]) * eye_vscale) + dlib_reye_mean[1];
-    
-    dlib::set_subm(flattened_2d_landmarks_full_rotated, dlib_reye_range, dlib::range(0,2)) = dlib_reye;
-    
-    
-    dlib::matrix<long> dlib_nose_range(1,nose_dlib.size());
-    for (int i = 0; i < nose_dlib.size(); i++ )
-    {
-        dlib_nose_range(0,i) = (long)nose_dlib[i];
-    }
-    dlib::matrix<double> dlib_nose = dlib::subm(flattened_2d_landmarks_full_rotated, dlib_nose_range, dlib::range(0,2));
-    
-    double dlib_nose_mean[2];
-    dlib_nose_mean[0] = dlib::mean(dlib::colm(dlib_nose,0));
-    dlib_nose_mean[1] = dlib::mean(dlib::colm(dlib_nose,1));
-    
-    dlib::set_colm(dlib_nose,0) = ((dlib::colm(dlib_nose,0) - dlib_nose_mean[0]) * nose_hscale) + dlib_nose_mean[0];
-    dlib::set_colm(dlib_nose,1) = ((dlib::colm(dlib_nose,1) - dlib_nose_mean[1]) * nose_vscale) + dlib_nose_mean[1];
-    
-    dlib::set_subm(flattened_2d_landmarks_full_rotated, dlib_nose_range, dlib::range(0,2)) = dlib_nose;
-    
-    dlib::matrix<double, 68,2> _2d_landmarks_full;
-    _2d_landmarks_full = dlib::subm(flattened_2d_landmarks_full_rotated * rotation_matrix, dlib::range(0,67), dlib::range(0,1));
-    
-    
-    
-    dlib::set_colm(_2d_landmarks_full,0) = colm(_2d_landmarks_full,0) + mean_landmarks(0,0);
-    dlib::set_colm(_2d_landmarks_full,1) = colm(_2d_landmarks_full,1) + mean_landmarks(0,1);
-    
-    _2d_landmarks_full = adjust_warp_for_angle(landmarks, _2d_landmarks_full, *factr);
-    
-    PhiPoint * output = (PhiPoint *)malloc(_2d_landmarks_full.nr()*sizeof(PhiPoint));
-    for (int row = 0; row < _2d_landmarks_full.nr(); row++)
-    {
-        output[row] = PhiPoint{
-            static_cast<int>(std::round(_2d_landmarks_full(row,0))),
-            static_cast<int>(std::round(_2d_landmarks_full(row,1)))
-        };
-        
-    }
-    
-    return output;
-};
-
-
-void calculate_3d_golden_inner_face_warp_pretty(int * landmarks_ptr, double * parameters, double * factr, double * scaling_factors)
-{
-    dlib::matrix<int, 68, 2> landmarks_i = dlib::mat(landmarks_ptr, 68, 2);
-    //    std::cout << landmarks_i << std::endl;
-    dlib::matrix<double, 68, 2> landmarks = dlib::matrix_cast<double>(landmarks_i);
-    //    std::cout << landmarks << std::endl;
-    
-    dlib::matrix<double> mean_landmarks = dlib::rowm(landmarks,30);
-    dlib::matrix<double> centered_landmarks = landmarks;
-    dlib::set_colm(centered_landmarks,0) = colm(centered_landmarks,0) - mean_landmarks(0,0);
-    dlib::set_colm(centered_landmarks,1) = colm(centered_landmarks,1) - mean_landmarks(0,1);
-    
-    double *dlib_3d = landmarks3d_female;
-    
-    dlib::matrix<double,68,3> landmarks3d = dlib::mat(dlib_3d, 68, 3);
-    dlib::matrix<double> mean_landmarks3d = dlib::rowm(landmarks3d,30);
-    dlib::matrix<double> centered_landmarks3d = landmarks3d;
-    dlib::set_colm(centered_landmarks3d,0) = colm(centered_landmarks3d,0) - mean_landmarks3d(0,0);
-    dlib::set_colm(centered_landmarks3d,1) = colm(centered_landmarks3d,1) - mean_landmarks3d(0,1);
-    dlib::set_colm(centered_landmarks3d,2) = colm(centered_landmarks3d,2) - mean_landmarks3d(0,2);
-    
-    dlib::matrix<double> rotation_matrix = find_overall_rotation_matrix(centered_landmarks, centered_landmarks3d, parameters);
-    
-    dlib::matrix<double,68,3> flattened_2d_landmarks_full = centered_landmarks3d * rotation_matrix;
-    dlib::set_subm(flattened_2d_landmarks_full, dlib::range(0,67), dlib::range(0,1)) = centered_landmarks;
-    dlib::matrix<double,68,3> flattened_2d_landmarks_full_rotated = flattened_2d_landmarks_full * dlib::inv(rotation_matrix);
-    
-    // Calculate scaling factors for warp
-    
-    // left eye, horizontal
-    double ideal_eyedist_lh = std::sqrt(std::pow(centered_landmarks3d(36, 0) - centered_landmarks3d(39, 0), 2.0) +  std::pow(centered_landmarks3d(36, 1) - centered_landmarks3d(39, 1), 2.0));
-    double user_eyedist_lh = std::sqrt(std::pow(flattened_2d_landmarks_full_rotated(36, 0) - flattened_2d_landmarks_full_rotated(39, 0), 2) +
-                                       std::pow(flattened_2d_landmarks_full_rotated(36, 1) - flattened_2d_landmarks_full_rotated(39, 1), 2));
-    double leye_hscale = ideal_eyedist_lh / user_eyedist_lh;
-    
-    // left eye, vertical
-    double ideal_eyedist_lv1 = std::sqrt(std::pow(centered_landmarks3d(37, 0) - centered_landmarks3d(41, 0), 2.0) +  std::pow(centered_landmarks3d(37, 1) - centered_landmarks3d(41, 1), 2.0));
-    double user_eyedist_lv1 = std::sqrt(std::pow(flattened_2d_landmarks_full_rotated(37, 0) - flattened_2d_landmarks_full_rotated(41, 0), 2) +
-                                        std::pow(flattened_2d_landmarks_full_rotated(37, 1) - flattened_2d_landmarks_full_rotated(41, 1), 2));
-    
-    double ideal_eyedist_lv2 = std::sqrt(std::pow(centered_landmarks3d(38, 0) - centered_landmarks3d(40, 0), 2.0) +  std::pow(centered_landmarks3d(38, 1) - centered_landmarks3d(40, 1), 2.0));
-    double user_eyedist_lv2 = std::sqrt(std::pow(flattened_2d_landmarks_full_rotated(38, 0) - flattened_2d_landmarks_full_rotated(40, 0), 2) +
-                                        std::pow(flattened_2d_landmarks_full_rotated(38, 1) - flattened_2d_landmarks_full_rotated(40, 1), 2));
-    double leye_vscale = 0.5 * (ideal_eyedist_lv1 / user_eyedist_lv1) + 0.5 * (ideal_eyedist_lv2 / user_eyedist_lv2);
-    
-    // right eye, horizontal
-    double ideal_eyedist_rh = std::sqrt(std::pow(centered_landmarks3d(42, 0) - centered_landmarks3d(45, 0), 2.0) +  std::pow(centered_landmarks3d(42, 1) - centered_landmarks3d(45, 1), 2.0));
-    double user_eyedist_rh = std::sqrt(std::pow(flattened_2d_landmarks_full_rotated(42, 0) - flattened_2d_landmarks_full_rotated(45, 0), 2.0) +
-                                       std::pow(flattened_2d_landmarks_full_rotated(42, 1) - flattened_2d_landmarks_full_rotated(45, 1), 2.0));
-    double reye_hscale = ideal_eyedist_rh / user_eyedist_rh;
-    
-    // right eye, vertical
-    double ideal_eyedist_rv1 = std::sqrt(std::pow(centered_landmarks3d(43, 0) - centered_landmarks3d(47, 0), 2.0) +  std::pow(centered_landmarks3d(43, 1) - centered_landmarks3d(47, 1), 2.0));
-    double user_eyedist_rv1 = std::sqrt(std::pow(flattened_2d_landmarks_full_rotated(43, 0) - flattened_2d_landmarks_full_rotated(47, 0), 2) +
-                                        std::pow(flattened_2d_landmarks_full_rotated(43, 1) - flattened_2d_landmarks_full_rotated(47, 1), 2));
-    
-    double ideal_eyedist_rv2 = std::sqrt(std::pow(centered_landmarks3d(44, 0) - centered_landmarks3d(46, 0), 2.0) +  std::pow(centered_landmarks3d(44, 1) - centered_landmarks3d(46, 1), 2.0));
-    double user_eyedist_rv2 = std::sqrt(std::pow(flattened_2d_landmarks_full_rotated(44, 0) - flattened_2d_landmarks_full_rotated(46, 0), 2) +
-                                        std::pow(flattened_2d_landmarks_full_rotated(44, 1) - flattened_2d_landmarks_full_rotated(46, 1), 2));
-    double reye_vscale = 0.5 * (ideal_eyedist_rv1 / user_eyedist_rv1) + 0.5 * (ideal_eyedist_rv2 / user_eyedist_rv2);
-    
-    double eye_vscale = 0.5 * leye_vscale + 0.5 * reye_vscale;
-    double eye_hscale = 0.5 * leye_hscale + 0.5 * reye_hscale;
-    
-    //    std::cout << "Eyes " << eye_hscale << ", " << eye_vscale << std::endl;
-    
-    // nose hscale
-    double ideal_nosedist_h1 = std::sqrt(std::pow(centered_landmarks3d(31, 0) - centered_landmarks3d(35, 0), 2.0) +  std::pow(centered_landmarks3d(31, 1) - centered_landmarks3d(35, 1), 2.0));
-    double user_nosedist_h1 = std::sqrt(std::pow(flattened_2d_landmarks_full_rotated(31, 0) - flattened_2d_landmarks_full_rotated(35, 0), 2) +
-                                        std::pow(flattened_2d_landmarks_full_rotated(31, 1) - flattened_2d_landmarks_full_rotated(35, 1), 2));
-    
-    double nose_hscale1 = ideal_nosedist_h1 / user_nosedist_h1;
-    
-    double ideal_nosedist_h2 = std::sqrt(std::pow(centered_landmarks3d(32, 0) - centered_landmarks3d(34, 0), 2.0) +  std::pow(centered_landmarks3d(32, 1) - centered_landmarks3d(34, 1), 2.0));
-    double user_nosedist_h2 = std::sqrt(std::pow(flattened_2d_landmarks_full_rotated(32, 0) - flattened_2d_landmarks_full_rotated(34, 0), 2) +
-                                        std::pow(flattened_2d_landmarks_full_rotated(32, 1) - flattened_2d_landmarks_full_rotated(34, 1), 2));
-    
-    double nose_hscale2 = ideal_nosedist_h2 / user_nosedist_h2;
-    
-    double nose_hscale = 0.7 * nose_hscale1 + 0.3 * nose_hscale2; // 0.7 for the wider .: more accurate value, 0.3 of the other
-    
-    // nose vscale
-    double ideal_nosedist_v = std::sqrt(std::pow(centered_landmarks3d(27, 0) - centered_landmarks3d(33, 0), 2.0) +  std::pow(centered_landmarks3d(27, 1) - centered_landmarks3d(33, 1), 2.0));
-    double user_nosedist_v = std::sqrt(std::pow(flattened_2d_landmarks_full_rotated(27, 0) - flattened_2d_landmarks_full_rotated(33, 0), 2) +
-                                       std::pow(flattened_2d_landmarks_full_rotated(27, 1) - flattened_2d_landmarks_full_rotated(33, 1), 2));
-    
-    double nose_vscale = ideal_nosedist_v / user_nosedist_v;
-    
-    // mouth hscale
-    //double ideal_mouthdist_h1 = std::sqrt(std::pow(centered_landmarks3d(48, 0) - centered_landmarks3d(54, 0), 2.0) +  std::pow(centered_landmarks3d(48, 1) - centered_landmarks3d(54, 1), 2.0));
-    //double user_mouthdist_h1 = std::sqrt(std::pow(flattened_2d_landmarks_full_rotated(48, 0) - flattened_2d_landmarks_full_rotated(54, 0), 2) +
-    //                                     std::pow(flattened_2d_landmarks_full_rotated(48, 1) - flattened_2d_landmarks_full_rotated(54, 1), 2));
-    
-    //double mouth_hscale = ideal_mouthdist_h1 / user_mouthdist_h1;
-    
-    // mouth vscale
-    //double ideal_mouthdist_v = std::sqrt(std::pow(centered_landmarks3d(51, 0) - centered_landmarks3d(57, 0), 2.0) +  std::pow(centered_landmarks3d(51, 1) - centered_landmarks3d(57, 1), 2.0));
-    //double user_mouthdist_v = std::sqrt(std::pow(flattened_2d_landmarks_full_rotated(51, 0) - flattened_2d_landmarks_full_rotated(57, 0), 2) +
-    //                                    std::pow(flattened_2d_landmarks_full_rotated(51, 1) - flattened_2d_landmarks_full_rotated(57, 1), 2));
-    
-    //double mouth_vscale = ideal_mouthdist_v / user_mouthdist_v;
-    
-    scaling_factors[0] = eye_hscale;
-    scaling_factors[1] = eye_vscale;
-    scaling_factors[2] = nose_hscale;
-    scaling_factors[3] = nose_vscale;
-    scaling_factors[4] = 0.96;//mouth_hscale;
-    scaling_factors[5] = 0.96;//mouth_vscale;
-}
-
-PhiPoint * apply_3d_golden_inner_face_warp_pretty(int * landmarks_ptr, double * parameters, double * factr, double * scaling_factors) {
-    
-    
-    // CALLER MUST FREE MEMORY ON RETURN.
-    double eye_hscale = scaling_factors[0];
-    double eye_vscale = scaling_factors[1];
-    double nose_hscale = scaling_factors[2];
-    double nose_vscale = scaling_factors[3];
-    double mouth_hscale = scaling_factors[4];
-    double mouth_vscale = scaling_factors[5];
-    
-    dlib::matrix<int, 68, 2> landmarks_i = dlib::mat(landmarks_ptr, 68, 2);
-    //    std::cout << landmarks_i << std::endl;
-    dlib::matrix<double, 68, 2> landmarks = dlib::matrix_cast<double>(landmarks_i);
-    //    std::cout << landmarks << std::endl;
-    
-    dlib::matrix<double> mean_landmarks = dlib::rowm(landmarks,30);
-    dlib::matrix<double> centered_landmarks = landmarks;
-    dlib::set_colm(centered_landmarks,0) = colm(centered_landmarks,0) - mean_landmarks(0,0);
-    dlib::set_colm(centered_landmarks,1) = colm(centered_landmarks,1) - mean_landmarks(0,1);
-    
-    double *dlib_3d = landmarks3d_female;
-    
-    dlib::matrix<double,68,3> landmarks3d = dlib::mat(dlib_3d, 68, 3);
-    dlib::matrix<double> mean_landmarks3d = dlib::rowm(landmarks3d,30);
-    dlib::matrix<double> centered_landmarks3d = landmarks3d;
-    dlib::set_colm(centered_landmarks3d,0) = colm(centered_landmarks3d,0) - mean_landmarks3d(0,0);
-    dlib::set_colm(centered_landmarks3d,1) = colm(centered_landmarks3d,1) - mean_landmarks3d(0,1);
-    dlib::set_colm(centered_landmarks3d,2) = colm(centered_landmarks3d,2) - mean_landmarks3d(0,2);
-    
-    dlib::matrix<double> rotation_matrix = find_overall_rotation_matrix(centered_landmarks, centered_landmarks3d, parameters);
-    
-    dlib::matrix<double,68,3> flattened_2d_landmarks_full = centered_landmarks3d * rotation_matrix;
-    dlib::set_subm(flattened_2d_landmarks_full, dlib::range(0,67), dlib::range(0,1)) = centered_landmarks;
-    dlib::matrix<double,68,3> flattened_2d_landmarks_full_rotated = flattened_2d_landmarks_full * dlib::inv(rotation_matrix);
-    
-    
-    dlib::matrix<long> dlib_leye_range(1,leye_dlib.size());
-    for (int i = 0; i < leye_dlib.size(); i++ )
-    {
-        dlib_leye_range(0,i) = (long)leye_dlib[i];
-    }
-    dlib::matrix<double> dlib_leye = dlib::subm(flattened_2d_landmarks_full_rotated, dlib_leye_range, dlib::range(0,2));
-    
-    double dlib_leye_mean[2];
-    dlib_leye_mean[0] = dlib::mean(dlib::colm(dlib_leye,0));
-    dlib_leye_mean[1] = dlib::mean(dlib::colm(dlib_leye,1));
-    
-    dlib::set_colm(dlib_leye,0) = ((dlib::colm(dlib_leye,0) - dlib_leye_mean[0]) * eye_hscale) + dlib_leye_mean[0];
-    dlib::set_colm(dlib_leye,1) = ((dlib::colm(dlib_leye,1) - dlib_leye_mean[1]) * eye_vscale) + dlib_leye_mean[1];
-    
-    dlib::set_subm(flattened_2d_landmarks_full_rotated, dlib_leye_range, dlib::range(0,2)) = dlib_leye;
-    
-    dlib::matrix<long> dlib_reye_range(1,reye_dlib.size());
-    for (int i = 0; i < reye_dlib.size(); i++ )
-    {
-        dlib_reye_range(0,i) = (long)reye_dlib[i];
-    }
-    dlib::matrix<double> dlib_reye = dlib::subm(flattened_2d_landmarks_full_rotated, dlib_reye_range, dlib::range(0,2));
-    
-    double dlib_reye_mean[2];
-    dlib_reye_mean[0] = dlib::mean(dlib::colm(dlib_reye,0));
-    dlib_reye_mean[1] = dlib::mean(dlib::colm(dlib_reye,1));
-    
-    dlib::set_colm(dlib_reye,0) = ((dlib::colm(dlib_reye,0) - dlib_reye_mean[0]) * eye_hscale) + dlib_reye_mean[0];
-    dlib::set_colm(dlib_reye,1) = ((dlib::colm(dlib_reye,1) - dlib_reye_mean[1]) * eye_vscale) + dlib_reye_mean[1];
-    
-    dlib::set_subm(flattened_2d_landmarks_full_rotated, dlib_reye_range, dlib::range(0,2)) = dlib_reye;
-    
-    
-    dlib::matrix<long> dlib_nose_range(1,nose_dlib.size());
-    for (int i = 0; i < nose_dlib.size(); i++ )
-    {
-        dlib_nose_range(0,i) = (long)nose_dlib[i];
-    }
-    dlib::matrix<double> dlib_nose = dlib::subm(flattened_2d_landmarks_full_rotated, dlib_nose_range, dlib::range(0,2));
-    
-    double dlib_nose_mean[2];
-    dlib_nose_mean[0] = dlib::mean(dlib::colm(dlib_nose,0));
-    dlib_nose_mean[1] = dlib::mean(dlib::colm(dlib_nose,1));
-    
-    dlib::set_colm(dlib_nose,0) = ((dlib::colm(dlib_nose,0) - dlib_nose_mean[0]) * nose_hscale) + dlib_nose_mean[0];
-    dlib::set_colm(dlib_nose,1) = ((dlib::colm(dlib_nose,1) - dlib_nose_mean[1]) * nose_vscale) + dlib_nose_mean[1];
-    
-    dlib::set_subm(flattened_2d_landmarks_full_rotated, dlib_nose_range, dlib::range(0,2)) = dlib_nose;
-    
-    
-    
-    //
-    dlib::matrix<long> dlib_mouth_range(1,outermouth_dlib.size());
-    for (int i = 0; i < outermouth_dlib.size(); i++ )
-    {
-        dlib_mouth_range(0,i) = (long)outermouth_dlib[i];
-    }
-    dlib::matrix<double> dlib_mouth = dlib::subm(flattened_2d_landmarks_full_rotated, dlib_mouth_range, dlib::range(0,2));
-    
-    double dlib_mouth_mean[2];
-    dlib_mouth_mean[0] = dlib::mean(dlib::colm(dlib_mouth,0));
-    dlib_mouth_mean[1] = dlib::mean(dlib::colm(dlib_mouth,1));
-    
-    dlib::set_colm(dlib_mouth,0) = ((dlib::colm(dlib_mouth,0) - dlib_mouth_mean[0]) * mouth_hscale) + dlib_mouth_mean[0];
-    dlib::set_colm(dlib_mouth,1) = ((dlib::colm(dlib_mouth,1) - dlib_mouth_mean[1]) * mouth_vscale) + dlib_mouth_mean[1];
-    
-    dlib::set_subm(flattened_2d_landmarks_full_rotated, dlib_mouth_range, dlib::range(0,2)) = dlib_mouth;
-    //
-    dlib::matrix<long> dlib_mouth_inner_range(1,innermouth_dlib.size());
-    for (int i = 0; i < innermouth_dlib.size(); i++ )
-    {
-        dlib_mouth_inner_range(0,i) = (long)innermouth_dlib[i];
-    }
-    dlib::matrix<double> dlib_mouth_inner = dlib::subm(flattened_2d_landmarks_full_rotated, dlib_mouth_inner_range, dlib::range(0,2));
-    
-    double dlib_mouth_inner_mean[2];
-    dlib_mouth_inner_mean[0] = dlib::mean(dlib::colm(dlib_mouth_inner,0));
-    dlib_mouth_inner_mean[1] = dlib::mean(dlib::colm(dlib_mouth_inner,1));
-    
-    dlib::set_colm(dlib_mouth_inner,0) = ((dlib::colm(dlib_mouth_inner,0) - dlib_mouth_inner_mean[0]) * mouth_hscale) + dlib_mouth_inner_mean[0];
-    dlib::set_colm(dlib_mouth_inner,1) = ((dlib::colm(dlib_mouth_inner,1) - dlib_mouth_inner_mean[1]) * mouth_vscale) + dlib_mouth_inner_mean[1];
-    
-    dlib::set_subm(flattened_2d_landmarks_full_rotated, dlib_mouth_inner_range, dlib::range(0,2)) = dlib_mouth_inner;
-    
-    //
-    
-    
-    dlib::matrix<double, 68,2> _2d_landmarks_full;
-    _2d_landmarks_full = dlib::subm(flattened_2d_landmarks_full_rotated * rotation_matrix, dlib::range(0,67), dlib::range(0,1));
-    
-    
-    dlib::set_colm(_2d_landmarks_full,0) = colm(_2d_landmarks_full,0) + mean_landmarks(0,0);
-    dlib::set_colm(_2d_landmarks_full,1) = colm(_2d_landmarks_full,1) + mean_landmarks(0,1);
-    
-    _2d_landmarks_full = adjust_warp_for_angle(landmarks, _2d_landmarks_full, *factr);
-    
-    PhiPoint * output = (PhiPoint *)malloc(_2d_landmarks_full.nr()*sizeof(PhiPoint));
-    for (int row = 0; row < _2d_landmarks_full.nr(); row++)
-    {
-        output[row] = PhiPoint{
-            static_cast<int>(std::round(_2d_landmarks_full(row,0))),
-            static_cast<int>(std::round(_2d_landmarks_full(row,1)))
-        };
-        
-    }
-    
-    return output;
-};
-
-
-void calculate_3d_golden_inner_face_warp_handsome(int * landmarks_ptr, double * parameters, double * factr, double * scaling_factors)
-{
-    dlib::matrix<int, 68, 2> landmarks_i = dlib::mat(landmarks_ptr, 68, 2);
-    //    std::cout << landmarks_i << std::endl;
-    dlib::matrix<double, 68, 2> landmarks = dlib::matrix_cast<double>(landmarks_i);
-    //    std::cout << landmarks << std::endl;
-    
-    dlib::matrix<double> mean_landmarks = dlib::rowm(landmarks,30);
-    dlib::matrix<double> centered_landmarks = landmarks;
-    dlib::set_colm(centered_landmarks,0) = colm(centered_landmarks,0) - mean_landmarks(0,0);
-    dlib::set_colm(centered_landmarks,1) = colm(centered_landmarks,1) - mean_landmarks(0,1);
-    
-    double *dlib_3d = landmarks3d_male;
-    
-    dlib::matrix<double,68,3> landmarks3d = dlib::mat(dlib_3d, 68, 3);
-    dlib::matrix<double> mean_landmarks3d = dlib::rowm(landmarks3d,30);
-    dlib::matrix<double> centered_landmarks3d = landmarks3d;
-    dlib::set_colm(centered_landmarks3d,0) = colm(centered_landmarks3d,0) - mean_landmarks3d(0,0);
-    dlib::set_colm(centered_landmarks3d,1) = colm(centered_landmarks3d,1) - mean_landmarks3d(0,1);
-    dlib::set_colm(centered_landmarks3d,2) = colm(centered_landmarks3d,2) - mean_landmarks3d(0,2);
-    
-    dlib::matrix<double> rotation_matrix = find_overall_rotation_matrix(centered_landmarks, centered_landmarks3d, parameters);
-    
-    dlib::matrix<double,68,3> flattened_2d_landmarks_full = centered_landmarks3d * rotation_matrix;
-    dlib::set_subm(flattened_2d_landmarks_full, dlib::range(0,67), dlib::range(0,1)) = centered_landmarks;
-    dlib::matrix<double,68,3> flattened_2d_landmarks_full_rotated = flattened_2d_landmarks_full * dlib::inv(rotation_matrix);
-    
-    // Calculate scaling factors for warp
-    
-    // left eye, horizontal
-    double ideal_eyedist_lh = std::sqrt(std::pow(centered_landmarks3d(36, 0) - centered_landmarks3d(39, 0), 2.0) +  std::pow(centered_landmarks3d(36, 1) - centered_landmarks3d(39, 1), 2.0));
-    double user_eyedist_lh = std::sqrt(std::pow(flattened_2d_landmarks_full_rotated(36, 0) - flattened_2d_landmarks_full_rotated(39, 0), 2) +
-                                       std::pow(flattened_2d_landmarks_full_rotated(36, 1) - flattened_2d_landmarks_full_rotated(39, 1), 2));
-    double leye_hscale = ideal_eyedist_lh / user_eyedist_lh;
-    
-    // left eye, vertical
-    double ideal_eyedist_lv1 = std::sqrt(std::pow(centered_landmarks3d(37, 0) - centered_landmarks3d(41, 0), 2.0) +  std::pow(centered_landmarks3d(37, 1) - centered_landmarks3d(41, 1), 2.0));
-    double user_eyedist_lv1 = std::sqrt(std::pow(flattened_2d_landmarks_full_rotated(37, 0) - flattened_2d_landmarks_full_rotated(41, 0), 2) +
-                                        std::pow(flattened_2d_landmarks_full_rotated(37, 1) - flattened_2d_landmarks_full_rotated(41, 1), 2));
-    
-    double ideal_eyedist_lv2 = std::sqrt(std::pow(centered_landmarks3d(38, 0) - centered_landmarks3d(40, 0), 2.0) +  std::pow(centered_landmarks3d(38, 1) - centered_landmarks3d(40, 1), 2.0));
-    double user_eyedist_lv2 = std::sqrt(std::pow(flattened_2d_landmarks_full_rotated(38, 0) - flattened_2d_landmarks_full_rotated(40, 0), 2) +
-                                        std::pow(flattened_2d_landmarks_full_rotated(38, 1) - flattened_2d_landmarks_full_rotated(40, 1), 2));
-    double leye_vscale = 0.5 * (ideal_eyedist_lv1 / user_eyedist_lv1) + 0.5 * (ideal_eyedist_lv2 / user_eyedist_lv2);
-    
-    // right eye, horizontal
-    double ideal_eyedist_rh = std::sqrt(std::pow(centered_landmarks3d(42, 0) - centered_landmarks3d(45, 0), 2.0) +  std::pow(centered_landmarks3d(42, 1) - centered_landmarks3d(45, 1), 2.0));
-    double user_eyedist_rh = std::sqrt(std::pow(flattened_2d_landmarks_full_rotated(42, 0) - flattened_2d_landmarks_full_rotated(45, 0), 2.0) +
-                                       std::pow(flattened_2d_landmarks_full_rotated(42, 1) - flattened_2d_landmarks_full_rotated(45, 1), 2.0));
-    double reye_hscale = ideal_eyedist_rh / user_eyedist_rh;
-    
-    // right eye, vertical
-    double ideal_eyedist_rv1 = std::sqrt(std::pow(centered_landmarks3d(43, 0) - centered_landmarks3d(47, 0), 2.0) +  std::pow(centered_landmarks3d(43, 1) - centered_landmarks3d(47, 1), 2.0));
-    double user_eyedist_rv1 = std::sqrt(std::pow(flattened_2d_landmarks_full_rotated(43, 0) - flattened_2d_landmarks_full_rotated(47, 0), 2) +
-                                        std::pow(flattened_2d_landmarks_full_rotated(43, 1) - flattened_2d_landmarks_full_rotated(47, 1), 2));
-    
-    double ideal_eyedist_rv2 = std::sqrt(std::pow(centered_landmarks3d(44, 0) - centered_landmarks3d(46, 0), 2.0) +  std::pow(centered_landmarks3d(44, 1) - centered_landmarks3d(46, 1), 2.0));
-    double user_eyedist_rv2 = std::sqrt(std::pow(flattened_2d_landmarks_full_rotated(44, 0) - flattened_2d_landmarks_full_rotated(46, 0), 2) +
-                                        std::pow(flattened_2d_landmarks_full_rotated(44, 1) - flattened_2d_landmarks_full_rotated(46, 1), 2));
-    double reye_vscale = 0.5 * (ideal_eyedist_rv1 / user_eyedist_rv1) + 0.5 * (ideal_eyedist_rv2 / user_eyedist_rv2);
-    
-    double eye_vscale = 0.5 * leye_vscale + 0.5 * reye_vscale;
-    double eye_hscale = 0.5 * leye_hscale + 0.5 * reye_hscale;
-    
-    //    std::cout << "Eyes " << eye_hscale << ", " << eye_vscale << std::endl;
-    
-    // nose hscale
-    double ideal_nosedist_h1 = std::sqrt(std::pow(centered_landmarks3d(31, 0) - centered_landmarks3d(35, 0), 2.0) +  std::pow(centered_landmarks3d(31, 1) - centered_landmarks3d(35, 1), 2.0));
-    double user_nosedist_h1 = std::sqrt(std::pow(flattened_2d_landmarks_full_rotated(31, 0) - flattened_2d_landmarks_full_rotated(35, 0), 2) +
-                                        std::pow(flattened_2d_landmarks_full_rotated(31, 1) - flattened_2d_landmarks_full_rotated(35, 1), 2));
-    
-    double nose_hscale1 = ideal_nosedist_h1 / user_nosedist_h1;
-    
-    double ideal_nosedist_h2 = std::sqrt(std::pow(centered_landmarks3d(32, 0) - centered_landmarks3d(34, 0), 2.0) +  std::pow(centered_landmarks3d(32, 1) - centered_landmarks3d(34, 1), 2.0));
-    double user_nosedist_h2 = std::sqrt(std::pow(flattened_2d_landmarks_full_rotated(32, 0) - flattened_2d_landmarks_full_rotated(34, 0), 2) +
-                                        std::pow(flattened_2d_landmarks_full_rotated(32, 1) - flattened_2d_landmarks_full_rotated(34, 1), 2));
-    
-    double nose_hscale2 = ideal_nosedist_h2 / user_nosedist_h2;
-    
-    double nose_hscale = 0.7 * nose_hscale1 + 0.3 * nose_hscale2; // 0.7 for the wider .: more accurate value, 0.3 of the other
-    
-    // nose vscale
-    double ideal_nosedist_v = std::sqrt(std::pow(centered_landmarks3d(27, 0) - centered_landmarks3d(33, 0), 2.0) +  std::pow(centered_landmarks3d(27, 1) - centered_landmarks3d(33, 1), 2.0));
-    double user_nosedist_v = std::sqrt(std::pow(flattened_2d_landmarks_full_rotated(27, 0) - flattened_2d_landmarks_full_rotated(33, 0), 2) +
-                                       std::pow(flattened_2d_landmarks_full_rotated(27, 1) - flattened_2d_landmarks_full_rotated(33, 1), 2));
-    
-    double nose_vscale = ideal_nosedist_v / user_nosedist_v;
-    
-    // mouth hscale
-    //double ideal_mouthdist_h1 = std::sqrt(std::pow(centered_landmarks3d(48, 0) - centered_landmarks3d(54, 0), 2.0) +  std::pow(centered_landmarks3d(48, 1) - centered_landmarks3d(54, 1), 2.0));
-    //double user_mouthdist_h1 = std::sqrt(std::pow(flattened_2d_landmarks_full_rotated(48, 0) - flattened_2d_landmarks_full_rotated(54, 0), 2) +
-    //                                     std::pow(flattened_2d_landmarks_full_rotated(48, 1) - flattened_2d_landmarks_full_rotated(54, 1), 2));
-    
-    //double mouth_hscale = ideal_mouthdist_h1 / user_mouthdist_h1;
-    
-    // mouth vscale
-    //double ideal_mouthdist_v = std::sqrt(std::pow(centered_landmarks3d(51, 0) - centered_landmarks3d(57, 0), 2.0) +  std::pow(centered_landmarks3d(51, 1) - centered_landmarks3d(57, 1), 2.0));
-    //double user_mouthdist_v = std::sqrt(std::pow(flattened_2d_landmarks_full_rotated(51, 0) - flattened_2d_landmarks_full_rotated(57, 0), 2) +
-    //                                    std::pow(flattened_2d_landmarks_full_rotated(51, 1) - flattened_2d_landmarks_full_rotated(57, 1), 2));
-    
-    //double mouth_vscale = ideal_mouthdist_v / user_mouthdist_v;
-    
-    scaling_factors[0] = eye_hscale;
-    scaling_factors[1] = eye_vscale;
-    scaling_factors[2] = nose_hscale;
-    scaling_factors[3] = nose_vscale;
-    scaling_factors[4] = 0.98;//mouth_hscale;
-    scaling_factors[5] = 0.98;//mouth_vscale;
-}
-
-PhiPoint * apply_3d_golden_inner_face_warp_handsome(int * landmarks_ptr, double * parameters, double * factr, double * scaling_factors) {
-    
-    
-    // CALLER MUST FREE MEMORY ON RETURN.
-    double eye_hscale = scaling_factors[0];
-    double eye_vscale = scaling_factors[1];
-    double nose_hscale = scaling_factors[2];
-    double nose_vscale = scaling_factors[3];
-    double mouth_hscale = scaling_factors[4];
-    double mouth_vscale = scaling_factors[5];
-    
-    dlib::matrix<int, 68, 2> landmarks_i = dlib::mat(landmarks_ptr, 68, 2);
-    //    std::cout << landmarks_i << std::endl;
-    dlib::matrix<double, 68, 2> landmarks = dlib::matrix_cast<double>(landmarks_i);
-    //    std::cout << landmarks << std::endl;
-    
-    dlib::matrix<double> mean_landmarks = dlib::rowm(landmarks,30);
-    dlib::matrix<double> centered_landmarks = landmarks;
-    dlib::set_colm(centered_landmarks,0) = colm(centered_landmarks,0) - mean_landmarks(0,0);
-    dlib::set_colm(centered_landmarks,1) = colm(centered_landmarks,1) - mean_landmarks(0,1);
-    
-    double *dlib_3d = landmarks3d_male;
-    
-    dlib::matrix<double,68,3> landmarks3d = dlib::mat(dlib_3d, 68, 3);
-    dlib::matrix<double> mean_landmarks3d = dlib::rowm(landmarks3d,30);
-    dlib::matrix<double> centered_landmarks3d = landmarks3d;
-    dlib::set_colm(centered_landmarks3d,0) = colm(centered_landmarks3d,0) - mean_landmarks3d(0,0);
-    dlib::set_colm(centered_landmarks3d,1) = colm(centered_landmarks3d,1) - mean_landmarks3d(0,1);
-    dlib::set_colm(centered_landmarks3d,2) = colm(centered_landmarks3d,2) - mean_landmarks3d(0,2);
-    
-    dlib::matrix<double> rotation_matrix = find_overall_rotation_matrix(centered_landmarks, centered_landmarks3d, parameters);
-    
-    dlib::matrix<double,68,3> flattened_2d_landmarks_full = centered_landmarks3d * rotation_matrix;
-    dlib::set_subm(flattened_2d_landmarks_full, dlib::range(0,67), dlib::range(0,1)) = centered_landmarks;
-    dlib::matrix<double,68,3> flattened_2d_landmarks_full_rotated = flattened_2d_landmarks_full * dlib::inv(rotation_matrix);
-    
-    
-    dlib::matrix<long> dlib_leye_range(1,leye_dlib.size());
-    for (int i = 0; i < leye_dlib.size(); i++ )
-    {
-        dlib_leye_range(0,i) = (long)leye_dlib[i];
-    }
-    dlib::matrix<double> dlib_leye = dlib::subm(flattened_2d_landmarks_full_rotated, dlib_leye_range, dlib::range(0,2));
-    
-    double dlib_leye_mean[2];
-    dlib_leye_mean[0] = dlib::mean(dlib::colm(dlib_leye,0));
-    dlib_leye_mean[1] = dlib::mean(dlib::colm(dlib_leye,1));
-    
-    dlib::set_colm(dlib_leye,0) = ((dlib::colm(dlib_leye,0) - dlib_leye_mean[0]) * eye_hscale) + dlib_leye_mean[0];
-    dlib::set_colm(dlib_leye,1) = ((dlib::colm(dlib_leye,1) - dlib_leye_mean[1]) * eye_vscale) + dlib_leye_mean[1];
-    
-    dlib::set_subm(flattened_2d_landmarks_full_rotated, dlib_leye_range, dlib::range(0,2)) = dlib_leye;
-    
-    dlib::matrix<long> dlib_reye_range(1,reye_dlib.size());
-    for (int i = 0; i < reye_dlib.size(); i++ )
-    {
-        dlib_reye_range(0,i) = (long)reye_dlib[i];
-    }
-    dlib::matrix<double> dlib_reye = dlib::subm(flattened_2d_landmarks_full_rotated, dlib_reye_range, dlib::range(0,2));
-    
-    double dlib_reye_mean[2];
-    dlib_reye_mean[0] = dlib::mean(dlib::colm(dlib_reye,0));
-    dlib_reye_mean[1] = dlib::mean(dlib::colm(dlib_reye,1));
-    
-    dlib::set_colm(dlib_reye,0) = ((dlib::colm(dlib_reye,0) - dlib_reye_mean[0]) * eye_hscale) + dlib_reye_mean[0];
-    dlib::set_colm(dlib_reye,1) = ((dlib::colm(dlib_reye,1) - dlib_reye_mean[1]) * eye_vscale) + dlib_reye_mean[1];
-    
-    dlib::set_subm(flattened_2d_landmarks_full_rotated, dlib_reye_range, dlib::range(0,2)) = dlib_reye;
-    
-    
-    dlib::matrix<long> dlib_nose_range(1,nose_dlib.size());
-    for (int i = 0; i < nose_dlib.size(); i++ )
-    {
-        dlib_nose_range(0,i) = (long)nose_dlib[i];
-    }
-    dlib::matrix<double> dlib_nose = dlib::subm(flattened_2d_landmarks_full_rotated, dlib_nose_range, dlib::range(0,2));
-    
-    double dlib_nose_mean[2];
-    dlib_nose_mean[0] = dlib::mean(dlib::colm(dlib_nose,0));
-    dlib_nose_mean[1] = dlib::mean(dlib::colm(dlib_nose,1));
-    
-    dlib::set_colm(dlib_nose,0) = ((dlib::colm(dlib_nose,0) - dlib_nose_mean[0]) * nose_hscale) + dlib_nose_mean[0];
-    dlib::set_colm(dlib_nose,1) = ((dlib::colm(dlib_nose,1) - dlib_nose_mean[1]) * nose_vscale) + dlib_nose_mean[1];
-    
-    dlib::set_subm(flattened_2d_landmarks_full_rotated, dlib_nose_range, dlib::range(0,2)) = dlib_nose;
-    
-    
-    
-    //
-    dlib::matrix<long> dlib_mouth_range(1,outermouth_dlib.size());
-    for (int i = 0; i < outermouth_dlib.size(); i++ )
-    {
-        dlib_mouth_range(0,i) = (long)outermouth_dlib[i];
-    }
-    dlib::matrix<double> dlib_mouth = dlib::subm(flattened_2d_landmarks_full_rotated, dlib_mouth_range, dlib::range(0,2));
-    
-    double dlib_mouth_mean[2];
-    dlib_mouth_mean[0] = dlib::mean(dlib::colm(dlib_mouth,0));
-    dlib_mouth_mean[1] = dlib::mean(dlib::colm(dlib_mouth,1));
-    
-    dlib::set_colm(dlib_mouth,0) = ((dlib::colm(dlib_mouth,0) - dlib_mouth_mean[0]) * mouth_hscale) + dlib_mouth_mean[0];
-    dlib::set_colm(dlib_mouth,1) = ((dlib::colm(dlib_mouth,1) - dlib_mouth_mean[1]) * mouth_vscale) + dlib_mouth_mean[1];
-    
-    dlib::set_subm(flattened_2d_landmarks_full_rotated, dlib_mouth_range, dlib::range(0,2)) = dlib_mouth;
-    //
-    dlib::matrix<long> dlib_mouth_inner_range(1,innermouth_dlib.size());
-    for (int i = 0; i < innermouth_dlib.size(); i++ )
-    {
-        dlib_mouth_inner_range(0,i) = (long)innermouth_dlib[i];
-    }
-    dlib::matrix<double> dlib_mouth_inner = dlib::subm(flattened_2d_landmarks_full_rotated, dlib_mouth_inner_range, dlib::range(0,2));
-    
-    double dlib_mouth_inner_mean[2];
-    dlib_mouth_inner_mean[0] = dlib::mean(dlib::colm(dlib_mouth_inner,0));
-    dlib_mouth_inner_mean[1] = dlib::mean(dlib::colm(dlib_mouth_inner,1));
-    
-    dlib::set_colm(dlib_mouth_inner,0) = ((dlib::colm(dlib_mouth_inner,0) - dlib_mouth_inner_mean[0]) * mouth_hscale) + dlib_mouth_inner_mean[0];
-    dlib::set_colm(dlib_mouth_inner,1) = ((dlib::colm(dlib_mouth_inner,1) - dlib_mouth_inner_mean[1]) * mouth_vscale) + dlib_mouth_inner_mean[1];
-    
-    dlib::set_subm(flattened_2d_landmarks_full_rotated, dlib_mouth_inner_range, dlib::range(0,2)) = dlib_mouth_inner;
-    
-    //
-    
-    
-    
-    dlib::matrix<double, 68,2> _2d_landmarks_full;
-    _2d_landmarks_full = dlib::subm(flattened_2d_landmarks_full_rotated * rotation_matrix, dlib::range(0,67), dlib::range(0,1));
-    
-    
-    dlib::set_colm(_2d_landmarks_full,0) = colm(_2d_landmarks_full,0) + mean_landmarks(0,0);
-    dlib::set_colm(_2d_landmarks_full,1) = colm(_2d_landmarks_full,1) + mean_landmarks(0,1);
-    
-    _2d_landmarks_full = adjust_warp_for_angle(landmarks, _2d_landmarks_full, *factr);
-    
-    PhiPoint * output = (PhiPoint *)malloc(_2d_landmarks_full.nr()*sizeof(PhiPoint));
-    for (int row = 0; row < _2d_landmarks_full.nr(); row++)
-    {
-        output[row] = PhiPoint{
-            static_cast<int>(std::round(_2d_landmarks_full(row,0))),
-            static_cast<int>(std::round(_2d_landmarks_full(row,1)))
-        };
-        
-    }
-    
-    return output;
-};
-//
-PhiPoint * return_3d_attractive_adjusted_warp_pretty(int * landmarks_ptr, double * parameters, double * factr)
-{
-    // CALLER MUST FREE MEMORY ON RETURN.
-    const double nose_scaling_x = 0.9;
-    const double nose_scaling_y = 0.9;
-    
-    const double eye_scaling_x = 1.05;
-    const double eye_scaling_y = 1.05;
-    
-    dlib::matrix<int, 68, 2> landmarks_i = dlib::mat(landmarks_ptr, 68, 2);
-    
-    dlib::matrix<double, 68, 2> landmarks = dlib::matrix_cast<double>(landmarks_i);
-    
-    dlib::matrix<double> mean_landmarks = dlib::rowm(landmarks,30);
-    dlib::matrix<double> centered_landmarks = landmarks;
-    dlib::set_colm(centered_landmarks,0) = colm(centered_landmarks,0) - mean_landmarks(0,0);
-    dlib::set_colm(centered_landmarks,1) = colm(centered_landmarks,1) - mean_landmarks(0,1);
-    
-    double *dlib_3d = landmarks3d_female;
-    dlib::matrix<double,68,3> landmarks3d = dlib::mat(dlib_3d, 68, 3);
-    dlib::matrix<double> mean_landmarks3d = dlib::rowm(landmarks3d,30);
-    dlib::matrix<double> centered_landmarks3d = landmarks3d;
-    dlib::set_colm(centered_landmarks3d,0) = colm(centered_landmarks3d,0) - mean_landmarks3d(0,0);
-    dlib::set_colm(centered_landmarks3d,1) = colm(centered_landmarks3d,1) - mean_landmarks3d(0,1);
-    dlib::set_colm(centered_landmarks3d,2) = colm(centered_landmarks3d,2) - mean_landmarks3d(0,2);
-    
-    dlib::matrix<double> rotation_matrix = find_overall_rotation_matrix(centered_landmarks, centered_landmarks3d, parameters);
-    
-    dlib::matrix<double,68,3> flattened_2d_landmarks_full = centered_landmarks3d * rotation_matrix;
-    dlib::set_subm(flattened_2d_landmarks_full, dlib::range(0,67), dlib::range(0,1)) = centered_landmarks;
-    dlib::matrix<double,68,3> flattened_2d_landmarks_full_rotated = flattened_2d_landmarks_full * dlib::inv(rotation_matrix);
-    
-    dlib::matrix<long> dlib_leye_range(1,leye_dlib.size());
-    for (int i = 0; i < leye_dlib.size(); i++ )
-    {
-        dlib_leye_range(0,i) = (long)leye_dlib[i];
-    }
-    dlib::matrix<double> dlib_leye = dlib::subm(flattened_2d_landmarks_full_rotated, dlib_leye_range, dlib::range(0,2));
-    
-    double dlib_leye_mean[2];
-    dlib_leye_mean[0] = dlib::mean(dlib::colm(dlib_leye,0));
-    dlib_leye_mean[1] = dlib::mean(dlib::colm(dlib_leye,1));
-    
-    dlib::set_colm(dlib_leye,0) = ((dlib::colm(dlib_leye,0) - dlib_leye_mean[0]) * eye_scaling_x) + dlib_leye_mean[0];
-    dlib::set_colm(dlib_leye,1) = ((dlib::colm(dlib_leye,1) - dlib_leye_mean[1]) * eye_scaling_y) + dlib_leye_mean[1];
-    
-    dlib::matrix<long> dlib_reye_range(1,reye_dlib.size());
-    for (int i = 0; i < reye_dlib.size(); i++ )
-    {
-        dlib_reye_range(0,i) = (long)reye_dlib[i];
-    }
-    dlib::matrix<double> dlib_reye = dlib::subm(flattened_2d_landmarks_full_rotated, dlib_reye_range, dlib::range(0,2));
-    
-    double dlib_reye_mean[2];
-    dlib_reye_mean[0] = dlib::mean(dlib::colm(dlib_reye,0));
-    dlib_reye_mean[1] = dlib::mean(dlib::colm(dlib_reye,1));
-    
-    dlib::set_colm(dlib_reye,0) = ((dlib::colm(dlib_reye,0) - dlib_reye_mean[0]) * eye_scaling_x) + dlib_reye_mean[0];
-    dlib::set_colm(dlib_reye,1) = ((dlib::colm(dlib_reye,1) - dlib_reye_mean[1]) * eye_scaling_y) + dlib_reye_mean[1];
-    
-    dlib::set_subm(flattened_2d_landmarks_full_rotated, dlib_leye_range, dlib::range(0,2)) = dlib_leye;
-    dlib::set_subm(flattened_2d_landmarks_full_rotated, dlib_reye_range, dlib::range(0,2)) = dlib_reye;
-    
-    //
-    dlib::matrix<long> dlib_nose_range(1,nose_dlib_edge.size());
-    for (int i = 0; i < nose_dlib_edge.size(); i++ )
-    {
-        dlib_nose_range(0,i) = (long)nose_dlib_edge[i];
-    }
-    dlib::matrix<double> dlib_nose = dlib::subm(flattened_2d_landmarks_full_rotated, dlib_nose_range, dlib::range(0,2));
-    
-    double dlib_nose_mean[2];
-    dlib_nose_mean[0] = dlib_nose(2,0);
-    dlib_nose_mean[1] = dlib_nose(2,1);
-    
-    dlib::set_colm(dlib_nose,0) = ((dlib::colm(dlib_nose,0) - dlib_nose_mean[0]) * nose_scaling_x) + dlib_nose_mean[0];
-    dlib::set_colm(dlib_nose,1) = ((dlib::colm(dlib_nose,1) - dlib_nose_mean[1]) * nose_scaling_y) + dlib_nose_mean[1];
-    
-    dlib::set_subm(flattened_2d_landmarks_full_rotated, dlib_nose_range, dlib::range(0,2)) = dlib_nose;
-    //
-    
-    dlib::matrix<double,68,3> tmp = flattened_2d_landmarks_full_rotated * rotation_matrix;
-    dlib::matrix<double, 68,2> _2d_landmarks_full = dlib::subm(tmp, dlib::range(0,67), dlib::range(0,1));
-    
-    
-    dlib::set_colm(_2d_landmarks_full,0) = colm(_2d_landmarks_full,0) + mean_landmarks(0,0);
-    dlib::set_colm(_2d_landmarks_full,1) = colm(_2d_landmarks_full,1) + mean_landmarks(0,1);
-    
-    _2d_landmarks_full = adjust_warp_for_angle(landmarks, _2d_landmarks_full, *factr);
-    
-    PhiPoint * output = (PhiPoint *)malloc(_2d_landmarks_full.nr()*sizeof(PhiPoint));
-    for (int row = 0; row < _2d_landmarks_full.nr(); row++)
-    {
-        output[row] = PhiPoint{
-            static_cast<int>(std::round(_2d_landmarks_full(row,0))),
-            static_cast<int>(std::round(_2d_landmarks_full(row,1)))
-        };
-        
-    };
-    return output;
-    
-};
-
-PhiPoint * return_3d_attractive_adjusted_warp_handsome(int * landmarks_ptr, double * parameters, double * factr)
-{
-    // CALLER MUST FREE MEMORY ON RETURN.
-    const double nose_scaling_x = 0.95;
-    const double nose_scaling_y = 0.92;
-    
-    const double eye_scaling_x = 1.05;
-    const double eye_scaling_y = 1.02;
-    
-    dlib::matrix<int, 68, 2> landmarks_i = dlib::mat(landmarks_ptr, 68, 2);
-    
-    dlib::matrix<double, 68, 2> landmarks = dlib::matrix_cast<double>(landmarks_i);
-    
-    dlib::matrix<double> mean_landmarks = dlib::rowm(landmarks,30);
-    dlib::matrix<double> centered_landmarks = landmarks;
-    dlib::set_colm(centered_landmarks,0) = colm(centered_landmarks,0) - mean_landmarks(0,0);
-    dlib::set_colm(centered_landmarks,1) = colm(centered_landmarks,1) - mean_landmarks(0,1);
-    
-    double *dlib_3d = landmarks3d_male;
-    dlib::matrix<double,68,3> landmarks3d = dlib::mat(dlib_3d, 68, 3);
-    dlib::matrix<double> mean_landmarks3d = dlib::rowm(landmarks3d,30);
-    dlib::matrix<double> centered_landmarks3d = landmarks3d;
-    dlib::set_colm(centered_landmarks3d,0) = colm(centered_landmarks3d,0) - mean_landmarks3d(0,0);
-    dlib::set_colm(centered_landmarks3d,1) = colm(centered_landmarks3d,1) - mean_landmarks3d(0,1);
-    dlib::set_colm(centered_landmarks3d,2) = colm(centered_landmarks3d,2) - mean_landmarks3d(0,2);
-    
-    dlib::matrix<double> rotation_matrix = find_overall_rotation_matrix(centered_landmarks, centered_landmarks3d, parameters);
-    
-    dlib::matrix<double,68,3> flattened_2d_landmarks_full = centered_landmarks3d * rotation_matrix;
-    dlib::set_subm(flattened_2d_landmarks_full, dlib::range(0,67), dlib::range(0,1)) = centered_landmarks;
-    dlib::matrix<double,68,3> flattened_2d_landmarks_full_rotated = flattened_2d_landmarks_full * dlib::inv(rotation_matrix);
-    
-    dlib::matrix<long> dlib_leye_range(1,leye_dlib.size());
-    for (int i = 0; i < leye_dlib.size(); i++ )
-    {
-        dlib_leye_range(0,i) = (long)leye_dlib[i];
-    }
-    dlib::matrix<double> dlib_leye = dlib::subm(flattened_2d_landmarks_full_rotated, dlib_leye_range, dlib::range(0,2));
-    
-    double dlib_leye_mean[2];
-    dlib_leye_mean[0] = dlib::mean(dlib::colm(dlib_leye,0));
-    dlib_leye_mean[1] = dlib::mean(dlib::colm(dlib_leye,1));
-    
-    dlib::set_colm(dlib_leye,0) = ((dlib::colm(dlib_leye,0) - dlib_leye_mean[0]) * eye_scaling_x) + dlib_leye_mean[0];
-    dlib::set_colm(dlib_leye,1) = ((dlib::colm(dlib_leye,1) - dlib_leye_mean[1]) * eye_scaling_y) + dlib_leye_mean[1];
-    
-    dlib::matrix<long> dlib_reye_range(1,reye_dlib.size());
-    for (int i = 0; i < reye_dlib.size(); i++ )
-    {
-        dlib_reye_range(0,i) = (long)reye_dlib[i];
-    }
-    dlib::matrix<double> dlib_reye = dlib::subm(flattened_2d_landmarks_full_rotated, dlib_reye_range, dlib::range(0,2));
-    
-    double dlib_reye_mean[2];
-    dlib_reye_mean[0] = dlib::mean(dlib::colm(dlib_reye,0));
-    dlib_reye_mean[1] = dlib::mean(dlib::colm(dlib_reye,1));
-    
-    dlib::set_colm(dlib_reye,0) = ((dlib::colm(dlib_reye,0) - dlib_reye_mean[0]) * eye_scaling_x) + dlib_reye_mean[0];
-    dlib::set_colm(dlib_reye,1) = ((dlib::colm(dlib_reye,1) - dlib_reye_mean[1]) * eye_scaling_y) + dlib_reye_mean[1];
-    
-    dlib::set_subm(flattened_2d_landmarks_full_rotated, dlib_leye_range, dlib::range(0,2)) = dlib_leye;
-    dlib::set_subm(flattened_2d_landmarks_full_rotated, dlib_reye_range, dlib::range(0,2)) = dlib_reye;
-    
-    //
-    dlib::matrix<long> dlib_nose_range(1,nose_dlib_edge.size());
-    for (int i = 0; i < nose_dlib_edge.size(); i++ )
-    {
-        dlib_nose_range(0,i) = (long)nose_dlib_edge[i];
-    }
-    dlib::matrix<double> dlib_nose = dlib::subm(flattened_2d_landmarks_full_rotated, dlib_nose_range, dlib::range(0,2));
-    
-    double dlib_nose_mean[2];
-    dlib_nose_mean[0] = dlib_nose(2,0);
-    dlib_nose_mean[1] = dlib_nose(2,1);
-    
-    dlib::set_colm(dlib_nose,0) = ((dlib::colm(dlib_nose,0) - dlib_nose_mean[0]) * nose_scaling_x) + dlib_nose_mean[0];
-    dlib::set_colm(dlib_nose,1) = ((dlib::colm(dlib_nose,1) - dlib_nose_mean[1]) * nose_scaling_y) + dlib_nose_mean[1];
-    
-    dlib::set_subm(flattened_2d_landmarks_full_rotated, dlib_nose_range, dlib::range(0,2)) = dlib_nose;
-    //
-    
-    dlib::matrix<double,68,3> tmp = flattened_2d_landmarks_full_rotated * rotation_matrix;
-    dlib::matrix<double, 68,2> _2d_landmarks_full = dlib::subm(tmp, dlib::range(0,67), dlib::range(0,1));
-    
-    
-    dlib::set_colm(_2d_landmarks_full,0) = colm(_2d_landmarks_full,0) + mean_landmarks(0,0);
-    dlib::set_colm(_2d_landmarks_full,1) = colm(_2d_landmarks_full,1) + mean_landmarks(0,1);
-    
-    _2d_landmarks_full = adjust_warp_for_angle(landmarks, _2d_landmarks_full, *factr);
-    
-    PhiPoint * output = (PhiPoint *)malloc(_2d_landmarks_full.nr()*sizeof(PhiPoint));
-    for (int row = 0; row < _2d_landmarks_full.nr(); row++)
-    {
-        output[row] = PhiPoint{
-            static_cast<int>(std::round(_2d_landmarks_full(row,0))),
-            static_cast<int>(std::round(_2d_landmarks_full(row,1)))
-        };
-        
-    };
-    return output;
-    
-};
-
-PhiPoint * return_3d_attractive_adjusted_warp2(int * landmarks_ptr, double * parameters, double*factr)
-{
-    // CALLER MUST FREE MEMORY ON RETURN.
-    const double nose_scaling_x = 0.8;
-    const double nose_scaling_y = 0.9;
-    
-    const double eye_scaling_x = 1.1;
-    const double eye_scaling_y = 1.1;
-    
-    dlib::matrix<int, 68, 2> landmarks_i = dlib::mat(landmarks_ptr, 68, 2);
-    
-    dlib::matrix<double, 68, 2> landmarks = dlib::matrix_cast<double>(landmarks_i);
-    
-    dlib::matrix<double> mean_landmarks = dlib::rowm(landmarks,30);
-    dlib::matrix<double> centered_landmarks = landmarks;
-    dlib::set_colm(centered_landmarks,0) = colm(centered_landmarks,0) - mean_landmarks(0,0);
-    dlib::set_colm(centered_landmarks,1) = colm(centered_landmarks,1) - mean_landmarks(0,1);
-    
-    double *dlib_3d = landmarks3d_dlib;
-    dlib::matrix<double,68,3> landmarks3d = dlib::mat(dlib_3d, 68, 3);
-    dlib::matrix<double> mean_landmarks3d = dlib::rowm(landmarks3d,30);
-    dlib::matrix<double> centered_landmarks3d = landmarks3d;
-    dlib::set_colm(centered_landmarks3d,0) = colm(centered_landmarks3d,0) - mean_landmarks3d(0,0);
-    dlib::set_colm(centered_landmarks3d,1) = colm(centered_landmarks3d,1) - mean_landmarks3d(0,1);
-    dlib::set_colm(centered_landmarks3d,2) = colm(centered_landmarks3d,2) - mean_landmarks3d(0,2);
-    
-    dlib::matrix<double> rotation_matrix = find_overall_rotation_matrix(centered_landmarks, centered_landmarks3d, parameters);
-    
-    dlib::matrix<double,68,3> flattened_2d_landmarks_full = centered_landmarks3d * rotation_matrix;
-    dlib::set_subm(flattened_2d_landmarks_full, dlib::range(0,67), dlib::range(0,1)) = centered_landmarks;
-    dlib::matrix<double,68,3> flattened_2d_landmarks_full_rotated = flattened_2d_landmarks_full * dlib::inv(rotation_matrix);
-    
-    dlib::matrix<long> dlib_leye_range(1,leye_dlib.size());
-    for (int i = 0; i < leye_dlib.size(); i++ )
-    {
-        dlib_leye_range(0,i) = (long)leye_dlib[i];
-    }
-    dlib::matrix<double> dlib_leye = dlib::subm(flattened_2d_landmarks_full_rotated, dlib_leye_range, dlib::range(0,2));
-    
-    double dlib_leye_mean[2];
-    dlib_leye_mean[0] = dlib::mean(dlib::colm(dlib_leye,0));
-    dlib_leye_mean[1] = dlib::mean(dlib::colm(dlib_leye,1));
-    
-    dlib::set_colm(dlib_leye,0) = ((dlib::colm(dlib_leye,0) - dlib_leye_mean[0]) * eye_scaling_x) + dlib_leye_mean[0];
-    dlib::set_colm(dlib_leye,1) = ((dlib::colm(dlib_leye,1) - dlib_leye_mean[1]) * eye_scaling_y) + dlib_leye_mean[1];
-    
-    dlib::matrix<long> dlib_reye_range(1,reye_dlib.size());
-    for (int i = 0; i < reye_dlib.size(); i++ )
-    {
-        dlib_reye_range(0,i) = (long)reye_dlib[i];
-    }
-    dlib::matrix<double> dlib_reye = dlib::subm(flattened_2d_landmarks_full_rotated, dlib_reye_range, dlib::range(0,2));
-    
-    double dlib_reye_mean[2];
-    dlib_reye_mean[0] = dlib::mean(dlib::colm(dlib_reye,0));
-    dlib_reye_mean[1] = dlib::mean(dlib::colm(dlib_reye,1));
-    
-    dlib::set_colm(dlib_reye,0) = ((dlib::colm(dlib_reye,0) - dlib_reye_mean[0]) * eye_scaling_x) + dlib_reye_mean[0];
-    dlib::set_colm(dlib_reye,1) = ((dlib::colm(dlib_reye,1) - dlib_reye_mean[1]) * eye_scaling_y) + dlib_reye_mean[1];
-    
-    dlib::set_subm(flattened_2d_landmarks_full_rotated, dlib_leye_range, dlib::range(0,2)) = dlib_leye;
-    dlib::set_subm(flattened_2d_landmarks_full_rotated, dlib_reye_range, dlib::range(0,2)) = dlib_reye;
-    
-    //
-    dlib::matrix<long> dlib_nose_range(1,nose_dlib_edge.size());
-    for (int i = 0; i < nose_dlib_edge.size(); i++ )
-    {
-        dlib_nose_range(0,i) = (long)nose_dlib_edge[i];
-    }
-    dlib::matrix<double> dlib_nose = dlib::subm(flattened_2d_landmarks_full_rotated, dlib_nose_range, dlib::range(0,2));
-    
-    double dlib_nose_mean[2];
-    dlib_nose_mean[0] = dlib_nose(2,0);
-    dlib_nose_mean[1] = dlib_nose(2,1);
-    
-    dlib::set_colm(dlib_nose,0) = ((dlib::colm(dlib_nose,0) - dlib_nose_mean[0]) * nose_scaling_x) + dlib_nose_mean[0];
-    dlib::set_colm(dlib_nose,1) = ((dlib::colm(dlib_nose,1) - dlib_nose_mean[1]) * nose_scaling_y) + dlib_nose_mean[1];
-    
-    dlib::set_subm(flattened_2d_landmarks_full_rotated, dlib_nose_range, dlib::range(0,2)) = dlib_nose;
-    //
-    
-    dlib::matrix<double,68,3> tmp = flattened_2d_landmarks_full_rotated * rotation_matrix;
-    dlib::matrix<double, 68,2> _2d_landmarks_full = dlib::subm(tmp, dlib::range(0,67), dlib::range(0,1));
-    
-    
-    dlib::set_colm(_2d_landmarks_full,0) = colm(_2d_landmarks_full,0) + mean_landmarks(0,0);
-    dlib::set_colm(_2d_landmarks_full,1) = colm(_2d_landmarks_full,1) + mean_landmarks(0,1);
-    
-    _2d_landmarks_full = adjust_warp_for_angle(landmarks, _2d_landmarks_full, *factr);
-    
-    PhiPoint * output = (PhiPoint *)malloc(_2d_landmarks_full.nr()*sizeof(PhiPoint));
-    for (int row = 0; row < _2d_landmarks_full.nr(); row++)
-    {
-        output[row] = PhiPoint{
-            static_cast<int>(std::round(_2d_landmarks_full(row,0))),
-            static_cast<int>(std::round(_2d_landmarks_full(row,1)))
-        };
-        
-    };
-    return output;
-};
-
-
-
-PhiPoint * return_3d_silly_adjusted_warp(int * landmarks_ptr, double * parameters, double * factr )
-{
-    // CALLER MUST FREE MEMORY ON RETURN.
-    const double eye_scaling_x = 1.3;
-    const double eye_scaling_y = 1.5;
-    
-    const double mouth_scaling_x = 0.7;
-    const double mouth_scaling_y = 0.9;
-    
-    const double nose_scaling_x = 0.8;
-    const double nose_scaling_y = 0.8;
-    
-    
-    dlib::matrix<int, 68, 2> landmarks_i = dlib::mat(landmarks_ptr, 68, 2);
-    
-    dlib::matrix<double, 68, 2> landmarks = dlib::matrix_cast<double>(landmarks_i);
-    
-    dlib::matrix<double> mean_landmarks = dlib::rowm(landmarks,30);
-    dlib::matrix<double> centered_landmarks = landmarks;
-    dlib::set_colm(centered_landmarks,0) = colm(centered_landmarks,0) - mean_landmarks(0,0);
-    dlib::set_colm(centered_landmarks,1) = colm(centered_landmarks,1) - mean_landmarks(0,1);
-    
-    double *dlib_3d = landmarks3d_dlib;
-    dlib::matrix<double,68,3> landmarks3d = dlib::mat(dlib_3d, 68, 3);
-    dlib::matrix<double> mean_landmarks3d = dlib::rowm(landmarks3d,30);
-    dlib::matrix<double> centered_landmarks3d = landmarks3d;
-    dlib::set_colm(centered_landmarks3d,0) = colm(centered_landmarks3d,0) - mean_landmarks3d(0,0);
-    dlib::set_colm(centered_landmarks3d,1) = colm(centered_landmarks3d,1) - mean_landmarks3d(0,1);
-    dlib::set_colm(centered_landmarks3d,2) = colm(centered_landmarks3d,2) - mean_landmarks3d(0,2);
-    
-    dlib::matrix<double> rotation_matrix = find_overall_rotation_matrix(centered_landmarks, centered_landmarks3d, parameters);
-    
-    dlib::matrix<double,68,3> flattened_2d_landmarks_full = centered_landmarks3d * rotation_matrix;
-    dlib::set_subm(flattened_2d_landmarks_full, dlib::range(0,67), dlib::range(0,1)) = centered_landmarks;
-    dlib::matrix<double,68,3> flattened_2d_landmarks_full_rotated = flattened_2d_landmarks_full * dlib::inv(rotation_matrix);
-    
-    dlib::matrix<long> dlib_leye_range(1,leye_dlib.size());
-    for (int i = 0; i < leye_dlib.size(); i++ )
-    {
-        dlib_leye_range(0,i) = (long)leye_dlib[i];
-    }
-    dlib::matrix<double> dlib_leye = dlib::subm(flattened_2d_landmarks_full_rotated, dlib_leye_range, dlib::range(0,2));
-    
-    double dlib_leye_mean[2];
-    dlib_leye_mean[0] = dlib::mean(dlib::colm(dlib_leye,0));
-    dlib_leye_mean[1] = dlib::mean(dlib::colm(dlib_leye,1));
-    
-    dlib::set_colm(dlib_leye,0) = ((dlib::colm(dlib_leye,0) - dlib_leye_mean[0]) * eye_scaling_x) + dlib_leye_mean[0];
-    dlib::set_colm(dlib_leye,1) = ((dlib::colm(dlib_leye,1) - dlib_leye_mean[1]) * eye_scaling_y) + dlib_leye_mean[1];
-    
-    dlib::matrix<long> dlib_reye_range(1,reye_dlib.size());
-    for (int i = 0; i < reye_dlib.size(); i++ )
-    {
-        dlib_reye_range(0,i) = (long)reye_dlib[i];
-    }
-    dlib::matrix<double> dlib_reye = dlib::subm(flattened_2d_landmarks_full_rotated, dlib_reye_range, dlib::range(0,2));
-    
-    double dlib_reye_mean[2];
-    dlib_reye_mean[0] = dlib::mean(dlib::colm(dlib_reye,0));
-    dlib_reye_mean[1] = dlib::mean(dlib::colm(dlib_reye,1));
-    
-    dlib::set_colm(dlib_reye,0) = ((dlib::colm(dlib_reye,0) - dlib_reye_mean[0]) * eye_scaling_x) + dlib_reye_mean[0];
-    dlib::set_colm(dlib_reye,1) = ((dlib::colm(dlib_reye,1) - dlib_reye_mean[1]) * eye_scaling_y) + dlib_reye_mean[1];
-    
-    dlib::set_subm(flattened_2d_landmarks_full_rotated, dlib_leye_range, dlib::range(0,2)) = dlib_leye;
-    dlib::set_subm(flattened_2d_landmarks_full_rotated, dlib_reye_range, dlib::range(0,2)) = dlib_reye;
-    
-    //
-    dlib::matrix<long> dlib_mouth_range(1,outermouth_dlib.size());
-    for (int i = 0; i < outermouth_dlib.size(); i++ )
-    {
-        dlib_mouth_range(0,i) = (long)outermouth_dlib[i];
-    }
-    dlib::matrix<double> dlib_mouth = dlib::subm(flattened_2d_landmarks_full_rotated, dlib_mouth_range, dlib::range(0,2));
-    
-    double dlib_mouth_mean[2];
-    dlib_mouth_mean[0] = dlib::mean(dlib::colm(dlib_mouth,0));
-    dlib_mouth_mean[1] = dlib::mean(dlib::colm(dlib_mouth,1));
-    
-    dlib::set_colm(dlib_mouth,0) = ((dlib::colm(dlib_mouth,0) - dlib_mouth_mean[0]) * mouth_scaling_x) + dlib_mouth_mean[0];
-    dlib::set_colm(dlib_mouth,1) = ((dlib::colm(dlib_mouth,1) - dlib_mouth_mean[1]) * mouth_scaling_y) + dlib_mouth_mean[1];
-    
-    dlib::set_subm(flattened_2d_landmarks_full_rotated, dlib_mouth_range, dlib::range(0,2)) = dlib_mouth;
-    //
-    dlib::matrix<long> dlib_mouth_inner_range(1,innermouth_dlib.size());
-    for (int i = 0; i < innermouth_dlib.size(); i++ )
-    {
-        dlib_mouth_inner_range(0,i) = (long)innermouth_dlib[i];
-    }
-    dlib::matrix<double> dlib_mouth_inner = dlib::subm(flattened_2d_landmarks_full_rotated, dlib_mouth_inner_range, dlib::range(0,2));
-    
-    double dlib_mouth_inner_mean[2];
-    dlib_mouth_inner_mean[0] = dlib::mean(dlib::colm(dlib_mouth_inner,0));
-    dlib_mouth_inner_mean[1] = dlib::mean(dlib::colm(dlib_mouth_inner,1));
-    
-    dlib::set_colm(dlib_mouth_inner,0) = ((dlib::colm(dlib_mouth_inner,0) - dlib_mouth_inner_mean[0]) * mouth_scaling_x) + dlib_mouth_inner_mean[0];
-    dlib::set_colm(dlib_mouth_inner,1) = ((dlib::colm(dlib_mouth_inner,1) - dlib_mouth_inner_mean[1]) * mouth_scaling_y) + dlib_mouth_inner_mean[1];
-    
-    dlib::set_subm(flattened_2d_landmarks_full_rotated, dlib_mouth_inner_range, dlib::range(0,2)) = dlib_mouth_inner;
-    
-    //
-    dlib::matrix<long> dlib_nose_range(1,nose_dlib_edge.size());
-    for (int i = 0; i < nose_dlib_edge.size(); i++ )
-    {
-        dlib_nose_range(0,i) = (long)nose_dlib_edge[i];
-    }
-    dlib::matrix<double> dlib_nose = dlib::subm(flattened_2d_landmarks_full_rotated, dlib_nose_range, dlib::range(0,2));
-    
-    double dlib_nose_mean[2];
-    dlib_nose_mean[0] = dlib_nose(2,0);
-    dlib_nose_mean[1] = dlib_nose(2,1);
-    
-    dlib::set_colm(dlib_nose,0) = ((dlib::colm(dlib_nose,0) - dlib_nose_mean[0]) * nose_scaling_x) + dlib_nose_mean[0];
-    dlib::set_colm(dlib_nose,1) = ((dlib::colm(dlib_nose,1) - dlib_nose_mean[1]) * nose_scaling_y) + dlib_nose_mean[1];
-    
-    dlib::set_subm(flattened_2d_landmarks_full_rotated, dlib_nose_range, dlib::range(0,2)) = dlib_nose;
-    //
-    
-    dlib::matrix<double,68,3> tmp = flattened_2d_landmarks_full_rotated * rotation_matrix;
-    dlib::matrix<double, 68,2> _2d_landmarks_full = dlib::subm(tmp, dlib::range(0,67), dlib::range(0,1));
-    
-    
-    dlib::set_colm(_2d_landmarks_full,0) = colm(_2d_landmarks_full,0) + mean_landmarks(0,0);
-    dlib::set_colm(_2d_landmarks_full,1) = colm(_2d_landmarks_full,1) + mean_landmarks(0,1);
-    
-    _2d_landmarks_full = adjust_warp_for_angle(landmarks, _2d_landmarks_full, *factr);
-    
-    PhiPoint * output = (PhiPoint *)malloc(_2d_landmarks_full.nr()*sizeof(PhiPoint));
-    for (int row = 0; row < _2d_landmarks_full.nr(); row++)
-    {
-        output[row] = PhiPoint{
-            static_cast<int>(std::round(_2d_landmarks_full(row,0))),
-            static_cast<int>(std::round(_2d_landmarks_full(row,1)))
-        };
-        
-    };
-    return output;
+    reproject_landmarks(frontal, pose.rotation_matrix, pose.landmarks[30], warped);
 };
 
-PhiPoint3D * return_3d_point_set(int * landmarks_ptr, double * parameters, double * factr )
+class warp_engine
 {
-    // CALLER MUST FREE MEMORY ON RETURN.
-    
-    dlib::matrix<int, 68, 2> landmarks_i = dlib::mat(landmarks_ptr, 68, 2);
-    
-    dlib::matrix<double, 68, 2> landmarks = dlib::matrix_cast<double>(landmarks_i);
-    
-    dlib::matrix<double> mean_landmarks = dlib::rowm(landmarks,30);
-    dlib::matrix<double> centered_landmarks = landmarks;
-    dlib::set_colm(centered_landmarks,0) = colm(centered_landmarks,0) - mean_landmarks(0,0);
-    dlib::set_colm(centered_landmarks,1) = colm(centered_landmarks,1) - mean_landmarks(0,1);
-    
-    double *dlib_3d = landmarks3d_dlib;
-    dlib::matrix<double,68,3> landmarks3d = dlib::mat(dlib_3d, 68, 3);
-    dlib::matrix<double> mean_landmarks3d = dlib::rowm(landmarks3d,30);
-    dlib::matrix<double> centered_landmarks3d = landmarks3d;
-    dlib::set_colm(centered_landmarks3d,0) = colm(centered_landmarks3d,0) - mean_landmarks3d(0,0);
-    dlib::set_colm(centered_landmarks3d,1) = colm(centered_landmarks3d,1) - mean_landmarks3d(0,1);
-    dlib::set_colm(centered_landmarks3d,2) = colm(centered_landmarks3d,2) - mean_landmarks3d(0,2);
-    
-    dlib::matrix<double> rotation_matrix = find_overall_rotation_matrix(centered_landmarks, centered_landmarks3d, parameters);
-    
-    dlib::matrix<double,68,3> flattened_2d_landmarks_full = centered_landmarks3d * rotation_matrix;
-    dlib::set_subm(flattened_2d_landmarks_full, dlib::range(0,67), dlib::range(0,1)) = centered_landmarks;
+public:
+    warp_engine() : next_slot(0)
+    {
+        for (int i = 0; i < cache_size; i++)
+        {
+            poses[i].tpl = nullptr;
+        }
+    }
     
-    PhiPoint3D * output = (PhiPoint3D *)malloc(flattened_2d_landmarks_full.nr()*sizeof(PhiPoint3D));
-    for (int row = 0; row < flattened_2d_landmarks_full.nr(); row++)
+    const face_pose & solve(const landmarks_2d &landmarks, const face_template &tpl, double * parameters)
     {
-        output[row] = PhiPoint3D{
-            static_cast<int>(std::round(flattened_2d_landmarks_full(row,0))),
-            static_cast<int>(std::round(flattened_2d_landmarks_full(row,1))),
-            static_cast<int>(std::round(flattened_2d_landmarks_full(row,2)))
-        };
+        // The solver is warm started from the parameters, so a pose is only reused for the same
+        // landmarks, template and starting parameters; anything else may converge elsewhere.
+        for (int i = 0; i < cache_size; i++)
+        {
+            if (poses[i].tpl == &tpl && poses[i].landmarks == landmarks && std::equal(parameters, parameters + 7, start_parameters[i]))
+            {
+                std::copy(poses[i].parameters, poses[i].parameters + 7, parameters);
+                return poses[i];
+            }
+        }
         
-    };
-    return output;
+        const int slot = next_slot;
+        next_slot = (next_slot + 1) % cache_size;
+        std::copy(parameters, parameters + 7, start_parameters[slot]);
+        solve_face_pose(landmarks, tpl, parameters, poses[slot]);
+        return poses[slot];
+    }
+    
+private:
+    static const int cache_size = 4;
+    face_pose poses[cache_size];
+    // The parameters each cached pose was solved from
+    double start_parameters[cache_size][7];
+    int next_slot;
 };
 
+warp_engine engine;
 
-PhiPoint * return_face_swap_warp(int * landmarks_face1_ptr, int * landmarks_face2_ptr, double * parameters_face1, double * parameters_face2, double*factr_face1, double*factr_face2)
+// Landmark jitter on a still face is a pixel or two per point, about 2 px aligned RMS between frames.
+const double default_pose_tolerance = 2.5;
+
+// Per-face warp state. Everything a warp reads or updates between frames lives here, so warps
+// of different faces share nothing and can run side by side.
+struct PhiWarpContext
 {
-    // CALLER MUST FREE MEMORY ON RETURN.
-    
-    dlib::matrix<int, 68, 2> landmarks_i1 = dlib::mat(landmarks_face1_ptr, 68, 2);
-    dlib::matrix<int, 68, 2> landmarks_i2 = dlib::mat(landmarks_face2_ptr, 68, 2);
-    
-    dlib::matrix<double, 68, 2> landmarks_face1 = dlib::matrix_cast<double>(landmarks_i1);
-    dlib::matrix<double, 68, 2> landmarks_face2 = dlib::matrix_cast<double>(landmarks_i2);
-    
-    dlib::matrix<double> mean_landmarks_face1 = dlib::rowm(landmarks_face1,30);
-    dlib::matrix<double> centered_landmarks_face1 = landmarks_face1;
-    dlib::set_colm(centered_landmarks_face1,0) = colm(centered_landmarks_face1,0) - mean_landmarks_face1(0,0);
-    dlib::set_colm(centered_landmarks_face1,1) = colm(centered_landmarks_face1,1) - mean_landmarks_face1(0,1);
-    
-    dlib::matrix<double> mean_landmarks_face2 = dlib::rowm(landmarks_face2,30);
-    dlib::matrix<double> centered_landmarks_face2 = landmarks_face2;
-    dlib::set_colm(centered_landmarks_face2,0) = colm(centered_landmarks_face2,0) - mean_landmarks_face2(0,0);
-    dlib::set_colm(centered_landmarks_face2,1) = colm(centered_landmarks_face2,1) - mean_landmarks_face2(0,1);
-    
-    double *dlib_3d = landmarks3d_dlib;
-    dlib::matrix<double,68,3> landmarks3d = dlib::mat(dlib_3d, 68, 3);
-    dlib::matrix<double> mean_landmarks3d = dlib::rowm(landmarks3d,30);
-    dlib::matrix<double> centered_landmarks3d = landmarks3d;
-    dlib::set_colm(centered_landmarks3d,0) = colm(centered_landmarks3d,0) - mean_landmarks3d(0,0);
-    dlib::set_colm(centered_landmarks3d,1) = colm(centered_landmarks3d,1) - mean_landmarks3d(0,1);
-    dlib::set_colm(centered_landmarks3d,2) = colm(centered_landmarks3d,2) - mean_landmarks3d(0,2);
-    
-    dlib::matrix<double> rotation_matrix_face1 = find_overall_rotation_matrix(centered_landmarks_face1, centered_landmarks3d, parameters_face1);
-    dlib::matrix<double> rotation_matrix_face2 = find_overall_rotation_matrix(centered_landmarks_face2, centered_landmarks3d, parameters_face2);
-    
-    dlib::matrix<double,68,3> flattened_2d_landmarks_full_face1 = centered_landmarks3d * rotation_matrix_face1;
-    dlib::matrix<double,68,3> flattened_2d_landmarks_full_face2 = centered_landmarks3d * rotation_matrix_face2;
-    
-    dlib::set_subm(flattened_2d_landmarks_full_face2, dlib::range(0,67), dlib::range(0,1)) = centered_landmarks_face1;
-    dlib::matrix<double,68,3> flattened_2d_landmarks_full_rotated_face2 = flattened_2d_landmarks_full_face1 * dlib::inv(rotation_matrix_face1) * rotation_matrix_face2;
-    
-    dlib::set_subm(flattened_2d_landmarks_full_face1, dlib::range(0,67), dlib::range(0,1)) = centered_landmarks_face2;
-    dlib::matrix<double,68,3> flattened_2d_landmarks_full_rotated_face1 = flattened_2d_landmarks_full_face2 * dlib::inv(rotation_matrix_face2) * rotation_matrix_face1;
-    
-    dlib::matrix<double, 68,2> _2d_landmarks_full_face_1 = dlib::subm(flattened_2d_landmarks_full_face1, dlib::range(0,67), dlib::range(0,1));
-    dlib::matrix<double, 68,2> _2d_landmarks_full_face_2 = dlib::subm(flattened_2d_landmarks_full_face2, dlib::range(0,67), dlib::range(0,1));
-    
-    
-    dlib::matrix<long> face_outline(1,dlib_face_outline.size() + total_mouth.size() + total_eyes.size());
-    for (int i = 0; i < dlib_face_outline.size(); i++ )
-    {
-        face_outline(0,i) = (long)dlib_face_outline[i];
-    }
-    
-    for (int i = (int)dlib_face_outline.size(); i < (int)dlib_face_outline.size() + total_mouth.size(); i++ )
-    {
-        face_outline(0,i) = (long)total_mouth[i - (int)dlib_face_outline.size()];
-    }
-    
-    for (int i = (int)(dlib_face_outline.size() + total_mouth.size()); i < (int)(dlib_face_outline.size() + total_mouth.size() + total_eyes.size()); i++ )
-    {
-        face_outline(0,i) = (long)total_eyes[i - (int)dlib_face_outline.size() - (int)total_mouth.size()];
+    PhiWarpContext() : smoothed_reg(1.0), warped(), source(), has_pose(false), pose(), pose_tolerance(default_pose_tolerance), robust_roll(false), pose_hits(0), pose_misses(0)
+    {
+        const double initial_parameters[7] = {0.0, 1.0, 0.0, 1.0, 0.0, 0.0, 1.0};
+        std::copy(initial_parameters, initial_parameters + 7, parameters);
+        std::fill(scaling, scaling + 6, 1.0);
+    }
+    
+    // Temporal smoothing of the angle adjustment
+    double smoothed_reg;
+    // Pose warm start, [roll, cholesky]
+    double parameters[7];
+    // Golden inner calibration scales
+    double scaling[6];
+    // Last warp before rounding and the landmarks it was warped from, kept for vertex output
+    landmarks_2d warped;
+    landmarks_2d source;
+    // Current pose, and the landmarks it was last fully solved for
+    bool has_pose;
+    face_pose pose;
+    landmarks_2d solved_landmarks;
+    // Aligned RMS motion in pixels below which the solved rotation is reused
+    double pose_tolerance;
+    // Roll from the mirrored landmark pairs rather than the eyes alone
+    bool robust_roll;
+    unsigned long pose_hits;
+    unsigned long pose_misses;
+};
+
+// The original entry points take pose parameters from the caller but share this smoothing state.
+PhiWarpContext legacy_context;
+
+const face_pose & solve_context_pose(PhiWarpContext &context, const landmarks_2d &landmarks, const face_template &tpl)
+{
+    // Motion is measured against the landmarks of the last full solve rather than the last
+    // frame, so slow drift cannot keep an out-of-date rotation alive indefinitely.
+    if (context.has_pose && context.pose.tpl == &tpl && aligned_rms_distance(context.solved_landmarks, landmarks) < context.pose_tolerance)
+    {
+        context.pose_hits++;
+        if (context.pose.landmarks != landmarks)
+        {
+            refit_face_pose(landmarks, context.parameters, context.pose, context.robust_roll);
+        }
+        return context.pose;
     }
     
-    //    dlib::matrix<long> face_outline(1,dlib_face_outline.size());
-    //    for (int i = 0; i < dlib_face_outline.size(); i++ )
-    //    {
-    //        face_outline(0,i) = (long)dlib_face_outline[i];
-    //    }
-    
-    dlib::set_subm(_2d_landmarks_full_face_1, face_outline, dlib::range(0,1)) = dlib::subm(centered_landmarks_face2, face_outline, dlib::range(0,1));
-    dlib::set_subm(_2d_landmarks_full_face_2, face_outline, dlib::range(0,1)) = dlib::subm(centered_landmarks_face1, face_outline, dlib::range(0,1));
-    
-    //    _2d_landmarks_full_face_1 = adjust_warp_for_angle(landmarks_face2, _2d_landmarks_full_face_1, *factr_face1);
-    //    _2d_landmarks_full_face_2 = adjust_warp_for_angle(landmarks_face1, _2d_landmarks_full_face_2, *factr_face2);
-    
-    dlib::set_colm(_2d_landmarks_full_face_1,0) = colm(_2d_landmarks_full_face_1,0) + mean_landmarks_face2(0,0);
-    dlib::set_colm(_2d_landmarks_full_face_1,1) = colm(_2d_landmarks_full_face_1,1) + mean_landmarks_face2(0,1);
-    
-    dlib::set_colm(_2d_landmarks_full_face_2,0) = colm(_2d_landmarks_full_face_2,0) + mean_landmarks_face1(0,0);
-    dlib::set_colm(_2d_landmarks_full_face_2,1) = colm(_2d_landmarks_full_face_2,1) + mean_landmarks_face1(0,1);
-    
-    PhiPoint * output = (PhiPoint *)malloc((_2d_landmarks_full_face_1.nr() + _2d_landmarks_full_face_2.nr())  *sizeof(PhiPoint));
-    for (int row = 0; row < _2d_landmarks_full_face_1.nr(); row++)
-    {
-        output[row] = PhiPoint{
-            static_cast<int>(std::round(_2d_landmarks_full_face_1(row,0))),
-            static_cast<int>(std::round(_2d_landmarks_full_face_1(row,1)))
-        };
-        
-    };
-    
-    for (int row = (int)_2d_landmarks_full_face_1.nr(); row < _2d_landmarks_full_face_1.nr()+_2d_landmarks_full_face_2.nr(); row++)
-    {
-        output[row] = PhiPoint{
-            static_cast<int>(std::round(_2d_landmarks_full_face_2(row - _2d_landmarks_full_face_1.nr(),0))),
-            static_cast<int>(std::round(_2d_landmarks_full_face_2(row - _2d_landmarks_full_face_1.nr(),1)))
-        };
-        
-    };
-    
-    
-    return output;
+    context.pose_misses++;
+    solve_face_pose(landmarks, tpl, context.parameters, context.pose, context.robust_roll);
+    context.solved_landmarks = landmarks;
+    context.has_pose = true;
+    return context.pose;
 };
 
-PhiPoint * return_face_puppet_warp(int * landmarks_face1_ptr, int * landmarks_face2_ptr, double * parameters_face1, double * parameters_face2, double*factr_face1, double*factr_face2)
+// Effects
+
+warp_effect feature_scale_effect(double eye_scaling_x, double eye_scaling_y,
+                                 double mouth_scaling_x, double mouth_scaling_y,
+                                 double nose_scaling_x, double nose_scaling_y)
 {
-    // CALLER MUST FREE MEMORY ON RETURN.
-    
-    dlib::matrix<int, 68, 2> landmarks_i1 = dlib::mat(landmarks_face1_ptr, 68, 2);
-    dlib::matrix<int, 68, 2> landmarks_i2 = dlib::mat(landmarks_face2_ptr, 68, 2);
-    
-    dlib::matrix<double, 68, 2> landmarks_face1 = dlib::matrix_cast<double>(landmarks_i1);
-    dlib::matrix<double, 68, 2> landmarks_face2 = dlib::matrix_cast<double>(landmarks_i2);
-    
-    dlib::matrix<double> mean_landmarks_face1 = dlib::rowm(landmarks_face1,30);
-    dlib::matrix<double> centered_landmarks_face1 = landmarks_face1;
-    dlib::set_colm(centered_landmarks_face1,0) = colm(centered_landmarks_face1,0) - mean_landmarks_face1(0,0);
-    dlib::set_colm(centered_landmarks_face1,1) = colm(centered_landmarks_face1,1) - mean_landmarks_face1(0,1);
-    
-    dlib::matrix<double> mean_landmarks_face2 = dlib::rowm(landmarks_face2,30);
-    dlib::matrix<double> centered_landmarks_face2 = landmarks_face2;
-    dlib::set_colm(centered_landmarks_face2,0) = colm(centered_landmarks_face2,0) - mean_landmarks_face2(0,0);
-    dlib::set_colm(centered_landmarks_face2,1) = colm(centered_landmarks_face2,1) - mean_landmarks_face2(0,1);
-    
-    double *dlib_3d = landmarks3d_dlib;
-    dlib::matrix<double,68,3> landmarks3d = dlib::mat(dlib_3d, 68, 3);
-    dlib::matrix<double> mean_landmarks3d = dlib::rowm(landmarks3d,30);
-    dlib::matrix<double> centered_landmarks3d = landmarks3d;
-    dlib::set_colm(centered_landmarks3d,0) = colm(centered_landmarks3d,0) - mean_landmarks3d(0,0);
-    dlib::set_colm(centered_landmarks3d,1) = colm(centered_landmarks3d,1) - mean_landmarks3d(0,1);
-    dlib::set_colm(centered_landmarks3d,2) = colm(centered_landmarks3d,2) - mean_landmarks3d(0,2);
-    
-    dlib::matrix<double> rotation_matrix_face1 = find_overall_rotation_matrix(centered_landmarks_face1, centered_landmarks3d, parameters_face1);
-    dlib::matrix<double> rotation_matrix_face2 = find_overall_rotation_matrix(centered_landmarks_face2, centered_landmarks3d, parameters_face2);
-    
-    dlib::matrix<double,68,3> flattened_2d_landmarks_full_face1 = centered_landmarks3d * rotation_matrix_face1;
-    dlib::matrix<double,68,3> flattened_2d_landmarks_full_face2 = centered_landmarks3d * rotation_matrix_face2;
-    
-    dlib::set_subm(flattened_2d_landmarks_full_face2, dlib::range(0,67), dlib::range(0,1)) = centered_landmarks_face1;
-    dlib::matrix<double,68,3> flattened_2d_landmarks_full_rotated_face2 = flattened_2d_landmarks_full_face1 * dlib::inv(rotation_matrix_face1) * rotation_matrix_face2;
-    
-    dlib::set_subm(flattened_2d_landmarks_full_face1, dlib::range(0,67), dlib::range(0,1)) = centered_landmarks_face2;
-    dlib::matrix<double,68,3> flattened_2d_landmarks_full_rotated_face1 = flattened_2d_landmarks_full_face2 * dlib::inv(rotation_matrix_face2) * rotation_matrix_face1;
-    
-    dlib::matrix<double, 68,2> _2d_landmarks_full_face_1;
-    _2d_landmarks_full_face_1 = dlib::subm(flattened_2d_landmarks_full_face1, dlib::range(0,67), dlib::range(0,1));
-    dlib::matrix<double, 68,2> _2d_landmarks_full_face_2;
-    _2d_landmarks_full_face_2 = dlib::subm(flattened_2d_landmarks_full_face2, dlib::range(0,67), dlib::range(0,1));
-    
-    dlib::set_colm(_2d_landmarks_full_face_1,0) = colm(_2d_landmarks_full_face_1,0) + mean_landmarks_face2(0,0);
-    dlib::set_colm(_2d_landmarks_full_face_1,1) = colm(_2d_landmarks_full_face_1,1) + mean_landmarks_face2(0,1);
-    
-    dlib::set_colm(_2d_landmarks_full_face_2,0) = colm(_2d_landmarks_full_face_2,0) + mean_landmarks_face1(0,0);
-    dlib::set_colm(_2d_landmarks_full_face_2,1) = colm(_2d_landmarks_full_face_2,1) + mean_landmarks_face1(0,1);
-    
-    PhiPoint * output = (PhiPoint *)malloc((_2d_landmarks_full_face_1.nr() + _2d_landmarks_full_face_2.nr())  *sizeof(PhiPoint));
-    for (int row = 0; row < _2d_landmarks_full_face_1.nr(); row++)
-    {
-        output[row] = PhiPoint{
-            static_cast<int>(std::round(_2d_landmarks_full_face_1(row,0))),
-            static_cast<int>(std::round(_2d_landmarks_full_face_1(row,1)))
-        };
-        
-    };
-    
-    for (int row = (int)_2d_landmarks_full_face_1.nr(); row < _2d_landmarks_full_face_1.nr()+_2d_landmarks_full_face_2.nr(); row++)
-    {
-        output[row] = PhiPoint{
-            static_cast<int>(std::round(_2d_landmarks_full_face_2(row - _2d_landmarks_full_face_1.nr(),0))),
-            static_cast<int>(std::round(_2d_landmarks_full_face_2(row - _2d_landmarks_full_face_1.nr(),1)))
-        };
-        
-    };
-    
-    
-    return output;
+    // The nostrils are scaled about the nose tip rather than their mean.
+    return warp_effect{5, {
+        {&leye_dlib, pivot_region_mean, eye_scaling_x, eye_scaling_y, 1.0},
+        {&reye_dlib, pivot_region_mean, eye_scaling_x, eye_scaling_y, 1.0},
+        {&outermouth_dlib, pivot_region_mean, mouth_scaling_x, mouth_scaling_y, 1.0},
+        {&innermouth_dlib, pivot_region_mean, mouth_scaling_x, mouth_scaling_y, 1.0},
+        {&nose_dlib_edge, nose_dlib_edge[2], nose_scaling_x, nose_scaling_y, 1.0}
+    }, nullptr};
 };
 
-PhiPoint * return_3d_dynamic_adjusted_warp(int * landmarks_ptr, double * parameters, double * factr )
+warp_effect golden_inner_effect(const double * scaling_factors, bool scale_mouth)
 {
+    return warp_effect{scale_mouth ? 5 : 3, {
+        {&leye_dlib, pivot_region_mean, scaling_factors[0], scaling_factors[1], 1.0},
+        {&reye_dlib, pivot_region_mean, scaling_factors[0], scaling_factors[1], 1.0},
+        {&nose_dlib, pivot_region_mean, scaling_factors[2], scaling_factors[3], 1.0},
+        {&outermouth_dlib, pivot_region_mean, scaling_factors[4], scaling_factors[5], 1.0},
+        {&innermouth_dlib, pivot_region_mean, scaling_factors[4], scaling_factors[5], 1.0}
+    }, nullptr};
+};
+
+// Jaw and nose take the template's shape outright.
+const warp_effect golden_total_effect {0, {}, &exchange_list_nose_chin_warp};
+
+// Everything inside the jaw line shrinks towards the centroid of the whole face.
+const double tiny_factor = 0.75;
+const warp_effect tiny_face_effect {1, {
+    {&dlib_inner_face, pivot_face_centroid, tiny_factor, tiny_factor, tiny_factor}
+}, nullptr};
+
+double animation_phase()
+{
+    // sin^2 of the warp clock, cycling about every 0.4 seconds.
+    double seconds = warp_clock_seconds();
+    return sin(8 * seconds) * sin(8 * seconds);
+};
+
+void golden_inner_scaling_factors(const face_template &tpl, const landmarks_3d &frontal, double nose_hscale1_weight, double mouth_scaling, double * scaling_factors)
+{
+    // Calculate scaling factors for warp: ideal (template) over user (frontalised) distances.
     
-    // CALLER MUST FREE MEMORY ON RETURN.
-    
-    double ms = std::chrono::duration_cast<std::chrono::milliseconds>(std::chrono::steady_clock::now().time_since_epoch()).count();
-    
-    const double eye_scaling_x = 1.0 + 0.3 * sin(8 * ms / 1000.0) * sin(8 * ms / 1000.0);
-    const double eye_scaling_y = 1.0 + 0.6 * sin(8 * ms / 1000.0) * sin(8 * ms / 1000.0);
-    
-    const double mouth_scaling_x = 1.0 + 0.1 * sin(8 * ms / 1000.0) * sin(8 * ms / 1000.0);
-    const double mouth_scaling_y = 1.0 + 0.7 * sin(8 * ms / 1000.0) * sin(8 * ms / 1000.0);
-    
-    const double nose_scaling_x = 1.0;
-    const double nose_scaling_y = 1.0;
-    
-    
-    dlib::matrix<int, 68, 2> landmarks_i = dlib::mat(landmarks_ptr, 68, 2);
-    
-    dlib::matrix<double, 68, 2> landmarks = dlib::matrix_cast<double>(landmarks_i);
-    
-    dlib::matrix<double> mean_landmarks = dlib::rowm(landmarks,30);
-    dlib::matrix<double> centered_landmarks = landmarks;
-    dlib::set_colm(centered_landmarks,0) = colm(centered_landmarks,0) - mean_landmarks(0,0);
-    dlib::set_colm(centered_landmarks,1) = colm(centered_landmarks,1) - mean_landmarks(0,1);
-    
-    double *dlib_3d = landmarks3d_dlib;
-    dlib::matrix<double,68,3> landmarks3d = dlib::mat(dlib_3d, 68, 3);
-    dlib::matrix<double> mean_landmarks3d = dlib::rowm(landmarks3d,30);
-    dlib::matrix<double> centered_landmarks3d = landmarks3d;
-    dlib::set_colm(centered_landmarks3d,0) = colm(centered_landmarks3d,0) - mean_landmarks3d(0,0);
-    dlib::set_colm(centered_landmarks3d,1) = colm(centered_landmarks3d,1) - mean_landmarks3d(0,1);
-    dlib::set_colm(centered_landmarks3d,2) = colm(centered_landmarks3d,2) - mean_landmarks3d(0,2);
-    
-    dlib::matrix<double> rotation_matrix = find_overall_rotation_matrix(centered_landmarks, centered_landmarks3d, parameters);
-    
-    dlib::matrix<double,68,3> flattened_2d_landmarks_full = centered_landmarks3d * rotation_matrix;
-    dlib::set_subm(flattened_2d_landmarks_full, dlib::range(0,67), dlib::range(0,1)) = centered_landmarks;
-    dlib::matrix<double,68,3> flattened_2d_landmarks_full_rotated = flattened_2d_landmarks_full * dlib::inv(rotation_matrix);
-    
-    dlib::matrix<long> dlib_leye_range(1,leye_dlib.size());
-    for (int i = 0; i < leye_dlib.size(); i++ )
-    {
-        dlib_leye_range(0,i) = (long)leye_dlib[i];
-    }
-    dlib::matrix<double> dlib_leye = dlib::subm(flattened_2d_landmarks_full_rotated, dlib_leye_range, dlib::range(0,2));
-    
-    double dlib_leye_mean[2];
-    dlib_leye_mean[0] = dlib::mean(dlib::colm(dlib_leye,0));
-    dlib_leye_mean[1] = dlib::mean(dlib::colm(dlib_leye,1));
-    
-    dlib::set_colm(dlib_leye,0) = ((dlib::colm(dlib_leye,0) - dlib_leye_mean[0]) * eye_scaling_x) + dlib_leye_mean[0];
-    dlib::set_colm(dlib_leye,1) = ((dlib::colm(dlib_leye,1) - dlib_leye_mean[1]) * eye_scaling_y) + dlib_leye_mean[1];
-    
-    dlib::matrix<long> dlib_reye_range(1,reye_dlib.size());
-    for (int i = 0; i < reye_dlib.size(); i++ )
-    {
-        dlib_reye_range(0,i) = (long)reye_dlib[i];
-    }
-    dlib::matrix<double> dlib_reye = dlib::subm(flattened_2d_landmarks_full_rotated, dlib_reye_range, dlib::range(0,2));
-    
-    double dlib_reye_mean[2];
-    dlib_reye_mean[0] = dlib::mean(dlib::colm(dlib_reye,0));
-    dlib_reye_mean[1] = dlib::mean(dlib::colm(dlib_reye,1));
-    
-    dlib::set_colm(dlib_reye,0) = ((dlib::colm(dlib_reye,0) - dlib_reye_mean[0]) * eye_scaling_x) + dlib_reye_mean[0];
-    dlib::set_colm(dlib_reye,1) = ((dlib::colm(dlib_reye,1) - dlib_reye_mean[1]) * eye_scaling_y) + dlib_reye_mean[1];
-    
-    dlib::set_subm(flattened_2d_landmarks_full_rotated, dlib_leye_range, dlib::range(0,2)) = dlib_leye;
-    dlib::set_subm(flattened_2d_landmarks_full_rotated, dlib_reye_range, dlib::range(0,2)) = dlib_reye;
+    // left eye, horizontal and vertical
+    double leye_hscale = tpl.ideal_eyedist_lh / landmark_distance(frontal, 36, 39);
+    double leye_vscale = 0.5 * (tpl.ideal_eyedist_lv1 / landmark_distance(frontal, 37, 41)) +
+                         0.5 * (tpl.ideal_eyedist_lv2 / landmark_distance(frontal, 38, 40));
     
-    //
-    dlib::matrix<long> dlib_mouth_range(1,outermouth_dlib.size());
-    for (int i = 0; i < outermouth_dlib.size(); i++ )
-    {
-        dlib_mouth_range(0,i) = (long)outermouth_dlib[i];
-    }
-    dlib::matrix<double> dlib_mouth = dlib::subm(flattened_2d_landmarks_full_rotated, dlib_mouth_range, dlib::range(0,2));
+    // right eye, horizontal and vertical
+    double reye_hscale = tpl.ideal_eyedist_rh / landmark_distance(frontal, 42, 45);
+    double reye_vscale = 0.5 * (tpl.ideal_eyedist_rv1 / landmark_distance(frontal, 43, 47)) +
+                         0.5 * (tpl.ideal_eyedist_rv2 / landmark_distance(frontal, 44, 46));
     
-    double dlib_mouth_mean[2];
-    dlib_mouth_mean[0] = dlib::mean(dlib::colm(dlib_mouth,0));
-    dlib_mouth_mean[1] = dlib::mean(dlib::colm(dlib_mouth,1));
+    // nose hscale: the wider pair is the more accurate value
+    double nose_hscale1 = tpl.ideal_nosedist_h1 / landmark_distance(frontal, 31, 35);
+    double nose_hscale2 = tpl.ideal_nosedist_h2 / landmark_distance(frontal, 32, 34);
     
-    dlib::set_colm(dlib_mouth,0) = ((dlib::colm(dlib_mouth,0) - dlib_mouth_mean[0]) * mouth_scaling_x) + dlib_mouth_mean[0];
-    dlib::set_colm(dlib_mouth,1) = ((dlib::colm(dlib_mouth,1) - dlib_mouth_mean[1]) * mouth_scaling_y) + dlib_mouth_mean[1];
+    // nose vscale
+    double nose_vscale = tpl.ideal_nosedist_v / landmark_distance(frontal, 27, 33);
     
-    dlib::set_subm(flattened_2d_landmarks_full_rotated, dlib_mouth_range, dlib::range(0,2)) = dlib_mouth;
-    //
-    dlib::matrix<long> dlib_mouth_inner_range(1,innermouth_dlib.size());
-    for (int i = 0; i < innermouth_dlib.size(); i++ )
-    {
-        dlib_mouth_inner_range(0,i) = (long)innermouth_dlib[i];
+    scaling_factors[0] = 0.5 * leye_hscale + 0.5 * reye_hscale;
+    scaling_factors[1] = 0.5 * leye_vscale + 0.5 * reye_vscale;
+    scaling_factors[2] = nose_hscale1_weight * nose_hscale1 + (1.0 - nose_hscale1_weight) * nose_hscale2;
+    scaling_factors[3] = nose_vscale;
+    scaling_factors[4] = mouth_scaling;
+    scaling_factors[5] = mouth_scaling;
+};
+
+// Warp kinds
+
+const face_template & template_for_kind(PhiWarpKind kind)
+{
+    switch (kind)
+    {
+        case PhiWarpAttractivePretty:
+        case PhiWarpGoldenTotalPretty:
+        case PhiWarpGoldenInnerPretty:
+        case PhiWarpApplyGoldenInnerPretty:
+            return face_template_female;
+        case PhiWarpAttractiveHandsome:
+        case PhiWarpGoldenTotalHandsome:
+        case PhiWarpGoldenInnerHandsome:
+        case PhiWarpApplyGoldenInnerHandsome:
+            return face_template_male;
+        default:
+            return face_template_dlib;
     }
-    dlib::matrix<double> dlib_mouth_inner = dlib::subm(flattened_2d_landmarks_full_rotated, dlib_mouth_inner_range, dlib::range(0,2));
-    
-    double dlib_mouth_inner_mean[2];
-    dlib_mouth_inner_mean[0] = dlib::mean(dlib::colm(dlib_mouth_inner,0));
-    dlib_mouth_inner_mean[1] = dlib::mean(dlib::colm(dlib_mouth_inner,1));
-    
-    dlib::set_colm(dlib_mouth_inner,0) = ((dlib::colm(dlib_mouth_inner,0) - dlib_mouth_inner_mean[0]) * mouth_scaling_x) + dlib_mouth_inner_mean[0];
-    dlib::set_colm(dlib_mouth_inner,1) = ((dlib::colm(dlib_mouth_inner,1) - dlib_mouth_inner_mean[1]) * mouth_scaling_y) + dlib_mouth_inner_mean[1];
-    
-    dlib::set_subm(flattened_2d_landmarks_full_rotated, dlib_mouth_inner_range, dlib::range(0,2)) = dlib_mouth_inner;
-    
-    //
-    dlib::matrix<long> dlib_nose_range(1,nose_dlib_edge.size());
-    for (int i = 0; i < nose_dlib_edge.size(); i++ )
-    {
-        dlib_nose_range(0,i) = (long)nose_dlib_edge[i];
+};
+
+warp_effect effect_for_kind(PhiWarpKind kind, const face_pose &pose, const double * scaling, double phase)
+{
+    switch (kind)
+    {
+        case PhiWarpAttractive:
+            return feature_scale_effect(1.1, 1.1, 1.0, 1.0, 0.8, 0.9);
+        case PhiWarpAttractivePretty:
+            return feature_scale_effect(1.05, 1.05, 1.0, 1.0, 0.9, 0.9);
+        case PhiWarpAttractiveHandsome:
+            return feature_scale_effect(1.05, 1.02, 1.0, 1.0, 0.95, 0.92);
+        case PhiWarpSilly:
+            return feature_scale_effect(1.3, 1.5, 0.7, 0.9, 0.8, 0.8);
+        case PhiWarpDynamic:
+            return feature_scale_effect(1.0 + 0.3 * phase, 1.0 + 0.6 * phase,
+                                        1.0 + 0.1 * phase, 1.0 + 0.7 * phase,
+                                        1.0, 1.0);
+        case PhiWarpBigNose:
+            return feature_scale_effect(1.0, 1.0,
+                                        1.0, 1.0,
+                                        1.0 + 0.7 * phase, 1.0 + 0.7 * phase);
+        case PhiWarpBigLips:
+            return feature_scale_effect(1.0, 1.0,
+                                        1.3 + 0.7 * phase, 1.3 + 0.7 * phase,
+                                        1.0, 1.0);
+        case PhiWarpTiny:
+            return tiny_face_effect;
+        case PhiWarpGoldenTotalPretty:
+        case PhiWarpGoldenTotalHandsome:
+            return golden_total_effect;
+        case PhiWarpGoldenInnerPretty:
+        case PhiWarpGoldenInnerHandsome:
+        {
+            // The pretty variant measures the nose width on the outer nostrils only.
+            double scaling_factors[6];
+            golden_inner_scaling_factors(*pose.tpl, pose.frontal, kind == PhiWarpGoldenInnerPretty ? 1.0 : 0.7, 1.0, scaling_factors);
+            return golden_inner_effect(scaling_factors, false);
+        }
+        case PhiWarpApplyGoldenInnerPretty:
+        case PhiWarpApplyGoldenInnerHandsome:
+            return golden_inner_effect(scaling, true);
     }
-    dlib::matrix<double> dlib_nose = dlib::subm(flattened_2d_landmarks_full_rotated, dlib_nose_range, dlib::range(0,2));
-    
-    double dlib_nose_mean[2];
-    dlib_nose_mean[0] = dlib_nose(2,0);
-    dlib_nose_mean[1] = dlib_nose(2,1);
-    
-    dlib::set_colm(dlib_nose,0) = ((dlib::colm(dlib_nose,0) - dlib_nose_mean[0]) * nose_scaling_x) + dlib_nose_mean[0];
-    dlib::set_colm(dlib_nose,1) = ((dlib::colm(dlib_nose,1) - dlib_nose_mean[1]) * nose_scaling_y) + dlib_nose_mean[1];
-    
-    dlib::set_subm(flattened_2d_landmarks_full_rotated, dlib_nose_range, dlib::range(0,2)) = dlib_nose;
-    //
-    
-    dlib::matrix<double,68,3> tmp = flattened_2d_landmarks_full_rotated * rotation_matrix;
-    dlib::matrix<double, 68,2> _2d_landmarks_full = dlib::subm(tmp, dlib::range(0,67), dlib::range(0,1));
-    
+    return warp_effect{0, {}, nullptr};
+};
+
+void return_3d_kind_warp_into(PhiWarpKind kind, int * landmarks_ptr, double * parameters, double * factr, const double * scaling, PhiPoint * output)
+{
+    landmarks_2d landmarks;
+    load_landmarks(landmarks_ptr, landmarks);
     
-    dlib::set_colm(_2d_landmarks_full,0) = colm(_2d_landmarks_full,0) + mean_landmarks(0,0);
-    dlib::set_colm(_2d_landmarks_full,1) = colm(_2d_landmarks_full,1) + mean_landmarks(0,1);
+    const face_pose &pose = engine.solve(landmarks, template_for_kind(kind), parameters);
+    const warp_effect effect = effect_for_kind(kind, pose, scaling, animation_phase());
     
-    _2d_landmarks_full = adjust_warp_for_angle(landmarks, _2d_landmarks_full, *factr);
+    landmarks_2d warped;
+    apply_warp_effects(pose, &effect, 1, warped);
+    adjust_warp_for_angle(pose.landmarks, warped, legacy_context.smoothed_reg, *factr);
+    repair_folds(pose.landmarks, warped);
     
-    PhiPoint * output = (PhiPoint *)malloc(_2d_landmarks_full.nr()*sizeof(PhiPoint));
-    for (int row = 0; row < _2d_landmarks_full.nr(); row++)
-    {
-        output[row] = PhiPoint{
-            static_cast<int>(std::round(_2d_landmarks_full(row,0))),
-            static_cast<int>(std::round(_2d_landmarks_full(row,1)))
-        };
-        
-    };
-    return output;
+    write_phi_points(warped, output);
 };
 
-PhiPoint * return_3d_tiny_face_warp(int * landmarks_ptr, double * parameters, double * factr )
+PhiPoint * return_3d_kind_warp(PhiWarpKind kind, int * landmarks_ptr, double * parameters, double * factr, const double * scaling)
 {
     // CALLER MUST FREE MEMORY ON RETURN.
-    const double tiny_factor = 0.75;
-    
-    
-    dlib::matrix<int, 68, 2> landmarks_i = dlib::mat(landmarks_ptr, 68, 2);
-    
-    dlib::matrix<double, 68, 2> landmarks = dlib::matrix_cast<double>(landmarks_i);
-    
-    dlib::matrix<double,1,2> mean_landmarks;
-    mean_landmarks = dlib::mean(dlib::colm(landmarks,0)), dlib::mean(dlib::colm(landmarks,1));
-    dlib::matrix<double> centered_landmarks = landmarks;
-    dlib::set_colm(centered_landmarks,0) = colm(centered_landmarks,0) - mean_landmarks(0,0);
-    dlib::set_colm(centered_landmarks,1) = colm(centered_landmarks,1) - mean_landmarks(0,1);
-    
-    double *dlib_3d = landmarks3d_dlib;
-    dlib::matrix<double,68,3> landmarks3d = dlib::mat(dlib_3d, 68, 3);
-    dlib::matrix<double> mean_landmarks3d = dlib::rowm(landmarks3d,30);
-    dlib::matrix<double> centered_landmarks3d = landmarks3d;
-    dlib::set_colm(centered_landmarks3d,0) = colm(centered_landmarks3d,0) - mean_landmarks3d(0,0);
-    dlib::set_colm(centered_landmarks3d,1) = colm(centered_landmarks3d,1) - mean_landmarks3d(0,1);
-    dlib::set_colm(centered_landmarks3d,2) = colm(centered_landmarks3d,2) - mean_landmarks3d(0,2);
-    
-    dlib::matrix<double> rotation_matrix = find_overall_rotation_matrix(centered_landmarks, centered_landmarks3d, parameters);
-    
-    dlib::matrix<double,68,3> flattened_2d_landmarks_full = centered_landmarks3d * rotation_matrix;
-    dlib::set_subm(flattened_2d_landmarks_full, dlib::range(0,67), dlib::range(0,1)) = centered_landmarks;
-    dlib::matrix<double,68,3> flattened_2d_landmarks_full_rotated = flattened_2d_landmarks_full * dlib::inv(rotation_matrix);
-    
-    //
-    
-    dlib::matrix<long> not_face_outline(1,dlib_not_face_outline.size());
-    for (int i = 0; i < dlib_not_face_outline.size(); i++ )
-    {
-        not_face_outline(0,i) = (long)dlib_not_face_outline[i];
-        //std::string to_string(long dlib_not_face_outline[i]);
-    }
-    
-    dlib::set_subm(flattened_2d_landmarks_full_rotated, dlib::range(27,67), dlib::range(0,2)) = dlib::rowm(flattened_2d_landmarks_full_rotated, dlib::range(27,67)) * tiny_factor;
-    
-    dlib::matrix<double,68,3> tmp = flattened_2d_landmarks_full_rotated * rotation_matrix;
-    dlib::matrix<double, 68,2> _2d_landmarks_full = dlib::subm(tmp, dlib::range(0,67), dlib::range(0,1));
-    
-    
-    dlib::set_colm(_2d_landmarks_full,0) = colm(_2d_landmarks_full,0) + mean_landmarks(0,0);
-    dlib::set_colm(_2d_landmarks_full,1) = colm(_2d_landmarks_full,1) + mean_landmarks(0,1);
-    
-    _2d_landmarks_full = adjust_warp_for_angle(landmarks, _2d_landmarks_full, *factr);
-    
-    PhiPoint * output = (PhiPoint *)malloc(_2d_landmarks_full.nr()*sizeof(PhiPoint));
-    for (int row = 0; row < _2d_landmarks_full.nr(); row++)
-    {
-        output[row] = PhiPoint{
-            static_cast<int>(std::round(_2d_landmarks_full(row,0))),
-            static_cast<int>(std::round(_2d_landmarks_full(row,1)))
-        };
-        
-    };
+    PhiPoint * output = (PhiPoint *)malloc(68*sizeof(PhiPoint));
+    return_3d_kind_warp_into(kind, landmarks_ptr, parameters, factr, scaling, output);
     return output;
 };
 
+// Batches smaller than this are warped in turn; handing work to the pool costs more than a solve.
+const int parallel_batch_threshold = 4;
+// Faces handed to the pool at once by the batch warp
+const int parallel_batch_chunk = 16;
 
-PhiPoint * return_big_nose_face_warp(int * landmarks_ptr, double * parameters, double * factr )
+dlib::thread_pool & warp_thread_pool()
 {
-    // CALLER MUST FREE MEMORY ON RETURN.
-    
-    double ms = std::chrono::duration_cast<std::chrono::milliseconds>(std::chrono::steady_clock::now().time_since_epoch()).count();
-    
-    const double eye_scaling_x = 1.0;
-    const double eye_scaling_y = 1.0;
-    
-    const double mouth_scaling_x = 1.0;
-    const double mouth_scaling_y = 1.0;
-    
-    const double nose_scaling_x = 1.0 + 0.7 * sin(8 * ms / 1000.0) * sin(8 * ms / 1000.0);
-    const double nose_scaling_y = 1.0 + 0.7 * sin(8 * ms / 1000.0) * sin(8 * ms / 1000.0);
-    
-    
-    dlib::matrix<int, 68, 2> landmarks_i = dlib::mat(landmarks_ptr, 68, 2);
-    
-    dlib::matrix<double, 68, 2> landmarks = dlib::matrix_cast<double>(landmarks_i);
-    
-    dlib::matrix<double> mean_landmarks = dlib::rowm(landmarks,30);
-    dlib::matrix<double> centered_landmarks = landmarks;
-    dlib::set_colm(centered_landmarks,0) = colm(centered_landmarks,0) - mean_landmarks(0,0);
-    dlib::set_colm(centered_landmarks,1) = colm(centered_landmarks,1) - mean_landmarks(0,1);
-    
-    double *dlib_3d = landmarks3d_dlib;
-    dlib::matrix<double,68,3> landmarks3d = dlib::mat(dlib_3d, 68, 3);
-    dlib::matrix<double> mean_landmarks3d = dlib::rowm(landmarks3d,30);
-    dlib::matrix<double> centered_landmarks3d = landmarks3d;
-    dlib::set_colm(centered_landmarks3d,0) = colm(centered_landmarks3d,0) - mean_landmarks3d(0,0);
-    dlib::set_colm(centered_landmarks3d,1) = colm(centered_landmarks3d,1) - mean_landmarks3d(0,1);
-    dlib::set_colm(centered_landmarks3d,2) = colm(centered_landmarks3d,2) - mean_landmarks3d(0,2);
-    
-    dlib::matrix<double> rotation_matrix = find_overall_rotation_matrix(centered_landmarks, centered_landmarks3d, parameters);
-    
-    dlib::matrix<double,68,3> flattened_2d_landmarks_full = centered_landmarks3d * rotation_matrix;
-    dlib::set_subm(flattened_2d_landmarks_full, dlib::range(0,67), dlib::range(0,1)) = centered_landmarks;
-    dlib::matrix<double,68,3> flattened_2d_landmarks_full_rotated = flattened_2d_landmarks_full * dlib::inv(rotation_matrix);
-    
-    dlib::matrix<long> dlib_leye_range(1,leye_dlib.size());
-    for (int i = 0; i < leye_dlib.size(); i++ )
-    {
-        dlib_leye_range(0,i) = (long)leye_dlib[i];
-    }
-    dlib::matrix<double> dlib_leye = dlib::subm(flattened_2d_landmarks_full_rotated, dlib_leye_range, dlib::range(0,2));
-    
-    double dlib_leye_mean[2];
-    dlib_leye_mean[0] = dlib::mean(dlib::colm(dlib_leye,0));
-    dlib_leye_mean[1] = dlib::mean(dlib::colm(dlib_leye,1));
-    
-    dlib::set_colm(dlib_leye,0) = ((dlib::colm(dlib_leye,0) - dlib_leye_mean[0]) * eye_scaling_x) + dlib_leye_mean[0];
-    dlib::set_colm(dlib_leye,1) = ((dlib::colm(dlib_leye,1) - dlib_leye_mean[1]) * eye_scaling_y) + dlib_leye_mean[1];
-    
-    dlib::matrix<long> dlib_reye_range(1,reye_dlib.size());
-    for (int i = 0; i < reye_dlib.size(); i++ )
-    {
-        dlib_reye_range(0,i) = (long)reye_dlib[i];
-    }
-    dlib::matrix<double> dlib_reye = dlib::subm(flattened_2d_landmarks_full_rotated, dlib_reye_range, dlib::range(0,2));
-    
-    double dlib_reye_mean[2];
-    dlib_reye_mean[0] = dlib::mean(dlib::colm(dlib_reye,0));
-    dlib_reye_mean[1] = dlib::mean(dlib::colm(dlib_reye,1));
-    
-    dlib::set_colm(dlib_reye,0) = ((dlib::colm(dlib_reye,0) - dlib_reye_mean[0]) * eye_scaling_x) + dlib_reye_mean[0];
-    dlib::set_colm(dlib_reye,1) = ((dlib::colm(dlib_reye,1) - dlib_reye_mean[1]) * eye_scaling_y) + dlib_reye_mean[1];
-    
-    dlib::set_subm(flattened_2d_landmarks_full_rotated, dlib_leye_range, dlib::range(0,2)) = dlib_leye;
-    dlib::set_subm(flattened_2d_landmarks_full_rotated, dlib_reye_range, dlib::range(0,2)) = dlib_reye;
-    
-    //
-    dlib::matrix<long> dlib_mouth_range(1,outermouth_dlib.size());
-    for (int i = 0; i < outermouth_dlib.size(); i++ )
+    static dlib::thread_pool pool(std::max(1u, std::thread::hardware_concurrency()));
+    return pool;
+};
+
+void return_3d_kind_warps_into(PhiWarpKind kind, int num_faces, int * landmarks_ptr, double * parameters, double * factrs, const double * scaling, PhiPoint * output)
+{
+    // Landmarks, outputs, parameters and factrs are laid out face after face: 68 points, 68 points,
+    // 7 doubles and 1 double per face.
+    if (num_faces < parallel_batch_threshold)
     {
-        dlib_mouth_range(0,i) = (long)outermouth_dlib[i];
+        for (int face = 0; face < num_faces; face++)
+        {
+            return_3d_kind_warp_into(kind, landmarks_ptr + face * 136, parameters + face * 7, factrs + face, scaling, output + face * 68);
+        }
+        return;
+    }
+    
+    // Poses are independent per face, so solve them on the pool without going through the shared
+    // pose cache. The angle adjustment smooths from face to face and so runs afterwards, in face order.
+    // Faces go through in chunks so the working sets stay on the stack.
+    const face_template &tpl = template_for_kind(kind);
+    const double phase = animation_phase();
+    landmarks_2d landmarks[parallel_batch_chunk];
+    landmarks_2d warped[parallel_batch_chunk];
+    for (int first = 0; first < num_faces; first += parallel_batch_chunk)
+    {
+        const int chunk = std::min(parallel_batch_chunk, num_faces - first);
+        dlib::parallel_for(warp_thread_pool(), 0, chunk, [&](long i)
+        {
+            const long face = first + i;
+            load_landmarks(landmarks_ptr + face * 136, landmarks[i]);
+            
+            face_pose pose;
+            solve_face_pose(landmarks[i], tpl, parameters + face * 7, pose);
+            const warp_effect effect = effect_for_kind(kind, pose, scaling, phase);
+            apply_warp_effects(pose, &effect, 1, warped[i]);
+        });
+        
+        for (int i = 0; i < chunk; i++)
+        {
+            adjust_warp_for_angle(landmarks[i], warped[i], legacy_context.smoothed_reg, factrs[first + i]);
+            repair_folds(landmarks[i], warped[i]);
+            write_phi_points(warped[i], output + (first + i) * 68);
+        }
     }
-    dlib::matrix<double> dlib_mouth = dlib::subm(flattened_2d_landmarks_full_rotated, dlib_mouth_range, dlib::range(0,2));
+};
+
+void context_warp_into(PhiWarpContext &context, PhiWarpKind kind, int * landmarks_ptr, double phase, double & factr, PhiPoint * output)
+{
+    landmarks_2d landmarks;
+    load_landmarks(landmarks_ptr, landmarks);
     
-    double dlib_mouth_mean[2];
-    dlib_mouth_mean[0] = dlib::mean(dlib::colm(dlib_mouth,0));
-    dlib_mouth_mean[1] = dlib::mean(dlib::colm(dlib_mouth,1));
+    const face_pose &pose = solve_context_pose(context, landmarks, template_for_kind(kind));
+    const warp_effect effect = effect_for_kind(kind, pose, context.scaling, phase);
     
-    dlib::set_colm(dlib_mouth,0) = ((dlib::colm(dlib_mouth,0) - dlib_mouth_mean[0]) * mouth_scaling_x) + dlib_mouth_mean[0];
-    dlib::set_colm(dlib_mouth,1) = ((dlib::colm(dlib_mouth,1) - dlib_mouth_mean[1]) * mouth_scaling_y) + dlib_mouth_mean[1];
+    context.source = landmarks;
+    apply_warp_effects(pose, &effect, 1, context.warped);
+    adjust_warp_for_angle(pose.landmarks, context.warped, context.smoothed_reg, factr);
+    repair_folds(pose.landmarks, context.warped);
     
-    dlib::set_subm(flattened_2d_landmarks_full_rotated, dlib_mouth_range, dlib::range(0,2)) = dlib_mouth;
-    //
-    dlib::matrix<long> dlib_mouth_inner_range(1,innermouth_dlib.size());
-    for (int i = 0; i < innermouth_dlib.size(); i++ )
+    write_phi_points(context.warped, output);
+};
+
+void context_warps_into(PhiWarpContext ** contexts, PhiWarpKind kind, int num_faces, int * landmarks_ptr, double * factrs, PhiPoint * output)
+{
+    // Each face brings its own context, so whole warps, smoothing included, run in parallel.
+    const double phase = animation_phase();
+    auto warp_face = [&](long face)
     {
-        dlib_mouth_inner_range(0,i) = (long)innermouth_dlib[i];
-    }
-    dlib::matrix<double> dlib_mouth_inner = dlib::subm(flattened_2d_landmarks_full_rotated, dlib_mouth_inner_range, dlib::range(0,2));
-    
-    double dlib_mouth_inner_mean[2];
-    dlib_mouth_inner_mean[0] = dlib::mean(dlib::colm(dlib_mouth_inner,0));
-    dlib_mouth_inner_mean[1] = dlib::mean(dlib::colm(dlib_mouth_inner,1));
-    
-    dlib::set_colm(dlib_mouth_inner,0) = ((dlib::colm(dlib_mouth_inner,0) - dlib_mouth_inner_mean[0]) * mouth_scaling_x) + dlib_mouth_inner_mean[0];
-    dlib::set_colm(dlib_mouth_inner,1) = ((dlib::colm(dlib_mouth_inner,1) - dlib_mouth_inner_mean[1]) * mouth_scaling_y) + dlib_mouth_inner_mean[1];
-    
-    dlib::set_subm(flattened_2d_landmarks_full_rotated, dlib_mouth_inner_range, dlib::range(0,2)) = dlib_mouth_inner;
+        context_warp_into(*contexts[face], kind, landmarks_ptr + face * 136, phase, factrs[face], output + face * 68);
+    };
     
-    //
-    dlib::matrix<long> dlib_nose_range(1,nose_dlib_edge.size());
-    for (int i = 0; i < nose_dlib_edge.size(); i++ )
+    if (num_faces < parallel_batch_threshold)
     {
-        dlib_nose_range(0,i) = (long)nose_dlib_edge[i];
+        for (int face = 0; face < num_faces; face++)
+        {
+            warp_face(face);
+        }
+        return;
     }
-    dlib::matrix<double> dlib_nose = dlib::subm(flattened_2d_landmarks_full_rotated, dlib_nose_range, dlib::range(0,2));
-    
-    double dlib_nose_mean[2];
-    dlib_nose_mean[0] = dlib_nose(2,0);
-    dlib_nose_mean[1] = dlib_nose(2,1);
-    
-    dlib::set_colm(dlib_nose,0) = ((dlib::colm(dlib_nose,0) - dlib_nose_mean[0]) * nose_scaling_x) + dlib_nose_mean[0];
-    dlib::set_colm(dlib_nose,1) = ((dlib::colm(dlib_nose,1) - dlib_nose_mean[1]) * nose_scaling_y) + dlib_nose_mean[1];
-    
-    dlib::set_subm(flattened_2d_landmarks_full_rotated, dlib_nose_range, dlib::range(0,2)) = dlib_nose;
-    //
-    
-    dlib::matrix<double,68,3> tmp = flattened_2d_landmarks_full_rotated * rotation_matrix;
-    dlib::matrix<double, 68,2> _2d_landmarks_full = dlib::subm(tmp, dlib::range(0,67), dlib::range(0,1));
-    
-    
-    dlib::set_colm(_2d_landmarks_full,0) = colm(_2d_landmarks_full,0) + mean_landmarks(0,0);
-    dlib::set_colm(_2d_landmarks_full,1) = colm(_2d_landmarks_full,1) + mean_landmarks(0,1);
-    
-    _2d_landmarks_full = adjust_warp_for_angle(landmarks, _2d_landmarks_full, *factr);
-    
-    PhiPoint * output = (PhiPoint *)malloc(_2d_landmarks_full.nr()*sizeof(PhiPoint));
-    for (int row = 0; row < _2d_landmarks_full.nr(); row++)
-    {
-        output[row] = PhiPoint{
-            static_cast<int>(std::round(_2d_landmarks_full(row,0))),
-            static_cast<int>(std::round(_2d_landmarks_full(row,1)))
-        };
-        
-    };
-    return output;
+    dlib::parallel_for(warp_thread_pool(), 0, num_faces, warp_face);
 };
 
-PhiPoint * return_big_lip_face_warp(int * landmarks_ptr, double * parameters, double * factr )
+int swap_partner(int face, int num_faces)
 {
-    // CALLER MUST FREE MEMORY ON RETURN.
-    
-    double ms = std::chrono::duration_cast<std::chrono::milliseconds>(std::chrono::steady_clock::now().time_since_epoch()).count();
-    
-    const double eye_scaling_x = 1.0;
-    const double eye_scaling_y = 1.0;
-    
-    const double mouth_scaling_x = 1.3 + 0.7 * sin(8 * ms / 1000.0) * sin(8 * ms / 1000.0);
-    const double mouth_scaling_y = 1.3 + 0.7 * sin(8 * ms / 1000.0) * sin(8 * ms / 1000.0);
-    
-    const double nose_scaling_x = 1.0;
-    const double nose_scaling_y = 1.0;
-    
-    
-    dlib::matrix<int, 68, 2> landmarks_i = dlib::mat(landmarks_ptr, 68, 2);
-    
-    dlib::matrix<double, 68, 2> landmarks = dlib::matrix_cast<double>(landmarks_i);
-    
-    dlib::matrix<double> mean_landmarks = dlib::rowm(landmarks,30);
-    dlib::matrix<double> centered_landmarks = landmarks;
-    dlib::set_colm(centered_landmarks,0) = colm(centered_landmarks,0) - mean_landmarks(0,0);
-    dlib::set_colm(centered_landmarks,1) = colm(centered_landmarks,1) - mean_landmarks(0,1);
-    
-    double *dlib_3d = landmarks3d_dlib;
-    dlib::matrix<double,68,3> landmarks3d = dlib::mat(dlib_3d, 68, 3);
-    dlib::matrix<double> mean_landmarks3d = dlib::rowm(landmarks3d,30);
-    dlib::matrix<double> centered_landmarks3d = landmarks3d;
-    dlib::set_colm(centered_landmarks3d,0) = colm(centered_landmarks3d,0) - mean_landmarks3d(0,0);
-    dlib::set_colm(centered_landmarks3d,1) = colm(centered_landmarks3d,1) - mean_landmarks3d(0,1);
-    dlib::set_colm(centered_landmarks3d,2) = colm(centered_landmarks3d,2) - mean_landmarks3d(0,2);
-    
-    dlib::matrix<double> rotation_matrix = find_overall_rotation_matrix(centered_landmarks, centered_landmarks3d, parameters);
-    
-    dlib::matrix<double,68,3> flattened_2d_landmarks_full = centered_landmarks3d * rotation_matrix;
-    dlib::set_subm(flattened_2d_landmarks_full, dlib::range(0,67), dlib::range(0,1)) = centered_landmarks;
-    dlib::matrix<double,68,3> flattened_2d_landmarks_full_rotated = flattened_2d_landmarks_full * dlib::inv(rotation_matrix);
-    
-    dlib::matrix<long> dlib_leye_range(1,leye_dlib.size());
-    for (int i = 0; i < leye_dlib.size(); i++ )
+    // Faces swap in consecutive pairs. With an odd count the last face joins the first pair in a
+    // three-way rotation, as the pairwise Swift loop used to do.
+    if (num_faces % 2 == 1 && num_faces > 1)
+    {
+        if (face == 0)
+        {
+            return num_faces - 1;
+        }
+        if (face == num_faces - 1)
+        {
+            return 1;
+        }
+    }
+    return num_faces > 1 ? face ^ 1 : face;
+};
+
+void context_swaps_into(PhiWarpContext ** contexts, int num_faces, int * landmarks_ptr, double * factrs, PhiPoint * output)
+{
+    // As with the pair warp, a face takes its partner's landmarks outright, so no pose is solved.
+    // Every face's input is kept in its context for vertex output before any output is written.
+    for (int face = 0; face < num_faces; face++)
     {
-        dlib_leye_range(0,i) = (long)leye_dlib[i];
+        load_landmarks(landmarks_ptr + face * 136, contexts[face]->source);
+        factrs[face] = 0.0;
     }
-    dlib::matrix<double> dlib_leye = dlib::subm(flattened_2d_landmarks_full_rotated, dlib_leye_range, dlib::range(0,2));
-    
-    double dlib_leye_mean[2];
-    dlib_leye_mean[0] = dlib::mean(dlib::colm(dlib_leye,0));
-    dlib_leye_mean[1] = dlib::mean(dlib::colm(dlib_leye,1));
-    
-    dlib::set_colm(dlib_leye,0) = ((dlib::colm(dlib_leye,0) - dlib_leye_mean[0]) * eye_scaling_x) + dlib_leye_mean[0];
-    dlib::set_colm(dlib_leye,1) = ((dlib::colm(dlib_leye,1) - dlib_leye_mean[1]) * eye_scaling_y) + dlib_leye_mean[1];
-    
-    dlib::matrix<long> dlib_reye_range(1,reye_dlib.size());
-    for (int i = 0; i < reye_dlib.size(); i++ )
+    for (int face = 0; face < num_faces; face++)
     {
-        dlib_reye_range(0,i) = (long)reye_dlib[i];
+        PhiWarpContext &context = *contexts[face];
+        context.warped = contexts[swap_partner(face, num_faces)]->source;
+        write_phi_points(context.warped, output + face * 68);
     }
-    dlib::matrix<double> dlib_reye = dlib::subm(flattened_2d_landmarks_full_rotated, dlib_reye_range, dlib::range(0,2));
-    
-    double dlib_reye_mean[2];
-    dlib_reye_mean[0] = dlib::mean(dlib::colm(dlib_reye,0));
-    dlib_reye_mean[1] = dlib::mean(dlib::colm(dlib_reye,1));
-    
-    dlib::set_colm(dlib_reye,0) = ((dlib::colm(dlib_reye,0) - dlib_reye_mean[0]) * eye_scaling_x) + dlib_reye_mean[0];
-    dlib::set_colm(dlib_reye,1) = ((dlib::colm(dlib_reye,1) - dlib_reye_mean[1]) * eye_scaling_y) + dlib_reye_mean[1];
-    
-    dlib::set_subm(flattened_2d_landmarks_full_rotated, dlib_leye_range, dlib::range(0,2)) = dlib_leye;
-    dlib::set_subm(flattened_2d_landmarks_full_rotated, dlib_reye_range, dlib::range(0,2)) = dlib_reye;
-    
-    //
-    dlib::matrix<long> dlib_mouth_range(1,outermouth_dlib.size());
-    for (int i = 0; i < outermouth_dlib.size(); i++ )
+};
+
+// Calibration
+
+// Observations are averaged in this many interleaved groups; the median of the group means
+// ignores a few bad frames where a plain mean would be pulled towards them.
+const int calibration_groups = 8;
+const int max_calibration_samples = 512;
+// Frames scoring below this in check_do_warp are turned too far from the camera to measure.
+const double calibration_min_pose_score = 0.8;
+// Converged once every scale's standard error is below this, after at least the minimum frames.
+const int calibration_min_samples = 24;
+const double calibration_tolerance = 0.004;
+
+struct PhiCalibrationAccumulator
+{
+    explicit PhiCalibrationAccumulator(PhiWarpKind kind) :
+        tpl(&template_for_kind(kind)),
+        mouth_scaling(tpl == &face_template_male ? 0.98 : 0.96)
     {
-        dlib_mouth_range(0,i) = (long)outermouth_dlib[i];
+        reset();
     }
-    dlib::matrix<double> dlib_mouth = dlib::subm(flattened_2d_landmarks_full_rotated, dlib_mouth_range, dlib::range(0,2));
-    
-    double dlib_mouth_mean[2];
-    dlib_mouth_mean[0] = dlib::mean(dlib::colm(dlib_mouth,0));
-    dlib_mouth_mean[1] = dlib::mean(dlib::colm(dlib_mouth,1));
-    
-    dlib::set_colm(dlib_mouth,0) = ((dlib::colm(dlib_mouth,0) - dlib_mouth_mean[0]) * mouth_scaling_x) + dlib_mouth_mean[0];
-    dlib::set_colm(dlib_mouth,1) = ((dlib::colm(dlib_mouth,1) - dlib_mouth_mean[1]) * mouth_scaling_y) + dlib_mouth_mean[1];
     
-    dlib::set_subm(flattened_2d_landmarks_full_rotated, dlib_mouth_range, dlib::range(0,2)) = dlib_mouth;
-    //
-    dlib::matrix<long> dlib_mouth_inner_range(1,innermouth_dlib.size());
-    for (int i = 0; i < innermouth_dlib.size(); i++ )
+    void reset()
     {
-        dlib_mouth_inner_range(0,i) = (long)innermouth_dlib[i];
+        num_samples = 0;
+        std::fill(mean, mean + 6, 0.0);
+        std::fill(m2, m2 + 6, 0.0);
     }
-    dlib::matrix<double> dlib_mouth_inner = dlib::subm(flattened_2d_landmarks_full_rotated, dlib_mouth_inner_range, dlib::range(0,2));
     
-    double dlib_mouth_inner_mean[2];
-    dlib_mouth_inner_mean[0] = dlib::mean(dlib::colm(dlib_mouth_inner,0));
-    dlib_mouth_inner_mean[1] = dlib::mean(dlib::colm(dlib_mouth_inner,1));
-    
-    dlib::set_colm(dlib_mouth_inner,0) = ((dlib::colm(dlib_mouth_inner,0) - dlib_mouth_inner_mean[0]) * mouth_scaling_x) + dlib_mouth_inner_mean[0];
-    dlib::set_colm(dlib_mouth_inner,1) = ((dlib::colm(dlib_mouth_inner,1) - dlib_mouth_inner_mean[1]) * mouth_scaling_y) + dlib_mouth_inner_mean[1];
-    
-    dlib::set_subm(flattened_2d_landmarks_full_rotated, dlib_mouth_inner_range, dlib::range(0,2)) = dlib_mouth_inner;
-    
-    //
-    dlib::matrix<long> dlib_nose_range(1,nose_dlib_edge.size());
-    for (int i = 0; i < nose_dlib_edge.size(); i++ )
+    bool add(const landmarks_2d &landmarks)
     {
-        dlib_nose_range(0,i) = (long)nose_dlib_edge[i];
+        if (num_samples == max_calibration_samples || check_do_warp(landmarks, 1.0, 0.0) < calibration_min_pose_score)
+        {
+            return false;
+        }
+        
+        const face_pose &pose = solve_context_pose(context, landmarks, *tpl);
+        double * scaling = samples[num_samples];
+        golden_inner_scaling_factors(*tpl, pose.frontal, 0.7, mouth_scaling, scaling);
+        
+        // Welford's update keeps the variance stable without storing sums of squares.
+        num_samples++;
+        for (int i = 0; i < 6; i++)
+        {
+            double delta = scaling[i] - mean[i];
+            mean[i] += delta / num_samples;
+            m2[i] += delta * (scaling[i] - mean[i]);
+        }
+        return true;
     }
-    dlib::matrix<double> dlib_nose = dlib::subm(flattened_2d_landmarks_full_rotated, dlib_nose_range, dlib::range(0,2));
-    
-    double dlib_nose_mean[2];
-    dlib_nose_mean[0] = dlib_nose(2,0);
-    dlib_nose_mean[1] = dlib_nose(2,1);
     
-    dlib::set_colm(dlib_nose,0) = ((dlib::colm(dlib_nose,0) - dlib_nose_mean[0]) * nose_scaling_x) + dlib_nose_mean[0];
-    dlib::set_colm(dlib_nose,1) = ((dlib::colm(dlib_nose,1) - dlib_nose_mean[1]) * nose_scaling_y) + dlib_nose_mean[1];
+    bool converged() const
+    {
+        if (num_samples < calibration_min_samples)
+        {
+            return false;
+        }
+        for (int i = 0; i < 6; i++)
+        {
+            double variance = m2[i] / (num_samples - 1);
+            if (std::sqrt(variance / num_samples) > calibration_tolerance)
+            {
+                return false;
+            }
+        }
+        return true;
+    }
     
-    dlib::set_subm(flattened_2d_landmarks_full_rotated, dlib_nose_range, dlib::range(0,2)) = dlib_nose;
-    //
+    void estimate(double * scaling) const
+    {
+        if (num_samples < calibration_groups)
+        {
+            std::copy(mean, mean + 6, scaling);
+            return;
+        }
+        for (int i = 0; i < 6; i++)
+        {
+            double group_means[calibration_groups] = {};
+            int group_sizes[calibration_groups] = {};
+            for (int sample = 0; sample < num_samples; sample++)
+            {
+                group_means[sample % calibration_groups] += samples[sample][i];
+                group_sizes[sample % calibration_groups]++;
+            }
+            for (int group = 0; group < calibration_groups; group++)
+            {
+                group_means[group] /= group_sizes[group];
+            }
+            std::nth_element(group_means, group_means + calibration_groups / 2, group_means + calibration_groups);
+            double upper = group_means[calibration_groups / 2];
+            double lower = *std::max_element(group_means, group_means + calibration_groups / 2);
+            scaling[i] = 0.5 * (lower + upper);
+        }
+    }
     
-    dlib::matrix<double,68,3> tmp = flattened_2d_landmarks_full_rotated * rotation_matrix;
-    dlib::matrix<double, 68,2> _2d_landmarks_full = dlib::subm(tmp, dlib::range(0,67), dlib::range(0,1));
+    const face_template * tpl;
+    double mouth_scaling;
+    // Pose state, so consecutive frames of a still face reuse the solve
+    PhiWarpContext context;
+    int num_samples;
+    double mean[6];
+    double m2[6];
+    double samples[max_calibration_samples][6];
+};
+
+// Warps
+
+PhiPoint * return_3d_golden_total_face_warp_pretty(int * landmarks_ptr, double * parameters, double * factr)
+{
+    // CALLER MUST FREE MEMORY ON RETURN.
+    return return_3d_kind_warp(PhiWarpGoldenTotalPretty, landmarks_ptr, parameters, factr, nullptr);
+};
+
+PhiPoint * return_3d_golden_total_face_warp_handsome(int * landmarks_ptr, double * parameters, double * factr)
+{
+    // CALLER MUST FREE MEMORY ON RETURN.
+    return return_3d_kind_warp(PhiWarpGoldenTotalHandsome, landmarks_ptr, parameters, factr, nullptr);
+};
+
+PhiPoint * return_3d_golden_inner_face_warp_pretty(int * landmarks_ptr, double * parameters, double * factr)
+{
+    // CALLER MUST FREE MEMORY ON RETURN.
+    return return_3d_kind_warp(PhiWarpGoldenInnerPretty, landmarks_ptr, parameters, factr, nullptr);
+};
+
+PhiPoint * return_3d_golden_inner_face_warp_handsome(int * landmarks_ptr, double * parameters, double * factr)
+{
+    // CALLER MUST FREE MEMORY ON RETURN.
+    return return_3d_kind_warp(PhiWarpGoldenInnerHandsome, landmarks_ptr, parameters, factr, nullptr);
+};
+
+void calculate_3d_golden_inner_face_warp(int * landmarks_ptr, const face_template &tpl, double * parameters, double mouth_scaling, double * scaling_factors)
+{
+    landmarks_2d landmarks;
+    load_landmarks(landmarks_ptr, landmarks);
     
+    const face_pose &pose = engine.solve(landmarks, tpl, parameters);
+    golden_inner_scaling_factors(tpl, pose.frontal, 0.7, mouth_scaling, scaling_factors);
+};
+
+void calculate_3d_golden_inner_face_warp_pretty(int * landmarks_ptr, double * parameters, double * factr, double * scaling_factors)
+{
+    calculate_3d_golden_inner_face_warp(landmarks_ptr, face_template_female, parameters, 0.96, scaling_factors);
+};
+
+PhiPoint * apply_3d_golden_inner_face_warp_pretty(int * landmarks_ptr, double * parameters, double * factr, double * scaling_factors) {
+    // CALLER MUST FREE MEMORY ON RETURN.
+    return return_3d_kind_warp(PhiWarpApplyGoldenInnerPretty, landmarks_ptr, parameters, factr, scaling_factors);
+};
+
+void calculate_3d_golden_inner_face_warp_handsome(int * landmarks_ptr, double * parameters, double * factr, double * scaling_factors)
+{
+    calculate_3d_golden_inner_face_warp(landmarks_ptr, face_template_male, parameters, 0.98, scaling_factors);
+};
+
+PhiPoint * apply_3d_golden_inner_face_warp_handsome(int * landmarks_ptr, double * parameters, double * factr, double * scaling_factors) {
+    // CALLER MUST FREE MEMORY ON RETURN.
+    return return_3d_kind_warp(PhiWarpApplyGoldenInnerHandsome, landmarks_ptr, parameters, factr, scaling_factors);
+};
+
+PhiPoint * return_3d_attractive_adjusted_warp_pretty(int * landmarks_ptr, double * parameters, double * factr)
+{
+    // CALLER MUST FREE MEMORY ON RETURN.
+    return return_3d_kind_warp(PhiWarpAttractivePretty, landmarks_ptr, parameters, factr, nullptr);
+};
+
+PhiPoint * return_3d_attractive_adjusted_warp_handsome(int * landmarks_ptr, double * parameters, double * factr)
+{
+    // CALLER MUST FREE MEMORY ON RETURN.
+    return return_3d_kind_warp(PhiWarpAttractiveHandsome, landmarks_ptr, parameters, factr, nullptr);
+};
+
+PhiPoint * return_3d_attractive_adjusted_warp2(int * landmarks_ptr, double * parameters, double*factr)
+{
+    // CALLER MUST FREE MEMORY ON RETURN.
+    return return_3d_kind_warp(PhiWarpAttractive, landmarks_ptr, parameters, factr, nullptr);
+};
+
+PhiPoint * return_3d_silly_adjusted_warp(int * landmarks_ptr, double * parameters, double * factr )
+{
+    // CALLER MUST FREE MEMORY ON RETURN.
+    return return_3d_kind_warp(PhiWarpSilly, landmarks_ptr, parameters, factr, nullptr);
+};
+
+PhiPoint3D * return_3d_point_set(int * landmarks_ptr, double * parameters, double * factr )
+{
+    // CALLER MUST FREE MEMORY ON RETURN.
+    landmarks_2d landmarks;
+    load_landmarks(landmarks_ptr, landmarks);
     
-    dlib::set_colm(_2d_landmarks_full,0) = colm(_2d_landmarks_full,0) + mean_landmarks(0,0);
-    dlib::set_colm(_2d_landmarks_full,1) = colm(_2d_landmarks_full,1) + mean_landmarks(0,1);
+    const face_pose &pose = engine.solve(landmarks, face_template_dlib, parameters);
     
-    _2d_landmarks_full = adjust_warp_for_angle(landmarks, _2d_landmarks_full, *factr);
+    landmarks_3d flattened;
+    flatten_landmarks(pose.centered_landmarks, pose.tpl->centered, pose.rotation_matrix, flattened);
     
-    PhiPoint * output = (PhiPoint *)malloc(_2d_landmarks_full.nr()*sizeof(PhiPoint));
-    for (int row = 0; row < _2d_landmarks_full.nr(); row++)
+    PhiPoint3D * output = (PhiPoint3D *)malloc(68*sizeof(PhiPoint3D));
+    for (int row = 0; row < 68; row++)
     {
-        output[row] = PhiPoint{
-            static_cast<int>(std::round(_2d_landmarks_full(row,0))),
-            static_cast<int>(std::round(_2d_landmarks_full(row,1)))
+        output[row] = PhiPoint3D{
+            static_cast<int>(std::round(flattened[row][0])),
+            static_cast<int>(std::round(flattened[row][1])),
+            static_cast<int>(std::round(flattened[row][2]))
         };
-        
     };
     return output;
 };
 
+void return_face_pair_warp_into(int * landmarks_face1_ptr, int * landmarks_face2_ptr, double * parameters_face1, double * parameters_face2, PhiPoint * output)
+{
+    // Each face takes the other face's landmarks unchanged, so no pose is solved. The parameters
+    // are left as they are; the callers' face logs only read them back to warm start the other
+    // warps, which keep them up to date themselves.
+    landmarks_2d landmarks_face1, landmarks_face2;
+    load_landmarks(landmarks_face1_ptr, landmarks_face1);
+    load_landmarks(landmarks_face2_ptr, landmarks_face2);
+    write_phi_points(landmarks_face2, output);
+    write_phi_points(landmarks_face1, output + 68);
+};
+
+PhiPoint * return_face_pair_warp(int * landmarks_face1_ptr, int * landmarks_face2_ptr, double * parameters_face1, double * parameters_face2)
+{
+    // CALLER MUST FREE MEMORY ON RETURN.
+    PhiPoint * output = (PhiPoint *)malloc(2 * 68 *sizeof(PhiPoint));
+    return_face_pair_warp_into(landmarks_face1_ptr, landmarks_face2_ptr, parameters_face1, parameters_face2, output);
+    return output;
+};
+
+PhiPoint * return_face_swap_warp(int * landmarks_face1_ptr, int * landmarks_face2_ptr, double * parameters_face1, double * parameters_face2, double*factr_face1, double*factr_face2)
+{
+    // CALLER MUST FREE MEMORY ON RETURN.
+    return return_face_pair_warp(landmarks_face1_ptr, landmarks_face2_ptr, parameters_face1, parameters_face2);
+};
+
+PhiPoint * return_face_puppet_warp(int * landmarks_face1_ptr, int * landmarks_face2_ptr, double * parameters_face1, double * parameters_face2, double*factr_face1, double*factr_face2)
+{
+    // CALLER MUST FREE MEMORY ON RETURN.
+    return return_face_pair_warp(landmarks_face1_ptr, landmarks_face2_ptr, parameters_face1, parameters_face2);
+};
+
+PhiPoint * return_3d_dynamic_adjusted_warp(int * landmarks_ptr, double * parameters, double * factr )
+{
+    // CALLER MUST FREE MEMORY ON RETURN.
+    return return_3d_kind_warp(PhiWarpDynamic, landmarks_ptr, parameters, factr, nullptr);
+};
+
+PhiPoint * return_3d_tiny_face_warp(int * landmarks_ptr, double * parameters, double * factr )
+{
+    // CALLER MUST FREE MEMORY ON RETURN.
+    return return_3d_kind_warp(PhiWarpTiny, landmarks_ptr, parameters, factr, nullptr);
+};
+
+PhiPoint * return_big_nose_face_warp(int * landmarks_ptr, double * parameters, double * factr )
+{
+    // CALLER MUST FREE MEMORY ON RETURN.
+    return return_3d_kind_warp(PhiWarpBigNose, landmarks_ptr, parameters, factr, nullptr);
+};
+
+PhiPoint * return_big_lip_face_warp(int * landmarks_ptr, double * parameters, double * factr )
+{
+    // CALLER MUST FREE MEMORY ON RETURN.
+    return return_3d_kind_warp(PhiWarpBigLips, landmarks_ptr, parameters, factr, nullptr);
+};
+
 
 
 // Needs c linkage to be imported to Swift
@@ -2834,3 +1768,182 @@ extern "C" {
     }
 }
 
+extern "C" {
+    void warp_face_into(PhiWarpKind kind, PhiPoint * landmarks, double * parameters, double * factr, double * scaling, PhiPoint * output)
+    {
+        return_3d_kind_warp_into(kind, (int *)landmarks, parameters, factr, scaling, output);
+    }
+}
+
+extern "C" {
+    void warp_faces_into(PhiWarpKind kind, int num_faces, PhiPoint * landmarks, double * parameters, double * factrs, double * scaling, PhiPoint * output)
+    {
+        return_3d_kind_warps_into(kind, num_faces, (int *)landmarks, parameters, factrs, scaling, output);
+    }
+}
+
+extern "C" {
+    void face_swap_warp_into(PhiPoint * landmarks_face1_ptr, PhiPoint * landmarks_face2_ptr, double * parameters_face1, double * parameters_face2, double*factr_face1, double*factr_face2, PhiPoint * output){
+        return_face_pair_warp_into((int*)landmarks_face1_ptr, (int*) landmarks_face2_ptr, parameters_face1, parameters_face2, output);
+    }
+}
+
+extern "C" {
+    void face_puppet_warp_into(PhiPoint * landmarks_face1_ptr, PhiPoint * landmarks_face2_ptr, double * parameters_face1, double * parameters_face2, double*factr_face1, double*factr_face2, PhiPoint * output){
+        return_face_pair_warp_into((int*)landmarks_face1_ptr, (int*) landmarks_face2_ptr, parameters_face1, parameters_face2, output);
+    }
+}
+
+extern "C" {
+    PhiWarpContext * warp_context_create()
+    {
+        // CALLER MUST DESTROY WITH warp_context_destroy.
+        return new PhiWarpContext();
+    }
+}
+
+extern "C" {
+    void warp_context_destroy(PhiWarpContext * context)
+    {
+        delete context;
+    }
+}
+
+extern "C" {
+    void warp_context_set_scaling(PhiWarpContext * context, double * scaling)
+    {
+        std::copy(scaling, scaling + 6, context->scaling);
+    }
+}
+
+extern "C" {
+    void warp_context_set_pose_tolerance(PhiWarpContext * context, double tolerance)
+    {
+        context->pose_tolerance = tolerance;
+    }
+}
+
+extern "C" {
+    void warp_context_set_robust_roll(PhiWarpContext * context, int robust)
+    {
+        // The pose in the context was solved with the other roll, so the next warp solves afresh.
+        context->robust_roll = robust != 0;
+        context->has_pose = false;
+    }
+}
+
+extern "C" {
+    void warp_context_pose_stats(PhiWarpContext * context, unsigned long * hits, unsigned long * misses)
+    {
+        *hits = context->pose_hits;
+        *misses = context->pose_misses;
+    }
+}
+
+extern "C" {
+    void warp_context_warp_into(PhiWarpContext * context, PhiWarpKind kind, PhiPoint * landmarks, double * factr, PhiPoint * output)
+    {
+        context_warp_into(*context, kind, (int *)landmarks, animation_phase(), *factr, output);
+    }
+}
+
+extern "C" {
+    void warp_contexts_warp_into(PhiWarpContext ** contexts, PhiWarpKind kind, int num_faces, PhiPoint * landmarks, double * factrs, PhiPoint * output)
+    {
+        context_warps_into(contexts, kind, num_faces, (int *)landmarks, factrs, output);
+    }
+}
+
+extern "C" {
+    void warp_context_vertices_into(PhiWarpContext * context, float width, float height, float * region_alphas, PhiVertex * output)
+    {
+        write_face_vertices(context->warped, context->source, width, height, region_alphas, output);
+    }
+}
+
+extern "C" {
+    void warp_contexts_swap_into(PhiWarpContext ** contexts, int num_faces, PhiPoint * landmarks, double * factrs, PhiPoint * output)
+    {
+        context_swaps_into(contexts, num_faces, (int *)landmarks, factrs, output);
+    }
+}
+
+extern "C" {
+    PhiCalibrationAccumulator * calibration_create(PhiWarpKind kind)
+    {
+        // CALLER MUST DESTROY WITH calibration_destroy.
+        return new PhiCalibrationAccumulator(kind);
+    }
+}
+
+extern "C" {
+    void calibration_destroy(PhiCalibrationAccumulator * calibration)
+    {
+        delete calibration;
+    }
+}
+
+extern "C" {
+    void calibration_reset(PhiCalibrationAccumulator * calibration)
+    {
+        calibration->reset();
+    }
+}
+
+extern "C" {
+    int calibration_add_observation(PhiCalibrationAccumulator * calibration, PhiPoint * landmarks_ptr)
+    {
+        landmarks_2d landmarks;
+        load_landmarks((int *)landmarks_ptr, landmarks);
+        return calibration->add(landmarks) ? 1 : 0;
+    }
+}
+
+extern "C" {
+    int calibration_num_observations(PhiCalibrationAccumulator * calibration)
+    {
+        return calibration->num_samples;
+    }
+}
+
+extern "C" {
+    int calibration_converged(PhiCalibrationAccumulator * calibration)
+    {
+        return calibration->converged() ? 1 : 0;
+    }
+}
+
+extern "C" {
+    void calibration_estimate(PhiCalibrationAccumulator * calibration, double * scaling)
+    {
+        calibration->estimate(scaling);
+    }
+}
+
+extern "C" {
+    void warp_set_clock(PhiWarpClock clock)
+    {
+        warp_clock = clock;
+    }
+}
+
+extern "C" {
+    void warp_get_stats(PhiWarpStats * stats)
+    {
+        stats->pose_solves = counters.pose_solves.load(std::memory_order_relaxed);
+        stats->solver_iterations = counters.solver_iterations.load(std::memory_order_relaxed);
+        stats->cost_evaluations = counters.cost_evaluations.load(std::memory_order_relaxed);
+        stats->folded_triangles = counters.folded_triangles.load(std::memory_order_relaxed);
+    }
+}
+
+extern "C" {
+    void warp_reset_stats(void)
+    {
+        counters.pose_solves.store(0, std::memory_order_relaxed);
+        counters.solver_iterations.store(0, std::memory_order_relaxed);
+        counters.cost_evaluations.store(0, std::memory_order_relaxed);
+        counters.folded_triangles.store(0, std::memory_order_relaxed);
+    }
+}
+
@@ -7,6 +7,45 @@
 #ifdef __cplusplus
 extern "C" {
 #endif
+
+typedef enum {
+    PhiWarpAttractive,
+    PhiWarpAttractivePretty,
+    PhiWarpAttractiveHandsome,
+    PhiWarpSilly,
+    PhiWarpDynamic,
+    PhiWarpBigNose,
+    PhiWarpBigLips,
+    PhiWarpTiny,
+    PhiWarpGoldenTotalPretty,
+    PhiWarpGoldenTotalHandsome,
+    PhiWarpGoldenInnerPretty,
+    PhiWarpGoldenInnerHandsome,
+    PhiWarpApplyGoldenInnerPretty,
+    PhiWarpApplyGoldenInnerHandsome
+} PhiWarpKind;
+
+// Seconds on any fixed origin. The animated warps read time through the warp clock.
+typedef double (*PhiWarpClock)(void);
+
+typedef struct {
+    unsigned long pose_solves;
+    unsigned long solver_iterations;
+    unsigned long cost_evaluations;
+    // In-face triangles found inside out in a warp, and moved back towards the source
+    unsigned long folded_triangles;
+} PhiWarpStats;
+
+// Null restores the steady clock. Set it before warping, not during.
+void warp_set_clock(PhiWarpClock clock);
+
+// Solver and fold counts since the last reset, across all threads.
+void warp_get_stats(PhiWarpStats * stats);
+
+void warp_reset_stats(void);
+
+// Opaque per-face warp state: smoothing, pose warm start and calibration scales.
+typedef struct PhiWarpContext PhiWarpContext;
     
 PhiPoint * adjusted_warp(PhiPoint * landmarks, PhiPoint * face_flat_warp, double * parameters);
     
@@ -50,6 +89,69 @@ PhiPoint * apply_golden_inner_pretty(PhiPoint * landmarks, double * parameters,
 
 PhiPoint * apply_golden_inner_handsome(PhiPoint * landmarks, double * parameters, double * factr, double * scaling);
 
+// Caller-owned output buffers. scaling is only read by the PhiWarpApplyGoldenInner kinds and may be NULL otherwise.
+void warp_face_into(PhiWarpKind kind, PhiPoint * landmarks, double * parameters, double * factr, double * scaling, PhiPoint * output);
+
+// num_faces faces laid out one after another: 68 landmarks, 7 parameters, 1 factr and 68 output points each.
+void warp_faces_into(PhiWarpKind kind, int num_faces, PhiPoint * landmarks, double * parameters, double * factrs, double * scaling, PhiPoint * output);
+
+// output holds 2 * 68 points.
+void face_swap_warp_into(PhiPoint * landmarks_face1_ptr, PhiPoint * landmarks_face2_ptr, double * parameters_face1, double * parameters_face2, double*factr_face1, double*factr_face2, PhiPoint * output);
+
+void face_puppet_warp_into(PhiPoint * landmarks_face1_ptr, PhiPoint * landmarks_face2_ptr, double * parameters_face1, double * parameters_face2, double*factr_face1, double*factr_face2, PhiPoint * output);
+
+PhiWarpContext * warp_context_create(void);
+
+void warp_context_destroy(PhiWarpContext * context);
+
+// scaling holds the 6 golden inner calibration scales.
+void warp_context_set_scaling(PhiWarpContext * context, double * scaling);
+
+// Pose is reused while aligned RMS landmark motion (pixels) stays below tolerance; 0 always re-solves.
+void warp_context_set_pose_tolerance(PhiWarpContext * context, double tolerance);
+
+// Nonzero estimates roll from mirrored landmark pairs across the whole face instead of the eyes
+// alone, which holds up better when one eye is closed or badly tracked. Off by default.
+void warp_context_set_robust_roll(PhiWarpContext * context, int robust);
+
+void warp_context_pose_stats(PhiWarpContext * context, unsigned long * hits, unsigned long * misses);
+
+void warp_context_warp_into(PhiWarpContext * context, PhiWarpKind kind, PhiPoint * landmarks, double * factr, PhiPoint * output);
+
+// Streaming golden inner calibration. kind picks the template, PhiWarpApplyGoldenInnerPretty or
+// PhiWarpApplyGoldenInnerHandsome. Frames turned away from the camera are rejected; the estimate is
+// a median of means, so a few bad frames do not skew it.
+typedef struct PhiCalibrationAccumulator PhiCalibrationAccumulator;
+
+PhiCalibrationAccumulator * calibration_create(PhiWarpKind kind);
+
+void calibration_destroy(PhiCalibrationAccumulator * calibration);
+
+void calibration_reset(PhiCalibrationAccumulator * calibration);
+
+// Returns 1 if the frame was used, 0 if it was rejected.
+int calibration_add_observation(PhiCalibrationAccumulator * calibration, PhiPoint * landmarks);
+
+int calibration_num_observations(PhiCalibrationAccumulator * calibration);
+
+// 1 once the estimate is stable enough to stop calibrating early.
+int calibration_converged(PhiCalibrationAccumulator * calibration);
+
+// Writes the 6 scales for warp_context_set_scaling and the apply golden inner warps.
+void calibration_estimate(PhiCalibrationAccumulator * calibration, double * scaling);
+
+// Face swap over any number of faces, with no pose solves. Faces swap in consecutive pairs; with an
+// odd count the last face rotates with the first pair. One distinct context per face.
+void warp_contexts_swap_into(PhiWarpContext ** contexts, int num_faces, PhiPoint * landmarks, double * factrs, PhiPoint * output);
+
+// Writes 68 vertices for the context's last warp: warped points as positions, its input landmarks
+// as texture coordinates, both normalised by width and height. Positions are not rounded.
+// region_alphas is {inner face, outline, eyes, mouth}.
+void warp_context_vertices_into(PhiWarpContext * context, float width, float height, float * region_alphas, PhiVertex * output);
+
+// One distinct context per face; faces are warped concurrently when there are enough of them.
+void warp_contexts_warp_into(PhiWarpContext ** contexts, PhiWarpKind kind, int num_faces, PhiPoint * landmarks, double * factrs, PhiPoint * output);
+
 #ifdef __cplusplus
 }
 #endif
@@ -2,6 +2,8 @@
 #ifndef triangle_wrapper_h
 #define triangle_wrapper_h
 
-PhiTriangle * triangulate_wrapper(const PhiPoint * edgesLandMarks, int nEdges, int nFaces, int * nTris);
+// The in-face triangles of nFaces faces of 68 landmarks each. *nTris is set to the count; the
+// caller frees the result.
+PhiTriangle * triangulate_wrapper(int nFaces, int * nTris);
 
 #endif /* triangle_wrapper_h */
@@ -2,6 +2,7 @@
 
 #import <GTEngine.h>
 #import "triangulator.h"
+#import "vertex_cache.h"
 #import "Clarkson-Delaunay.h"
 #include <CoreGraphics/CoreGraphics.h>
 #include <stdlib.h>
@@ -232,6 +233,7 @@ PhiTriangle * unsafeTidyIndices(const PhiPoint * edgesLandMarks, int numEdges, i
     // Now for dirty bit.
     // Set ntris to be the size of 'tidied'
     *nTris = numVertices / 3;
+    optimize_vertex_cache(triResults, *nTris, numPoints, NULL);
     
 //    *nTris = idx;
         return triResults;
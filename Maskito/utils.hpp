@@ -3,6 +3,9 @@
 
 #include <opencv2/imgproc/imgproc.hpp>
 #include <opencv2/highgui/highgui.hpp>
+#include <algorithm>
+#include <array>
+#include <cmath>
 #include <iostream>
 
 double max_of_cvmat(const cv::Mat &mat){
@@ -26,16 +29,6 @@ void elementwise_product_cvmat_scalar(cv::Mat &imagemat, const double scalar){
     };
 };
 
-void elementwise_product_cvmat(cv::Mat &imagemat, const std::vector<std::vector<float>> &vector_b){
-    for(int i=0; i<imagemat.rows; i++){
-        for(int j=0; j<imagemat.cols; j++){
-            imagemat.at<cv::Vec3b>(i,j)[0] = imagemat.at<cv::Vec3b>(i,j)[0] * vector_b[i][j];
-            imagemat.at<cv::Vec3b>(i,j)[1] = imagemat.at<cv::Vec3b>(i,j)[1] * vector_b[i][j];
-            imagemat.at<cv::Vec3b>(i,j)[2] = imagemat.at<cv::Vec3b>(i,j)[2] * vector_b[i][j];
-        };
-    };
-};
-
 void elementwise_sum_cvmat(cv::Mat &imagemat, cv::Mat &imagemat2){
     /*NB sums accumulate in the first cvmat passed in!*/
     for(int i=0; i<imagemat.rows; i++){
@@ -47,74 +40,180 @@ void elementwise_sum_cvmat(cv::Mat &imagemat, cv::Mat &imagemat2){
     };
 };
 
-std::vector<std::vector<float>> elementwise_product(const std::vector<std::vector<float>> &vector_a, const std::vector<std::vector<float>> &vector_b){
-    //Lets hope those two vectors are the same size
-    std::vector<std::vector<float>> product = vector_a;
-    long num_rows = vector_a.size();
-    long num_cols = vector_a[0].size();
-    
-    for (int i = 0; i < num_rows; i++){
-        for (int j = 0; j < num_cols; j++){
-            product[i][j] = vector_a[i][j] * vector_b[i][j];
+// Masks are cv::Mat1f: one contiguous allocation, rows read through plain pointers so the
+// loops below vectorise. They work in place and compose without temporaries.
+
+void elementwise_product(cv::Mat1f &mask, const cv::Mat1f &other){
+    /*mask *= other, in place. The masks must be the same size.*/
+    for (int i = 0; i < mask.rows; i++){
+        float * row = mask[i];
+        const float * other_row = other[i];
+        for (int j = 0; j < mask.cols; j++){
+            row[j] *= other_row[j];
+        };
+    };
+};
+
+void invert_mask(cv::Mat1f &mask){
+    /*mask = 1 - mask, in place.*/
+    for (int i = 0; i < mask.rows; i++){
+        float * row = mask[i];
+        for (int j = 0; j < mask.cols; j++){
+            row[j] = 1.0f - row[j];
+        };
+    };
+};
+
+void elementwise_product_cvmat(cv::Mat &imagemat, const cv::Mat1f &mask){
+    /*Scales each pixel of an 8-bit, 3 channel image by the mask, in place.*/
+    for (int i = 0; i < imagemat.rows; i++){
+        uchar * row = imagemat.ptr<uchar>(i);
+        const float * mask_row = mask[i];
+        for (int j = 0; j < imagemat.cols; j++){
+            row[3 * j + 0] = (uchar)(row[3 * j + 0] * mask_row[j]);
+            row[3 * j + 1] = (uchar)(row[3 * j + 1] * mask_row[j]);
+            row[3 * j + 2] = (uchar)(row[3 * j + 2] * mask_row[j]);
+        };
+    };
+};
+
+void blend_by_mask(cv::Mat &imagemat, const cv::Mat &source, const cv::Mat1f &mask, float weight = 1.0f){
+    /*imagemat += (source - imagemat) * mask * weight, in place, for 8-bit,
+     3 channel images of the same size: takes source where mask * weight is 1
+     and keeps imagemat where it is 0. Replaces the product, inverse product
+     and sum of the two images.*/
+    for (int i = 0; i < imagemat.rows; i++){
+        uchar * row = imagemat.ptr<uchar>(i);
+        const uchar * source_row = source.ptr<uchar>(i);
+        const float * mask_row = mask[i];
+        for (int j = 0; j < imagemat.cols; j++){
+            const float alpha = mask_row[j] * weight;
+            for (int c = 0; c < 3; c++){
+                row[3 * j + c] = (uchar)(row[3 * j + c] + (source_row[3 * j + c] - row[3 * j + c]) * alpha + 0.5f);
+            };
         };
     };
-    return product;
 };
 
-std::vector<std::vector<float>> copy_subset_vector(const std::vector<std::vector<float>> &base_vector, std::vector<int> &indices){
-    std::vector<std::vector<float>> output_vector;
+std::vector<cv::Point2f> landmark_points(const std::array<std::array<long, 2>, 68> &landmarks, const std::vector<int> &indices){
+    std::vector<cv::Point2f> points;
+    points.reserve(indices.size());
     for (int i = 0; i < indices.size(); i++){
-        output_vector.push_back(base_vector[indices[i]]);
+        points.push_back(cv::Point2f((float)landmarks[indices[i]][0], (float)landmarks[indices[i]][1]));
     };
-    return output_vector;
+    return points;
 };
 
-std::vector<std::vector<float>> invert_mask(const std::vector<std::vector<float>> &mask){
-    long num_rows = mask.size();
-    long num_cols = mask[0].size();
-    
-    std::vector<std::vector<float>> inverted_mask;
-    
-    for (int i = 0; i < num_rows; i++){
-        for (int j = 0; j < num_cols; j++){
-            inverted_mask[i][j] = 1.0 - mask[i][j];
+void add_span_coverage(std::vector<float> &coverage, double x_start, double x_end, float weight, bool antialias){
+    /*Adds weight to the pixels of one row covered by [x_start, x_end). Without
+     antialiasing a pixel is covered when its centre is; with it, by the fraction
+     of its width inside the span.*/
+    const double width = (double)coverage.size();
+    if (!antialias){
+        long first = std::max(0L, (long)std::ceil(x_start - 0.5));
+        long last = std::min((long)coverage.size(), (long)std::ceil(x_end - 0.5));
+        for (long x = first; x < last; x++){
+            coverage[x] += weight;
         };
+        return;
     };
-    
-    return inverted_mask;
+    x_start = std::max(0.0, x_start);
+    x_end = std::min(width, x_end);
+    if (x_end <= x_start){
+        return;
+    };
+    long first = (long)x_start;
+    long last = std::min((long)x_end, (long)coverage.size() - 1);
+    if (first == last){
+        coverage[first] += weight * (float)(x_end - x_start);
+        return;
+    };
+    coverage[first] += weight * (float)(first + 1 - x_start);
+    for (long x = first + 1; x < last; x++){
+        coverage[x] += weight;
+    };
+    coverage[last] += weight * (float)(x_end - last);
 };
 
-std::vector<std::vector<float>> convex_mask(const long &num_rows, const long &num_cols, const std::vector<std::vector<float>> &shape){
-    /*Returns an array of the same dimensions as pix_grid, consiting
-     of a mask of 1's and 0's. If a point in pix_grid lies in the convex
-     hull of shape, the mask contains a 1, otherwise it contains a 0.
-     */
-    cv::Subdiv2D subdiv;
-    for (int i = 0; i < shape.size(); i++){
-        cv::Point2f fp((float)shape[i][0], (float)shape[i][1]);
-        subdiv.insert(fp);
+template <typename T>
+void fill_polygon(cv::Mat_<T> &mask, const std::vector<cv::Point2f> &polygon, double value, bool antialias = false){
+    /*Scanline fill of a polygon (convex or not, even-odd rule) into an 8-bit or
+     float mask. Each covered pixel moves towards value, in the mask's units, by its
+     coverage, so 1 (or 255) paints a shape in and 0 cuts one out. Only rows and columns inside the polygon's
+     bounding box are visited. Antialiasing takes 4 sub-scanlines per row and exact
+     horizontal coverage.*/
+    if (polygon.size() < 3){
+        return;
+    };
+    float min_x = polygon[0].x, max_x = polygon[0].x, min_y = polygon[0].y, max_y = polygon[0].y;
+    for (int i = 1; i < polygon.size(); i++){
+        min_x = std::min(min_x, polygon[i].x);
+        max_x = std::max(max_x, polygon[i].x);
+        min_y = std::min(min_y, polygon[i].y);
+        max_y = std::max(max_y, polygon[i].y);
+    };
+    const int col_start = std::max(0, (int)std::floor(min_x));
+    const int col_end = std::min(mask.cols, (int)std::ceil(max_x) + 1);
+    const int row_start = std::max(0, (int)std::floor(min_y));
+    const int row_end = std::min(mask.rows, (int)std::ceil(max_y) + 1);
+    if (col_start >= col_end || row_start >= row_end){
+        return;
     };
     
-    std::vector<std::vector<float>> mask;
-    mask.resize(num_rows);
-    int edge;
-    int vertex;
-    
-    for (int i = 0; i < num_rows; i++){
-        mask[i].resize(num_rows);
-        for (int j = 0; j < num_cols; j++){
-            cv::Point2f fp((float)i, (float)j);
-            int tmp = subdiv.locate(fp, edge, vertex);
-            if(tmp == cv::Subdiv2D::PTLOC_INSIDE)
-            {
-                mask[i][j] = 1.0;
-            }
-            else
-            {
-                mask[i][j] = 0.0;
+    const int samples = antialias ? 4 : 1;
+    const float weight = 1.0f / samples;
+    std::vector<float> coverage(col_end - col_start);
+    std::vector<double> crossings;
+    for (int row = row_start; row < row_end; row++){
+        std::fill(coverage.begin(), coverage.end(), 0.0f);
+        bool covered = false;
+        for (int s = 0; s < samples; s++){
+            const double y = row + (s + 0.5) / samples;
+            crossings.clear();
+            for (int i = 0; i < polygon.size(); i++){
+                const cv::Point2f &p = polygon[i];
+                const cv::Point2f &q = polygon[(i + 1) % polygon.size()];
+                if ((p.y <= y) != (q.y <= y)){
+                    crossings.push_back(p.x + (y - p.y) * (q.x - p.x) / (q.y - p.y));
+                };
             };
+            std::sort(crossings.begin(), crossings.end());
+            for (int k = 0; k + 1 < crossings.size(); k += 2){
+                add_span_coverage(coverage, crossings[k] - col_start, crossings[k + 1] - col_start, weight, antialias);
+                covered = true;
+            };
+        };
+        if (!covered){
+            continue;
         };
+        T * mask_row = mask[row] + col_start;
+        for (int x = 0; x < coverage.size(); x++){
+            const float c = std::min(coverage[x], 1.0f);
+            if (c > 0.0f){
+                mask_row[x] = cv::saturate_cast<T>(mask_row[x] + (value - mask_row[x]) * c);
+            };
+        };
+    };
+};
+
+template <typename T>
+void fill_convex_hull(cv::Mat_<T> &mask, const std::vector<cv::Point2f> &shape, double value, bool antialias = false){
+    /*Fills the convex hull of shape, see fill_polygon.*/
+    if (shape.size() < 3){
+        return;
     };
+    std::vector<cv::Point2f> hull;
+    cv::convexHull(shape, hull);
+    fill_polygon(mask, hull, value, antialias);
+};
+
+cv::Mat1f convex_mask(const long &num_rows, const long &num_cols, const std::vector<cv::Point2f> &shape, bool antialias = false){
+    /*Returns a num_rows x num_cols mask of 1's and 0's (fractions on the
+     border when antialiased). A pixel is 1 when it lies in the convex hull
+     of shape, whose points are (x, y) = (column, row).
+     */
+    cv::Mat1f mask = cv::Mat1f::zeros((int)num_rows, (int)num_cols);
+    fill_convex_hull(mask, shape, 1.0, antialias);
     return mask;
 };
 
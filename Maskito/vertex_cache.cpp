@@ -0,0 +1,332 @@
+#include "vertex_cache.h"
+
+#include <stdlib.h>
+#include <string.h>
+#include <algorithm>
+#include <cmath>
+#include <unordered_map>
+#include <vector>
+
+// Tuning from Tom Forsyth, "Linear-Speed Vertex Cache Optimisation". The optimiser models an LRU
+// cache of this many entries; it does not need to match the hardware size to do well.
+static const int kCacheSize = 32;
+static const float kCacheDecayPower = 1.5f;
+static const float kLastTriScore = 0.75f;
+static const float kValenceBoostScale = 2.0f;
+static const float kValenceBoostPower = 0.5f;
+
+static float vertex_score(int cachePosition, int remainingTris)
+{
+    if (remainingTris == 0)
+    {
+        return -1.0f;
+    }
+    float score = 0.0f;
+    if (cachePosition >= 3)
+    {
+        score = std::pow(1.0f - (cachePosition - 3) / (float)(kCacheSize - 3), kCacheDecayPower);
+    }
+    else if (cachePosition >= 0)
+    {
+        // The triangle just drawn: fixed score, so the next one is not forced to share its newest edge.
+        score = kLastTriScore;
+    }
+    // Vertices with few triangles left get a boost, so they are finished off rather than left stranded.
+    return score + kValenceBoostScale * std::pow((float)remainingTris, -kValenceBoostPower);
+}
+
+static const unsigned int * tri_indices(const PhiTriangle &tri)
+{
+    return &tri.p0;
+}
+
+float average_cache_miss_ratio(const PhiTriangle * tris, int nTris, int cacheSize)
+{
+    if (nTris <= 0)
+    {
+        return 0.0f;
+    }
+    unsigned int maxIndex = 0;
+    for (int t = 0; t < nTris; ++t)
+    {
+        const unsigned int * v = tri_indices(tris[t]);
+        for (int k = 0; k < 3; ++k)
+        {
+            maxIndex = std::max(maxIndex, v[k]);
+        }
+    }
+    // A FIFO holds exactly the last cacheSize misses, so a vertex is cached if it was loaded
+    // within that many misses.
+    std::vector<int> loadedAt(maxIndex + 1, -1);
+    int misses = 0;
+    for (int t = 0; t < nTris; ++t)
+    {
+        const unsigned int * v = tri_indices(tris[t]);
+        for (int k = 0; k < 3; ++k)
+        {
+            if (loadedAt[v[k]] < 0 || misses - loadedAt[v[k]] > cacheSize)
+            {
+                loadedAt[v[k]] = misses++;
+            }
+        }
+    }
+    return (float)misses / nTris;
+}
+
+int optimize_vertex_cache(PhiTriangle * tris, int nTris, int nVertices, PhiVertexCacheStats * stats)
+{
+    for (int t = 0; t < nTris; ++t)
+    {
+        const unsigned int * v = tri_indices(tris[t]);
+        if (v[0] >= (unsigned int)nVertices || v[1] >= (unsigned int)nVertices || v[2] >= (unsigned int)nVertices)
+        {
+            return 0;
+        }
+    }
+    if (stats)
+    {
+        stats->acmrBefore = average_cache_miss_ratio(tris, nTris, PHI_REPORT_CACHE_SIZE);
+    }
+
+    // Triangles still to be drawn around each vertex: the first remaining[v] entries of its
+    // slice of vertexTris.
+    std::vector<int> remaining(nVertices, 0);
+    std::vector<int> firstTri(nVertices + 1, 0);
+    for (int t = 0; t < nTris; ++t)
+    {
+        const unsigned int * v = tri_indices(tris[t]);
+        for (int k = 0; k < 3; ++k)
+        {
+            ++remaining[v[k]];
+        }
+    }
+    for (int v = 0; v < nVertices; ++v)
+    {
+        firstTri[v + 1] = firstTri[v] + remaining[v];
+    }
+    std::vector<int> vertexTris(firstTri[nVertices]);
+    std::vector<int> filled(firstTri.begin(), firstTri.end() - 1);
+    for (int t = 0; t < nTris; ++t)
+    {
+        const unsigned int * v = tri_indices(tris[t]);
+        for (int k = 0; k < 3; ++k)
+        {
+            vertexTris[filled[v[k]]++] = t;
+        }
+    }
+
+    std::vector<int> cachePosition(nVertices, -1);
+    std::vector<float> vertexScore(nVertices);
+    std::vector<float> triScore(nTris, 0.0f);
+    std::vector<char> drawn(nTris, 0);
+    for (int v = 0; v < nVertices; ++v)
+    {
+        vertexScore[v] = vertex_score(-1, remaining[v]);
+    }
+    int best = -1;
+    for (int t = 0; t < nTris; ++t)
+    {
+        const unsigned int * v = tri_indices(tris[t]);
+        triScore[t] = vertexScore[v[0]] + vertexScore[v[1]] + vertexScore[v[2]];
+        if (best < 0 || triScore[t] > triScore[best])
+        {
+            best = t;
+        }
+    }
+
+    std::vector<PhiTriangle> ordered;
+    ordered.reserve(nTris);
+    std::vector<int> cache, nextCache;
+    cache.reserve(kCacheSize + 3);
+    nextCache.reserve(kCacheSize + 3);
+    int scan = 0;
+    while ((int)ordered.size() < nTris)
+    {
+        if (best < 0)
+        {
+            // Nothing in the cache touches an undrawn triangle: start again from the next one in the input.
+            while (drawn[scan])
+            {
+                ++scan;
+            }
+            best = scan;
+        }
+        drawn[best] = 1;
+        ordered.push_back(tris[best]);
+
+        const unsigned int * v = tri_indices(tris[best]);
+        nextCache.clear();
+        for (int k = 0; k < 3; ++k)
+        {
+            int * active = &vertexTris[firstTri[v[k]]];
+            for (int i = 0; i < remaining[v[k]]; ++i)
+            {
+                if (active[i] == best)
+                {
+                    active[i] = active[--remaining[v[k]]];
+                    break;
+                }
+            }
+            if (std::find(nextCache.begin(), nextCache.end(), (int)v[k]) == nextCache.end())
+            {
+                nextCache.push_back(v[k]);
+            }
+        }
+        for (int vertex : cache)
+        {
+            if (vertex != (int)v[0] && vertex != (int)v[1] && vertex != (int)v[2])
+            {
+                nextCache.push_back(vertex);
+            }
+        }
+
+        // Rescore every vertex whose position changed, including those pushed out of the cache,
+        // and pass the difference on to the triangles still around it.
+        for (int i = 0; i < (int)nextCache.size(); ++i)
+        {
+            int vertex = nextCache[i];
+            cachePosition[vertex] = i < kCacheSize ? i : -1;
+            float score = vertex_score(cachePosition[vertex], remaining[vertex]);
+            float delta = score - vertexScore[vertex];
+            vertexScore[vertex] = score;
+            const int * active = &vertexTris[firstTri[vertex]];
+            for (int j = 0; j < remaining[vertex]; ++j)
+            {
+                triScore[active[j]] += delta;
+            }
+        }
+        if ((int)nextCache.size() > kCacheSize)
+        {
+            nextCache.resize(kCacheSize);
+        }
+        std::swap(cache, nextCache);
+
+        best = -1;
+        for (int vertex : cache)
+        {
+            const int * active = &vertexTris[firstTri[vertex]];
+            for (int j = 0; j < remaining[vertex]; ++j)
+            {
+                if (best < 0 || triScore[active[j]] > triScore[best])
+                {
+                    best = active[j];
+                }
+            }
+        }
+    }
+
+    if (nTris > 0)
+    {
+        memcpy(tris, &ordered[0], sizeof(PhiTriangle) * nTris);
+    }
+    if (stats)
+    {
+        stats->acmrAfter = average_cache_miss_ratio(tris, nTris, PHI_REPORT_CACHE_SIZE);
+    }
+    return 1;
+}
+
+static unsigned long long edge_key(unsigned int from, unsigned int to)
+{
+    return ((unsigned long long)from << 32) | to;
+}
+
+int triangle_strip16(const PhiTriangle * tris, int nTris, unsigned short ** strip)
+{
+    *strip = NULL;
+    std::unordered_map<unsigned long long, int> edgeTri;
+    edgeTri.reserve(3 * nTris);
+    std::vector<char> used(nTris, 0);
+    for (int t = 0; t < nTris; ++t)
+    {
+        const unsigned int * v = tri_indices(tris[t]);
+        if (v[0] > 0xFFFF || v[1] > 0xFFFF || v[2] > 0xFFFF)
+        {
+            return 0;
+        }
+        if (v[0] == v[1] || v[1] == v[2] || v[2] == v[0])
+        {
+            used[t] = 1;
+            continue;
+        }
+        for (int k = 0; k < 3; ++k)
+        {
+            edgeTri.emplace(edge_key(v[k], v[(k + 1) % 3]), t);
+        }
+    }
+
+    // The undrawn triangle with the directed edge from -> to, or -1.
+    auto neighbour = [&](unsigned int from, unsigned int to) {
+        auto found = edgeTri.find(edge_key(from, to));
+        return (found == edgeTri.end() || used[found->second]) ? -1 : found->second;
+    };
+
+    std::vector<unsigned short> out;
+    out.reserve(nTris * 2);
+    for (int t = 0; t < nTris; ++t)
+    {
+        if (used[t])
+        {
+            continue;
+        }
+        // Start with the rotation whose third edge can continue the strip, if any does.
+        const unsigned int * v = tri_indices(tris[t]);
+        int r = 0;
+        while (r < 3 && neighbour(v[(r + 2) % 3], v[(r + 1) % 3]) < 0)
+        {
+            ++r;
+        }
+        r %= 3;
+        unsigned short a = v[r], b = v[(r + 1) % 3], c = v[(r + 2) % 3];
+        if (!out.empty())
+        {
+            // Degenerate joint; each strip starts on an even position so its winding is not flipped.
+            out.push_back(out.back());
+            out.push_back(a);
+            if (out.size() % 2 == 1)
+            {
+                out.push_back(a);
+            }
+        }
+        out.push_back(a);
+        out.push_back(b);
+        out.push_back(c);
+        used[t] = 1;
+
+        for (;;)
+        {
+            // Odd triangles in a strip are wound backwards, so the shared edge runs the other way.
+            size_t n = out.size();
+            bool even = (n - 2) % 2 == 0;
+            unsigned int from = even ? out[n - 2] : out[n - 1];
+            unsigned int to = even ? out[n - 1] : out[n - 2];
+            int next = neighbour(from, to);
+            if (next < 0)
+            {
+                break;
+            }
+            used[next] = 1;
+            const unsigned int * w = tri_indices(tris[next]);
+            for (int k = 0; k < 3; ++k)
+            {
+                if (w[k] != from && w[k] != to)
+                {
+                    out.push_back(w[k]);
+                    break;
+                }
+            }
+        }
+    }
+
+    if (out.empty())
+    {
+        return 0;
+    }
+    *strip = (unsigned short *) malloc(sizeof(unsigned short) * out.size());
+    if (*strip == NULL)
+    {
+        return 0;
+    }
+    memcpy(*strip, &out[0], sizeof(unsigned short) * out.size());
+    return (int)out.size();
+}
@@ -0,0 +1,39 @@
+//
+//  vertex_cache.h
+//
+
+#ifndef vertex_cache_h
+#define vertex_cache_h
+
+#include "PHI_C_Types.h"
+
+// Cache size used for the ACMR figures in PhiVertexCacheStats. Small enough to be pessimistic
+// for the post-transform caches of current mobile GPUs.
+#define PHI_REPORT_CACHE_SIZE 16
+
+typedef struct {
+    float acmrBefore;
+    float acmrAfter;
+} PhiVertexCacheStats;
+
+#ifdef __cplusplus
+extern "C" {
+#endif
+    // Average cache miss ratio: vertices transformed per triangle when tris are drawn through a FIFO
+    // post-transform cache of cacheSize entries. 3 is the worst case, about 0.5 the best for a large grid.
+    float average_cache_miss_ratio(const PhiTriangle * tris, int nTris, int cacheSize);
+
+    // Reorders tris in place so that consecutive triangles reuse recently transformed vertices
+    // (Forsyth's linear-speed optimiser). Every triangle keeps its vertex order, so winding is unchanged.
+    // stats may be NULL. Returns 0 and leaves tris untouched if an index is not below nVertices.
+    int optimize_vertex_cache(PhiTriangle * tris, int nTris, int nVertices, PhiVertexCacheStats * stats);
+
+    // Converts a triangle list into a single strip of 16 bit indices, joining runs with degenerate
+    // triangles; winding is preserved. Degenerate input triangles are dropped. *strip is for the caller
+    // to free. Returns the strip length, or 0 if an index does not fit in 16 bits.
+    int triangle_strip16(const PhiTriangle * tris, int nTris, unsigned short ** strip);
+#ifdef __cplusplus
+}
+#endif
+
+#endif /* vertex_cache_h */
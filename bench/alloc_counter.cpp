@@ -0,0 +1,75 @@
+//
+//  alloc_counter.cpp
+//
+//  Replaces the global allocators with counting versions for the standalone checks.
+//
+
+#include "alloc_counter.h"
+
+#include <cstdlib>
+#include <new>
+
+std::atomic<long> new_calls(0);
+std::atomic<long> malloc_calls(0);
+
+#if defined(__GLIBC__)
+// glibc lets a program replace malloc and reach the real allocator through these.
+extern "C" void * __libc_malloc(size_t size);
+extern "C" void * __libc_calloc(size_t count, size_t size);
+extern "C" void * __libc_realloc(void * pointer, size_t size);
+
+extern "C" void * malloc(size_t size)
+{
+    malloc_calls.fetch_add(1, std::memory_order_relaxed);
+    return __libc_malloc(size);
+}
+
+extern "C" void * calloc(size_t count, size_t size)
+{
+    malloc_calls.fetch_add(1, std::memory_order_relaxed);
+    return __libc_calloc(count, size);
+}
+
+extern "C" void * realloc(void * pointer, size_t size)
+{
+    malloc_calls.fetch_add(1, std::memory_order_relaxed);
+    return __libc_realloc(pointer, size);
+}
+
+void * raw_allocate(size_t size)
+{
+    return __libc_malloc(size);
+}
+#else
+// Elsewhere only operator new is counted.
+void * raw_allocate(size_t size)
+{
+    return std::malloc(size);
+}
+#endif
+
+void * operator new(size_t size)
+{
+    new_calls.fetch_add(1, std::memory_order_relaxed);
+    void * pointer = raw_allocate(size ? size : 1);
+    if (!pointer)
+    {
+        throw std::bad_alloc();
+    }
+    return pointer;
+}
+
+void * operator new[](size_t size)
+{
+    return operator new(size);
+}
+
+void operator delete(void * pointer) noexcept
+{
+    std::free(pointer);
+}
+
+void operator delete[](void * pointer) noexcept
+{
+    std::free(pointer);
+}
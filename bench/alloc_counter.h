@@ -0,0 +1,16 @@
+//
+//  alloc_counter.h
+//
+//  Heap allocations made by the whole program so far. Linking alloc_counter.o replaces
+//  operator new and, on glibc, malloc, calloc and realloc with versions that count calls.
+//
+
+#ifndef alloc_counter_h
+#define alloc_counter_h
+
+#include <atomic>
+
+extern std::atomic<long> new_calls;
+extern std::atomic<long> malloc_calls;
+
+#endif /* alloc_counter_h */
@@ -0,0 +1,139 @@
+//
+//  delaunay_bench.cpp
+//
+//  Core scaling of GTE's Delaunay2: triangulates the same random point sets with 1 to N
+//  threads, reports the median time and the speed-up over one thread, and checks that every
+//  result is a Delaunay triangulation with as many triangles as the serial insertion. Whole-pixel
+//  points are often cocircular, so the triangles themselves may differ between thread counts.
+//
+//  usage: delaunay_bench [max threads] [points] [repetitions]
+//
+
+#include <Mathematics/GteBSNumber.h>
+#include <Mathematics/GteDelaunay2.h>
+#include <Mathematics/GteUIntegerAP32.h>
+
+#include <algorithm>
+#include <chrono>
+#include <cstdio>
+#include <cstdlib>
+#include <random>
+#include <thread>
+#include <vector>
+
+typedef gte::BSNumber<gte::UIntegerAP32> exact_number;
+typedef gte::Delaunay2<float, exact_number> triangulator;
+
+// Exact for whole-pixel coordinates: positive when d is strictly inside the circumcircle of the
+// counterclockwise triangle a, b, c.
+long long in_circle(const gte::Vector2<float> &a, const gte::Vector2<float> &b, const gte::Vector2<float> &c, const gte::Vector2<float> &d)
+{
+    const long long ax = (long long)a[0] - (long long)d[0], ay = (long long)a[1] - (long long)d[1];
+    const long long bx = (long long)b[0] - (long long)d[0], by = (long long)b[1] - (long long)d[1];
+    const long long cx = (long long)c[0] - (long long)d[0], cy = (long long)c[1] - (long long)d[1];
+    return (ax * ax + ay * ay) * (bx * cy - cx * by) - (bx * bx + by * by) * (ax * cy - cx * ay) + (cx * cx + cy * cy) * (ax * by - bx * ay);
+}
+
+// Every triangle must be counterclockwise, adjacent both ways, and have no neighbour's far
+// vertex strictly inside its circumcircle; locally Delaunay everywhere is Delaunay.
+bool is_delaunay(const triangulator &delaunay, const std::vector<gte::Vector2<float>> &points)
+{
+    const std::vector<int> &indices = delaunay.GetIndices();
+    const std::vector<int> &adjacencies = delaunay.GetAdjacencies();
+    const int num_triangles = delaunay.GetNumTriangles();
+    for (int t = 0; t < num_triangles; t++)
+    {
+        const gte::Vector2<float> &a = points[indices[3 * t]], &b = points[indices[3 * t + 1]], &c = points[indices[3 * t + 2]];
+        const long long area = ((long long)b[0] - (long long)a[0]) * ((long long)c[1] - (long long)a[1]) - ((long long)c[0] - (long long)a[0]) * ((long long)b[1] - (long long)a[1]);
+        if (area <= 0)
+        {
+            return false;
+        }
+        for (int j = 0; j < 3; j++)
+        {
+            const int neighbour = adjacencies[3 * t + j];
+            if (neighbour < 0)
+            {
+                continue;
+            }
+            int far = -1;
+            bool linked = false;
+            for (int k = 0; k < 3; k++)
+            {
+                const int vertex = indices[3 * neighbour + k];
+                if (vertex != indices[3 * t] && vertex != indices[3 * t + 1] && vertex != indices[3 * t + 2])
+                {
+                    far = vertex;
+                }
+                linked = linked || adjacencies[3 * neighbour + k] == t;
+            }
+            if (far < 0 || !linked || in_circle(a, b, c, points[far]) > 0)
+            {
+                return false;
+            }
+        }
+    }
+    return true;
+}
+
+int main(int argc, char ** argv)
+{
+    const unsigned cores = std::max(1u, std::thread::hardware_concurrency());
+    const unsigned max_threads = argc > 1 ? (unsigned)atoi(argv[1]) : cores;
+    const int num_points = argc > 2 ? atoi(argv[2]) : 20000;
+    const int repetitions = argc > 3 ? atoi(argv[3]) : 5;
+    if (max_threads < 1 || num_points < 3 || repetitions < 1)
+    {
+        fprintf(stderr, "usage: %s [max threads] [points] [repetitions]\n", argv[0]);
+        return 2;
+    }
+
+    // Whole-pixel coordinates like tracked landmarks, so duplicates and cocircular points occur.
+    std::mt19937 random(7);
+    std::vector<std::vector<gte::Vector2<float>>> point_sets(repetitions);
+    for (std::vector<gte::Vector2<float>> &points : point_sets)
+    {
+        for (int i = 0; i < num_points; i++)
+        {
+            points.push_back(gte::Vector2<float>{(float)(random() % 1920), (float)(random() % 1080)});
+        }
+    }
+
+    std::vector<int> serial_triangles(repetitions);
+    double serial_median = 0.0;
+    int failures = 0;
+    printf("%d points, median of %d, %u cores\n", num_points, repetitions, cores);
+    printf("threads  median ms  speed-up  triangles\n");
+    for (unsigned threads = 1; threads <= max_threads; threads++)
+    {
+        triangulator delaunay(threads);
+        std::vector<double> times;
+        size_t num_triangles = 0;
+        for (int r = 0; r < repetitions; r++)
+        {
+            const std::vector<gte::Vector2<float>> &points = point_sets[r];
+            const auto start = std::chrono::steady_clock::now();
+            delaunay((int)points.size(), &points[0], 0.0f);
+            times.push_back(std::chrono::duration<double, std::milli>(std::chrono::steady_clock::now() - start).count());
+
+            num_triangles = delaunay.GetNumTriangles();
+            if (threads == 1)
+            {
+                serial_triangles[r] = delaunay.GetNumTriangles();
+            }
+            if (delaunay.GetNumTriangles() != serial_triangles[r] || !is_delaunay(delaunay, points))
+            {
+                printf("FAIL %u threads: point set %d is not the Delaunay triangulation\n", threads, r);
+                failures++;
+            }
+        }
+        std::sort(times.begin(), times.end());
+        const double median = times[times.size() / 2];
+        if (threads == 1)
+        {
+            serial_median = median;
+        }
+        printf("%7u  %9.2f  %8.2f  %9zu\n", threads, median, serial_median / median, num_triangles);
+    }
+    return failures ? 1 : 0;
+}
@@ -0,0 +1,124 @@
+//
+//  fold_test.cpp
+//
+//  Checks that fold repair leaves closed mouths alone. The inner lips of a closed mouth are
+//  slivers that cross by a pixel after rounding; they must not count as folds, and the mouth
+//  must keep the shape the tiny warp gives it rather than being moved back to the source. The
+//  fixture holds tracked faces whose mouths an earlier repair reverted, and one with the inner
+//  lips pressed exactly together.
+//
+//  usage: fold_test fixture.csv
+//
+
+#include <algorithm>
+#include <cmath>
+#include <cstdio>
+#include <fstream>
+#include <sstream>
+#include <string>
+#include <vector>
+
+#include "normalise_warp.h"
+
+const double frame_rate = 30.0;
+const double initial_parameters[7] = {0.0, 1.0, 0.0, 1.0, 0.0, 0.0, 1.0};
+const double min_mouth_move = 4.0;
+
+int current_frame = 0;
+
+double virtual_clock()
+{
+    return current_frame / frame_rate;
+}
+
+struct closed_mouth
+{
+    int frame;
+    PhiPoint landmarks[68];
+};
+
+// One face per row, in the fixture format warp_bench reads; the frame sets the warp clock.
+bool load_faces(const char * path, std::vector<closed_mouth> &faces)
+{
+    std::ifstream file(path);
+    if (!file)
+    {
+        fprintf(stderr, "cannot read %s\n", path);
+        return false;
+    }
+    std::string line;
+    while (std::getline(file, line))
+    {
+        if (line.empty() || line[0] == '#')
+        {
+            continue;
+        }
+        std::replace(line.begin(), line.end(), ',', ' ');
+        std::istringstream fields(line);
+        closed_mouth face;
+        int face_index;
+        fields >> face.frame >> face_index;
+        for (int i = 0; i < 68; i++)
+        {
+            fields >> face.landmarks[i].x >> face.landmarks[i].y;
+        }
+        if (!fields)
+        {
+            fprintf(stderr, "%s: bad row for frame %d\n", path, face.frame);
+            return false;
+        }
+        faces.push_back(face);
+    }
+    return !faces.empty();
+}
+
+double distance(const PhiPoint &a, const PhiPoint &b)
+{
+    return std::hypot((double)(a.x - b.x), (double)(a.y - b.y));
+}
+
+int main(int argc, char ** argv)
+{
+    if (argc != 2)
+    {
+        fprintf(stderr, "usage: %s fixture.csv\n", argv[0]);
+        return 2;
+    }
+    std::vector<closed_mouth> faces;
+    if (!load_faces(argv[1], faces))
+    {
+        return 2;
+    }
+
+    warp_set_clock(virtual_clock);
+    int failures = 0;
+    for (closed_mouth &face : faces)
+    {
+        current_frame = face.frame;
+        double parameters[7];
+        std::copy(initial_parameters, initial_parameters + 7, parameters);
+        double factr = 0.0;
+        PhiPoint output[68];
+        warp_face_into(PhiWarpTiny, face.landmarks, parameters, &factr, NULL, output);
+
+        // The tiny warp moves every mouth point well over min_mouth_move; a mouth repaired back to
+        // the source stays within a pixel or two of it.
+        for (int i = 48; i < 68; i++)
+        {
+            if (distance(output[i], face.landmarks[i]) < min_mouth_move)
+            {
+                printf("FAIL frame %d: mouth point %d moved from (%d, %d) only to (%d, %d)\n", face.frame, i, face.landmarks[i].x, face.landmarks[i].y, output[i].x, output[i].y);
+                failures++;
+                break;
+            }
+        }
+    }
+    warp_set_clock(NULL);
+
+    if (failures)
+    {
+        return 1;
+    }
+    printf("%zu closed mouths kept their tiny warp\n", faces.size());
+    return 0;
+}
@@ -0,0 +1,90 @@
+//
+//  roll_test.cpp
+//
+//  Checks the robust roll setting on a tilted face with one eye tracked too high. The eye-only
+//  roll follows the bad eye and tilts the template's jaw and nose that the golden total warp
+//  puts in place; the roll from mirrored pairs across the whole face should tilt them far less.
+//
+
+#include <algorithm>
+#include <cmath>
+#include <cstdio>
+
+#include "normalise_warp.h"
+#include "synthetic_faces.h"
+
+// How far the left eye is tracked above where it is, in pixels
+const int eye_error = 8;
+
+int failures = 0;
+
+void warp(PhiWarpContext * context, PhiPoint * face, PhiPoint * output)
+{
+    double factr = 0.0;
+    warp_context_warp_into(context, PhiWarpGoldenTotalPretty, face, &factr, output);
+}
+
+void warp_with_roll(bool robust, PhiPoint * face, PhiPoint * output)
+{
+    PhiWarpContext * context = warp_context_create();
+    warp_context_set_robust_roll(context, robust);
+    warp(context, face, output);
+    warp_context_destroy(context);
+}
+
+// Largest movement of the jaw and nose, the points the golden total warp takes from the template
+double jaw_and_nose_moved(const PhiPoint * from, const PhiPoint * to)
+{
+    double moved = 0.0;
+    for (int i = 0; i < 36; i++)
+    {
+        moved = std::max(moved, std::hypot((double)(to[i].x - from[i].x), (double)(to[i].y - from[i].y)));
+    }
+    return moved;
+}
+
+int main()
+{
+    PhiPoint face[68], bad_eye[68];
+    make_face(face, 0.2, 0.0, 0.3, 2.0, 500, 400, 0);
+    std::copy(face, face + 68, bad_eye);
+    for (int i = 36; i < 42; i++)
+    {
+        bad_eye[i].y -= eye_error;
+    }
+
+    double moved[2];
+    PhiPoint robust_output[68];
+    for (int robust = 0; robust < 2; robust++)
+    {
+        PhiPoint output[68], bad_eye_output[68];
+        warp_with_roll(robust, face, output);
+        warp_with_roll(robust, bad_eye, bad_eye_output);
+        moved[robust] = jaw_and_nose_moved(output, bad_eye_output);
+        printf("%-9s roll: a %d px eye error moves the jaw and nose %.1f px\n", robust ? "robust" : "eye-only", eye_error, moved[robust]);
+        if (robust)
+        {
+            std::copy(bad_eye_output, bad_eye_output + 68, robust_output);
+        }
+    }
+    if (!(moved[1] <= 0.5 * moved[0]))
+    {
+        printf("FAIL the robust roll should at least halve the eye-only movement\n");
+        failures++;
+    }
+
+    // Turning the setting on for a face already being tracked must not keep the eye-only pose.
+    PhiWarpContext * context = warp_context_create();
+    PhiPoint output[68];
+    warp(context, bad_eye, output);
+    warp_context_set_robust_roll(context, 1);
+    warp(context, bad_eye, output);
+    warp_context_destroy(context);
+    if (jaw_and_nose_moved(output, robust_output) > 0.0)
+    {
+        printf("FAIL switching a context to the robust roll kept its eye-only pose\n");
+        failures++;
+    }
+
+    return failures ? 1 : 0;
+}
@@ -0,0 +1,94 @@
+//
+//  swap_test.cpp
+//
+//  Checks that every face swap entry point hands each face its partner's landmarks unchanged,
+//  including faces turned far enough apart that a repair toward the face's own shape would
+//  have moved points.
+//
+
+#include <algorithm>
+#include <cstdio>
+
+#include "normalise_warp.h"
+#include "synthetic_faces.h"
+
+const int max_faces = 5;
+const double initial_parameters[7] = {0.0, 1.0, 0.0, 1.0, 0.0, 0.0, 1.0};
+
+PhiPoint faces[max_faces][68];
+double parameters[max_faces][7];
+double factrs[max_faces];
+PhiPoint output[max_faces * 68];
+PhiWarpContext * contexts[max_faces];
+
+int failures = 0;
+
+// Partners as documented for warp_contexts_swap_into: consecutive pairs, and with an odd count
+// the last face joins the first pair in a rotation.
+int expected_partner(int face, int num_faces)
+{
+    if (num_faces % 2 == 1 && num_faces > 1)
+    {
+        if (face == 0)
+        {
+            return num_faces - 1;
+        }
+        if (face == num_faces - 1)
+        {
+            return 1;
+        }
+    }
+    return face % 2 == 0 ? face + 1 : face - 1;
+}
+
+void expect_partner(const char * name, int face, const PhiPoint * swapped, const PhiPoint * partner)
+{
+    for (int i = 0; i < 68; i++)
+    {
+        if (swapped[i].x != partner[i].x || swapped[i].y != partner[i].y)
+        {
+            printf("FAIL %s: face %d point %d is (%d, %d), partner has (%d, %d)\n", name, face, i, swapped[i].x, swapped[i].y, partner[i].x, partner[i].y);
+            failures++;
+            return;
+        }
+    }
+}
+
+int main()
+{
+    for (int face = 0; face < max_faces; face++)
+    {
+        // Neighbouring faces look in opposite directions and differ in size and roll.
+        double yaw = (face % 2 ? -0.6 : 0.6) * (1.0 + 0.1 * face);
+        make_face(faces[face], yaw, 0.1 * (face % 3), 0.15 * (face - 2), 1.8 + 0.3 * face, 300 + 250 * face, 400 + 30 * face, face + 1);
+        std::copy(initial_parameters, initial_parameters + 7, parameters[face]);
+        contexts[face] = warp_context_create();
+    }
+
+    face_swap_warp_into(faces[0], faces[1], parameters[0], parameters[1], &factrs[0], &factrs[1], output);
+    expect_partner("face_swap_warp_into", 0, output, faces[1]);
+    expect_partner("face_swap_warp_into", 1, output + 68, faces[0]);
+
+    for (int num_faces = 2; num_faces <= max_faces; num_faces++)
+    {
+        char name[64];
+        snprintf(name, sizeof(name), "warp_contexts_swap_into, %d faces", num_faces);
+        warp_contexts_swap_into(contexts, num_faces, faces[0], factrs, output);
+        for (int face = 0; face < num_faces; face++)
+        {
+            expect_partner(name, face, output + face * 68, faces[expected_partner(face, num_faces)]);
+        }
+    }
+
+    for (int face = 0; face < max_faces; face++)
+    {
+        warp_context_destroy(contexts[face]);
+    }
+
+    if (failures)
+    {
+        return 1;
+    }
+    printf("every swap returned its partner's landmarks\n");
+    return 0;
+}
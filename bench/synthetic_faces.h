@@ -0,0 +1,38 @@
+//
+//  synthetic_faces.h
+//
+//  68-point faces for the standalone checks: the dlib 3D template turned to a pose, scaled,
+//  placed and rounded to whole pixels like tracker output.
+//
+
+#ifndef synthetic_faces_h
+#define synthetic_faces_h
+
+#include <cmath>
+#include <cstdlib>
+
+#include "PHI_C_Types.h"
+
+// Defined with the face templates in normalise_warp.cpp
+extern double landmarks3d_dlib[];
+
+// jitter_seed 0 gives an exact projection; any other seed adds up to a pixel of tracker noise.
+inline void make_face(PhiPoint * face, double yaw, double pitch, double roll, double scale, double x, double y, unsigned jitter_seed)
+{
+    srand(jitter_seed);
+    for (int i = 0; i < 68; i++)
+    {
+        double px = landmarks3d_dlib[3 * i], py = landmarks3d_dlib[3 * i + 1], pz = landmarks3d_dlib[3 * i + 2];
+        double x1 = px * cos(yaw) + pz * sin(yaw);
+        double z1 = -px * sin(yaw) + pz * cos(yaw);
+        double y1 = py * cos(pitch) - z1 * sin(pitch);
+        double x2 = x1 * cos(roll) - y1 * sin(roll);
+        double y2 = x1 * sin(roll) + y1 * cos(roll);
+        int noise_x = jitter_seed ? rand() % 3 - 1 : 0;
+        int noise_y = jitter_seed ? rand() % 3 - 1 : 0;
+        face[i].x = (int)lround(x2 * scale + x) + noise_x;
+        face[i].y = (int)lround(y2 * scale + y) + noise_y;
+    }
+}
+
+#endif /* synthetic_faces_h */
@@ -0,0 +1,263 @@
+//
+//  warp_alloc_test.cpp
+//
+//  Counts heap allocations made by each exported warp once it has warmed up, and fails if any
+//  call allocates more than its result buffer: nothing for the _into and context entry points,
+//  one malloc for the entry points that hand back a buffer for the caller to free.
+//
+
+#include <algorithm>
+#include <cstdio>
+#include <cstdlib>
+
+#include "alloc_counter.h"
+#include "normalise_warp.h"
+#include "synthetic_faces.h"
+
+const int num_faces = 6;
+const double initial_parameters[7] = {0.0, 1.0, 0.0, 1.0, 0.0, 0.0, 1.0};
+
+// Inputs and outputs live here, so the calls under test are the only allocations.
+PhiPoint faces[num_faces][68];
+double parameters[num_faces][7];
+double factrs[num_faces];
+double scaling[6] = {1.02, 0.98, 0.95, 1.0, 0.96, 0.96};
+PhiPoint output[num_faces * 68];
+PhiVertex vertices[68];
+PhiWarpContext * contexts[num_faces];
+PhiCalibrationAccumulator * calibration;
+
+// Every frame moves the faces by a pixel or two and sometimes turns them, so both the pose
+// cache hits and the full solves are measured.
+void next_frame(int frame)
+{
+    for (int face = 0; face < num_faces; face++)
+    {
+        double yaw = 0.35 * (face - 2.5) / 2.5 + 0.05 * (frame % 5);
+        make_face(faces[face], yaw, 0.05 * (face % 3), 0.1 * (face - 3), 2.0 + 0.2 * face, 300 + 250 * face, 400 + 20 * face, frame * num_faces + face + 1);
+    }
+}
+
+typedef PhiPoint * (*single_warp)(PhiPoint *, double *, double *);
+
+struct single_case
+{
+    const char * name;
+    single_warp warp;
+};
+
+const single_case single_warps[] = {
+    {"attractive_adjusted_warp", attractive_adjusted_warp},
+    {"attractive_adjusted_warp_pretty", attractive_adjusted_warp_pretty},
+    {"attractive_adjusted_warp_handsome", attractive_adjusted_warp_handsome},
+    {"silly_adjusted_warp", silly_adjusted_warp},
+    {"bignose_adjusted_warp", bignose_adjusted_warp},
+    {"dynamic_adjusted_warp", dynamic_adjusted_warp},
+    {"biglips_adjusted_warp", biglips_adjusted_warp},
+    {"tiny_face_warp", tiny_face_warp},
+    {"golden_total_pretty", golden_total_pretty},
+    {"golden_total_handsome", golden_total_handsome},
+    {"golden_inner_pretty", golden_inner_pretty},
+    {"golden_inner_handsome", golden_inner_handsome}
+};
+
+const PhiWarpKind all_kinds[] = {
+    PhiWarpAttractive, PhiWarpAttractivePretty, PhiWarpAttractiveHandsome, PhiWarpSilly, PhiWarpDynamic,
+    PhiWarpBigNose, PhiWarpBigLips, PhiWarpTiny, PhiWarpGoldenTotalPretty, PhiWarpGoldenTotalHandsome,
+    PhiWarpGoldenInnerPretty, PhiWarpGoldenInnerHandsome, PhiWarpApplyGoldenInnerPretty, PhiWarpApplyGoldenInnerHandsome
+};
+
+const int num_kinds = sizeof(all_kinds) / sizeof(all_kinds[0]);
+const int num_single_warps = sizeof(single_warps) / sizeof(single_warps[0]);
+
+// Runs one call of every entry point for the current frame. Each call is bracketed by counter
+// reads; mallocs[i] and news[i] collect what call i allocated.
+const int max_calls = 64;
+const char * call_names[max_calls];
+long call_mallocs[max_calls];
+long call_news[max_calls];
+long call_allowed_mallocs[max_calls];
+int num_calls;
+
+struct call_scope
+{
+    call_scope(const char * name, long allowed_mallocs) : index(num_calls++)
+    {
+        call_names[index] = name;
+        call_allowed_mallocs[index] = allowed_mallocs;
+        mallocs = malloc_calls.load();
+        news = new_calls.load();
+    }
+    ~call_scope()
+    {
+        call_mallocs[index] += malloc_calls.load() - mallocs;
+        call_news[index] += new_calls.load() - news;
+    }
+    int index;
+    long mallocs;
+    long news;
+};
+
+void run_all_warps()
+{
+    num_calls = 0;
+    for (int i = 0; i < num_single_warps; i++)
+    {
+        PhiPoint * result;
+        {
+            call_scope scope(single_warps[i].name, 1);
+            result = single_warps[i].warp(faces[0], parameters[0], &factrs[0]);
+        }
+        free(result);
+    }
+    {
+        PhiPoint * result;
+        {
+            call_scope scope("adjusted_warp", 1);
+            result = adjusted_warp(faces[0], faces[1], parameters[0]);
+        }
+        free(result);
+    }
+    {
+        PhiPoint3D * result;
+        {
+            call_scope scope("threed_point_set", 1);
+            result = threed_point_set(faces[0], parameters[0], &factrs[0]);
+        }
+        free(result);
+    }
+    {
+        PhiPoint * result;
+        {
+            call_scope scope("face_swap_warp", 1);
+            result = face_swap_warp(faces[0], faces[1], parameters[0], parameters[1], &factrs[0], &factrs[1]);
+        }
+        free(result);
+        {
+            call_scope scope("face_puppet_warp", 1);
+            result = face_puppet_warp(faces[0], faces[1], parameters[0], parameters[1], &factrs[0], &factrs[1]);
+        }
+        free(result);
+    }
+    {
+        double calibrated[6];
+        call_scope scope("calc_golden_inner_pretty/handsome", 0);
+        calc_golden_inner_pretty(faces[0], parameters[0], &factrs[0], calibrated);
+        calc_golden_inner_handsome(faces[0], parameters[0], &factrs[0], calibrated);
+    }
+    {
+        PhiPoint * pretty;
+        PhiPoint * handsome;
+        {
+            call_scope scope("apply_golden_inner_pretty/handsome", 2);
+            pretty = apply_golden_inner_pretty(faces[0], parameters[0], &factrs[0], scaling);
+            handsome = apply_golden_inner_handsome(faces[0], parameters[0], &factrs[0], scaling);
+        }
+        free(pretty);
+        free(handsome);
+    }
+    {
+        call_scope scope("warp_face_into, every kind", 0);
+        for (int k = 0; k < num_kinds; k++)
+        {
+            warp_face_into(all_kinds[k], faces[0], parameters[0], &factrs[0], scaling, output);
+        }
+    }
+    {
+        call_scope scope("warp_faces_into, 2 faces", 0);
+        warp_faces_into(PhiWarpSilly, 2, faces[0], parameters[0], factrs, scaling, output);
+    }
+    {
+        call_scope scope("warp_faces_into, 6 faces", 0);
+        warp_faces_into(PhiWarpTiny, num_faces, faces[0], parameters[0], factrs, scaling, output);
+    }
+    {
+        call_scope scope("face_swap_warp_into/face_puppet_warp_into", 0);
+        face_swap_warp_into(faces[0], faces[1], parameters[0], parameters[1], &factrs[0], &factrs[1], output);
+        face_puppet_warp_into(faces[0], faces[1], parameters[0], parameters[1], &factrs[0], &factrs[1], output);
+    }
+    {
+        call_scope scope("warp_context_warp_into, every kind", 0);
+        for (int k = 0; k < num_kinds; k++)
+        {
+            warp_context_warp_into(contexts[0], all_kinds[k], faces[0], &factrs[0], output);
+        }
+    }
+    {
+        call_scope scope("warp_context_vertices_into", 0);
+        float alphas[4] = {1.0f, 0.5f, 1.0f, 1.0f};
+        warp_context_vertices_into(contexts[0], 1280.0f, 720.0f, alphas, vertices);
+    }
+    {
+        call_scope scope("warp_contexts_warp_into, 2 faces", 0);
+        warp_contexts_warp_into(contexts, PhiWarpBigNose, 2, faces[0], factrs, output);
+    }
+    {
+        call_scope scope("warp_contexts_warp_into, 6 faces", 0);
+        warp_contexts_warp_into(contexts, PhiWarpApplyGoldenInnerPretty, num_faces, faces[0], factrs, output);
+    }
+    {
+        call_scope scope("warp_contexts_swap_into, 2 faces", 0);
+        warp_contexts_swap_into(contexts, 2, faces[0], factrs, output);
+    }
+    {
+        call_scope scope("warp_contexts_swap_into, 5 faces", 0);
+        warp_contexts_swap_into(contexts, 5, faces[0], factrs, output);
+    }
+    {
+        double calibrated[6];
+        call_scope scope("calibration", 0);
+        calibration_add_observation(calibration, faces[2]);
+        calibration_converged(calibration);
+        calibration_estimate(calibration, calibrated);
+    }
+}
+
+int main()
+{
+    for (int face = 0; face < num_faces; face++)
+    {
+        std::copy(initial_parameters, initial_parameters + 7, parameters[face]);
+        contexts[face] = warp_context_create();
+        warp_context_set_scaling(contexts[face], scaling);
+    }
+    calibration = calibration_create(PhiWarpApplyGoldenInnerHandsome);
+    
+    // Warm-up: thread pools, static templates and first-touch caches.
+    const int warm_up_frames = 3;
+    const int measured_frames = 20;
+    for (int frame = 0; frame < warm_up_frames; frame++)
+    {
+        next_frame(frame);
+        run_all_warps();
+    }
+    std::fill(call_mallocs, call_mallocs + max_calls, 0);
+    std::fill(call_news, call_news + max_calls, 0);
+    for (int frame = warm_up_frames; frame < warm_up_frames + measured_frames; frame++)
+    {
+        next_frame(frame);
+        run_all_warps();
+    }
+    
+    int failures = 0;
+    for (int i = 0; i < num_calls; i++)
+    {
+        bool ok = call_news[i] == 0 && call_mallocs[i] <= call_allowed_mallocs[i] * measured_frames;
+        printf("%-4s %-42s malloc %4ld (allowed %ld), new %4ld\n", ok ? "ok" : "FAIL", call_names[i], call_mallocs[i], call_allowed_mallocs[i] * measured_frames, call_news[i]);
+        failures += ok ? 0 : 1;
+    }
+    
+    for (int face = 0; face < num_faces; face++)
+    {
+        warp_context_destroy(contexts[face]);
+    }
+    calibration_destroy(calibration);
+    
+    if (failures)
+    {
+        printf("%d of %d entry points allocated after warm-up\n", failures, num_calls);
+        return 1;
+    }
+    printf("no allocations after warm-up in %d frames\n", measured_frames);
+    return 0;
+}
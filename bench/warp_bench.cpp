@@ -0,0 +1,702 @@
+//
+//  warp_bench.cpp
+//
+//  Replays a landmark sequence through every exported warp on a virtual clock, reports the
+//  latency distribution, solver work and heap allocations of each entry point, and diffs the
+//  outputs against a golden file.
+//
+//  usage: warp_bench [--update] [--tolerance px] [--repeat n] fixture.csv golden.txt
+//         warp_bench --record fixture.csv
+//
+//  A fixture is CSV with one row per face per frame: frame, face, then x0, y0 ... x67, y67 in
+//  dlib order. Every frame must hold the same number of faces. Lines starting with # are
+//  skipped. --record writes a synthetic sequence in this format; tracker output saved the same
+//  way replays unchanged. --update rewrites the golden file from this run instead of checking it.
+//
+
+#include <algorithm>
+#include <chrono>
+#include <cmath>
+#include <cstdio>
+#include <cstdlib>
+#include <cstring>
+#include <fstream>
+#include <map>
+#include <sstream>
+#include <string>
+#include <vector>
+
+#include "alloc_counter.h"
+#include "normalise_warp.h"
+#include "synthetic_faces.h"
+
+const int max_faces = 8;
+const double frame_rate = 30.0;
+// Outputs of every golden_stride-th frame go into the golden file.
+const int golden_stride = 15;
+const double initial_parameters[7] = {0.0, 1.0, 0.0, 1.0, 0.0, 0.0, 1.0};
+double fixed_scaling[6] = {1.02, 0.98, 0.95, 1.0, 0.96, 0.96};
+
+// The animated warps read the frame time through the warp clock.
+int current_frame = 0;
+
+double virtual_clock()
+{
+    return current_frame / frame_rate;
+}
+
+// Fixtures
+
+typedef std::vector<PhiPoint> frame_faces;
+
+bool load_fixture(const char * path, std::vector<frame_faces> &frames, int &num_faces)
+{
+    std::ifstream file(path);
+    if (!file)
+    {
+        fprintf(stderr, "cannot read %s\n", path);
+        return false;
+    }
+    std::map<int, std::map<int, std::vector<PhiPoint>>> rows;
+    std::string line;
+    while (std::getline(file, line))
+    {
+        if (line.empty() || line[0] == '#')
+        {
+            continue;
+        }
+        std::replace(line.begin(), line.end(), ',', ' ');
+        std::istringstream fields(line);
+        int frame, face;
+        std::vector<PhiPoint> points(68);
+        fields >> frame >> face;
+        for (int i = 0; i < 68; i++)
+        {
+            fields >> points[i].x >> points[i].y;
+        }
+        if (!fields || face < 0 || face >= max_faces)
+        {
+            fprintf(stderr, "%s: bad row for frame %d\n", path, frame);
+            return false;
+        }
+        rows[frame][face] = points;
+    }
+    num_faces = rows.empty() ? 0 : (int)rows.begin()->second.size();
+    for (const auto &frame : rows)
+    {
+        if ((int)frame.second.size() != num_faces || frame.second.rbegin()->first != num_faces - 1)
+        {
+            fprintf(stderr, "%s: frame %d does not hold faces 0 to %d\n", path, frame.first, num_faces - 1);
+            return false;
+        }
+        frame_faces faces;
+        for (const auto &face : frame.second)
+        {
+            faces.insert(faces.end(), face.second.begin(), face.second.end());
+        }
+        frames.push_back(faces);
+    }
+    if (num_faces < 2)
+    {
+        fprintf(stderr, "%s: the pair warps need at least two faces per frame\n", path);
+        return false;
+    }
+    return true;
+}
+
+// Three faces for 30 frames: turning, nodding, drifting, with a pixel of tracker noise.
+bool record_fixture(const char * path)
+{
+    FILE * file = fopen(path, "w");
+    if (!file)
+    {
+        fprintf(stderr, "cannot write %s\n", path);
+        return false;
+    }
+    fprintf(file, "# frame, face, x0, y0, ..., x67, y67\n");
+    const int num_faces = 3, num_frames = 30;
+    PhiPoint face[68];
+    for (int frame = 0; frame < num_frames; frame++)
+    {
+        const double t = frame / frame_rate;
+        for (int f = 0; f < num_faces; f++)
+        {
+            const double yaw = 0.3 * sin(2.0 * t + f) + 0.2 * (f - 1);
+            const double pitch = 0.1 * sin(3.0 * t + 2 * f);
+            const double roll = 0.05 * (f - 1) + 0.03 * sin(t);
+            make_face(face, yaw, pitch, roll, 1.8 + 0.3 * f, 320 + 320 * f + 10 * t, 380 + 15 * f, frame * num_faces + f + 1);
+            fprintf(file, "%d,%d", frame, f);
+            for (int i = 0; i < 68; i++)
+            {
+                fprintf(file, ",%d,%d", face[i].x, face[i].y);
+            }
+            fprintf(file, "\n");
+        }
+    }
+    fclose(file);
+    return true;
+}
+
+// Entry points
+
+// Warm starts, smoothing and calibration carried from frame to frame by one entry point.
+struct bench_state
+{
+    double parameters[max_faces][7];
+    double factrs[max_faces];
+    PhiWarpContext * contexts[max_faces];
+    PhiCalibrationAccumulator * calibration;
+};
+
+// Brackets the one call being measured: wall time, allocations and solver counters.
+struct call_meter
+{
+    void start()
+    {
+        warp_reset_stats();
+        news = new_calls.load();
+        mallocs = malloc_calls.load();
+        began = std::chrono::steady_clock::now();
+    }
+    void stop()
+    {
+        microseconds = std::chrono::duration<double, std::micro>(std::chrono::steady_clock::now() - began).count();
+        allocations = new_calls.load() - news + malloc_calls.load() - mallocs;
+        warp_get_stats(&stats);
+    }
+    std::chrono::steady_clock::time_point began;
+    long news;
+    long mallocs;
+    double microseconds;
+    long allocations;
+    PhiWarpStats stats;
+};
+
+struct bench_entry;
+
+// Runs one call on the frame's faces and writes its outputs as numbers, returning how many.
+// Outputs are pixels, except calibration scales, which are written in percent.
+typedef int (*bench_run)(const bench_entry &entry, bench_state &state, PhiPoint * faces, int num_faces, call_meter &meter, double * output);
+
+typedef PhiPoint * (*single_warp)(PhiPoint *, double *, double *);
+
+struct bench_entry
+{
+    std::string name;
+    bench_run run;
+    PhiWarpKind kind;
+    single_warp single;
+    bench_state state;
+    std::vector<double> latencies;
+    long allocations;
+    unsigned long pose_solves;
+    unsigned long solver_iterations;
+    unsigned long cost_evaluations;
+    unsigned long folded_triangles;
+};
+
+int write_points(const PhiPoint * points, int count, double * output)
+{
+    for (int i = 0; i < count; i++)
+    {
+        output[2 * i] = points[i].x;
+        output[2 * i + 1] = points[i].y;
+    }
+    return 2 * count;
+}
+
+int write_scales(const double * scaling, double * output)
+{
+    for (int i = 0; i < 6; i++)
+    {
+        output[i] = 100.0 * scaling[i];
+    }
+    return 6;
+}
+
+int run_single(const bench_entry &entry, bench_state &state, PhiPoint * faces, int num_faces, call_meter &meter, double * output)
+{
+    meter.start();
+    PhiPoint * result = entry.single(faces, state.parameters[0], &state.factrs[0]);
+    meter.stop();
+    const int count = write_points(result, 68, output);
+    free(result);
+    return count;
+}
+
+int run_adjusted(const bench_entry &entry, bench_state &state, PhiPoint * faces, int num_faces, call_meter &meter, double * output)
+{
+    meter.start();
+    PhiPoint * result = adjusted_warp(faces, faces + 68, state.parameters[0]);
+    meter.stop();
+    const int count = write_points(result, 68, output);
+    free(result);
+    return count;
+}
+
+int run_threed(const bench_entry &entry, bench_state &state, PhiPoint * faces, int num_faces, call_meter &meter, double * output)
+{
+    meter.start();
+    PhiPoint3D * result = threed_point_set(faces, state.parameters[0], &state.factrs[0]);
+    meter.stop();
+    for (int i = 0; i < 68; i++)
+    {
+        output[3 * i] = result[i].x;
+        output[3 * i + 1] = result[i].y;
+        output[3 * i + 2] = result[i].z;
+    }
+    free(result);
+    return 3 * 68;
+}
+
+int run_pair(const bench_entry &entry, bench_state &state, PhiPoint * faces, int num_faces, call_meter &meter, double * output)
+{
+    PhiPoint * (*pair_warp)(PhiPoint *, PhiPoint *, double *, double *, double *, double *) = entry.kind == PhiWarpDynamic ? face_puppet_warp : face_swap_warp;
+    meter.start();
+    PhiPoint * result = pair_warp(faces, faces + 68, state.parameters[0], state.parameters[1], &state.factrs[0], &state.factrs[1]);
+    meter.stop();
+    const int count = write_points(result, 2 * 68, output);
+    free(result);
+    return count;
+}
+
+int run_pair_into(const bench_entry &entry, bench_state &state, PhiPoint * faces, int num_faces, call_meter &meter, double * output)
+{
+    void (*pair_warp)(PhiPoint *, PhiPoint *, double *, double *, double *, double *, PhiPoint *) = entry.kind == PhiWarpDynamic ? face_puppet_warp_into : face_swap_warp_into;
+    PhiPoint result[2 * 68];
+    meter.start();
+    pair_warp(faces, faces + 68, state.parameters[0], state.parameters[1], &state.factrs[0], &state.factrs[1], result);
+    meter.stop();
+    return write_points(result, 2 * 68, output);
+}
+
+int run_calc_golden(const bench_entry &entry, bench_state &state, PhiPoint * faces, int num_faces, call_meter &meter, double * output)
+{
+    double scaling[6];
+    meter.start();
+    if (entry.kind == PhiWarpApplyGoldenInnerPretty)
+    {
+        calc_golden_inner_pretty(faces, state.parameters[0], &state.factrs[0], scaling);
+    }
+    else
+    {
+        calc_golden_inner_handsome(faces, state.parameters[0], &state.factrs[0], scaling);
+    }
+    meter.stop();
+    return write_scales(scaling, output);
+}
+
+int run_apply_golden(const bench_entry &entry, bench_state &state, PhiPoint * faces, int num_faces, call_meter &meter, double * output)
+{
+    meter.start();
+    PhiPoint * result = entry.kind == PhiWarpApplyGoldenInnerPretty
+        ? apply_golden_inner_pretty(faces, state.parameters[0], &state.factrs[0], fixed_scaling)
+        : apply_golden_inner_handsome(faces, state.parameters[0], &state.factrs[0], fixed_scaling);
+    meter.stop();
+    const int count = write_points(result, 68, output);
+    free(result);
+    return count;
+}
+
+int run_face_into(const bench_entry &entry, bench_state &state, PhiPoint * faces, int num_faces, call_meter &meter, double * output)
+{
+    PhiPoint result[68];
+    meter.start();
+    warp_face_into(entry.kind, faces, state.parameters[0], &state.factrs[0], fixed_scaling, result);
+    meter.stop();
+    return write_points(result, 68, output);
+}
+
+int run_faces_into(const bench_entry &entry, bench_state &state, PhiPoint * faces, int num_faces, call_meter &meter, double * output)
+{
+    PhiPoint result[max_faces * 68];
+    meter.start();
+    warp_faces_into(entry.kind, num_faces, faces, state.parameters[0], state.factrs, fixed_scaling, result);
+    meter.stop();
+    return write_points(result, num_faces * 68, output);
+}
+
+int run_context(const bench_entry &entry, bench_state &state, PhiPoint * faces, int num_faces, call_meter &meter, double * output)
+{
+    PhiPoint result[68];
+    meter.start();
+    warp_context_warp_into(state.contexts[0], entry.kind, faces, &state.factrs[0], result);
+    meter.stop();
+    return write_points(result, 68, output);
+}
+
+int run_context_vertices(const bench_entry &entry, bench_state &state, PhiPoint * faces, int num_faces, call_meter &meter, double * output)
+{
+    const float width = 1280.0f, height = 720.0f;
+    float alphas[4] = {1.0f, 0.5f, 1.0f, 1.0f};
+    PhiPoint warped[68];
+    PhiVertex vertices[68];
+    warp_context_warp_into(state.contexts[0], entry.kind, faces, &state.factrs[0], warped);
+    meter.start();
+    warp_context_vertices_into(state.contexts[0], width, height, alphas, vertices);
+    meter.stop();
+    // Back to pixels, so the golden tolerance means the same here as elsewhere.
+    for (int i = 0; i < 68; i++)
+    {
+        output[4 * i] = (vertices[i].x + 1.0f) * 0.5f * width;
+        output[4 * i + 1] = (1.0f - vertices[i].y) * 0.5f * height;
+        output[4 * i + 2] = vertices[i].u * width;
+        output[4 * i + 3] = vertices[i].v * height;
+    }
+    return 4 * 68;
+}
+
+int run_contexts(const bench_entry &entry, bench_state &state, PhiPoint * faces, int num_faces, call_meter &meter, double * output)
+{
+    PhiPoint result[max_faces * 68];
+    meter.start();
+    warp_contexts_warp_into(state.contexts, entry.kind, num_faces, faces, state.factrs, result);
+    meter.stop();
+    return write_points(result, num_faces * 68, output);
+}
+
+int run_contexts_swap(const bench_entry &entry, bench_state &state, PhiPoint * faces, int num_faces, call_meter &meter, double * output)
+{
+    PhiPoint result[max_faces * 68];
+    meter.start();
+    warp_contexts_swap_into(state.contexts, num_faces, faces, state.factrs, result);
+    meter.stop();
+    return write_points(result, num_faces * 68, output);
+}
+
+int run_calibration(const bench_entry &entry, bench_state &state, PhiPoint * faces, int num_faces, call_meter &meter, double * output)
+{
+    double scaling[6];
+    meter.start();
+    calibration_add_observation(state.calibration, faces);
+    calibration_estimate(state.calibration, scaling);
+    meter.stop();
+    output[0] = calibration_num_observations(state.calibration);
+    return 1 + write_scales(scaling, output + 1);
+}
+
+const PhiWarpKind all_kinds[] = {
+    PhiWarpAttractive, PhiWarpAttractivePretty, PhiWarpAttractiveHandsome, PhiWarpSilly, PhiWarpDynamic,
+    PhiWarpBigNose, PhiWarpBigLips, PhiWarpTiny, PhiWarpGoldenTotalPretty, PhiWarpGoldenTotalHandsome,
+    PhiWarpGoldenInnerPretty, PhiWarpGoldenInnerHandsome, PhiWarpApplyGoldenInnerPretty, PhiWarpApplyGoldenInnerHandsome
+};
+
+const char * kind_names[] = {
+    "attractive", "attractive_pretty", "attractive_handsome", "silly", "dynamic",
+    "bignose", "biglips", "tiny", "golden_total_pretty", "golden_total_handsome",
+    "golden_inner_pretty", "golden_inner_handsome", "apply_golden_inner_pretty", "apply_golden_inner_handsome"
+};
+
+const int num_kinds = sizeof(all_kinds) / sizeof(all_kinds[0]);
+
+struct single_case
+{
+    const char * name;
+    single_warp warp;
+};
+
+const single_case single_warps[] = {
+    {"attractive_adjusted_warp", attractive_adjusted_warp},
+    {"attractive_adjusted_warp_pretty", attractive_adjusted_warp_pretty},
+    {"attractive_adjusted_warp_handsome", attractive_adjusted_warp_handsome},
+    {"silly_adjusted_warp", silly_adjusted_warp},
+    {"bignose_adjusted_warp", bignose_adjusted_warp},
+    {"dynamic_adjusted_warp", dynamic_adjusted_warp},
+    {"biglips_adjusted_warp", biglips_adjusted_warp},
+    {"tiny_face_warp", tiny_face_warp},
+    {"golden_total_pretty", golden_total_pretty},
+    {"golden_total_handsome", golden_total_handsome},
+    {"golden_inner_pretty", golden_inner_pretty},
+    {"golden_inner_handsome", golden_inner_handsome}
+};
+
+void add_entry(std::vector<bench_entry> &entries, const std::string &name, bench_run run, PhiWarpKind kind, single_warp single = NULL)
+{
+    bench_entry entry;
+    entry.name = name;
+    entry.run = run;
+    entry.kind = kind;
+    entry.single = single;
+    entry.allocations = 0;
+    entry.pose_solves = entry.solver_iterations = entry.cost_evaluations = entry.folded_triangles = 0;
+    for (int face = 0; face < max_faces; face++)
+    {
+        std::copy(initial_parameters, initial_parameters + 7, entry.state.parameters[face]);
+        entry.state.factrs[face] = 0.0;
+        entry.state.contexts[face] = warp_context_create();
+        warp_context_set_scaling(entry.state.contexts[face], fixed_scaling);
+    }
+    entry.state.calibration = calibration_create(PhiWarpApplyGoldenInnerHandsome);
+    entries.push_back(entry);
+}
+
+// The puppet forms are told apart from the swaps by kind PhiWarpDynamic, the calibration forms
+// by the pretty or handsome apply kind.
+std::vector<bench_entry> all_entries()
+{
+    std::vector<bench_entry> entries;
+    for (const single_case &single : single_warps)
+    {
+        add_entry(entries, single.name, run_single, PhiWarpAttractive, single.warp);
+    }
+    add_entry(entries, "adjusted_warp", run_adjusted, PhiWarpAttractive);
+    add_entry(entries, "threed_point_set", run_threed, PhiWarpAttractive);
+    add_entry(entries, "face_swap_warp", run_pair, PhiWarpAttractive);
+    add_entry(entries, "face_puppet_warp", run_pair, PhiWarpDynamic);
+    add_entry(entries, "calc_golden_inner_pretty", run_calc_golden, PhiWarpApplyGoldenInnerPretty);
+    add_entry(entries, "calc_golden_inner_handsome", run_calc_golden, PhiWarpApplyGoldenInnerHandsome);
+    add_entry(entries, "apply_golden_inner_pretty", run_apply_golden, PhiWarpApplyGoldenInnerPretty);
+    add_entry(entries, "apply_golden_inner_handsome", run_apply_golden, PhiWarpApplyGoldenInnerHandsome);
+    add_entry(entries, "face_swap_warp_into", run_pair_into, PhiWarpAttractive);
+    add_entry(entries, "face_puppet_warp_into", run_pair_into, PhiWarpDynamic);
+    for (int k = 0; k < num_kinds; k++)
+    {
+        add_entry(entries, std::string("warp_face_into/") + kind_names[k], run_face_into, all_kinds[k]);
+    }
+    add_entry(entries, "warp_faces_into/silly", run_faces_into, PhiWarpSilly);
+    for (int k = 0; k < num_kinds; k++)
+    {
+        add_entry(entries, std::string("warp_context_warp_into/") + kind_names[k], run_context, all_kinds[k]);
+    }
+    add_entry(entries, "warp_context_vertices_into", run_context_vertices, PhiWarpBigNose);
+    add_entry(entries, "warp_contexts_warp_into/tiny", run_contexts, PhiWarpTiny);
+    add_entry(entries, "warp_contexts_swap_into", run_contexts_swap, PhiWarpAttractive);
+    add_entry(entries, "calibration", run_calibration, PhiWarpApplyGoldenInnerHandsome);
+    return entries;
+}
+
+void destroy_entries(std::vector<bench_entry> &entries)
+{
+    for (bench_entry &entry : entries)
+    {
+        for (int face = 0; face < max_faces; face++)
+        {
+            warp_context_destroy(entry.state.contexts[face]);
+        }
+        calibration_destroy(entry.state.calibration);
+    }
+}
+
+// Golden files: one line per entry and golden frame, "name frame count values...".
+
+typedef std::map<std::string, std::vector<double>> golden_outputs;
+
+std::string golden_key(const std::string &name, int frame)
+{
+    return name + " " + std::to_string(frame);
+}
+
+bool load_golden(const char * path, golden_outputs &golden)
+{
+    std::ifstream file(path);
+    if (!file)
+    {
+        fprintf(stderr, "cannot read %s; run with --update to create it\n", path);
+        return false;
+    }
+    std::string line;
+    while (std::getline(file, line))
+    {
+        if (line.empty() || line[0] == '#')
+        {
+            continue;
+        }
+        std::istringstream fields(line);
+        std::string name;
+        int frame, count;
+        fields >> name >> frame >> count;
+        std::vector<double> values(count);
+        for (double &value : values)
+        {
+            fields >> value;
+        }
+        if (!fields)
+        {
+            fprintf(stderr, "%s: bad line for %s\n", path, name.c_str());
+            return false;
+        }
+        golden[golden_key(name, frame)] = values;
+    }
+    return true;
+}
+
+bool save_golden(const char * path, const char * fixture, const golden_outputs &outputs)
+{
+    FILE * file = fopen(path, "w");
+    if (!file)
+    {
+        fprintf(stderr, "cannot write %s\n", path);
+        return false;
+    }
+    fprintf(file, "# warp_bench outputs for %s, every %d frames: entry frame count values...\n", fixture, golden_stride);
+    for (const auto &output : outputs)
+    {
+        fprintf(file, "%s %zu", output.first.c_str(), output.second.size());
+        for (double value : output.second)
+        {
+            if (value == std::floor(value))
+            {
+                fprintf(file, " %.0f", value);
+            }
+            else
+            {
+                fprintf(file, " %.3f", value);
+            }
+        }
+        fprintf(file, "\n");
+    }
+    fclose(file);
+    return true;
+}
+
+// Returns the number of outputs further than tolerance from the golden file, or missing.
+int diff_golden(const golden_outputs &golden, const golden_outputs &outputs, double tolerance)
+{
+    int failures = 0;
+    double largest = 0.0;
+    for (const auto &output : outputs)
+    {
+        const auto expected = golden.find(output.first);
+        if (expected == golden.end() || expected->second.size() != output.second.size())
+        {
+            printf("FAIL %s: not in the golden file with %zu values\n", output.first.c_str(), output.second.size());
+            failures++;
+            continue;
+        }
+        for (size_t i = 0; i < output.second.size(); i++)
+        {
+            const double difference = std::fabs(output.second[i] - expected->second[i]);
+            largest = std::max(largest, difference);
+            // Golden values are stored to three decimals.
+            if (difference > tolerance + 0.0005)
+            {
+                printf("FAIL %s: value %zu is %.3f, golden %.3f\n", output.first.c_str(), i, output.second[i], expected->second[i]);
+                failures++;
+                break;
+            }
+        }
+    }
+    for (const auto &expected : golden)
+    {
+        if (outputs.find(expected.first) == outputs.end())
+        {
+            printf("FAIL %s: in the golden file but not produced\n", expected.first.c_str());
+            failures++;
+        }
+    }
+    printf("%zu golden outputs, largest difference %.3f (tolerance %.3f)\n", golden.size(), largest, tolerance);
+    return failures;
+}
+
+double percentile(const std::vector<double> &sorted, double fraction)
+{
+    const size_t index = std::min(sorted.size() - 1, (size_t)(fraction * sorted.size()));
+    return sorted[index];
+}
+
+void report(const std::vector<bench_entry> &entries)
+{
+    printf("%-50s %6s %8s %8s %8s %8s %7s %7s %7s %6s %6s\n", "entry point (us; counts per call)", "calls", "p50", "p90", "p99", "max", "solves", "iters", "evals", "folds", "allocs");
+    for (const bench_entry &entry : entries)
+    {
+        std::vector<double> sorted = entry.latencies;
+        std::sort(sorted.begin(), sorted.end());
+        const double calls = (double)sorted.size();
+        printf("%-50s %6zu %8.1f %8.1f %8.1f %8.1f %7.2f %7.1f %7.1f %6.2f %6.2f\n", entry.name.c_str(), sorted.size(),
+               percentile(sorted, 0.5), percentile(sorted, 0.9), percentile(sorted, 0.99), sorted.back(),
+               entry.pose_solves / calls, entry.solver_iterations / calls, entry.cost_evaluations / calls,
+               entry.folded_triangles / calls, entry.allocations / calls);
+    }
+}
+
+int main(int argc, char ** argv)
+{
+    bool update = false;
+    double tolerance = 1.0;
+    int repeat = 1;
+    std::vector<const char *> paths;
+    for (int i = 1; i < argc; i++)
+    {
+        if (strcmp(argv[i], "--record") == 0 && i + 1 < argc)
+        {
+            return record_fixture(argv[i + 1]) ? 0 : 1;
+        }
+        else if (strcmp(argv[i], "--update") == 0)
+        {
+            update = true;
+        }
+        else if (strcmp(argv[i], "--tolerance") == 0 && i + 1 < argc)
+        {
+            tolerance = atof(argv[++i]);
+        }
+        else if (strcmp(argv[i], "--repeat") == 0 && i + 1 < argc)
+        {
+            repeat = std::max(1, atoi(argv[++i]));
+        }
+        else
+        {
+            paths.push_back(argv[i]);
+        }
+    }
+    if (paths.size() != 2)
+    {
+        fprintf(stderr, "usage: %s [--update] [--tolerance px] [--repeat n] fixture.csv golden.txt\n       %s --record fixture.csv\n", argv[0], argv[0]);
+        return 2;
+    }
+
+    std::vector<frame_faces> frames;
+    int num_faces = 0;
+    if (!load_fixture(paths[0], frames, num_faces))
+    {
+        return 2;
+    }
+
+    warp_set_clock(virtual_clock);
+    std::vector<bench_entry> entries = all_entries();
+    golden_outputs outputs;
+    std::vector<double> output(max_faces * 68 * 4);
+    call_meter meter;
+    for (int pass = 0; pass < repeat; pass++)
+    {
+        for (int frame = 0; frame < (int)frames.size(); frame++)
+        {
+            current_frame = pass * (int)frames.size() + frame;
+            for (bench_entry &entry : entries)
+            {
+                const int count = entry.run(entry, entry.state, &frames[frame][0], num_faces, meter, &output[0]);
+                entry.latencies.push_back(meter.microseconds);
+                entry.allocations += meter.allocations;
+                entry.pose_solves += meter.stats.pose_solves;
+                entry.solver_iterations += meter.stats.solver_iterations;
+                entry.cost_evaluations += meter.stats.cost_evaluations;
+                entry.folded_triangles += meter.stats.folded_triangles;
+                // Only the first pass starts from a fresh state, so only it is compared.
+                if (pass == 0 && frame % golden_stride == 0)
+                {
+                    outputs[golden_key(entry.name, frame)].assign(output.begin(), output.begin() + count);
+                }
+            }
+        }
+    }
+    warp_set_clock(NULL);
+
+    printf("%s: %zu frames of %d faces, %d pass%s\n", paths[0], frames.size(), num_faces, repeat, repeat == 1 ? "" : "es");
+    report(entries);
+    destroy_entries(entries);
+
+    if (update)
+    {
+        if (!save_golden(paths[1], paths[0], outputs))
+        {
+            return 2;
+        }
+        printf("wrote %zu outputs to %s\n", outputs.size(), paths[1]);
+        return 0;
+    }
+    golden_outputs golden;
+    if (!load_golden(paths[1], golden))
+    {
+        return 2;
+    }
+    return diff_golden(golden, outputs, tolerance) ? 1 : 0;
+}